@@ -0,0 +1,73 @@
+#include <string>
+#include <vector>
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_all.hpp>
+#include <fmt/format.h>
+
+#include "synthetic.hpp"
+
+namespace {
+/*! Ring large enough for all the records of a single drain. */
+constexpr std::size_t c_num_pages = 64;
+
+/*******************************************************************************
+ * @brief Offset of the first of @p num_records records.
+ *
+ * @param wrapped Whether the records straddle the end of the ring, one of them
+ *  split in the middle of its payload.
+ ******************************************************************************/
+std::uint64_t
+start_offset(const MockRing& ring, std::size_t num_records, bool wrapped) {
+    const auto ring_size = ring.num_pages() * elphi::c_page_size;
+    if (!wrapped)
+        return 0;
+    return ring_size - (num_records / 2) * c_sample_record_size - 16;
+}
+} // namespace
+
+TEST_CASE("Reading records from the ring buffer", "[bench][perf_events]") {
+    // Records available per wakeup, from a mostly idle to a saturated ring.
+    const std::size_t num_records = GENERATE(16, 512, 4096);
+    const bool wrapped = GENERATE(false, true);
+    const auto suffix = fmt::format("{} records{}", num_records, wrapped ? ", wrapped" : "");
+
+    MockRing ring{c_num_pages};
+    const auto start = start_offset(ring, num_records, wrapped);
+    fill_ring(ring, num_records, start, 4);
+    auto events = ring.open_events();
+
+    BENCHMARK_ADVANCED("get_perf_event " + suffix)(Catch::Benchmark::Chronometer meter) {
+        elphi::Buffer dest;
+        meter.measure([&] {
+            ring.rewind(start);
+            std::size_t num_read = 0;
+            while (events.get_perf_event(&dest, false))
+                ++num_read;
+            return num_read;
+        });
+    };
+
+    BENCHMARK_ADVANCED("drain_perf_events " + suffix)(Catch::Benchmark::Chronometer meter) {
+        meter.measure([&] {
+            ring.rewind(start);
+            std::size_t num_bytes = 0;
+            events.drain_perf_events(
+                [&num_bytes](const elphi::PerfRecord& record) { num_bytes += record.payload.size(); });
+            return num_bytes;
+        });
+    };
+}
+
+TEST_CASE("Copying out of the ring buffer", "[bench][utils]") {
+    const std::size_t size = GENERATE(64, 4096);
+    const bool wrapped = GENERATE(false, true);
+
+    elphi::Buffer ring(c_num_pages * elphi::c_page_size);
+    elphi::Buffer dest(size);
+    const auto offset = wrapped ? ring.size() - size / 2 : 0;
+
+    BENCHMARK(fmt::format("move_wrapped {} bytes{}", size, wrapped ? ", wrapped" : "")) {
+        return elphi::move_wrapped(ring, offset, dest);
+    };
+}
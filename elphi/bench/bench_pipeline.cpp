@@ -0,0 +1,48 @@
+#include <vector>
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_all.hpp>
+#include <elphi/perf_records.hpp>
+#include <elphi/sample_merger.hpp>
+#include <elphi/spsc_queue.hpp>
+#include <fmt/format.h>
+
+#include "synthetic.hpp"
+
+using namespace std::chrono_literals;
+
+TEST_CASE("Sampling pipeline", "[bench][sampling]") {
+    // Single-threaded replica of the session's hot path: a reader drains the
+    // ring into its queue, the consumer merges the CPUs into time order.
+    constexpr std::size_t c_num_cpus = 4;
+    constexpr std::size_t c_num_pages = 64;
+    const std::size_t num_records = GENERATE(512, 4096);
+    const std::size_t run_length = GENERATE(1, 64);
+
+    MockRing ring{c_num_pages};
+    fill_ring(ring, num_records, 0, c_num_cpus, run_length);
+    auto events = ring.open_events();
+
+    elphi::SpscQueue<elphi::CpuSample> queue{num_records};
+    elphi::SampleMerger merger{c_num_cpus, 1ms};
+    std::vector<elphi::CpuSample> batch;
+    batch.reserve(num_records);
+
+    BENCHMARK_ADVANCED(fmt::format("drain, parse and merge {} records, runs of {}", num_records, run_length))
+    (Catch::Benchmark::Chronometer meter) {
+        meter.measure([&] {
+            ring.rewind(0);
+            events.drain_perf_events([&queue](const elphi::PerfRecord& record) {
+                if (auto sample = elphi::parse_sample(record))
+                    (void)queue.try_push(*sample);
+            });
+            queue.consume([&merger](std::span<const elphi::CpuSample> samples) {
+                for (const auto& sample : samples)
+                    merger.push(sample.cpu, std::span{&sample, 1});
+            });
+            batch.clear();
+            merger.flush([&batch](const elphi::CpuSample& sample) { batch.push_back(sample); });
+            return batch.size();
+        });
+    };
+}
@@ -0,0 +1,63 @@
+#include <cinttypes>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_all.hpp>
+#include <elphi/symbolizer.hpp>
+#include <fmt/format.h>
+#include <unistd.h>
+
+namespace {
+/*******************************************************************************
+ * @brief Random addresses in the executable mappings of this binary.
+ ******************************************************************************/
+std::vector<std::uint64_t>
+random_self_ips(std::size_t num) {
+    const auto self = std::filesystem::read_symlink("/proc/self/exe").string();
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> ranges;
+    std::ifstream maps{"/proc/self/maps"};
+    for (std::string line; std::getline(maps, line);) {
+        std::uint64_t start = 0;
+        std::uint64_t end = 0;
+        char perms[5] = {}; // NOLINT - sscanf target.
+        if (std::sscanf(line.c_str(), "%" SCNx64 "-%" SCNx64 " %4s", &start, &end, perms) == 3 && perms[2] == 'x' &&
+            line.ends_with(self))
+            ranges.emplace_back(start, end);
+    }
+    REQUIRE(!ranges.empty());
+
+    std::mt19937_64 gen{42};
+    std::vector<std::uint64_t> ips;
+    ips.reserve(num);
+    for (std::size_t i = 0; i < num; ++i) {
+        const auto& [start, end] = ranges[i % ranges.size()];
+        ips.push_back(std::uniform_int_distribution<std::uint64_t>{start, end - 1}(gen));
+    }
+    return ips;
+}
+} // namespace
+
+TEST_CASE("Symbolization", "[bench][symbols]") {
+    constexpr std::size_t c_num_ips = 1 << 16;
+    const auto ips = random_self_ips(c_num_ips);
+    const auto pid = static_cast<elphi::ProcId>(::getpid());
+
+    auto cache = std::make_shared<elphi::SymbolCache>();
+    elphi::Symbolizer symbolizer{cache};
+    // Index the binary outside of the measurement.
+    (void)symbolizer.symbolize(pid, ips.front());
+
+    BENCHMARK(fmt::format("symbolize {} addresses", c_num_ips)) {
+        std::size_t resolved = 0;
+        for (auto ip : ips)
+            resolved += symbolizer.symbolize(pid, ip).has_value() ? 1 : 0;
+        return resolved;
+    };
+
+    BENCHMARK("index this binary") { return elphi::ElfSymbols{elphi::MappedFile{"/proc/self/exe"}}.size(); };
+}
@@ -0,0 +1,144 @@
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_all.hpp>
+#include <elphi/sample_table.hpp>
+#include <elphi/time_index.hpp>
+#include <elphi/timeline_lod.hpp>
+#include <elphi/timeline_view.hpp>
+#include <elphi/trace_export.hpp>
+#include <elphi/usage.hpp>
+#include <fmt/format.h>
+
+#include "synthetic.hpp"
+
+TEST_CASE("Generating timelines", "[bench][view]") {
+    constexpr std::size_t c_num_samples = 1 << 18;
+    // Context switches from every sample to rarely.
+    const std::size_t run_length = GENERATE(1, 16, 1024);
+
+    elphi::CpuSamplingResult result{.samples = make_samples(c_num_samples, 8, run_length)};
+    for (elphi::ProcId pid = 100; pid < 121; ++pid)
+        result.set_process_name(pid, fmt::format("proc{}", pid));
+
+    BENCHMARK(fmt::format("gen_cpu_timelines, runs of {}", run_length)) {
+        return elphi::view::gen_cpu_timelines(result);
+    };
+
+    BENCHMARK(fmt::format("gen_group_timelines, runs of {}", run_length)) {
+        return elphi::view::gen_group_timelines(result);
+    };
+}
+
+TEST_CASE("Querying time ranges", "[bench][view][index]") {
+    constexpr std::size_t c_num_samples = 1 << 20;
+    constexpr std::size_t c_num_queries = 256;
+    elphi::CpuSamplingResult result{.samples = make_samples(c_num_samples, 8, 1)};
+    const auto timeline = elphi::view::gen_cpu_timelines(result);
+    const auto& slices = timeline.at(0);
+    const auto last = slices.back().end_time.count();
+
+    std::vector<elphi::TimePoint> froms;
+    for (std::size_t i = 0; i < c_num_queries; ++i)
+        froms.emplace_back(static_cast<std::int64_t>(i * 7919 * 1000) % last);
+    // Viewport of a thousand slices.
+    const elphi::TimePoint width{8 * 1000 * 1000};
+
+    const elphi::view::TimelineIndex index{timeline};
+    BENCHMARK(fmt::format("{} indexed queries", c_num_queries)) {
+        std::size_t found = 0;
+        for (auto from : froms)
+            found += index.overlapping(0, from, from + width).size();
+        return found;
+    };
+    BENCHMARK(fmt::format("{} scanned queries", c_num_queries)) {
+        std::size_t found = 0;
+        for (auto from : froms)
+            for (const auto& slice : slices)
+                found += slice.end_time >= from && slice.begin_time <= from + width ? 1 : 0;
+        return found;
+    };
+    BENCHMARK("index a timeline") { return elphi::view::TimelineIndex{timeline}; };
+
+    const elphi::view::SampleIndex samples{result.samples};
+    const std::vector<elphi::CpuId> cpus{3};
+    BENCHMARK(fmt::format("{} sample queries of a CPU", c_num_queries)) {
+        std::size_t found = 0;
+        for (auto from : froms)
+            found += samples.for_each(from, from + width, cpus, [](const elphi::CpuSample&) {});
+        return found;
+    };
+}
+
+TEST_CASE("Timeline pyramid", "[bench][view][lod]") {
+    constexpr std::size_t c_num_samples = 1 << 18;
+    constexpr std::size_t c_screen_width = 200;
+    // Samples 1us apart, base buckets of 10 samples of each CPU.
+    const elphi::view::LodConfig config{.base_width = std::chrono::microseconds{80}};
+    elphi::CpuSamplingResult result{.samples = make_samples(c_num_samples, 8, 16)};
+
+    BENCHMARK("build pyramid") { return elphi::view::gen_timeline_pyramid(result, config); };
+    BENCHMARK("build timeline") { return elphi::view::gen_cpu_timelines(result); };
+
+    const auto pyramid = elphi::view::gen_timeline_pyramid(result, config);
+    const auto last = result.samples.back().time;
+    BENCHMARK(fmt::format("view of all CPUs, {} columns", c_screen_width)) {
+        std::size_t read = 0;
+        for (elphi::CpuId cpu = 0; cpu < 8; ++cpu)
+            read += pyramid.view(cpu, elphi::TimePoint::zero(), last, c_screen_width).buckets.size();
+        return read;
+    };
+}
+
+TEST_CASE("Aggregating usage", "[bench][view][usage]") {
+    constexpr std::size_t c_num_samples = 1 << 18;
+    // Samples 1us apart, the window slides every 4096 samples.
+    const elphi::view::UsageConfig config{.bucket_width = std::chrono::microseconds{4096}, .num_buckets = 8};
+    elphi::CpuSamplingResult result{.samples = make_samples(c_num_samples, 8, 16)};
+
+    BENCHMARK(fmt::format("add {} samples", c_num_samples)) {
+        elphi::view::UsageAggregator usage{config};
+        usage.add(result.samples);
+        return usage.num_threads();
+    };
+
+    elphi::view::UsageAggregator usage{config};
+    usage.add(result.samples);
+    BENCHMARK("top 10 threads") { return usage.top_threads(10); };
+}
+
+TEST_CASE("Exporting traces", "[bench][view][trace_export]") {
+    constexpr std::size_t c_num_samples = 1 << 18;
+    elphi::CpuSamplingResult result{.samples = make_samples(c_num_samples, 8, 1)};
+    const auto timeline = elphi::view::gen_cpu_timelines(result);
+    std::size_t num_slices = 0;
+    for (const auto& [cpu, slices] : timeline)
+        num_slices += slices.size();
+
+    // Formatting cost only, the disk is not measured.
+    BENCHMARK(fmt::format("{} slices to Chrome JSON", num_slices)) {
+        elphi::view::export_trace(timeline, result.names, "/dev/null", elphi::view::TraceFormat::chrome_json);
+    };
+    BENCHMARK(fmt::format("{} slices to Perfetto", num_slices)) {
+        elphi::view::export_trace(timeline, result.names, "/dev/null", elphi::view::TraceFormat::perfetto);
+    };
+}
+
+TEST_CASE("Scanning sample columns", "[bench][view][sample_table]") {
+    constexpr std::size_t c_num_samples = 1 << 20;
+    elphi::CpuSamplingResult result{.samples = make_samples(c_num_samples, 8, 16)};
+    const elphi::view::SampleTable table{result.samples};
+    const elphi::view::SampleFilter filter{.pid = 105, .tid = std::nullopt, .cpu = 3,
+                                              .from = elphi::TimePoint::min(), .to = elphi::TimePoint::max()};
+
+    BENCHMARK(fmt::format("count {} samples of a thread on a CPU, array of structs", c_num_samples)) {
+        std::size_t found = 0;
+        for (const auto& sample : result.samples)
+            found += sample.pid == filter.pid && sample.cpu == filter.cpu ? 1 : 0;
+        return found;
+    };
+    using enum elphi::view::ScanKernel;
+    for (const auto& [kernel, name] : {std::pair{scalar, "scalar"}, std::pair{sse2, "SSE2"}, std::pair{avx2, "AVX2"}}) {
+        BENCHMARK(fmt::format("count {} samples of a thread on a CPU, {} columns", c_num_samples, name)) {
+            return table.count(filter, kernel);
+        };
+    }
+}
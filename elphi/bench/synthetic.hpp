@@ -0,0 +1,72 @@
+/*******************************************************************************
+ * Synthetic inputs for the benchmarks.
+ ******************************************************************************/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <linux/perf_event.h>
+
+#include <elphi/cpu_sampler.hpp>
+
+#include "mock_ring.hpp"
+
+/*******************************************************************************
+ * @brief Sample record as written by the kernel for @ref elphi::c_sample_type.
+ ******************************************************************************/
+struct RawSample {
+    std::uint32_t pid;
+    std::uint32_t tid;
+    std::uint64_t time;
+    std::uint64_t addr;
+    std::uint32_t cpu;
+    std::uint32_t cpu_pad;
+};
+
+/*! Size of a whole sample record in the ring. */
+inline constexpr std::size_t c_sample_record_size = sizeof(perf_event_header) + sizeof(RawSample);
+
+/*******************************************************************************
+ * @brief Write @p num_records samples of @p num_cpus CPUs into @p ring .
+ *
+ * @param start Offset of the first record, records wrap around the end of the
+ *  ring if close to it.
+ * @param run_length Number of consecutive samples of the same thread.
+ ******************************************************************************/
+inline void
+fill_ring(MockRing& ring, std::size_t num_records, std::uint64_t start, std::size_t num_cpus,
+          std::size_t run_length = 16) {
+    ring.reset_to(start);
+    for (std::size_t i = 0; i < num_records; ++i) {
+        const auto pid = static_cast<std::uint32_t>(100 + (i / run_length) % 13);
+        ring.write_pod(PERF_RECORD_SAMPLE, RawSample{.pid = pid,
+                                                     .tid = pid,
+                                                     .time = 1000 * i,
+                                                     .addr = 0,
+                                                     .cpu = static_cast<std::uint32_t>(i % num_cpus),
+                                                     .cpu_pad = 0});
+    }
+}
+
+/*******************************************************************************
+ * @brief Time-ordered samples of @p num_cpus CPUs.
+ *
+ * @param run_length Number of consecutive samples of the same thread on a CPU.
+ ******************************************************************************/
+inline std::vector<elphi::CpuSample>
+make_samples(std::size_t num_samples, std::size_t num_cpus, std::size_t run_length) {
+    std::vector<elphi::CpuSample> samples;
+    samples.reserve(num_samples);
+    for (std::size_t i = 0; i < num_samples; ++i) {
+        const auto cpu = i % num_cpus;
+        const auto pid = static_cast<elphi::ProcId>(100 + cpu + (i / num_cpus / run_length) % 13);
+        samples.push_back({.pid = pid,
+                           .tid = pid,
+                           .cpu = cpu,
+                           .time = elphi::TimePoint{1000 * i},
+                           .cgroup = pid % 4});
+    }
+    return samples;
+}
@@ -0,0 +1,105 @@
+/*******************************************************************************
+ * @file call_tree.hpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license This file is released under ElPhi project's license, see LICENSE.
+ *
+ * Aggregation of sampled call stacks into a calling-context tree.
+ ******************************************************************************/
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace elphi {
+
+/*! Id of a node of @ref CallTree, i.e. of a unique call stack. */
+using StackId = std::uint32_t;
+
+/*! Id of the root, the empty stack, present in every tree. */
+inline constexpr StackId c_root_stack = 0;
+
+/*******************************************************************************
+ * @brief Calling-context tree of unique call stacks.
+ *
+ * Each node is a call stack, identified by its caller's node and the
+ * instruction pointer of the innermost frame. Nodes are hash-consed, equal
+ * stacks map to the same node, thus the memory grows only with the number of
+ * unique stacks. Nodes are never removed and created in order of their ids,
+ * parents before children.
+ ******************************************************************************/
+class CallTree {
+public:
+    /*******************************************************************************
+     * @brief Single frame of a call stack.
+     ******************************************************************************/
+    struct Node {
+        /*! Instruction pointer of the frame, zero for the root. */
+        std::uint64_t ip = 0;
+        /*! The calling frame, the root is its own parent. */
+        StackId parent = c_root_stack;
+        /*! Number of frames of the stack. */
+        std::uint32_t depth = 0;
+    };
+
+    /*******************************************************************************
+     * @brief Create tree with only the root.
+     ******************************************************************************/
+    CallTree();
+
+    /*******************************************************************************
+     * @brief Get node of stack @p parent called into @p ip , create it if not present.
+     ******************************************************************************/
+    StackId
+    child(StackId parent, std::uint64_t ip);
+
+    /*******************************************************************************
+     * @brief Get node of stack @p ips , creating the missing frames.
+     *
+     * @param ips Instruction pointers from the innermost frame to the outermost
+     *  caller, as in perf callchains.
+     ******************************************************************************/
+    StackId
+    intern(std::span<const std::uint64_t> ips);
+
+    /*******************************************************************************
+     * @brief Node @p id , must exist.
+     ******************************************************************************/
+    const Node&
+    node(StackId id) const noexcept {
+        return m_nodes[id];
+    }
+
+    /*******************************************************************************
+     * @brief Number of nodes, including the root.
+     ******************************************************************************/
+    std::size_t
+    size() const noexcept {
+        return m_nodes.size();
+    }
+
+private:
+    /*! Unique key of a non-root node. */
+    struct Key {
+        StackId parent;
+        std::uint64_t ip;
+
+        friend bool
+        operator==(const Key&, const Key&) = default;
+    };
+
+    /*! Hash of @ref Key. */
+    struct KeyHash {
+        std::size_t
+        operator()(const Key& key) const noexcept {
+            return std::hash<std::uint64_t>{}(key.ip ^ (std::uint64_t{key.parent} * 0x9E3779B97F4A7C15ULL));
+        }
+    };
+
+    /*! Nodes indexed by their ids. */
+    std::vector<Node> m_nodes;
+    /*! Maps frames to their nodes. */
+    std::unordered_map<Key, StackId, KeyHash> m_index;
+};
+} // namespace elphi
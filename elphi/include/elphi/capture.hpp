@@ -0,0 +1,330 @@
+/*******************************************************************************
+ * @file capture.hpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license This file is released under ElPhi project's license, see LICENSE.
+ *
+ * Compact on-disk format for captured samples.
+ *
+ * The file starts with a header followed by a sequence of blocks. Sample
+ * blocks hold samples of a single CPU in columns:
+ *  - dictionary of distinct (pid,tid,cgroup,kind,stack) tuples of the block,
+ *  - varint-encoded time deltas to the previous sample,
+ *  - varint-encoded indices into the dictionary,
+ *  - optional varint-encoded counter values of each sample.
+ * Name blocks hold (pid, name) string table entries, group blocks hold
+ * (cgroup, path) entries. Stack blocks hold (id, parent, ip, symbol) nodes of
+ * the calling-context tree in order of their ids, written on closing, and the
+ * counters block lists the counters of the values column. Version
+ * 1 files without cgroups, version 2 files without context switches and
+ * version 3 files without call stacks are still readable.
+ ******************************************************************************/
+#pragma once
+
+#include <concepts>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <elphi/call_tree.hpp>
+#include <elphi/cpu_sampler.hpp>
+#include <elphi/file_descriptor.hpp>
+#include <elphi/utils.hpp>
+
+namespace elphi {
+
+/*******************************************************************************
+ * @brief Streaming writer of capture files.
+ *
+ * Samples are buffered per CPU and written in blocks, the memory usage is
+ * bounded by the number of CPUs.
+ ******************************************************************************/
+class CaptureWriter {
+public:
+    /*! Maximum number of samples in a single block. */
+    static constexpr std::size_t c_block_samples = 4096;
+
+    /*******************************************************************************
+     * @brief Create or truncate capture file at @p path .
+     *
+     * @throw ElphiException if the file cannot be opened.
+     ******************************************************************************/
+    explicit CaptureWriter(const std::string& path);
+
+    /*******************************************************************************
+     * @brief Move-only.
+     ******************************************************************************/
+    CaptureWriter(const CaptureWriter&) = delete;
+
+    /*******************************************************************************
+     * @brief Reclaim @p other writer, left in undetermined state.
+     ******************************************************************************/
+    CaptureWriter(CaptureWriter&& other) noexcept = default;
+
+    /*******************************************************************************
+     * @brief Move-only.
+     ******************************************************************************/
+    CaptureWriter&
+    operator=(const CaptureWriter&) = delete;
+
+    /*******************************************************************************
+     * @brief Reclaim @p other writer, left in undetermined state.
+     ******************************************************************************/
+    CaptureWriter&
+    operator=(CaptureWriter&& other) noexcept = default;
+
+    /*******************************************************************************
+     * @brief Close the file, errors are ignored.
+     ******************************************************************************/
+    ~CaptureWriter();
+
+    /*******************************************************************************
+     * @brief Append @p samples to the capture.
+     *
+     * Samples of each CPU must be ordered by time, e.g. a @ref SampleSink batch.
+     * Their stacks must be recorded by @ref write_stack before closing.
+     *
+     * @param values Counted events of the samples, i-th values of the i-th sample,
+     *  e.g. a @ref CounterSink batch. Kept only after @ref write_counters, missing
+     *  values are zero.
+     * @throw ElphiException on write errors or if @p values do not match @p samples .
+     ******************************************************************************/
+    void
+    write(std::span<const CpuSample> samples, std::span<const CounterValues> values = {});
+
+    /*******************************************************************************
+     * @brief Record @p counters of the values passed to @ref write.
+     *
+     * @throw ElphiException if samples were written already or there are too many counters.
+     ******************************************************************************/
+    void
+    write_counters(std::span<const Counter> counters);
+
+    /*******************************************************************************
+     * @brief Record @p name of process @p pid .
+     ******************************************************************************/
+    void
+    write_name(ProcId pid, std::string_view name);
+
+    /*******************************************************************************
+     * @brief Record @p path of cgroup @p id .
+     ******************************************************************************/
+    void
+    write_group_name(GroupId id, std::string_view path);
+
+    /*******************************************************************************
+     * @brief Record node @p id of the call stack tree, @p parent called into @p ip .
+     *
+     * Nodes must be recorded in order of their ids, parents before children, as
+     * passed to a @ref StackSink. The root is implicit and ignored.
+     *
+     * @param symbol Function of the frame, empty if not resolved.
+     ******************************************************************************/
+    void
+    write_stack(StackId id, StackId parent, std::uint64_t ip, std::string_view symbol);
+
+    /*******************************************************************************
+     * @brief Flush all buffered data and close the file.
+     *
+     * No-op for closed writer.
+     *
+     * @throw ElphiException on write errors.
+     ******************************************************************************/
+    void
+    close();
+
+private:
+    /*! Node of the call stack tree, see @ref write_stack. */
+    struct StackEntry {
+        StackId id;
+        StackId parent;
+        std::uint64_t ip;
+        std::string symbol;
+    };
+
+    /*******************************************************************************
+     * @brief Write buffered samples of @p cpu as a single block.
+     ******************************************************************************/
+    void
+    flush_samples(CpuId cpu, std::vector<CpuSample>& samples, std::vector<CounterValues>& values);
+
+    /*******************************************************************************
+     * @brief Write buffered names, cgroup paths and stacks, a block for each.
+     ******************************************************************************/
+    void
+    flush_names();
+
+    /*******************************************************************************
+     * @brief Write @p bytes to the file.
+     ******************************************************************************/
+    void
+    write_bytes(std::span<const unsigned char> bytes);
+
+    /*! Output file. */
+    FileDescriptor m_fd;
+    /*! Samples not written yet, for each CPU. */
+    std::unordered_map<CpuId, std::vector<CpuSample>> m_pending;
+    /*! Counter values of @ref m_pending, empty without counters. */
+    std::unordered_map<CpuId, std::vector<CounterValues>> m_pending_values;
+    /*! Counters of the values. */
+    std::vector<Counter> m_counters;
+    /*! Whether any samples were passed to @ref write. */
+    bool m_written = false;
+    /*! Names not written yet. */
+    std::vector<std::pair<ProcId, std::string>> m_names;
+    /*! Cgroup paths not written yet. */
+    std::vector<std::pair<GroupId, std::string>> m_group_names;
+    /*! Call stack nodes not written yet. */
+    std::vector<StackEntry> m_stacks;
+    /*! Reused for encoding blocks. */
+    Buffer m_block;
+};
+
+/*******************************************************************************
+ * @brief Reader of capture files, maps the file into memory.
+ *
+ * Only block headers are read on opening, samples are decoded on demand.
+ ******************************************************************************/
+class CaptureReader {
+public:
+    /*******************************************************************************
+     * @brief Open and index capture at @p path .
+     *
+     * @throw ElphiException if the file cannot be read or is malformed.
+     ******************************************************************************/
+    explicit CaptureReader(const std::string& path);
+
+    /*******************************************************************************
+     * @brief Move-only.
+     ******************************************************************************/
+    CaptureReader(const CaptureReader&) = delete;
+
+    /*******************************************************************************
+     * @brief Reclaim @p other reader, left in undetermined state.
+     ******************************************************************************/
+    CaptureReader(CaptureReader&& other) noexcept;
+
+    /*******************************************************************************
+     * @brief Move-only.
+     ******************************************************************************/
+    CaptureReader&
+    operator=(const CaptureReader&) = delete;
+
+    /*******************************************************************************
+     * @brief Reclaim @p other reader, left in undetermined state.
+     ******************************************************************************/
+    CaptureReader&
+    operator=(CaptureReader&& other) noexcept;
+
+    /*******************************************************************************
+     * @brief Unmap the file.
+     ******************************************************************************/
+    ~CaptureReader();
+
+    /*******************************************************************************
+     * @brief Iterate all samples, ordered by time for each CPU.
+     *
+     * @param clbk Called as `clbk(const CpuSample&)` for each sample.
+     * @throw ElphiException if a block is malformed.
+     ******************************************************************************/
+    template <typename Clbk>
+        requires std::invocable<Clbk&, const CpuSample&>
+    void
+    for_each_sample(Clbk&& clbk) const {
+        std::vector<CpuSample> samples;
+        for (std::size_t i = 0; i < num_blocks(); ++i) {
+            decode_block(i, samples);
+            for (const auto& sample : samples)
+                clbk(sample);
+        }
+    }
+
+    /*******************************************************************************
+     * @brief Number of sample blocks.
+     ******************************************************************************/
+    std::size_t
+    num_blocks() const noexcept;
+
+    /*******************************************************************************
+     * @brief Total number of samples in the capture.
+     ******************************************************************************/
+    std::size_t
+    num_samples() const noexcept;
+
+    /*******************************************************************************
+     * @brief Decode samples of block @p block into @p dest .
+     *
+     * @throw ElphiException if the block is malformed.
+     ******************************************************************************/
+    void
+    decode_block(std::size_t block, std::vector<CpuSample>& dest) const;
+
+    /*******************************************************************************
+     * @brief Decode counter values of block @p block into @p dest .
+     *
+     * Blocks without values decode into zeroes, as many as the samples.
+     *
+     * @throw ElphiException if the block is malformed.
+     ******************************************************************************/
+    void
+    decode_counters(std::size_t block, std::vector<CounterValues>& dest) const;
+
+    /*******************************************************************************
+     * @brief Recorded process names.
+     ******************************************************************************/
+    const std::unordered_map<ProcId, std::string>&
+    process_names() const noexcept;
+
+    /*******************************************************************************
+     * @brief Recorded cgroup paths.
+     ******************************************************************************/
+    const std::unordered_map<GroupId, std::string>&
+    group_names() const noexcept;
+
+    /*******************************************************************************
+     * @brief Recorded counters of the values, empty if none were captured.
+     ******************************************************************************/
+    const std::vector<Counter>&
+    counters() const noexcept;
+
+    /*******************************************************************************
+     * @brief Recorded call stacks referenced by the samples, only the root if none.
+     ******************************************************************************/
+    const CallTree&
+    stacks() const noexcept;
+
+    /*******************************************************************************
+     * @brief Recorded functions of the innermost frames of @ref stacks.
+     ******************************************************************************/
+    const std::unordered_map<StackId, std::string>&
+    stack_symbols() const noexcept;
+
+    /*******************************************************************************
+     * @brief Decode the whole capture into memory.
+     ******************************************************************************/
+    CpuSamplingResult
+    read_all() const;
+
+private:
+    /*! Mapped file. */
+    std::span<const unsigned char> m_file;
+    /*! Offsets of the sample blocks. */
+    std::vector<std::size_t> m_blocks;
+    /*! Total number of samples. */
+    std::size_t m_num_samples = 0;
+    /*! Version of the format. */
+    std::uint32_t m_version = 0;
+    /*! Names from all name blocks. */
+    std::unordered_map<ProcId, std::string> m_names;
+    /*! Paths from all group blocks. */
+    std::unordered_map<GroupId, std::string> m_group_names;
+    /*! Counters from the counters block. */
+    std::vector<Counter> m_counters;
+    /*! Nodes from all stack blocks. */
+    CallTree m_stacks;
+    /*! Resolved symbols from all stack blocks. */
+    std::unordered_map<StackId, std::string> m_stack_symbols;
+};
+} // namespace elphi
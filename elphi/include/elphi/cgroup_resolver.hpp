@@ -0,0 +1,136 @@
+/*******************************************************************************
+ * @file cgroup_resolver.hpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license This file is released under ElPhi project's license, see LICENSE.
+ *
+ * Resolution of cgroup ids to their paths.
+ ******************************************************************************/
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <elphi/cpu_sampler.hpp>
+#include <elphi/string_table.hpp>
+
+namespace elphi {
+
+/*******************************************************************************
+ * @brief Caches paths of cgroup v2 groups by their ids, resolving unknown ones
+ *  asynchronously.
+ *
+ * The id of a cgroup, as reported by PERF_SAMPLE_CGROUP, is the inode number
+ * of its directory. A background thread walks the hierarchy when unknown ids
+ * are requested, once for all ids requested meanwhile, so that the caller
+ * never blocks on the filesystem.
+ *
+ * Except for the background thread, not thread-safe.
+ ******************************************************************************/
+class CgroupResolver {
+public:
+    /*******************************************************************************
+     * @brief Start the background scanner.
+     *
+     * @param root Mount point of the cgroup v2 hierarchy.
+     ******************************************************************************/
+    explicit CgroupResolver(std::string root = "/sys/fs/cgroup");
+
+    /*******************************************************************************
+     * @brief Non-copyable, non-movable because of the background thread.
+     ******************************************************************************/
+    CgroupResolver(const CgroupResolver&) = delete;
+    CgroupResolver(CgroupResolver&&) = delete;
+    CgroupResolver&
+    operator=(const CgroupResolver&) = delete;
+    CgroupResolver&
+    operator=(CgroupResolver&&) = delete;
+
+    /*******************************************************************************
+     * @brief Stop the scanner, pending requests are dropped.
+     ******************************************************************************/
+    ~CgroupResolver();
+
+    /*******************************************************************************
+     * @brief Find path of cgroup @p id relative to the root, e.g. "/system.slice".
+     *
+     * Unknown ids are requested from the scanner, thus the call never blocks.
+     *
+     * @return Id of the path in @ref names, nothing if not known yet.
+     *  @ref c_unknown_name if no such cgroup exists.
+     ******************************************************************************/
+    std::optional<NameId>
+    lookup(GroupId id);
+
+    /*******************************************************************************
+     * @brief Pass paths of the requested cgroups resolved since the last call to @p clbk .
+     *
+     * @param clbk Called as `clbk(GroupId, NameId)` for each resolved cgroup.
+     * @return Number of passed paths.
+     ******************************************************************************/
+    std::size_t
+    collect_resolved(const std::function<void(GroupId, NameId)>& clbk);
+
+    /*******************************************************************************
+     * @brief Wait until the scanner handles all requests, at most @p timeout .
+     *
+     * @return Whether the scanner is idle.
+     ******************************************************************************/
+    bool
+    wait_idle(std::chrono::milliseconds timeout);
+
+    /*******************************************************************************
+     * @brief Storage of the paths.
+     ******************************************************************************/
+    const StringTable&
+    names() const noexcept;
+
+private:
+    /*******************************************************************************
+     * @brief Move results of the scanner into the cache.
+     ******************************************************************************/
+    void
+    apply_scanned();
+
+    /*******************************************************************************
+     * @brief Body of the scanner thread.
+     ******************************************************************************/
+    void
+    run_scanner(const std::stop_token& token);
+
+    /*! Mount point of the hierarchy. */
+    std::string m_root;
+    /*! Interned paths. */
+    StringTable m_names;
+    /*! Path of each seen cgroup, including the missing ones. */
+    std::unordered_map<GroupId, NameId> m_paths;
+    /*! Resolved requests not collected yet. */
+    std::vector<std::pair<GroupId, NameId>> m_updates;
+    /*! Ids requested from the scanner, not resolved yet. */
+    std::unordered_set<GroupId> m_in_flight;
+
+    /*! Guards the members shared with the scanner below. */
+    std::mutex m_mutex;
+    /*! Signals new requests or finished scans. */
+    std::condition_variable_any m_cv;
+    /*! Ids to resolve. */
+    std::vector<GroupId> m_requests;
+    /*! Whether the scanner is processing requests. */
+    bool m_scanning = false;
+    /*! Paths of all cgroups found by the scans. */
+    std::vector<std::pair<GroupId, std::string>> m_results;
+    /*! Whether the scanner finished a scan not applied yet, checked without locking. */
+    std::atomic<bool> m_has_results{false};
+    /*! Scanner thread, must be the last member. */
+    std::jthread m_scanner;
+};
+} // namespace elphi
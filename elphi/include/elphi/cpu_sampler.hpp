@@ -7,17 +7,26 @@
  ******************************************************************************/
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <chrono>
 #include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
 #include <stop_token>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
+#include <elphi/call_tree.hpp>
 #include <elphi/exception.hpp>
+#include <elphi/string_table.hpp>
 
 namespace elphi {
 
+class SymbolCache;
+
 /*! Process ID. */
 using ProcId = std::uint32_t;
 /*! Thread ID. */
@@ -29,6 +38,74 @@ using GroupId = std::uint64_t;
 /*! Measure time in nanoseconds.  */
 using TimePoint = std::chrono::nanoseconds;
 
+/*! Maximum number of counters read with each sample. */
+inline constexpr std::size_t c_max_counters = 4;
+/*! Values of the counters read with a sample, in the order of @ref EventSpec::counters. */
+using CounterValues = std::array<std::uint64_t, c_max_counters>;
+
+/*******************************************************************************
+ * @brief Event counted by the kernel, software or read from the CPU's PMU.
+ ******************************************************************************/
+enum class Counter : std::uint8_t {
+    /*! Software timer of the running task, always available. */
+    task_clock,
+    /*! CPU cycles. */
+    cycles,
+    /*! Retired instructions. */
+    instructions,
+    /*! Last level cache accesses. */
+    cache_references,
+    /*! Last level cache misses. */
+    cache_misses,
+    /*! Retired branch instructions. */
+    branch_instructions,
+    /*! Mispredicted branch instructions. */
+    branch_misses,
+};
+
+/*******************************************************************************
+ * @brief Whether @p counter requires a hardware PMU.
+ ******************************************************************************/
+constexpr bool
+is_hardware(Counter counter) noexcept {
+    return counter != Counter::task_clock;
+}
+
+/*******************************************************************************
+ * @brief What to sample and which counters to read with each sample.
+ *
+ * The counters form a group with the sampled event, thus are scheduled on
+ * the PMU together and their ratios, e.g. IPC, stay valid even when the PMU
+ * is multiplexed.
+ ******************************************************************************/
+struct EventSpec {
+    /*! Event triggering the samples. */
+    Counter sampled = Counter::task_clock;
+    /*! Counters read with each sample, at most @ref c_max_counters. */
+    std::vector<Counter> counters{};
+
+    /*******************************************************************************
+     * @brief Whether any of the events requires a hardware PMU.
+     ******************************************************************************/
+    bool
+    uses_hardware() const noexcept {
+        return is_hardware(sampled) ||
+               std::any_of(counters.begin(), counters.end(), [](Counter counter) { return is_hardware(counter); });
+    }
+};
+
+/*******************************************************************************
+ * @brief What a sample records about its thread.
+ ******************************************************************************/
+enum class SampleKind : std::uint8_t {
+    /*! The thread was running at the time. */
+    tick,
+    /*! The thread started running at the time. */
+    switch_in,
+    /*! The thread stopped running at the time. */
+    switch_out,
+};
+
 /*******************************************************************************
  * struct Sample - Execution context at sampled point of time.
  *
@@ -43,27 +120,248 @@ struct CpuSample {
     CpuId cpu = 0;
     /*! Time of the sample. */
     TimePoint time = TimePoint::zero();
+    /*! Control group of the thread, zero if not sampled. */
+    GroupId cgroup = 0;
+    /*! Periodic sample or a context switch. */
+    SampleKind kind = SampleKind::tick;
+    /*! Call stack of the thread, node of @ref CpuSamplingResult::stacks, root if not sampled. */
+    StackId stack = c_root_stack;
 };
 
 
+/*******************************************************************************
+ * @brief Observed activity of a single CPU's ring buffer.
+ ******************************************************************************/
+struct RingStats {
+    /*! Records drained from the ring. */
+    std::uint64_t num_records = 0;
+    /*! Records the kernel dropped because the ring was full. */
+    std::uint64_t num_lost = 0;
+    /*! Longest time between two drains of the ring. */
+    TimePoint max_drain_interval = TimePoint::zero();
+};
+
 /*******************************************************************************
  * struct SamplingResult - Result of sampling gatherer
  ******************************************************************************/
 struct CpuSamplingResult {
 
     /*! Collected samples. */
-    std::vector<CpuSample> samples;
+    std::vector<CpuSample> samples{};
     /**
-     * @brief Map processes ids to names.
+     * @brief Map processes ids to names interned in @ref names.
      *
      * Not all PIDs present in @ref samples must be present here, if not
      * the process name is unknown.
      * That can happen for short-time processes where we did fail to obtain
      * the name before process exited.
      */
-    std::unordered_map<ProcId, std::string> process_names;
+    std::unordered_map<ProcId, NameId> process_names{};
+    /*! Storage of the names, shared with views generated from the result. */
+    StringTable names{};
+
+    /*******************************************************************************
+     * @brief Record @p name of process @p pid .
+     ******************************************************************************/
+    void
+    set_process_name(ProcId pid, std::string_view name) {
+        process_names.insert_or_assign(pid, names.intern(name));
+    }
+
+    /*******************************************************************************
+     * @brief Name of process @p pid , "UNKNOWN" if not known.
+     ******************************************************************************/
+    std::string_view
+    process_name(ProcId pid) const {
+        auto it = process_names.find(pid);
+        return names.resolve(it == process_names.end() ? c_unknown_name : it->second);
+    }
+
+    /*! Activity of each sampled CPU's ring, non-zero lost records mean missing samples. */
+    std::unordered_map<CpuId, RingStats> ring_stats{};
+
+    /*! Counters of @ref counter_values, empty if none were available. */
+    std::vector<Counter> counters{};
+
+    /*!
+     * Counted events of each sample since the previous sample of its CPU,
+     * i-th values belong to the i-th of @ref samples. Kept apart from the
+     * samples, empty if no @ref counters were sampled.
+     */
+    std::vector<CounterValues> counter_values{};
+
+    /*! Unique call stacks referenced by @ref CpuSample::stack. */
+    CallTree stacks{};
+
+    /*! Map stacks to functions of their innermost frames interned in @ref names. */
+    std::unordered_map<StackId, NameId> stack_symbols{};
+
+    /*******************************************************************************
+     * @brief Record @p symbol of the innermost frame of @p stack .
+     ******************************************************************************/
+    void
+    set_stack_symbol(StackId stack, std::string_view symbol) {
+        stack_symbols.insert_or_assign(stack, names.intern(symbol));
+    }
+
+    /*******************************************************************************
+     * @brief Function of the innermost frame of @p stack , "UNKNOWN" if not known.
+     ******************************************************************************/
+    std::string_view
+    stack_symbol(StackId stack) const {
+        auto it = stack_symbols.find(stack);
+        return names.resolve(it == stack_symbols.end() ? c_unknown_name : it->second);
+    }
+
+    /*! Map cgroup ids to their paths interned in @ref names. */
+    std::unordered_map<GroupId, NameId> group_names{};
+
+    /*******************************************************************************
+     * @brief Record @p path of cgroup @p id .
+     ******************************************************************************/
+    void
+    set_group_name(GroupId id, std::string_view path) {
+        group_names.insert_or_assign(id, names.intern(path));
+    }
+
+    /*******************************************************************************
+     * @brief Path of cgroup @p id , "UNKNOWN" if not known.
+     ******************************************************************************/
+    std::string_view
+    group_name(GroupId id) const {
+        auto it = group_names.find(id);
+        return names.resolve(it == group_names.end() ? c_unknown_name : it->second);
+    }
+};
+
+/*******************************************************************************
+ * @brief How to distribute the sampled CPUs among reader threads.
+ ******************************************************************************/
+enum class ShardPolicy {
+    /*! Split CPUs into @ref SamplingConfig::num_readers contiguous chunks. */
+    contiguous,
+    /*! One reader per NUMA node sampling CPUs of that node. */
+    per_numa_node,
+};
+
+/*******************************************************************************
+ * @brief How to size the per-CPU ring buffers.
+ ******************************************************************************/
+struct RingPolicy {
+    /*!
+     * Bytes of all rings together, zero for the perf_event_mlock_kb limit.
+     * Larger budgets require CAP_IPC_LOCK or enough RLIMIT_MEMLOCK.
+     */
+    std::size_t memory_budget = 0;
+    /*!
+     * Longest expected time between two drains of a ring. Rings below their
+     * wakeup watermark are drained twice as often.
+     */
+    TimePoint drain_latency = std::chrono::seconds(2);
+    /*! Fill level of a ring, as a fraction of its size, waking up its reader. */
+    double wakeup_fill = 0.5;
+    /*! Activity observed by a previous session, busy CPUs get larger rings. */
+    std::unordered_map<CpuId, RingStats> history{};
 };
 
+/*******************************************************************************
+ * struct SamplingConfig - Parameters of CPU sampling.
+ ******************************************************************************/
+struct SamplingConfig {
+    /*! CPU cores to sample, zero-based indices. */
+    std::vector<CpuId> cpus;
+    /*! Samples to take per second, can be zero only with @ref trace_switches. */
+    std::size_t frequency = 0;
+    /*!
+     * Whether to record context switches, requires Linux 4.3. Slices then
+     * begin and end exactly at the switches, including runs shorter than the
+     * sampling period. Switches do not carry cgroups, thus cannot be combined
+     * with @ref sample_cgroups.
+     */
+    bool trace_switches = false;
+    /*! Number of reader threads draining the events, at least one. */
+    std::size_t num_readers = 1;
+    /*! Assignment of CPUs to readers. */
+    ShardPolicy shard_policy = ShardPolicy::contiguous;
+    /*! Whether to pin each reader to the CPUs it samples. */
+    bool pin_readers = true;
+    /*! How long to wait for samples of idle CPUs before emitting newer ones. */
+    TimePoint reorder_window = std::chrono::seconds(2);
+    /*! Whether to sample cgroups of the threads, requires cgroup v2 and Linux 5.7. */
+    bool sample_cgroups = false;
+    /*! Whether to sample call stacks of the threads, user-space ones need frame pointers. */
+    bool sample_callchains = false;
+    /*!
+     * Symbol tables resolving the sampled call stacks, nothing is resolved if
+     * null. Requires @ref sample_callchains. Concurrent sessions sharing the
+     * cache share the indexes of the files they all map.
+     */
+    std::shared_ptr<SymbolCache> symbols{};
+    /*! Sizing of the ring buffers. */
+    RingPolicy rings{};
+    /*!
+     * Sampled events, hardware ones fall back to sampling
+     * @ref Counter::task_clock without counters if no PMU is present.
+     */
+    EventSpec events{};
+};
+
+/*******************************************************************************
+ * @brief Split @p cpus into at most @p num_shards contiguous, equally sized shards.
+ *
+ * @return Non-empty shards.
+ ******************************************************************************/
+std::vector<std::vector<CpuId>>
+shard_cpus(std::span<const CpuId> cpus, std::size_t num_shards);
+
+/*******************************************************************************
+ * @brief Group @p cpus by NUMA node.
+ *
+ * @param cpus CPUs to group.
+ * @param node_of Returns the node of a CPU.
+ * @return Non-empty shards, one for each node, ordered by the node.
+ ******************************************************************************/
+std::vector<std::vector<CpuId>>
+shard_cpus_by_node(std::span<const CpuId> cpus, const std::function<std::size_t(CpuId)>& node_of);
+
+/*******************************************************************************
+ * @brief Choose size of each CPU's ring buffer.
+ *
+ * Each ring holds records of @ref RingPolicy::drain_latency, or twice the
+ * observed drain interval if longer. CPUs are weighted by their records in
+ * @ref RingPolicy::history relative to the busiest one, rings which lost
+ * records get twice the space. The largest rings are halved until all fit
+ * into @p budget .
+ *
+ * @param cpus Sampled CPUs.
+ * @param record_rate Records per second of a fully busy CPU.
+ * @param record_size Bytes of a single record.
+ * @param policy Sizing policy.
+ * @param budget Bytes of all rings together, zero for unlimited.
+ * @return Number of data pages of each CPU's ring, a power of two.
+ ******************************************************************************/
+std::unordered_map<CpuId, std::size_t>
+size_rings(std::span<const CpuId> cpus, std::size_t record_rate, std::size_t record_size, const RingPolicy& policy,
+           std::size_t budget);
+
+/*******************************************************************************
+ * @brief Sample system for what processes are executed.
+ *
+ * Runs a @ref SamplingSession, its reader threads drain events of their
+ * shards of CPUs and hand the samples over through lock-free queues to the
+ * session's consumer thread, which merges them into a single time-ordered
+ * stream. The calling thread only waits for @p token and collects the result.
+ *
+ * Synchronous call, must be cancelled through @p token.
+ *
+ * @param config What and how to sample.
+ * @param token Cancel the sampling.
+ * @return Collected samples, ordered by time.
+ * @throw ElphiException in case of errors.
+ ******************************************************************************/
+CpuSamplingResult
+sample_cpus_sync(const SamplingConfig& config, const std::stop_token& token);
+
 /*******************************************************************************
  * @brief Sample system for what processes are executed.
  *
@@ -0,0 +1,187 @@
+/*******************************************************************************
+ * @file elf_symbols.hpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license This file is released under ElPhi project's license, see LICENSE.
+ *
+ * Function symbols of ELF files and their cache shared across sessions.
+ ******************************************************************************/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace elphi {
+
+/*******************************************************************************
+ * @brief Read-only memory mapping of a whole file.
+ ******************************************************************************/
+class MappedFile {
+public:
+    /*******************************************************************************
+     * @brief Map file at @p path .
+     *
+     * @throw ElphiException if the file cannot be opened or mapped.
+     ******************************************************************************/
+    explicit MappedFile(const std::string& path);
+
+    /*******************************************************************************
+     * @brief Move-only.
+     ******************************************************************************/
+    MappedFile(const MappedFile&) = delete;
+
+    /*******************************************************************************
+     * @brief Claim mapping of @p other , left empty.
+     ******************************************************************************/
+    MappedFile(MappedFile&& other) noexcept;
+
+    /*******************************************************************************
+     * @brief Move-only.
+     ******************************************************************************/
+    MappedFile&
+    operator=(const MappedFile&) = delete;
+
+    /*******************************************************************************
+     * @brief Unmap this file, claim mapping of @p other , left empty.
+     ******************************************************************************/
+    MappedFile&
+    operator=(MappedFile&& other) noexcept;
+
+    /*******************************************************************************
+     * @brief Unmap the file.
+     ******************************************************************************/
+    ~MappedFile();
+
+    /*******************************************************************************
+     * @brief Contents of the file, stay in place when the mapping is moved.
+     ******************************************************************************/
+    std::span<const std::byte>
+    data() const noexcept {
+        return {static_cast<const std::byte*>(m_data), m_size};
+    }
+
+private:
+    /*! Start of the mapping, null if empty. */
+    void* m_data = nullptr;
+    /*! Length of the mapping. */
+    std::size_t m_size = 0;
+};
+
+/*******************************************************************************
+ * @brief GNU build-id of ELF @p image in hex, empty if it has none.
+ ******************************************************************************/
+std::string
+elf_build_id(std::span<const std::byte> image);
+
+/*******************************************************************************
+ * @brief Index of function symbols of a 64-bit ELF file.
+ *
+ * Symbols of .symtab, or .dynsym of stripped files, are indexed by their
+ * start in an array sorted for binary search. Names are not copied, they view
+ * the file's string tables mapped in memory.
+ ******************************************************************************/
+class ElfSymbols {
+public:
+    /*******************************************************************************
+     * @brief Index symbols of ELF file @p file .
+     *
+     * @throw ElphiException if @p file is not a valid 64-bit ELF of this machine.
+     ******************************************************************************/
+    explicit ElfSymbols(MappedFile file);
+
+    /*******************************************************************************
+     * @brief Function containing byte at @p offset of the file.
+     *
+     * @param offset Offset in the file, as in the file's memory mappings.
+     * @return Raw, i.e. mangled, name of the function, valid for the index's
+     *  lifetime. Nothing if no function contains the byte.
+     ******************************************************************************/
+    std::optional<std::string_view>
+    lookup(std::uint64_t offset) const noexcept;
+
+    /*******************************************************************************
+     * @brief GNU build-id of the file in hex, empty if it has none.
+     ******************************************************************************/
+    const std::string&
+    build_id() const noexcept {
+        return m_build_id;
+    }
+
+    /*******************************************************************************
+     * @brief Number of indexed functions.
+     ******************************************************************************/
+    std::size_t
+    size() const noexcept {
+        return m_starts.size();
+    }
+
+private:
+    /*! Loadable segment translating file offsets to virtual addresses. */
+    struct Segment {
+        /*! Offset of the segment in the file. */
+        std::uint64_t offset;
+        /*! Virtual address of the segment. */
+        std::uint64_t address;
+        /*! Bytes of the segment in the file. */
+        std::uint64_t size;
+    };
+
+    /*! Function of @ref m_starts. */
+    struct Symbol {
+        /*! First address past the function. */
+        std::uint64_t end;
+        /*! Name in the mapped string table. */
+        std::string_view name;
+    };
+
+    /*! The mapped file. */
+    MappedFile m_file;
+    /*! Build-id of the file in hex. */
+    std::string m_build_id;
+    /*! Loadable segments of the file. */
+    std::vector<Segment> m_segments;
+    /*! Sorted unique start addresses of the functions. */
+    std::vector<std::uint64_t> m_starts;
+    /*! Functions in order of @ref m_starts, kept apart to keep the search dense. */
+    std::vector<Symbol> m_symbols;
+};
+
+/*******************************************************************************
+ * @brief Thread-safe cache of indexed ELF files keyed by their build-ids.
+ *
+ * Indexing is the expensive part of symbolization, files with the same
+ * build-id share the index even if they moved or were copied. The cache
+ * does not own the indexes, each lives only while some user holds it.
+ ******************************************************************************/
+class SymbolCache {
+public:
+    /*******************************************************************************
+     * @brief Index of file at @p path , reused if its build-id is cached.
+     *
+     * Files without build-id are indexed but not cached.
+     *
+     * @return The index, null if the file cannot be read or is not an ELF.
+     ******************************************************************************/
+    std::shared_ptr<const ElfSymbols>
+    load(const std::string& path);
+
+    /*******************************************************************************
+     * @brief Number of cached indexes still in use.
+     ******************************************************************************/
+    std::size_t
+    size() const;
+
+private:
+    /*! Guards @ref m_indexes. */
+    mutable std::mutex m_mutex;
+    /*! Indexes by build-id, expired ones are dropped on inserting new ones. */
+    std::unordered_map<std::string, std::weak_ptr<const ElfSymbols>> m_indexes;
+};
+} // namespace elphi
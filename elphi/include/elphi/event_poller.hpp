@@ -0,0 +1,72 @@
+/*******************************************************************************
+ * @file event_poller.hpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license This file is released under ElPhi project's license, see LICENSE.
+ *
+ * Waiting for readable descriptors with epoll.
+ ******************************************************************************/
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <sys/epoll.h>
+
+#include <elphi/file_descriptor.hpp>
+
+namespace elphi {
+
+/*******************************************************************************
+ * @brief Waits until any of the watched descriptors becomes readable.
+ *
+ * Unlike poll(), the cost of a wait depends only on the number of ready
+ * descriptors, not on the number of the watched ones. The wait can be
+ * interrupted from another thread by @ref wake.
+ ******************************************************************************/
+class EventPoller {
+public:
+    /*******************************************************************************
+     * @brief Create poller without descriptors.
+     *
+     * @throw ElphiException if epoll cannot be created.
+     ******************************************************************************/
+    EventPoller();
+
+    /*******************************************************************************
+     * @brief Watch @p fd for input.
+     *
+     * @param fd Watched descriptor, must outlive the poller.
+     * @param index Reported by @ref wait when @p fd is ready.
+     * @throw ElphiException if the descriptor cannot be watched.
+     ******************************************************************************/
+    void
+    add(int fd, std::uint32_t index);
+
+    /*******************************************************************************
+     * @brief Wait until a descriptor is ready, @p timeout passes or woken up.
+     *
+     * @return Indices of the ready descriptors, valid until the next call.
+     * @throw ElphiException on polling errors.
+     ******************************************************************************/
+    std::span<const std::uint32_t>
+    wait(std::chrono::milliseconds timeout);
+
+    /*******************************************************************************
+     * @brief Interrupt the current or the next @ref wait, thread-safe.
+     ******************************************************************************/
+    void
+    wake() noexcept;
+
+private:
+    /*! The epoll instance. */
+    FileDescriptor m_epoll;
+    /*! Eventfd interrupting the waits. */
+    FileDescriptor m_wake;
+    /*! Storage of the reported events. */
+    std::vector<epoll_event> m_events;
+    /*! Indices of the ready descriptors. */
+    std::vector<std::uint32_t> m_ready;
+};
+} // namespace elphi
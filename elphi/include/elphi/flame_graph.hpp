@@ -0,0 +1,74 @@
+/*******************************************************************************
+ * @file flame_graph.hpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license This file is released under ElPhi project's license, see LICENSE.
+ *
+ * Flame graph layout of sampled call stacks.
+ ******************************************************************************/
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <elphi/call_tree.hpp>
+#include <elphi/cpu_sampler.hpp>
+
+namespace elphi::view {
+
+/*******************************************************************************
+ * @brief Single frame of a flame graph, a rectangle of the plot.
+ *
+ * Horizontal position and width are measured in samples, the depth is the
+ * row. The root frame spans all samples.
+ ******************************************************************************/
+struct FlameFrame {
+    /*! Call stack of the frame, node of @ref CpuSamplingResult::stacks, the heaviest one of merged frames. */
+    StackId stack = c_root_stack;
+    /*! Instruction pointer of the frame, zero for the root. */
+    std::uint64_t ip = 0;
+    /*! Row of the frame, zero for the root. */
+    std::uint32_t depth = 0;
+    /*! Samples left of the frame. */
+    std::uint64_t offset = 0;
+    /*! Samples of the frame and all its callees, i.e. its width. */
+    std::uint64_t total = 0;
+    /*! Samples of the frame itself. */
+    std::uint64_t self = 0;
+    /*! Function of the frame interned in @ref CpuSamplingResult::names, "UNKNOWN" if not resolved. */
+    NameId symbol = c_unknown_name;
+
+    /*******************************************************************************
+     * @brief Default member-wise comparison.
+     ******************************************************************************/
+    friend auto
+    operator<=>(const FlameFrame&, const FlameFrame&) = default;
+};
+
+/*! Frames in depth-first order, callees of a frame sorted by their instruction pointers or functions. */
+using FlameGraph = std::vector<FlameFrame>;
+
+/*******************************************************************************
+ * @brief Lay out stacks of @p tree weighted by @p samples as a flame graph.
+ *
+ * Frames without samples in their subtree are omitted.
+ *
+ * @param tree Stacks referenced by the samples.
+ * @param samples Samples with their @ref CpuSample::stack, samples without
+ *  stacks are counted only to the root.
+ * @return Frames in depth-first order, the root first.
+ ******************************************************************************/
+FlameGraph
+gen_flame_graph(const CallTree& tree, std::span<const CpuSample> samples);
+
+/*******************************************************************************
+ * @brief Lay out stacks sampled in @p result as a flame graph.
+ *
+ * Frames are named by @ref CpuSamplingResult::stack_symbols. Sibling frames
+ * of the same function are merged into one, their callees too, and siblings
+ * are sorted by their names. Unresolved frames are kept apart by their
+ * instruction pointers.
+ ******************************************************************************/
+FlameGraph
+gen_flame_graph(const CpuSamplingResult& result);
+} // namespace elphi::view
@@ -0,0 +1,193 @@
+/*******************************************************************************
+ * @file name_resolver.hpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license This file is released under ElPhi project's license, see LICENSE.
+ *
+ * Resolution of process names from perf records and /proc.
+ ******************************************************************************/
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <elphi/cpu_sampler.hpp>
+#include <elphi/string_table.hpp>
+
+namespace elphi {
+
+/*******************************************************************************
+ * @brief Caches names of processes, resolving unknown ones asynchronously.
+ *
+ * Names are primarily learned from PERF_RECORD_COMM/FORK records. Processes
+ * not seen through them, e.g. started before the sampling, are looked up in
+ * /proc by a background thread so that the caller never blocks on the
+ * filesystem. At most `capacity` names are cached, least recently used ones
+ * are forgotten first.
+ *
+ * Except for the background thread, not thread-safe.
+ ******************************************************************************/
+class NameResolver {
+public:
+    /*******************************************************************************
+     * @brief Start the background /proc scanner.
+     *
+     * @param capacity Maximum number of cached names.
+     * @param proc_root Mount point of procfs.
+     ******************************************************************************/
+    explicit NameResolver(std::size_t capacity, std::string proc_root = "/proc");
+
+    /*******************************************************************************
+     * @brief Non-copyable, non-movable because of the background thread.
+     ******************************************************************************/
+    NameResolver(const NameResolver&) = delete;
+    NameResolver(NameResolver&&) = delete;
+    NameResolver&
+    operator=(const NameResolver&) = delete;
+    NameResolver&
+    operator=(NameResolver&&) = delete;
+
+    /*******************************************************************************
+     * @brief Stop the scanner, pending requests are dropped.
+     ******************************************************************************/
+    ~NameResolver();
+
+    /*******************************************************************************
+     * @brief Process @p pid is now named @p comm , e.g. after exec.
+     ******************************************************************************/
+    void
+    on_comm(ProcId pid, std::string_view comm);
+
+    /*******************************************************************************
+     * @brief Process @p child was forked from @p parent , inherits its name.
+     ******************************************************************************/
+    void
+    on_fork(ProcId parent, ProcId child);
+
+    /*******************************************************************************
+     * @brief Process @p pid exited, its name is the first to be forgotten.
+     ******************************************************************************/
+    void
+    on_exit(ProcId pid);
+
+    /*******************************************************************************
+     * @brief Find name of process @p pid .
+     *
+     * Unknown names are requested from the scanner, thus the call never blocks.
+     *
+     * @return Id of the name, nothing if not known yet. @ref c_unknown_name if
+     *  the process could not be found.
+     ******************************************************************************/
+    std::optional<NameId>
+    lookup(ProcId pid);
+
+    /*******************************************************************************
+     * @brief Request names of all processes currently present in /proc.
+     ******************************************************************************/
+    void
+    scan_all();
+
+    /*******************************************************************************
+     * @brief Pass names learned since the last call to @p clbk .
+     *
+     * @param clbk Called as `clbk(ProcId, NameId)` for each new or changed name.
+     * @return Number of passed names.
+     ******************************************************************************/
+    std::size_t
+    collect_resolved(const std::function<void(ProcId, NameId)>& clbk);
+
+    /*******************************************************************************
+     * @brief Wait until the scanner handles all requests, at most @p timeout .
+     *
+     * @return Whether the scanner is idle.
+     ******************************************************************************/
+    bool
+    wait_idle(std::chrono::milliseconds timeout);
+
+    /*******************************************************************************
+     * @brief Storage of the names.
+     ******************************************************************************/
+    const StringTable&
+    names() const noexcept;
+
+    /*******************************************************************************
+     * @brief Number of cached names.
+     ******************************************************************************/
+    std::size_t
+    size() const noexcept;
+
+private:
+    /*! Cached name, most recently used at the front. */
+    using LruList = std::list<std::pair<ProcId, NameId>>;
+
+    /*******************************************************************************
+     * @brief Cache @p name of @p pid and report it if changed.
+     ******************************************************************************/
+    void
+    store(ProcId pid, NameId name);
+
+    /*******************************************************************************
+     * @brief Move results of the scanner into the cache.
+     ******************************************************************************/
+    void
+    apply_scanned();
+
+    /*******************************************************************************
+     * @brief Body of the scanner thread.
+     ******************************************************************************/
+    void
+    run_scanner(const std::stop_token& token);
+
+    /*! Maximum size of @ref m_lru. */
+    std::size_t m_capacity;
+    /*! Mount point of procfs. */
+    std::string m_proc_root;
+    /*! Interned names. */
+    StringTable m_names;
+    /*! Cached names ordered by their last use. */
+    LruList m_lru;
+    /*! Index into @ref m_lru. */
+    std::unordered_map<ProcId, LruList::iterator> m_index;
+    /*! Names not collected yet. */
+    std::vector<std::pair<ProcId, NameId>> m_updates;
+    /*! PIDs requested from the scanner, not resolved yet. */
+    std::unordered_set<ProcId> m_in_flight;
+
+    /*! Guards the members shared with the scanner below. */
+    std::mutex m_mutex;
+    /*! Signals new requests or finished scans. */
+    std::condition_variable_any m_cv;
+    /*! PIDs to scan. */
+    std::vector<ProcId> m_requests;
+    /*! Whether to scan all of /proc. */
+    bool m_scan_all = false;
+    /*! Whether the scanner is processing requests. */
+    bool m_scanning = false;
+    /*! Scanned names, nothing if the process does not exist. */
+    std::vector<std::pair<ProcId, std::optional<std::string>>> m_results;
+    /*! Whether @ref m_results is non-empty, checked without locking. */
+    std::atomic<bool> m_has_results{false};
+    /*! Scanner thread, must be the last member. */
+    std::jthread m_scanner;
+};
+
+/*******************************************************************************
+ * @brief Read name of process @p pid from /proc/<pid>/comm.
+ *
+ * @param proc_root Mount point of procfs.
+ * @return The name, nothing if the process does not exist.
+ ******************************************************************************/
+std::optional<std::string>
+read_proc_comm(const std::string& proc_root, ProcId pid);
+} // namespace elphi
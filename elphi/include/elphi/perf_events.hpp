@@ -5,6 +5,8 @@
  ******************************************************************************/
 #pragma once
 
+#include <concepts>
+#include <cstring>
 #include <optional>
 #include <span>
 #include <variant>
@@ -17,6 +19,20 @@
 
 namespace elphi {
 
+/*******************************************************************************
+ * @brief Single record as stored in the event ring buffer.
+ *
+ * Only valid inside the @ref PerfEvents::drain_perf_events callback, the
+ * payload points either directly into the mapped ring buffer or into a scratch
+ * area reused by the following record.
+ ******************************************************************************/
+struct PerfRecord {
+    /*! Header of the record, the size includes the header itself. */
+    perf_event_header header;
+    /*! Record bytes following the header. */
+    std::span<const unsigned char> payload;
+};
+
 /*******************************************************************************
  * @brief RAII wrapper around perf_event Linux subsystem.
  *
@@ -36,7 +52,8 @@ public:
      * @param group_fd Group leader for events.
      * @param flags Flags for the event descriptor.
      * @param num_pages Number of pages to allocate for the ring event buffer.
-     *  Must be a power of two, at least 1.
+     *  Must be a power of two, or zero for an event without a ring, e.g. a
+     *  member of a group, which has nothing to drain.
      * @throw ElphiException if the event cannot be initialized.
      ******************************************************************************/
     PerfEvents(const perf_event_attr& attr, pid_t pid, int cpu, int group_fd, std::uint64_t flags,
@@ -81,6 +98,24 @@ public:
     std::optional<perf_event_header>
     get_perf_event(Buffer* dest, bool peek_only);
 
+    /*******************************************************************************
+     * @brief Pop all events currently present in the event buffer.
+     *
+     * Zero-copy batch alternative to @ref get_perf_event. The buffer head is
+     * read only once and the tail is published only once per batch, records
+     * are handed out as views into the mapped ring buffer. Only records
+     * wrapping around the end of the ring are copied into a scratch area
+     * reserved when the ring is mapped, thus draining never allocates.
+     *
+     * @param clbk Called for each record as `clbk(const PerfRecord&)`. The
+     *  record is not valid after the call returns.
+     * @return Number of popped records.
+     ******************************************************************************/
+    template <typename Clbk>
+        requires std::invocable<Clbk&, const PerfRecord&>
+    std::size_t
+    drain_perf_events(Clbk&& clbk);
+
     /*******************************************************************************
      * @brief Start/resume the event collection.
      *
@@ -126,9 +161,64 @@ private:
     void
     unmap_perf_event_buffer() noexcept;
 
+    /*******************************************************************************
+     * @brief Whether the event buffer is mapped and ready to be read from.
+     ******************************************************************************/
+    bool
+    is_mapped() const noexcept;
+
+    /*******************************************************************************
+     * @brief View the record starting at @p offset in the ring.
+     *
+     * @param ring Ring buffer, without the header page.
+     * @param offset Non-wrapped offset of the record, at least the header must
+     *  be already written there.
+     * @return The record, payload is empty if its size is corrupted.
+     ******************************************************************************/
+    PerfRecord
+    view_record(std::span<unsigned char> ring, std::uint64_t offset);
+
     /*! Event FD. */
     FileDescriptor m_fd;
     /*! MMapped ring buffer. */
     PerfEventBuffer m_buffer;
+    /*! Storage for records wrapping around the end of the ring buffer, reserved for the largest one. */
+    Buffer m_scratch;
 };
+
+template <typename Clbk>
+    requires std::invocable<Clbk&, const PerfRecord&>
+std::size_t
+PerfEvents::drain_perf_events(Clbk&& clbk) {
+    if (!is_mapped())
+        return 0;
+
+    auto* header = type_pune<perf_event_mmap_page>(m_buffer.data());
+    // The ring buffer begins at the next page.
+    const auto ring = m_buffer.subspan(c_page_size);
+
+    // Read the head only once, anything written afterwards is left for the next batch.
+    // Acquire pairs with the kernel's release, the records up to head are fully written.
+    const std::uint64_t head = load_acquire(header->data_head);
+    // Only we write the tail.
+    std::uint64_t tail = header->data_tail;
+
+    std::size_t num_records = 0;
+    while (tail + sizeof(perf_event_header) <= head) {
+        const PerfRecord record = view_record(ring, tail);
+        // Corrupted or not fully written record, wait for the next batch.
+        if (record.header.size < sizeof(perf_event_header) || tail + record.header.size > head)
+            break;
+
+        clbk(record);
+        tail += record.header.size;
+        ++num_records;
+    }
+
+    if (num_records > 0) {
+        // All reads must finish before the kernel is allowed to overwrite the records.
+        store_release(header->data_tail, tail);
+    }
+    return num_records;
+}
 } // namespace elphi
@@ -0,0 +1,180 @@
+/*******************************************************************************
+ * @file perf_records.hpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license This file is released under ElPhi project's license, see LICENSE.
+ *
+ * Parsing of records drained from the perf_event ring buffer.
+ ******************************************************************************/
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include <elphi/cpu_sampler.hpp>
+#include <elphi/perf_events.hpp>
+
+namespace elphi {
+
+/*! Fields of the sample records always requested by the sampler. */
+inline constexpr std::uint64_t c_sample_type = PERF_SAMPLE_TID | PERF_SAMPLE_TIME | PERF_SAMPLE_ADDR | PERF_SAMPLE_CPU;
+/*! Most frames of a parsed callchain, the kernel's default limit which can be raised by sysctl. */
+inline constexpr std::size_t c_max_callchain_depth = 127;
+
+/*******************************************************************************
+ * @brief Process lifecycle event from PERF_RECORD_COMM/FORK/EXIT.
+ ******************************************************************************/
+struct TaskEvent {
+    /*! Type of the event. */
+    enum class Kind : std::uint8_t {
+        /*! Process got a new name. */
+        comm,
+        /*! New process was forked. */
+        fork,
+        /*! Process exited. */
+        exit,
+    };
+
+    /*! Length of process names including the terminator, TASK_COMM_LEN. */
+    static constexpr std::size_t c_comm_len = 16;
+
+    /*******************************************************************************
+     * @brief New name of the process for @ref Kind::comm.
+     ******************************************************************************/
+    std::string_view
+    name() const noexcept {
+        return {comm.data(), comm_size};
+    }
+
+    /*! Type of the event. */
+    Kind kind = Kind::comm;
+    /*! The process. */
+    ProcId pid = 0;
+    /*! Parent of the process for @ref Kind::fork. */
+    ProcId parent = 0;
+    /*! Whether the process was renamed by exec for @ref Kind::comm. */
+    bool exec = false;
+    /*! Length of @ref comm. */
+    std::uint8_t comm_size = 0;
+    /*! New name of the process for @ref Kind::comm, not terminated. */
+    std::array<char, c_comm_len> comm{};
+};
+
+/*******************************************************************************
+ * @brief Change of a process' address space from PERF_RECORD_MMAP2/FORK/COMM/EXIT.
+ *
+ * Only executable mappings of files are reported, i.e. what call stacks can
+ * point into.
+ ******************************************************************************/
+struct MapEvent {
+    /*! Type of the event. */
+    enum class Kind : std::uint8_t {
+        /*! File was mapped into the process. */
+        map,
+        /*! New process was forked, inherits the mappings of its parent. */
+        fork,
+        /*! Process called exec, its mappings are gone. */
+        exec,
+        /*! Process exited, so did its address space. */
+        exit,
+    };
+
+    /*! Capacity of @ref filename, longer paths are truncated. */
+    static constexpr std::size_t c_path_len = 256;
+
+    /*******************************************************************************
+     * @brief Path of the mapped file for @ref Kind::map.
+     ******************************************************************************/
+    std::string_view
+    path() const noexcept {
+        return {filename.data(), filename_size};
+    }
+
+    /*! Type of the event. */
+    Kind kind = Kind::map;
+    /*! The process. */
+    ProcId pid = 0;
+    /*! Parent of the process for @ref Kind::fork. */
+    ProcId parent = 0;
+    /*! First mapped address. */
+    std::uint64_t start = 0;
+    /*! Length of the mapping in bytes. */
+    std::uint64_t size = 0;
+    /*! Offset of the mapping in the file. */
+    std::uint64_t offset = 0;
+    /*! Length of @ref filename. */
+    std::uint16_t filename_size = 0;
+    /*! Path of the mapped file for @ref Kind::map, not terminated. */
+    std::array<char, c_path_len> filename{};
+};
+
+/*******************************************************************************
+ * @brief Size of the sample records' payload with fields @p sample_type .
+ *
+ * @param num_counters Counters read by PERF_SAMPLE_READ besides the sampled event.
+ ******************************************************************************/
+std::size_t
+sample_payload_size(std::uint64_t sample_type, std::size_t num_counters = 0) noexcept;
+
+/*******************************************************************************
+ * @brief Parse sample @p record , nothing if it is not a sample.
+ *
+ * PERF_SAMPLE_READ values are expected in PERF_FORMAT_GROUP format, the
+ * sampled event first.
+ *
+ * @param sample_type Fields present in the record, @ref c_sample_type
+ *  optionally with PERF_SAMPLE_READ, PERF_SAMPLE_CALLCHAIN and PERF_SAMPLE_CGROUP.
+ * @param callchain Replaced by the instruction pointers of the callchain if
+ *  sampled, from the innermost frame, without the context markers. Deeper
+ *  stacks are cut to @ref c_max_callchain_depth innermost frames. Optional.
+ * @param counters Replaced by values of the other group members if read, as
+ *  read, i.e. totals since the start. Optional.
+ ******************************************************************************/
+std::optional<CpuSample>
+parse_sample(const PerfRecord& record, std::uint64_t sample_type = c_sample_type,
+             std::vector<std::uint64_t>* callchain = nullptr, CounterValues* counters = nullptr);
+
+/*******************************************************************************
+ * @brief Parse PERF_RECORD_SWITCH_CPU_WIDE @p record into a switch sample.
+ *
+ * Switches of the idle task are ignored, the switched-out thread records the
+ * beginning of the idle time.
+ *
+ * @param sample_type Fields of the records' sample_id, i.e. sample_id_all
+ *  must be set.
+ * @return Sample of @ref SampleKind::switch_in or @ref SampleKind::switch_out,
+ *  nothing for other records.
+ ******************************************************************************/
+std::optional<CpuSample>
+parse_switch(const PerfRecord& record, std::uint64_t sample_type = c_sample_type) noexcept;
+
+/*******************************************************************************
+ * @brief Parse PERF_RECORD_LOST @p record .
+ *
+ * @return Number of records the kernel dropped, nothing for other records.
+ ******************************************************************************/
+std::optional<std::uint64_t>
+parse_lost(const PerfRecord& record) noexcept;
+
+/*******************************************************************************
+ * @brief Parse process-wide lifecycle event from @p record .
+ *
+ * Thread-level events, i.e. new threads and renamed threads, are ignored.
+ *
+ * @return The event, nothing for other records.
+ ******************************************************************************/
+std::optional<TaskEvent>
+parse_task_event(const PerfRecord& record) noexcept;
+
+/*******************************************************************************
+ * @brief Parse PERF_RECORD_MMAP2 @p record of an executable file mapping.
+ *
+ * Anonymous and special mappings, e.g. [vdso], and kernel modules are ignored.
+ *
+ * @return Event of @ref MapEvent::Kind::map, nothing for other records.
+ ******************************************************************************/
+std::optional<MapEvent>
+parse_map_event(const PerfRecord& record) noexcept;
+} // namespace elphi
@@ -0,0 +1,154 @@
+/*******************************************************************************
+ * @file sample_merger.hpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license This file is released under ElPhi project's license, see LICENSE.
+ *
+ * Streaming merge of time-ordered sample streams.
+ ******************************************************************************/
+#pragma once
+
+#include <concepts>
+#include <span>
+#include <vector>
+
+#include <elphi/cpu_sampler.hpp>
+
+namespace elphi {
+
+/*******************************************************************************
+ * @brief K-way merge of time-ordered sample streams into one ordered stream.
+ *
+ * Samples are kept in a min-heap of the streams' first samples. A sample is
+ * emitted once no stream can produce an older one, i.e. when every stream has
+ * a pending sample, or once it is older than the reorder window before the
+ * newest pushed sample. Thus idle streams delay the output at most by the
+ * window and memory stays bounded by the samples pushed within it.
+ *
+ * Pending samples of a stream are kept in a buffer which is reused once
+ * consumed, thus a merger in a steady state does not allocate.
+ ******************************************************************************/
+class SampleMerger {
+public:
+    /*******************************************************************************
+     * @brief Create merger of @p num_streams streams.
+     *
+     * @param num_streams Number of input streams.
+     * @param reorder_window How long to wait for late samples of idle streams.
+     ******************************************************************************/
+    SampleMerger(std::size_t num_streams, TimePoint reorder_window);
+
+    /*******************************************************************************
+     * @brief Append @p samples to @p stream .
+     *
+     * @param stream Index of the input stream.
+     * @param samples Samples ordered by time, not older than any sample
+     *  previously pushed to the same stream.
+     ******************************************************************************/
+    void
+    push(std::size_t stream, std::span<const CpuSample> samples);
+
+    /*******************************************************************************
+     * @brief Make room for @p num pending samples of each stream.
+     *
+     * @throw std::bad_alloc if the room cannot be allocated.
+     ******************************************************************************/
+    void
+    reserve(std::size_t num);
+
+    /*******************************************************************************
+     * @brief Emit all samples which cannot be preceded by any future sample.
+     *
+     * @param clbk Called as `clbk(const CpuSample&)` in time order.
+     * @return Number of emitted samples.
+     ******************************************************************************/
+    template <typename Clbk>
+        requires std::invocable<Clbk&, const CpuSample&>
+    std::size_t
+    pop(Clbk&& clbk) {
+        std::size_t num = 0;
+        for (; can_emit(); ++num)
+            clbk(emit());
+        return num;
+    }
+
+    /*******************************************************************************
+     * @brief Emit all pending samples, e.g. at the end of the streams.
+     *
+     * @param clbk Called as `clbk(const CpuSample&)` in time order.
+     * @return Number of emitted samples.
+     ******************************************************************************/
+    template <typename Clbk>
+        requires std::invocable<Clbk&, const CpuSample&>
+    std::size_t
+    flush(Clbk&& clbk) {
+        std::size_t num = 0;
+        for (; !m_heap.empty(); ++num)
+            clbk(emit());
+        return num;
+    }
+
+    /*******************************************************************************
+     * @brief Number of samples waiting to be emitted.
+     ******************************************************************************/
+    std::size_t
+    num_pending() const noexcept;
+
+    /*******************************************************************************
+     * @brief Number of samples emitted out of order.
+     *
+     * Those arrived later than the reorder window allowed.
+     ******************************************************************************/
+    std::size_t
+    num_late() const noexcept;
+
+private:
+    /*! Pending samples of a stream. */
+    struct Stream {
+        /*! Samples, the emitted ones are compacted only once they make up most of it. */
+        std::vector<CpuSample> samples;
+        /*! Index of the first pending sample. */
+        std::size_t first = 0;
+
+        /*! Whether no sample is pending. */
+        bool
+        empty() const noexcept {
+            return first == samples.size();
+        }
+    };
+
+    /*! Oldest pending sample of a stream. */
+    struct HeapEntry {
+        /*! Time of the sample. */
+        TimePoint time;
+        /*! Stream of the sample. */
+        std::size_t stream;
+    };
+
+    /*******************************************************************************
+     * @brief Whether the oldest pending sample can be emitted.
+     ******************************************************************************/
+    bool
+    can_emit() const noexcept;
+
+    /*******************************************************************************
+     * @brief Remove the oldest pending sample, heap must not be empty.
+     ******************************************************************************/
+    CpuSample
+    emit();
+
+    /*! Pending samples of each stream. */
+    std::vector<Stream> m_streams;
+    /*! Min-heap of the first sample of each non-empty stream. */
+    std::vector<HeapEntry> m_heap;
+    /*! Samples older than newest - window are ready. */
+    TimePoint m_window;
+    /*! Time of the newest pushed sample. */
+    TimePoint m_newest = TimePoint::min();
+    /*! Time of the last emitted sample. */
+    TimePoint m_last_emitted = TimePoint::min();
+    /*! Number of pending samples. */
+    std::size_t m_num_pending = 0;
+    /*! Number of samples emitted out of order. */
+    std::size_t m_num_late = 0;
+};
+} // namespace elphi
@@ -0,0 +1,242 @@
+/*******************************************************************************
+ * @file sample_table.hpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license This file is released under ElPhi project's license, see LICENSE.
+ *
+ * Columnar storage of samples for fast filtering and counting.
+ ******************************************************************************/
+#pragma once
+
+#include <algorithm>
+#include <concepts>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include <elphi/cpu_sampler.hpp>
+
+namespace elphi::view {
+
+/*! Instruction set of the kernels scanning a @ref SampleTable. */
+enum class ScanKernel {
+    /*! Portable loop, one row at a time. */
+    scalar,
+    /*! SSE2, four rows at a time. */
+    sse2,
+    /*! AVX2, eight rows at a time. */
+    avx2,
+};
+
+/*******************************************************************************
+ * @brief Fastest kernel supported by the running CPU.
+ ******************************************************************************/
+ScanKernel
+best_scan_kernel() noexcept;
+
+/*******************************************************************************
+ * @brief Selection of samples, a sample must match all the set fields.
+ ******************************************************************************/
+struct SampleFilter {
+    /*! Process of the samples, any if not set. */
+    std::optional<ProcId> pid;
+    /*! Thread of the samples, any if not set. */
+    std::optional<ThreadId> tid;
+    /*! CPU of the samples, any if not set. */
+    std::optional<CpuId> cpu;
+    /*! Samples taken before are skipped. */
+    TimePoint from = TimePoint::min();
+    /*! Samples taken after are skipped. */
+    TimePoint to = TimePoint::max();
+};
+
+/*******************************************************************************
+ * @brief Time-ordered samples stored as columns.
+ *
+ * Filters mostly look at the time, process, thread and CPU, each is a column
+ * of its own, with the CPU narrowed to 16 bits. A scan thus reads only 10B
+ * per sample instead of the whole @ref CpuSample, and compares several
+ * samples per instruction. The remaining fields are kept in a row-wise
+ * column only read when the samples are materialized.
+ *
+ * Times are ordered, thus a time range is found by binary search and only
+ * the rows in it are scanned.
+ ******************************************************************************/
+class SampleTable {
+public:
+    /*! Number of samples materialized at once by @ref for_each_batch. */
+    static constexpr std::size_t c_batch_size = 1024;
+
+    /*******************************************************************************
+     * @brief Empty table.
+     ******************************************************************************/
+    SampleTable() = default;
+
+    /*******************************************************************************
+     * @brief Table of @p samples , see @ref append.
+     ******************************************************************************/
+    explicit SampleTable(std::span<const CpuSample> samples);
+
+    /*******************************************************************************
+     * @brief Append @p samples , keeping the rows ordered by time.
+     *
+     * Late samples, e.g. those emitted by @ref SampleMerger past its reorder
+     * window, are merged in among the rows of their time, after those already
+     * in the table. Only the rows newer than the oldest appended sample move.
+     *
+     * @param samples Samples mostly ordered by time, e.g. @ref CpuSamplingResult::samples.
+     * @throw ElphiException if a CPU does not fit 16 bits, nothing is appended then.
+     ******************************************************************************/
+    void
+    append(std::span<const CpuSample> samples);
+
+    /*******************************************************************************
+     * @brief Number of samples.
+     ******************************************************************************/
+    std::size_t
+    size() const noexcept {
+        return m_times.size();
+    }
+
+    /*******************************************************************************
+     * @brief Whether there are no samples.
+     ******************************************************************************/
+    bool
+    empty() const noexcept {
+        return m_times.empty();
+    }
+
+    /*******************************************************************************
+     * @brief Time of each sample.
+     ******************************************************************************/
+    std::span<const TimePoint>
+    times() const noexcept {
+        return m_times;
+    }
+
+    /*******************************************************************************
+     * @brief Process of each sample.
+     ******************************************************************************/
+    std::span<const ProcId>
+    pids() const noexcept {
+        return m_pids;
+    }
+
+    /*******************************************************************************
+     * @brief Thread of each sample.
+     ******************************************************************************/
+    std::span<const ThreadId>
+    tids() const noexcept {
+        return m_tids;
+    }
+
+    /*******************************************************************************
+     * @brief CPU of each sample.
+     ******************************************************************************/
+    std::span<const std::uint16_t>
+    cpus() const noexcept {
+        return m_cpus;
+    }
+
+    /*******************************************************************************
+     * @brief The @p index -th sample, must be less than @ref size.
+     ******************************************************************************/
+    CpuSample
+    row(std::size_t index) const noexcept;
+
+    /*******************************************************************************
+     * @brief Number of samples matching @p filter .
+     *
+     * @param kernel Instruction set to use, an unsupported one falls back to
+     *  @ref best_scan_kernel.
+     ******************************************************************************/
+    std::size_t
+    count(const SampleFilter& filter, ScanKernel kernel = best_scan_kernel()) const noexcept;
+
+    /*******************************************************************************
+     * @brief Append indices of the samples matching @p filter to @p rows .
+     *
+     * @param kernel Instruction set to use, an unsupported one falls back to
+     *  @ref best_scan_kernel.
+     * @return Number of appended indices, in increasing order.
+     ******************************************************************************/
+    std::size_t
+    select(const SampleFilter& filter, std::vector<std::size_t>& rows,
+           ScanKernel kernel = best_scan_kernel()) const;
+
+    /*******************************************************************************
+     * @brief Pass samples matching @p filter to @p clbk in batches.
+     *
+     * Existing views consume the samples as they are, e.g. `TimelineBuilder::add`.
+     *
+     * @param clbk Called as `clbk(std::span<const CpuSample>)` with at most
+     *  @ref c_batch_size samples in time order.
+     * @return Number of passed samples.
+     ******************************************************************************/
+    template <typename Clbk>
+        requires std::invocable<Clbk&, std::span<const CpuSample>>
+    std::size_t
+    for_each_batch(const SampleFilter& filter, Clbk&& clbk) const {
+        std::vector<std::size_t> rows;
+        std::vector<CpuSample> batch;
+        rows.reserve(c_batch_size);
+        batch.reserve(c_batch_size);
+        const auto [first, last] = rows_between(filter.from, filter.to);
+        std::size_t num = 0;
+        for (auto begin = first; begin < last; begin += c_batch_size) {
+            rows.clear();
+            select_between(filter, begin, std::min(begin + c_batch_size, last), rows, best_scan_kernel());
+            if (rows.empty())
+                continue;
+            batch.clear();
+            for (auto index : rows)
+                batch.push_back(row(index));
+            clbk(std::span<const CpuSample>{batch});
+            num += batch.size();
+        }
+        return num;
+    }
+
+private:
+    /*! Fields rarely filtered by. */
+    struct Details {
+        /*! Control group of the thread. */
+        GroupId cgroup;
+        /*! Call stack. */
+        StackId stack;
+        /*! Periodic sample or a context switch. */
+        SampleKind kind;
+    };
+
+    /*******************************************************************************
+     * @brief Merge rows from @p num_ordered on into the ordered rows before them, stably.
+     ******************************************************************************/
+    void
+    merge_tail(std::size_t num_ordered);
+
+    /*******************************************************************************
+     * @brief Rows [first, last) taken in time range [@p from, @p to].
+     ******************************************************************************/
+    std::pair<std::size_t, std::size_t>
+    rows_between(TimePoint from, TimePoint to) const noexcept;
+
+    /*******************************************************************************
+     * @brief Append rows in [@p begin, @p end) matching @p filter but its time range.
+     ******************************************************************************/
+    void
+    select_between(const SampleFilter& filter, std::size_t begin, std::size_t end, std::vector<std::size_t>& rows,
+                   ScanKernel kernel) const;
+
+    /*! Time column. */
+    std::vector<TimePoint> m_times;
+    /*! Process column. */
+    std::vector<ProcId> m_pids;
+    /*! Thread column. */
+    std::vector<ThreadId> m_tids;
+    /*! CPU column. */
+    std::vector<std::uint16_t> m_cpus;
+    /*! The other fields. */
+    std::vector<Details> m_details;
+};
+} // namespace elphi::view
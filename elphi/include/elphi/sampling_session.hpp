@@ -0,0 +1,232 @@
+/*******************************************************************************
+ * @file sampling_session.hpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license This file is released under ElPhi project's license, see LICENSE.
+ *
+ * Asynchronous sampling of CPU cores streaming the samples to sinks.
+ ******************************************************************************/
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <elphi/cpu_sampler.hpp>
+
+namespace elphi {
+
+/*! Receives batches of time-ordered samples, valid only during the call. */
+using SampleSink = std::function<void(std::span<const CpuSample>)>;
+
+/*!
+ * Receives counted events of the batch just passed to the sample sinks, i-th
+ * values belong to the i-th sample, valid only during the call.
+ */
+using CounterSink = std::function<void(std::span<const CounterValues>)>;
+
+/*! Receives new or changed process name, valid only during the call. */
+using NameSink = std::function<void(ProcId, std::string_view)>;
+
+/*! Receives path of a newly sampled cgroup, valid only during the call. */
+using GroupSink = std::function<void(GroupId, std::string_view)>;
+
+/*!
+ * Receives a new node of the call stack tree as its id, parent, instruction
+ * pointer and function, the function is empty if not resolved.
+ */
+using StackSink = std::function<void(StackId, StackId, std::uint64_t, std::string_view)>;
+
+/*******************************************************************************
+ * @brief Lifecycle of @ref SamplingSession.
+ ******************************************************************************/
+enum class SessionState {
+    /*! Events are opened, nothing is sampled yet. */
+    created,
+    /*! Sampling, samples are passed to the sinks. */
+    running,
+    /*! Sampling is paused, can be resumed by @ref SamplingSession::start. */
+    paused,
+    /*! All samples were passed to the sinks, cannot be restarted. */
+    stopped,
+};
+
+/*******************************************************************************
+ * @brief Continuous sampling passing the samples to sinks as they are drained.
+ *
+ * Samples are not accumulated, the session runs in constant memory. Sinks are
+ * called from a background thread, one batch at a time, in time order.
+ ******************************************************************************/
+class SamplingSession {
+public:
+    /*******************************************************************************
+     * @brief Open the events, sampling is started by @ref start.
+     *
+     * @param config What and how to sample.
+     * @throw ElphiException if @p config samples nothing or the events cannot
+     *  be opened.
+     ******************************************************************************/
+    explicit SamplingSession(SamplingConfig config);
+
+    /*******************************************************************************
+     * @brief Move-only.
+     ******************************************************************************/
+    SamplingSession(const SamplingSession&) = delete;
+
+    /*******************************************************************************
+     * @brief Reclaim @p other session, left in undetermined state.
+     ******************************************************************************/
+    SamplingSession(SamplingSession&& other) noexcept;
+
+    /*******************************************************************************
+     * @brief Move-only.
+     ******************************************************************************/
+    SamplingSession&
+    operator=(const SamplingSession&) = delete;
+
+    /*******************************************************************************
+     * @brief Reclaim @p other session, left in undetermined state.
+     ******************************************************************************/
+    SamplingSession&
+    operator=(SamplingSession&& other) noexcept;
+
+    /*******************************************************************************
+     * @brief Stop the session, errors are ignored.
+     ******************************************************************************/
+    ~SamplingSession();
+
+    /*******************************************************************************
+     * @brief Register a sink for the samples.
+     *
+     * @param sink Called from the session's thread with each batch.
+     * @throw ElphiException if the session has been already started.
+     ******************************************************************************/
+    void
+    add_sink(SampleSink sink);
+
+    /*******************************************************************************
+     * @brief Register a sink for counted events of the samples.
+     *
+     * Values are kept apart from the samples, in the order of @ref events,
+     * thus sessions without counters do not carry them. The sink is called
+     * right after the sample sinks with values of the same batch, periodic
+     * samples have the increments since the previous sample of their CPU,
+     * context switches zeroes. Never called if no counters are sampled.
+     *
+     * @param sink Called from the session's thread with each batch.
+     * @throw ElphiException if the session has been already started.
+     ******************************************************************************/
+    void
+    add_counter_sink(CounterSink sink);
+
+    /*******************************************************************************
+     * @brief Register a sink for names of the sampled processes.
+     *
+     * Names are learned from the kernel's records as processes fork and exec,
+     * unknown ones are looked up in /proc in the background. A name may be
+     * passed after the process' first samples, never after the last batch.
+     *
+     * @param sink Called from the session's thread with each new or changed name.
+     * @throw ElphiException if the session has been already started.
+     ******************************************************************************/
+    void
+    add_name_sink(NameSink sink);
+
+    /*******************************************************************************
+     * @brief Register a sink for paths of the sampled cgroups.
+     *
+     * Requires @ref SamplingConfig::sample_cgroups. Each cgroup is passed once,
+     * unknown ones are looked up in the background. A path may be passed after
+     * the cgroup's first samples, never after the last batch.
+     *
+     * @param sink Called from the session's thread with each new cgroup.
+     * @throw ElphiException if the session has been already started.
+     ******************************************************************************/
+    void
+    add_group_sink(GroupSink sink);
+
+    /*******************************************************************************
+     * @brief Register a sink for call stacks of the samples.
+     *
+     * Requires @ref SamplingConfig::sample_callchains. Stacks are aggregated
+     * into a calling-context tree, each new node is passed once as
+     * `sink(id, parent, ip, symbol)` before the first batch referring to it,
+     * parents before children. Replaying the nodes into @ref CallTree::child
+     * recreates the same ids. Symbols are resolved with
+     * @ref SamplingConfig::symbols, demangled.
+     *
+     * @param sink Called from the session's thread with each new stack.
+     * @throw ElphiException if the session has been already started.
+     ******************************************************************************/
+    void
+    add_stack_sink(StackSink sink);
+
+    /*******************************************************************************
+     * @brief Start or resume the sampling.
+     *
+     * @throw ElphiException if the session is stopped or events cannot be started.
+     ******************************************************************************/
+    void
+    start();
+
+    /*******************************************************************************
+     * @brief Pause the sampling, no-op unless running.
+     *
+     * Samples collected so far are still passed to the sinks.
+     ******************************************************************************/
+    void
+    pause();
+
+    /*******************************************************************************
+     * @brief Stop the sampling, pass all remaining samples to the sinks.
+     *
+     * Blocks until the sinks are called for the last time.
+     *
+     * @throw ElphiException in case sampling failed.
+     ******************************************************************************/
+    void
+    stop();
+
+    /*******************************************************************************
+     * @brief Current state of the session.
+     ******************************************************************************/
+    SessionState
+    state() const noexcept;
+
+    /*******************************************************************************
+     * @brief Activity of each CPU's ring buffer so far.
+     *
+     * Can be called from any thread, e.g. to watch for lost records. Passing
+     * the result to @ref RingPolicy::history of the next session resizes the
+     * rings to the observed load.
+     ******************************************************************************/
+    std::unordered_map<CpuId, RingStats>
+    ring_stats() const;
+
+    /*******************************************************************************
+     * @brief Actually sampled events, the software fallback if no PMU is present.
+     ******************************************************************************/
+    const EventSpec&
+    events() const noexcept;
+
+private:
+    struct Impl;
+
+    /*******************************************************************************
+     * @brief Open a reader of the configured events for each of @p shards .
+     *
+     * @throw ElphiException if the events cannot be opened.
+     ******************************************************************************/
+    void
+    open_readers(const std::vector<std::vector<CpuId>>& shards);
+
+    /*! Sampling parameters. */
+    SamplingConfig m_config;
+    /*! Current state. */
+    SessionState m_state = SessionState::created;
+    /*! Sampling threads and their state. */
+    std::unique_ptr<Impl> m_impl;
+};
+} // namespace elphi
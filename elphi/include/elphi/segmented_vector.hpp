@@ -0,0 +1,487 @@
+/*******************************************************************************
+ * @file segmented_vector.hpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license This file is released under ElPhi project's license, see LICENSE.
+ *
+ * Growable storage in fixed-size blocks recycled through a pool.
+ ******************************************************************************/
+#pragma once
+
+#include <algorithm>
+#include <compare>
+#include <concepts>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace elphi {
+
+/*******************************************************************************
+ * @brief Allocator of equally sized blocks, released blocks are reused.
+ *
+ * Released blocks are kept in an intrusive free list until @ref trim, thus a
+ * steady state of allocating and releasing does not reach the system
+ * allocator. Thread-safe.
+ ******************************************************************************/
+class BlockPool {
+public:
+    /*! Bytes of each block, large enough to amortize the pool's lock. */
+    static constexpr std::size_t c_block_size = std::size_t{64} << 10U;
+
+    /*******************************************************************************
+     * @brief Create empty pool.
+     ******************************************************************************/
+    BlockPool() = default;
+
+    BlockPool(const BlockPool&) = delete;
+    BlockPool(BlockPool&&) = delete;
+    BlockPool&
+    operator=(const BlockPool&) = delete;
+    BlockPool&
+    operator=(BlockPool&&) = delete;
+
+    /*******************************************************************************
+     * @brief Free the released blocks, all blocks must be released.
+     ******************************************************************************/
+    ~BlockPool();
+
+    /*******************************************************************************
+     * @brief Get an uninitialized block of @ref c_block_size bytes.
+     *
+     * @throw std::bad_alloc if a new block cannot be allocated.
+     ******************************************************************************/
+    void*
+    acquire();
+
+    /*******************************************************************************
+     * @brief Return @p block acquired from this pool for reuse.
+     ******************************************************************************/
+    void
+    release(void* block) noexcept;
+
+    /*******************************************************************************
+     * @brief Free all released blocks.
+     ******************************************************************************/
+    void
+    trim() noexcept;
+
+    /*******************************************************************************
+     * @brief Number of blocks allocated from the system, acquired or free.
+     ******************************************************************************/
+    std::size_t
+    num_blocks() const noexcept;
+
+    /*******************************************************************************
+     * @brief Number of released blocks ready for reuse.
+     ******************************************************************************/
+    std::size_t
+    num_free() const noexcept;
+
+private:
+    /*! Released block, linked through its first bytes. */
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    /*! Guards all of the below. */
+    mutable std::mutex m_mutex;
+    /*! Head of the free list. */
+    FreeBlock* m_free = nullptr;
+    /*! Number of blocks in the free list. */
+    std::size_t m_num_free = 0;
+    /*! Number of allocated blocks. */
+    std::size_t m_num_blocks = 0;
+};
+
+/*******************************************************************************
+ * @brief Sequence stored in blocks of a @ref BlockPool.
+ *
+ * Unlike std::vector, growing never moves the elements, thus appending is
+ * O(1) without spikes of reallocation and the addresses stay stable. Removing
+ * from the front releases whole blocks to the pool for other sequences.
+ *
+ * Iterate the blocks by @ref for_each_segment in hot loops, the iterators
+ * locate the block of each element.
+ *
+ * @tparam T Element type, trivially copyable.
+ ******************************************************************************/
+template <typename T>
+    requires std::is_trivially_copyable_v<T>
+class SegmentedVector {
+public:
+    /*! Elements in a block. */
+    static constexpr std::size_t c_segment_size = BlockPool::c_block_size / sizeof(T);
+    static_assert(c_segment_size > 0, "Elements must fit into a block.");
+    static_assert(alignof(T) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__, "Blocks are aligned as by operator new.");
+
+    /*******************************************************************************
+     * @brief Random-access iterator of the elements.
+     ******************************************************************************/
+    class Iterator {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        Iterator() = default;
+        Iterator(const SegmentedVector* vec, std::size_t index) noexcept : m_vec(vec), m_index(index) {}
+
+        reference
+        operator*() const noexcept {
+            return (*m_vec)[m_index];
+        }
+        pointer
+        operator->() const noexcept {
+            return &**this;
+        }
+        reference
+        operator[](difference_type n) const noexcept {
+            return *(*this + n);
+        }
+        Iterator&
+        operator++() noexcept {
+            ++m_index;
+            return *this;
+        }
+        Iterator
+        operator++(int) noexcept {
+            auto copy = *this;
+            ++m_index;
+            return copy;
+        }
+        Iterator&
+        operator--() noexcept {
+            --m_index;
+            return *this;
+        }
+        Iterator
+        operator--(int) noexcept {
+            auto copy = *this;
+            --m_index;
+            return copy;
+        }
+        Iterator&
+        operator+=(difference_type n) noexcept {
+            m_index = static_cast<std::size_t>(static_cast<difference_type>(m_index) + n);
+            return *this;
+        }
+        Iterator&
+        operator-=(difference_type n) noexcept {
+            return *this += -n;
+        }
+        friend Iterator
+        operator+(Iterator it, difference_type n) noexcept {
+            return it += n;
+        }
+        friend Iterator
+        operator+(difference_type n, Iterator it) noexcept {
+            return it += n;
+        }
+        friend Iterator
+        operator-(Iterator it, difference_type n) noexcept {
+            return it -= n;
+        }
+        friend difference_type
+        operator-(const Iterator& lhs, const Iterator& rhs) noexcept {
+            return static_cast<difference_type>(lhs.m_index) - static_cast<difference_type>(rhs.m_index);
+        }
+        friend bool
+        operator==(const Iterator& lhs, const Iterator& rhs) noexcept {
+            return lhs.m_index == rhs.m_index;
+        }
+        friend auto
+        operator<=>(const Iterator& lhs, const Iterator& rhs) noexcept {
+            return lhs.m_index <=> rhs.m_index;
+        }
+
+    private:
+        /*! Iterated sequence. */
+        const SegmentedVector* m_vec = nullptr;
+        /*! Index of the element. */
+        std::size_t m_index = 0;
+    };
+
+    /*******************************************************************************
+     * @brief Create empty sequence with a pool of its own, created on first use.
+     ******************************************************************************/
+    SegmentedVector() noexcept = default;
+
+    /*******************************************************************************
+     * @brief Create empty sequence allocating from @p pool .
+     ******************************************************************************/
+    explicit SegmentedVector(std::shared_ptr<BlockPool> pool) noexcept : m_pool(std::move(pool)) {}
+
+    /*******************************************************************************
+     * @brief Copy elements of @p other , the copy shares its pool.
+     ******************************************************************************/
+    SegmentedVector(const SegmentedVector& other) : m_pool(other.m_pool) {
+        other.for_each_segment([this](std::span<const T> segment) { append(segment); });
+    }
+
+    /*******************************************************************************
+     * @brief Reclaim blocks of @p other , left empty.
+     ******************************************************************************/
+    SegmentedVector(SegmentedVector&& other) noexcept :
+        m_pool(other.m_pool), m_blocks(std::move(other.m_blocks)), m_offset(other.m_offset), m_size(other.m_size) {
+        other.m_blocks.clear();
+        other.m_offset = 0;
+        other.m_size = 0;
+    }
+
+    /*******************************************************************************
+     * @brief Replace elements by a copy of @p other .
+     ******************************************************************************/
+    SegmentedVector&
+    operator=(const SegmentedVector& other) {
+        if (this != &other) {
+            clear();
+            other.for_each_segment([this](std::span<const T> segment) { append(segment); });
+        }
+        return *this;
+    }
+
+    /*******************************************************************************
+     * @brief Replace elements by blocks of @p other , left empty.
+     ******************************************************************************/
+    SegmentedVector&
+    operator=(SegmentedVector&& other) noexcept {
+        if (this != &other) {
+            clear();
+            m_pool = other.m_pool;
+            m_blocks = std::move(other.m_blocks);
+            m_offset = std::exchange(other.m_offset, 0);
+            m_size = std::exchange(other.m_size, 0);
+            other.m_blocks.clear();
+        }
+        return *this;
+    }
+
+    /*******************************************************************************
+     * @brief Release all blocks to the pool.
+     ******************************************************************************/
+    ~SegmentedVector() { clear(); }
+
+    /*******************************************************************************
+     * @brief Append @p value .
+     *
+     * @throw std::bad_alloc if a new block cannot be allocated.
+     ******************************************************************************/
+    T&
+    push_back(const T& value) {
+        const auto index = m_offset + m_size;
+        if (index == m_blocks.size() * c_segment_size)
+            grow();
+        T* slot = m_blocks[index / c_segment_size] + index % c_segment_size;
+        std::construct_at(slot, value);
+        ++m_size;
+        return *slot;
+    }
+
+    /*******************************************************************************
+     * @brief Append all @p values .
+     *
+     * @throw std::bad_alloc if a new block cannot be allocated.
+     ******************************************************************************/
+    void
+    append(std::span<const T> values) {
+        while (!values.empty()) {
+            const auto index = m_offset + m_size;
+            if (index == m_blocks.size() * c_segment_size)
+                grow();
+            const auto num = std::min(values.size(), c_segment_size - index % c_segment_size);
+            std::uninitialized_copy_n(values.data(), num, m_blocks[index / c_segment_size] + index % c_segment_size);
+            m_size += num;
+            values = values.subspan(num);
+        }
+    }
+
+    /*******************************************************************************
+     * @brief Remove first @p num elements, releasing blocks left without any.
+     ******************************************************************************/
+    void
+    pop_front(std::size_t num) noexcept {
+        num = std::min(num, m_size);
+        m_offset += num;
+        m_size -= num;
+        const auto num_empty = m_size == 0 ? m_blocks.size() : m_offset / c_segment_size;
+        for (std::size_t i = 0; i < num_empty; ++i)
+            m_pool->release(m_blocks[i]);
+        m_blocks.erase(m_blocks.begin(), m_blocks.begin() + static_cast<std::ptrdiff_t>(num_empty));
+        m_offset = m_size == 0 ? 0 : m_offset - num_empty * c_segment_size;
+    }
+
+    /*******************************************************************************
+     * @brief Remove all elements, releasing all blocks.
+     ******************************************************************************/
+    void
+    clear() noexcept {
+        pop_front(m_size);
+    }
+
+    /*******************************************************************************
+     * @brief Move all elements to the end of @p dest , freeing each block once copied.
+     *
+     * @p dest is reserved once, thus it is never reallocated and its pages are
+     * touched only as the blocks are copied. The copied blocks are returned to
+     * the system, the free blocks of the pool are freed too, so the resident
+     * memory stays close to a single copy of the elements.
+     *
+     * @throw std::bad_alloc if @p dest cannot grow, the elements not yet moved are kept.
+     ******************************************************************************/
+    void
+    move_to(std::vector<T>& dest) {
+        dest.reserve(dest.size() + m_size);
+        std::size_t num_freed = 0;
+        const auto forget_freed = [this, &num_freed] {
+            m_blocks.erase(m_blocks.begin(), m_blocks.begin() + static_cast<std::ptrdiff_t>(num_freed));
+        };
+        try {
+            while (m_size > 0) {
+                T* block = m_blocks[num_freed];
+                const auto num = std::min(m_size, c_segment_size - m_offset);
+                dest.insert(dest.end(), block + m_offset, block + m_offset + num);
+                m_size -= num;
+                m_offset = 0;
+                ++num_freed;
+                // Kept in the pool, the block would hold the memory of its copy.
+                m_pool->release(block);
+                m_pool->trim();
+            }
+        } catch (...) {
+            forget_freed();
+            throw;
+        }
+        forget_freed();
+        clear();
+    }
+
+    /*******************************************************************************
+     * @brief Call `clbk(std::span<const T>)` for contiguous runs of the elements, in order.
+     ******************************************************************************/
+    template <typename Clbk>
+        requires std::invocable<Clbk&, std::span<const T>>
+    void
+    for_each_segment(Clbk&& clbk) const {
+        auto offset = m_offset;
+        auto remaining = m_size;
+        for (std::size_t i = 0; remaining > 0; ++i) {
+            const auto num = std::min(remaining, c_segment_size - offset);
+            clbk(std::span<const T>{m_blocks[i] + offset, num});
+            remaining -= num;
+            offset = 0;
+        }
+    }
+
+    /*******************************************************************************
+     * @brief Element at @p index .
+     ******************************************************************************/
+    T&
+    operator[](std::size_t index) noexcept {
+        index += m_offset;
+        return m_blocks[index / c_segment_size][index % c_segment_size];
+    }
+
+    /*******************************************************************************
+     * @brief Element at @p index .
+     ******************************************************************************/
+    const T&
+    operator[](std::size_t index) const noexcept {
+        index += m_offset;
+        return m_blocks[index / c_segment_size][index % c_segment_size];
+    }
+
+    /*******************************************************************************
+     * @brief First element, must not be empty.
+     ******************************************************************************/
+    T&
+    front() noexcept {
+        return (*this)[0];
+    }
+
+    /*******************************************************************************
+     * @brief Last element, must not be empty.
+     ******************************************************************************/
+    T&
+    back() noexcept {
+        return (*this)[m_size - 1];
+    }
+
+    /*******************************************************************************
+     * @brief Last element, must not be empty.
+     ******************************************************************************/
+    const T&
+    back() const noexcept {
+        return (*this)[m_size - 1];
+    }
+
+    /*******************************************************************************
+     * @brief Number of elements.
+     ******************************************************************************/
+    std::size_t
+    size() const noexcept {
+        return m_size;
+    }
+
+    /*******************************************************************************
+     * @brief Whether there are no elements.
+     ******************************************************************************/
+    bool
+    empty() const noexcept {
+        return m_size == 0;
+    }
+
+    /*******************************************************************************
+     * @brief Iterator of the first element.
+     ******************************************************************************/
+    Iterator
+    begin() const noexcept {
+        return {this, 0};
+    }
+
+    /*******************************************************************************
+     * @brief Iterator past the last element.
+     ******************************************************************************/
+    Iterator
+    end() const noexcept {
+        return {this, m_size};
+    }
+
+    /*******************************************************************************
+     * @brief Pool of the blocks, nothing if none was used yet.
+     ******************************************************************************/
+    const std::shared_ptr<BlockPool>&
+    pool() const noexcept {
+        return m_pool;
+    }
+
+private:
+    /*******************************************************************************
+     * @brief Append an empty block.
+     ******************************************************************************/
+    void
+    grow() {
+        if (m_pool == nullptr)
+            m_pool = std::make_shared<BlockPool>();
+        // Room first, an acquired block must not leak.
+        if (m_blocks.size() == m_blocks.capacity())
+            m_blocks.reserve(std::max<std::size_t>(8, m_blocks.capacity() * 2));
+        m_blocks.push_back(static_cast<T*>(m_pool->acquire()));
+    }
+
+    /*! Source of the blocks. */
+    std::shared_ptr<BlockPool> m_pool;
+    /*! Blocks in order, the last one is partially filled. */
+    std::vector<T*> m_blocks;
+    /*! Index of the first element in the first block. */
+    std::size_t m_offset = 0;
+    /*! Number of elements. */
+    std::size_t m_size = 0;
+};
+} // namespace elphi
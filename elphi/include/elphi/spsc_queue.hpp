@@ -0,0 +1,117 @@
+/*******************************************************************************
+ * @file spsc_queue.hpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license This file is released under ElPhi project's license, see LICENSE.
+ *
+ * Bounded lock-free single-producer single-consumer queue.
+ ******************************************************************************/
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace elphi {
+
+/*******************************************************************************
+ * @brief Bounded lock-free queue for handing elements between two threads.
+ *
+ * Exactly one thread may push and exactly one other thread may consume.
+ * Both indices only grow, their difference is the number of queued elements.
+ *
+ * @tparam T Element type, must be default constructible and copyable.
+ ******************************************************************************/
+template <typename T>
+class SpscQueue {
+public:
+    /*******************************************************************************
+     * @brief Allocate the queue.
+     *
+     * @param capacity Minimal number of elements the queue can hold, rounded
+     *  up to a power of two.
+     ******************************************************************************/
+    explicit SpscQueue(std::size_t capacity) :
+        m_items(std::bit_ceil(std::max<std::size_t>(capacity, 1))), m_mask(m_items.size() - 1) {}
+
+    /*******************************************************************************
+     * @brief Push @p value to the queue, called by the producer only.
+     *
+     * @return Whether the value was pushed, false if the queue is full.
+     ******************************************************************************/
+    bool
+    try_push(const T& value) noexcept {
+        const auto head = m_head.load(std::memory_order_relaxed);
+        if (head - m_cached_tail == m_items.size()) {
+            m_cached_tail = m_tail.load(std::memory_order_acquire);
+            if (head - m_cached_tail == m_items.size())
+                return false;
+        }
+        m_items[head & m_mask] = value;
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /*******************************************************************************
+     * @brief Pop all queued elements, called by the consumer only.
+     *
+     * @param clbk Called as `clbk(std::span<const T>)` with at most two
+     *  contiguous chunks in FIFO order. Elements are released after the call.
+     * @return Number of popped elements.
+     ******************************************************************************/
+    template <typename Clbk>
+        requires std::invocable<Clbk&, std::span<const T>>
+    std::size_t
+    consume(Clbk&& clbk) {
+        const auto tail = m_tail.load(std::memory_order_relaxed);
+        const auto head = m_head.load(std::memory_order_acquire);
+        const auto num = head - tail;
+        if (num == 0)
+            return 0;
+
+        const std::span<const T> items{m_items};
+        const auto begin = tail & m_mask;
+        const auto first_n = std::min(num, items.size() - begin);
+        clbk(items.subspan(begin, first_n));
+        if (first_n < num)
+            clbk(items.first(num - first_n));
+
+        m_tail.store(head, std::memory_order_release);
+        return num;
+    }
+
+    /*******************************************************************************
+     * @brief Approximate number of queued elements.
+     ******************************************************************************/
+    std::size_t
+    size() const noexcept {
+        return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire);
+    }
+
+    /*******************************************************************************
+     * @brief Maximum number of elements the queue can hold.
+     ******************************************************************************/
+    std::size_t
+    capacity() const noexcept {
+        return m_items.size();
+    }
+
+private:
+    /*! Keep producer and consumer indices apart to avoid false sharing. */
+    static constexpr std::size_t c_cache_line = 64;
+
+    /*! Element storage. */
+    std::vector<T> m_items;
+    /*! Maps indices to the storage. */
+    std::size_t m_mask;
+    /*! Next index to write to, owned by the producer. */
+    alignas(c_cache_line) std::atomic<std::size_t> m_head{0};
+    /*! Producer's last seen value of @ref m_tail. */
+    std::size_t m_cached_tail{0};
+    /*! Next index to read from, owned by the consumer. */
+    alignas(c_cache_line) std::atomic<std::size_t> m_tail{0};
+};
+} // namespace elphi
@@ -0,0 +1,88 @@
+/*******************************************************************************
+ * @file string_table.hpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license This file is released under ElPhi project's license, see LICENSE.
+ *
+ * Interning of strings into small integer ids.
+ ******************************************************************************/
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace elphi {
+
+/*! Id of an interned string. */
+using NameId = std::uint32_t;
+
+/*! Id of the "UNKNOWN" string, present in every table. */
+inline constexpr NameId c_unknown_name = 0;
+
+/*******************************************************************************
+ * @brief Append-only table of unique strings.
+ *
+ * Each distinct string is stored only once and identified by its id. Views of
+ * the stored strings stay valid for the table's lifetime.
+ ******************************************************************************/
+class StringTable {
+public:
+    /*******************************************************************************
+     * @brief Create table containing only "UNKNOWN" as @ref c_unknown_name.
+     ******************************************************************************/
+    StringTable();
+
+    /*******************************************************************************
+     * @brief Copy the strings, ids are preserved.
+     ******************************************************************************/
+    StringTable(const StringTable& other);
+
+    /*******************************************************************************
+     * @brief Claim strings from @p other , left in undetermined state.
+     ******************************************************************************/
+    StringTable(StringTable&& other) noexcept = default;
+
+    /*******************************************************************************
+     * @brief Copy the strings, ids are preserved.
+     ******************************************************************************/
+    StringTable&
+    operator=(const StringTable& other);
+
+    /*******************************************************************************
+     * @brief Claim strings from @p other , left in undetermined state.
+     ******************************************************************************/
+    StringTable&
+    operator=(StringTable&& other) noexcept = default;
+
+    /*******************************************************************************
+     * @brief Default destructor.
+     ******************************************************************************/
+    ~StringTable() = default;
+
+    /*******************************************************************************
+     * @brief Get id of @p str , storing it if not present yet.
+     ******************************************************************************/
+    NameId
+    intern(std::string_view str);
+
+    /*******************************************************************************
+     * @brief Get string with id @p id , "UNKNOWN" for unknown ids.
+     ******************************************************************************/
+    std::string_view
+    resolve(NameId id) const noexcept;
+
+    /*******************************************************************************
+     * @brief Number of stored strings.
+     ******************************************************************************/
+    std::size_t
+    size() const noexcept;
+
+private:
+    /*! Stored strings indexed by their id, deque keeps them in place. */
+    std::deque<std::string> m_strings;
+    /*! Maps views of @ref m_strings to their ids. */
+    std::unordered_map<std::string_view, NameId> m_ids;
+};
+} // namespace elphi
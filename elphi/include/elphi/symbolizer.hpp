@@ -0,0 +1,147 @@
+/*******************************************************************************
+ * @file symbolizer.hpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license This file is released under ElPhi project's license, see LICENSE.
+ *
+ * Resolution of sampled instruction pointers to function names.
+ ******************************************************************************/
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <elphi/cpu_sampler.hpp>
+#include <elphi/elf_symbols.hpp>
+#include <elphi/perf_records.hpp>
+
+namespace elphi {
+
+/*******************************************************************************
+ * @brief Tracks address spaces of processes to resolve their instruction pointers.
+ *
+ * Mappings are learned from PERF_RECORD_MMAP2 records, processes not seen
+ * through them, e.g. started before the sampling, are read from
+ * /proc/<pid>/maps on their first lookup. Mapped files are indexed lazily,
+ * on the first address resolved in them, through the shared @ref SymbolCache.
+ * Address spaces are forgotten on exit of their processes, the indexes no
+ * other known process uses are released by @ref release_files.
+ *
+ * Only user-space addresses are resolved. Not thread-safe.
+ ******************************************************************************/
+class Symbolizer {
+public:
+    /*******************************************************************************
+     * @brief Create symbolizer without any known process.
+     *
+     * @param cache Indexes of the mapped files, shared with other symbolizers.
+     * @param proc_root Mount point of procfs.
+     ******************************************************************************/
+    explicit Symbolizer(std::shared_ptr<SymbolCache> cache, std::string proc_root = "/proc");
+
+    /*******************************************************************************
+     * @brief Apply change @p event of a process' address space.
+     ******************************************************************************/
+    void
+    on_map(const MapEvent& event);
+
+    /*******************************************************************************
+     * @brief Function of process @p pid containing instruction @p ip .
+     *
+     * @return Raw name of the function, valid until the next
+     *  @ref release_files. Nothing if the address is not in a mapped file or no
+     *  function of the file contains it, e.g. the process is gone.
+     ******************************************************************************/
+    std::optional<std::string_view>
+    symbolize(ProcId pid, std::uint64_t ip);
+
+    /*******************************************************************************
+     * @brief Release indexes of files not used by any known process.
+     *
+     * Scans all indexed files, call it once after a batch of exits.
+     ******************************************************************************/
+    void
+    release_files();
+
+    /*******************************************************************************
+     * @brief Number of processes with known address spaces.
+     ******************************************************************************/
+    std::size_t
+    num_processes() const noexcept {
+        return m_spaces.size();
+    }
+
+    /*******************************************************************************
+     * @brief Number of files indexed for the known processes.
+     ******************************************************************************/
+    std::size_t
+    num_files() const noexcept {
+        return m_files.size();
+    }
+
+private:
+    /*! Executable mapping of a file. */
+    struct Mapping {
+        /*! First mapped address. */
+        std::uint64_t start = 0;
+        /*! First address past the mapping. */
+        std::uint64_t end = 0;
+        /*! Offset of the mapping in the file. */
+        std::uint64_t offset = 0;
+        /*! Path of the file. */
+        std::string path{};
+        /*! Index of the file, null until first used or if it cannot be read. */
+        std::shared_ptr<const ElfSymbols> symbols{};
+        /*! Whether @ref symbols was loaded. */
+        bool loaded = false;
+    };
+
+    /*! Mappings of a process ordered by their start. */
+    using AddressSpace = std::vector<Mapping>;
+
+    /*******************************************************************************
+     * @brief Address space of @p pid , read from /proc if not known yet.
+     ******************************************************************************/
+    AddressSpace&
+    space(ProcId pid);
+
+    /*******************************************************************************
+     * @brief Add executable mappings of /proc/<@p pid>/maps to @p space .
+     *
+     * @return Whether the process is in /proc.
+     ******************************************************************************/
+    bool
+    read_maps(ProcId pid, AddressSpace& space) const;
+
+    /*******************************************************************************
+     * @brief Insert @p mapping into @p space replacing mappings it overlaps.
+     ******************************************************************************/
+    static void
+    map(AddressSpace& space, Mapping mapping);
+
+    /*******************************************************************************
+     * @brief Index of the file of @p mapping , loaded on first use.
+     ******************************************************************************/
+    const ElfSymbols*
+    symbols(Mapping& mapping);
+
+    /*! Indexes shared across symbolizers. */
+    std::shared_ptr<SymbolCache> m_cache;
+    /*! Mount point of procfs. */
+    std::string m_proc_root;
+    /*! Address spaces of the known processes. */
+    std::unordered_map<ProcId, AddressSpace> m_spaces;
+    /*! Files indexed for the known processes, keeps the names alive. */
+    std::unordered_map<std::string, std::shared_ptr<const ElfSymbols>> m_files;
+};
+
+/*******************************************************************************
+ * @brief Demangle C++ @p symbol , other symbols are returned as they are.
+ ******************************************************************************/
+std::string
+demangle(std::string_view symbol);
+} // namespace elphi
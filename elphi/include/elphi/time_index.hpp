@@ -0,0 +1,194 @@
+/*******************************************************************************
+ * @file time_index.hpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license This file is released under ElPhi project's license, see LICENSE.
+ *
+ * Time-range queries over timelines and samples without scanning them.
+ ******************************************************************************/
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <elphi/cpu_sampler.hpp>
+#include <elphi/timeline_view.hpp>
+
+namespace elphi::view {
+
+/*! Number of entries summarized by a single block of the indexes. */
+inline constexpr std::size_t c_time_block_size = 64;
+
+/*******************************************************************************
+ * @brief Index of a single CPU's timeline answering time-range queries.
+ *
+ * Slices are summarized in blocks of @ref c_time_block_size, a query
+ * binary-searches the dense block summaries first and then a single block,
+ * touching only a few cache lines even for timelines of hours.
+ *
+ * The index views the slices, it is invalidated with them.
+ ******************************************************************************/
+class SliceIndex {
+public:
+    /*******************************************************************************
+     * @brief Index of no slices.
+     ******************************************************************************/
+    SliceIndex() = default;
+
+    /*******************************************************************************
+     * @brief Index @p slices of a single CPU.
+     *
+     * @param slices Contiguous slices ordered by time, not overlapping, e.g. a
+     *  @ref CpuTimeline of @ref gen_cpu_timelines or of
+     *  @ref TimelineBuilder::take_timeline. The segmented slices of
+     *  @ref TimelineBuilder::cpu_timeline are not contiguous.
+     ******************************************************************************/
+    explicit SliceIndex(std::span<const ThreadTimeSlice> slices);
+
+    /*******************************************************************************
+     * @brief Slices overlapping time range [@p from, @p to], in O(log n).
+     *
+     * @return View of the indexed slices, empty if none overlaps.
+     ******************************************************************************/
+    std::span<const ThreadTimeSlice>
+    overlapping(TimePoint from, TimePoint to) const noexcept;
+
+    /*******************************************************************************
+     * @brief All indexed slices.
+     ******************************************************************************/
+    std::span<const ThreadTimeSlice>
+    slices() const noexcept {
+        return m_slices;
+    }
+
+private:
+    /*! The indexed slices. */
+    std::span<const ThreadTimeSlice> m_slices;
+    /*! Begin of the first slice of each block. */
+    std::vector<TimePoint> m_block_begins;
+    /*! Latest end of the slices up to the end of each block, non-decreasing. */
+    std::vector<TimePoint> m_block_ends;
+};
+
+/*******************************************************************************
+ * @brief Index of all CPUs of a timeline.
+ *
+ * The index views the slices of the timeline, it is invalidated with it.
+ ******************************************************************************/
+class TimelineIndex {
+public:
+    /*******************************************************************************
+     * @brief Index of no CPUs.
+     ******************************************************************************/
+    TimelineIndex() = default;
+
+    /*******************************************************************************
+     * @brief Index each CPU of @p timeline .
+     ******************************************************************************/
+    explicit TimelineIndex(const Timeline& timeline);
+
+    /*******************************************************************************
+     * @brief Slices of @p cpu overlapping time range [@p from, @p to].
+     *
+     * @return View of the slices, empty for unknown CPUs.
+     ******************************************************************************/
+    std::span<const ThreadTimeSlice>
+    overlapping(CpuId cpu, TimePoint from, TimePoint to) const noexcept;
+
+    /*******************************************************************************
+     * @brief Slices of each of @p cpus overlapping time range [@p from, @p to].
+     *
+     * @return View of the slices of each CPU in the order of @p cpus , CPUs
+     *  without such slices are omitted.
+     ******************************************************************************/
+    std::vector<std::pair<CpuId, std::span<const ThreadTimeSlice>>>
+    overlapping(std::span<const CpuId> cpus, TimePoint from, TimePoint to) const;
+
+private:
+    /*! Index of each CPU. */
+    std::unordered_map<CpuId, SliceIndex> m_cpus;
+};
+
+/*******************************************************************************
+ * @brief Index of time-ordered samples of all CPUs.
+ *
+ * Samples are summarized in blocks of @ref c_time_block_size by their time
+ * span and a mask of their CPUs, thus queries of a few CPUs skip the blocks
+ * of the other ones.
+ *
+ * The index views the samples, it is invalidated with them.
+ ******************************************************************************/
+class SampleIndex {
+public:
+    /*******************************************************************************
+     * @brief Index of no samples.
+     ******************************************************************************/
+    SampleIndex() = default;
+
+    /*******************************************************************************
+     * @brief Index @p samples ordered by time, e.g. @ref CpuSamplingResult::samples.
+     ******************************************************************************/
+    explicit SampleIndex(std::span<const CpuSample> samples);
+
+    /*******************************************************************************
+     * @brief Samples taken in time range [@p from, @p to], in O(log n).
+     *
+     * @return View of the indexed samples.
+     ******************************************************************************/
+    std::span<const CpuSample>
+    range(TimePoint from, TimePoint to) const noexcept;
+
+    /*******************************************************************************
+     * @brief Pass samples of @p cpus taken in [@p from, @p to] to @p clbk .
+     *
+     * @param clbk Called as `clbk(const CpuSample&)` in time order.
+     * @return Number of passed samples.
+     ******************************************************************************/
+    template <typename Clbk>
+    std::size_t
+    for_each(TimePoint from, TimePoint to, std::span<const CpuId> cpus, Clbk&& clbk) const {
+        const auto samples = range(from, to);
+        if (samples.empty())
+            return 0;
+
+        std::uint64_t mask = 0;
+        for (auto cpu : cpus)
+            mask |= cpu_bit(cpu);
+        std::size_t num_passed = 0;
+        const auto first = static_cast<std::size_t>(samples.data() - m_samples.data());
+        for (auto pos = first; pos < first + samples.size();) {
+            const auto block_end = std::min((pos / c_time_block_size + 1) * c_time_block_size, first + samples.size());
+            // Blocks of other CPUs only are skipped whole.
+            if ((m_block_cpus[pos / c_time_block_size] & mask) != 0)
+                for (const auto& sample : m_samples.subspan(pos, block_end - pos))
+                    if (std::ranges::find(cpus, sample.cpu) != cpus.end()) {
+                        clbk(sample);
+                        ++num_passed;
+                    }
+            pos = block_end;
+        }
+        return num_passed;
+    }
+
+private:
+    /*******************************************************************************
+     * @brief Bit of @p cpu in @ref m_block_cpus, shared by CPUs 64 apart.
+     ******************************************************************************/
+    static std::uint64_t
+    cpu_bit(CpuId cpu) noexcept {
+        return std::uint64_t{1} << (cpu % 64);
+    }
+
+    /*! The indexed samples. */
+    std::span<const CpuSample> m_samples;
+    /*! Time of the first sample of each block. */
+    std::vector<TimePoint> m_block_begins;
+    /*! Time of the last sample of each block. */
+    std::vector<TimePoint> m_block_ends;
+    /*! Bits of the CPUs present in each block. */
+    std::vector<std::uint64_t> m_block_cpus;
+};
+} // namespace elphi::view
@@ -0,0 +1,213 @@
+/*******************************************************************************
+ * @file timeline_lod.hpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license This file is released under ElPhi project's license, see LICENSE.
+ *
+ * Multi-resolution summary of CPU timelines for rendering zoomed-out views.
+ ******************************************************************************/
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include <elphi/cpu_sampler.hpp>
+
+namespace elphi::view {
+
+/*! Number of bins of @ref LodBucket::occupancy. */
+inline constexpr std::size_t c_occupancy_bins = 8;
+
+/*******************************************************************************
+ * @brief Summary of a single CPU during a single time bucket.
+ *
+ * The idle task, process 0, does not count as busy and is never dominant.
+ ******************************************************************************/
+struct LodBucket {
+    /*! Time the CPU executed threads, at most the width of the bucket. */
+    TimePoint busy = TimePoint::zero();
+    /*! Time of the dominant thread, approximate if the bucket holds many threads. */
+    TimePoint dominant_time = TimePoint::zero();
+    /*! Process ID of the dominant thread, zero if there was none. */
+    ProcId pid = 0;
+    /*! Thread ID of the dominant thread. */
+    ThreadId tid = 0;
+    /*******************************************************************************
+     * Number of the finished base buckets inside this one by their busy
+     * fraction, bin `i` holds fractions in [i/bins, (i+1)/bins), the last one
+     * also a full occupancy. Base buckets summarize themselves.
+     ******************************************************************************/
+    std::array<std::uint32_t, c_occupancy_bins> occupancy{};
+};
+
+/*******************************************************************************
+ * @brief Resolution of the levels of a @ref TimelinePyramid.
+ ******************************************************************************/
+struct LodConfig {
+    /*! Width of the buckets of the finest level. */
+    TimePoint base_width = std::chrono::milliseconds{1};
+    /*! Number of buckets of a level merged into a single one of the next level. */
+    std::size_t factor = 4;
+    /*! Number of levels, including the finest one. */
+    std::size_t num_levels = 10;
+};
+
+/*******************************************************************************
+ * @brief Buckets of a single level covering a time range.
+ ******************************************************************************/
+struct LodView {
+    /*! Start of the first bucket. */
+    TimePoint begin = TimePoint::zero();
+    /*! Width of each bucket. */
+    TimePoint width = TimePoint::zero();
+    /*! Consecutive buckets from @ref begin. */
+    std::span<const LodBucket> buckets;
+};
+
+/*******************************************************************************
+ * @brief Incrementally built pyramid of @ref LodBucket of each CPU.
+ *
+ * Level `k` splits the time into buckets of `base_width * factor^k` aligned to
+ * time zero, a renderer picks the finest level fitting its width and so reads
+ * O(screen width) buckets at any zoom.
+ *
+ * Time between consecutive samples of a CPU is attributed exactly as
+ * @ref TimelineBuilder prolongs its slices, i.e. only if the later sample
+ * continues the slice. Each level accumulates the time itself, adding samples
+ * costs O(levels) per sample plus O(1) per crossed bucket without any rebuild.
+ *
+ * Dominant threads are tracked by the space-saving algorithm over a few
+ * candidates, thus they are exact unless a bucket holds many threads.
+ ******************************************************************************/
+class TimelinePyramid {
+public:
+    /*******************************************************************************
+     * @brief Create empty pyramid of the default resolution.
+     ******************************************************************************/
+    TimelinePyramid();
+
+    /*******************************************************************************
+     * @brief Create empty pyramid of resolution given by @p config .
+     *
+     * @throw ElphiException if @p config has zero width, factor less than two
+     *  or no levels.
+     ******************************************************************************/
+    explicit TimelinePyramid(const LodConfig& config);
+
+    /*******************************************************************************
+     * @brief Extend the pyramid by @p samples .
+     *
+     * @param samples Samples ordered by time for each CPU, not older than the
+     *  samples added before, with non-negative times.
+     ******************************************************************************/
+    void
+    add(std::span<const CpuSample> samples);
+
+    /*******************************************************************************
+     * @brief Drop buckets of all levels which ended before @p cutoff .
+     *
+     * @return Number of dropped buckets of the finest level.
+     ******************************************************************************/
+    std::size_t
+    evict_before(TimePoint cutoff);
+
+    /*******************************************************************************
+     * @brief Buckets of @p cpu covering [@p from, @p to].
+     *
+     * @param max_buckets Buckets available for the range, the finest level
+     *  fitting into them is chosen, the coarsest one if none fits.
+     * @return Retained buckets of the range, empty for unknown CPUs. The last
+     *  one may still be accumulating. Invalidated by @ref add and
+     *  @ref evict_before.
+     ******************************************************************************/
+    LodView
+    view(CpuId cpu, TimePoint from, TimePoint to, std::size_t max_buckets) const;
+
+    /*******************************************************************************
+     * @brief Width of the buckets of level @p level .
+     ******************************************************************************/
+    TimePoint
+    width(std::size_t level) const {
+        return m_widths.at(level);
+    }
+
+    /*******************************************************************************
+     * @brief Number of levels.
+     ******************************************************************************/
+    std::size_t
+    num_levels() const noexcept {
+        return m_widths.size();
+    }
+
+    /*******************************************************************************
+     * @brief CPUs present in the pyramid, in no particular order.
+     ******************************************************************************/
+    std::vector<CpuId>
+    cpus() const;
+
+private:
+    /*! Thread accumulated in the last bucket of a level. */
+    struct Candidate {
+        ProcId pid = 0;
+        ThreadId tid = 0;
+        TimePoint time = TimePoint::zero();
+    };
+
+    /*! Buckets of a single level of a single CPU. */
+    struct Level {
+        /*! Number of the first retained bucket, counted from time zero. */
+        std::uint64_t first = 0;
+        /*! Retained buckets, only the last one accumulates. */
+        std::vector<LodBucket> buckets;
+        /*! Candidates for the dominant thread of bucket @ref candidates_of . */
+        std::vector<Candidate> candidates;
+        /*! Number of the bucket the candidates accumulate in. */
+        std::uint64_t candidates_of = 0;
+    };
+
+    /*! Pyramid of a single CPU. */
+    struct CpuLevels {
+        /*! Levels from the finest one. */
+        std::vector<Level> levels;
+        /*! The last added sample. */
+        std::optional<CpuSample> last;
+    };
+
+    /*******************************************************************************
+     * @brief Bucket number @p number of @p level , created with the preceding ones.
+     *
+     * @return The bucket, nullptr if already evicted.
+     ******************************************************************************/
+    LodBucket*
+    bucket_at(CpuLevels& cpu, std::size_t level, std::uint64_t number);
+
+    /*******************************************************************************
+     * @brief Account finished base bucket @p number into its occupancy and of the
+     *  buckets above.
+     ******************************************************************************/
+    void
+    finish_base(CpuLevels& cpu, std::uint64_t number);
+
+    /*******************************************************************************
+     * @brief Attribute time range [@p from, @p to) of @p cpu to thread of @p sample .
+     ******************************************************************************/
+    void
+    attribute(CpuLevels& cpu, const CpuSample& sample, TimePoint from, TimePoint to);
+
+    /*! Width of each level. */
+    std::vector<TimePoint> m_widths;
+    /*! Number of base buckets in a bucket of each level. */
+    std::vector<std::uint64_t> m_spans;
+    /*! Pyramid of each CPU. */
+    std::unordered_map<CpuId, CpuLevels> m_cpus;
+};
+
+/*******************************************************************************
+ * @brief Build pyramid of @p result at resolution @p config .
+ ******************************************************************************/
+TimelinePyramid
+gen_timeline_pyramid(const CpuSamplingResult& result, const LodConfig& config = {});
+} // namespace elphi::view
@@ -1,11 +1,18 @@
 #pragma once
 
+#include <optional>
+#include <span>
+
 #include <elphi/cpu_sampler.hpp>
+#include <elphi/segmented_vector.hpp>
 
 namespace elphi::view {
 
 /*******************************************************************************
  * @brief Time slice executing the given thread.
+ *
+ * Plain data, the name is resolved through the @ref StringTable of the
+ * sampling result the slice was generated from.
  ******************************************************************************/
 struct ThreadTimeSlice {
     /*! Starting of execution. */
@@ -13,8 +20,8 @@ struct ThreadTimeSlice {
     /*! End of execution. */
     TimePoint end_time;
 
-    /*! Process name. */
-    std::string name;
+    /*! Process name, interned in the table of the sampling result. */
+    NameId name = c_unknown_name;
 
     /*! Process ID */
     ProcId pid = 0;
@@ -22,6 +29,8 @@ struct ThreadTimeSlice {
     ThreadId tid = 0;
     /*! CPU Index */
     CpuId cpu = 0;
+    /*! Control group of the thread. */
+    GroupId cgroup = 0;
 
     /*******************************************************************************
      * @brief Default member-wise comparison.
@@ -30,21 +39,209 @@ struct ThreadTimeSlice {
     operator<=>(const ThreadTimeSlice&, const ThreadTimeSlice&) = default;
 };
 
+/*******************************************************************************
+ * @brief Value of @p counter in @p values , e.g. those of a slice.
+ *
+ * @param counters Counters of the values, see @ref CpuSamplingResult::counters.
+ * @return The value, nothing if @p counter was not sampled.
+ ******************************************************************************/
+std::optional<std::uint64_t>
+counter_value(const CounterValues& values, std::span<const Counter> counters, Counter counter) noexcept;
+
+/*******************************************************************************
+ * @brief Instructions per cycle of @p values , e.g. those of a slice.
+ *
+ * @param counters Counters of the values, see @ref CpuSamplingResult::counters.
+ * @return The IPC, nothing if instructions or cycles were not sampled, or
+ *  there were no cycles.
+ ******************************************************************************/
+std::optional<double>
+slice_ipc(const CounterValues& values, std::span<const Counter> counters) noexcept;
+
+/*******************************************************************************
+ * @brief Whether @p sample prolongs the slice of the @p last sample of its CPU.
+ *
+ * The rule @ref TimelineBuilder delimits its slices by, views attributing time
+ * between samples follow it to stay consistent with the timeline.
+ ******************************************************************************/
+bool
+prolongs_slice(const CpuSample& last, const CpuSample& sample) noexcept;
+
+/*******************************************************************************
+ * @brief Per-CPU state of the current sample, looked up once per run of samples.
+ *
+ * Samples tend to come in runs of the same CPU, the state of the run's CPU is
+ * reused until the CPU changes.
+ *
+ * @tparam T Type of the state, its address must be stable during the use.
+ ******************************************************************************/
+template <typename T>
+class CpuRunCache {
+public:
+    /*******************************************************************************
+     * @brief State of @p cpu , found by `lookup(cpu)` returning `T&` on a new run.
+     ******************************************************************************/
+    template <typename Lookup>
+    T&
+    at(CpuId cpu, Lookup&& lookup) {
+        if (m_state == nullptr || m_cpu != cpu) {
+            m_state = &lookup(cpu);
+            m_cpu = cpu;
+        }
+        return *m_state;
+    }
+
+private:
+    /*! CPU of the current run. */
+    CpuId m_cpu = 0;
+    /*! State of @ref m_cpu , null before the first run. */
+    T* m_state = nullptr;
+};
+
 /*! Timeline for a single CPU. */
 using CpuTimeline = std::vector<ThreadTimeSlice>;
 /*! Timeline for each CPU. */
 using Timeline = std::unordered_map<CpuId, CpuTimeline>;
 /*! Timeline for each cgroup. */
 using GroupTimeline = std::unordered_map<GroupId, Timeline>;
+/*! Counted events during each slice of a @ref CpuTimeline, in the same order. */
+using CpuCounters = std::vector<CounterValues>;
+/*! Counted events during the slices of each CPU. */
+using CounterTimeline = std::unordered_map<CpuId, CpuCounters>;
+
+/*******************************************************************************
+ * @brief Incrementally builds a Timeline from batches of samples.
+ *
+ * The last slice of each CPU stays open and is prolonged by new samples of
+ * the same thread, thus adding a batch costs O(batch) regardless of the
+ * timeline's size. Old slices can be evicted to keep the memory bounded.
+ *
+ * Slices are stored in blocks of a pool shared by all CPUs, growing never
+ * copies them and evicted blocks are reused by the new slices.
+ *
+ * Context switches delimit the slices exactly, a switch-in always starts a
+ * new slice and a switch-out closes it.
+ ******************************************************************************/
+class TimelineBuilder {
+public:
+    /*******************************************************************************
+     * @brief Create empty timeline.
+     ******************************************************************************/
+    TimelineBuilder() = default;
+
+    /*******************************************************************************
+     * @brief Create empty timeline naming slices by @p process_names .
+     ******************************************************************************/
+    explicit TimelineBuilder(std::unordered_map<ProcId, NameId> process_names);
+
+    /*******************************************************************************
+     * @brief Name the slices of process @p pid created from now on.
+     ******************************************************************************/
+    void
+    set_process_name(ProcId pid, NameId name);
+
+    /*******************************************************************************
+     * @brief Extend the timeline by @p samples .
+     *
+     * @param samples Samples ordered by time for each CPU, not older than the
+     *  samples added before.
+     ******************************************************************************/
+    void
+    add(std::span<const CpuSample> samples);
+
+    /*******************************************************************************
+     * @brief Drop slices which ended before @p cutoff .
+     *
+     * @return Number of dropped slices.
+     ******************************************************************************/
+    std::size_t
+    evict_before(TimePoint cutoff);
+
+    /*******************************************************************************
+     * @brief Retained slices of @p cpu , empty for unknown CPUs.
+     *
+     * Slices keep their addresses until evicted, the last one is prolonged
+     * by @ref add.
+     ******************************************************************************/
+    const SegmentedVector<ThreadTimeSlice>&
+    cpu_timeline(CpuId cpu) const;
+
+    /*******************************************************************************
+     * @brief CPUs present in the timeline, in no particular order.
+     ******************************************************************************/
+    std::vector<CpuId>
+    cpus() const;
+
+    /*******************************************************************************
+     * @brief Copy of the retained timeline.
+     ******************************************************************************/
+    Timeline
+    timeline() const;
+
+    /*******************************************************************************
+     * @brief Move the retained timeline out, leaving the builder empty.
+     ******************************************************************************/
+    Timeline
+    take_timeline();
+
+private:
+    /*! Slices of a single CPU. */
+    struct CpuSlices {
+        /*! Retained slices. */
+        SegmentedVector<ThreadTimeSlice> slices;
+        /*! Whether the last slice can be prolonged, i.e. not switched out. */
+        bool open = false;
+    };
+
+    /*******************************************************************************
+     * @brief Resolve process name or returns @ref c_unknown_name.
+     ******************************************************************************/
+    NameId
+    resolve_name(ProcId pid) const;
+
+    /*! Blocks of the slices. */
+    std::shared_ptr<BlockPool> m_pool = std::make_shared<BlockPool>();
+    /*! Slices of each CPU. */
+    std::unordered_map<CpuId, CpuSlices> m_cpus;
+    /*! Names of the processes. */
+    std::unordered_map<ProcId, NameId> m_names;
+};
 
 /*******************************************************************************
  * @brief Process sampling results into cpu activity Timeline.
  *
- * Timeline shows what process each CPU executed.
+ * Timeline shows what process each CPU executed. Names of the slices refer
+ * to @ref CpuSamplingResult::names of @p result .
  *
  * @param result Result from process sampling.
  * @return Constructed Timeline from sampling @p result.
  ******************************************************************************/
 Timeline
 gen_cpu_timelines(const CpuSamplingResult& result);
+
+/*******************************************************************************
+ * @brief Process sampling results into cpu activity Timeline of each cgroup.
+ *
+ * Slices are the same as in @ref gen_cpu_timelines, only distributed among
+ * the cgroups in a single pass over the samples. Paths of the groups are in
+ * @ref CpuSamplingResult::group_names of @p result .
+ *
+ * @param result Result from process sampling with cgroups.
+ * @return Timeline of each sampled cgroup.
+ ******************************************************************************/
+GroupTimeline
+gen_group_timelines(const CpuSamplingResult& result);
+
+/*******************************************************************************
+ * @brief Sum counted events of @p result over the slices of its timeline.
+ *
+ * Counters are kept apart from the slices, i-th values of a CPU belong to
+ * its i-th slice of @ref gen_cpu_timelines.
+ *
+ * @param result Result from process sampling with counters.
+ * @return Counters of each CPU's slices, empty without
+ *  @ref CpuSamplingResult::counter_values.
+ ******************************************************************************/
+CounterTimeline
+gen_counter_timelines(const CpuSamplingResult& result);
 } // namespace elphi::view
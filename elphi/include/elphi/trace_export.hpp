@@ -0,0 +1,148 @@
+/*******************************************************************************
+ * @file trace_export.hpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license This file is released under ElPhi project's license, see LICENSE.
+ *
+ * Export of timelines for existing trace viewers.
+ *
+ * Each CPU is a track of the trace, its slices are named by the executed
+ * process and annotated with the PID and TID. Two formats are written:
+ *  - Chrome Trace Event JSON, complete ("X") events and thread metadata,
+ *    opened by chrome://tracing and Perfetto UI.
+ *  - Perfetto protobuf trace, a track descriptor per CPU and begin/end track
+ *    events with interned names.
+ ******************************************************************************/
+#pragma once
+
+#include <span>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <elphi/file_descriptor.hpp>
+#include <elphi/string_table.hpp>
+#include <elphi/timeline_view.hpp>
+#include <elphi/utils.hpp>
+
+namespace elphi::view {
+
+/*! Format of an exported trace. */
+enum class TraceFormat {
+    /*! Chrome Trace Event JSON. */
+    chrome_json,
+    /*! Perfetto protobuf trace. */
+    perfetto,
+};
+
+/*******************************************************************************
+ * @brief Streaming writer of trace files.
+ *
+ * Events are formatted into a single reused buffer which is written out once
+ * it holds @ref c_flush_size bytes, thus the memory stays bounded regardless
+ * of the number of slices and the file is written in large chunks.
+ ******************************************************************************/
+class TraceWriter {
+public:
+    /*! Buffered bytes which trigger a write to the file. */
+    static constexpr std::size_t c_flush_size = std::size_t{1} << 20U;
+
+    /*******************************************************************************
+     * @brief Create or truncate trace file at @p path of @p format .
+     *
+     * @throw ElphiException if the file cannot be opened.
+     ******************************************************************************/
+    TraceWriter(const std::string& path, TraceFormat format);
+
+    /*******************************************************************************
+     * @brief Move-only.
+     ******************************************************************************/
+    TraceWriter(const TraceWriter&) = delete;
+
+    /*******************************************************************************
+     * @brief Reclaim @p other writer, left in undetermined state.
+     ******************************************************************************/
+    TraceWriter(TraceWriter&& other) noexcept = default;
+
+    /*******************************************************************************
+     * @brief Move-only.
+     ******************************************************************************/
+    TraceWriter&
+    operator=(const TraceWriter&) = delete;
+
+    /*******************************************************************************
+     * @brief Reclaim @p other writer, left in undetermined state.
+     ******************************************************************************/
+    TraceWriter&
+    operator=(TraceWriter&& other) noexcept = default;
+
+    /*******************************************************************************
+     * @brief Close the file, errors are ignored.
+     ******************************************************************************/
+    ~TraceWriter();
+
+    /*******************************************************************************
+     * @brief Append @p slices to the trace.
+     *
+     * Slices can come in any order, e.g. as evicted from a @ref TimelineBuilder.
+     *
+     * @param names Table the slices are named by, the same for all calls.
+     * @throw ElphiException on write errors.
+     ******************************************************************************/
+    void
+    write(std::span<const ThreadTimeSlice> slices, const StringTable& names);
+
+    /*******************************************************************************
+     * @brief Finish the trace, flush buffered events and close the file.
+     *
+     * No-op for closed writer.
+     *
+     * @throw ElphiException on write errors.
+     ******************************************************************************/
+    void
+    close();
+
+private:
+    /*******************************************************************************
+     * @brief Describe the track of @p cpu unless already described.
+     ******************************************************************************/
+    void
+    put_track(CpuId cpu);
+
+    /*******************************************************************************
+     * @brief Append @p slice as a complete JSON event.
+     ******************************************************************************/
+    void
+    put_json_slice(const ThreadTimeSlice& slice, const StringTable& names);
+
+    /*******************************************************************************
+     * @brief Append @p slice as begin and end packets.
+     ******************************************************************************/
+    void
+    put_perfetto_slice(const ThreadTimeSlice& slice, const StringTable& names);
+
+    /*******************************************************************************
+     * @brief Write buffered bytes to the file.
+     ******************************************************************************/
+    void
+    flush();
+
+    /*! Output file. */
+    FileDescriptor m_fd;
+    /*! Format of the file. */
+    TraceFormat m_format;
+    /*! Bytes not written yet, reused for formatting. */
+    Buffer m_buffer;
+    /*! CPUs with a described track. */
+    std::unordered_set<CpuId> m_tracks;
+    /*! Whether each name was interned in the Perfetto trace. */
+    std::vector<bool> m_interned;
+};
+
+/*******************************************************************************
+ * @brief Write @p timeline named by @p names as a trace file at @p path .
+ *
+ * @throw ElphiException if the file cannot be written.
+ ******************************************************************************/
+void
+export_trace(const Timeline& timeline, const StringTable& names, const std::string& path, TraceFormat format);
+} // namespace elphi::view
@@ -0,0 +1,209 @@
+/*******************************************************************************
+ * @file usage.hpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license This file is released under ElPhi project's license, see LICENSE.
+ *
+ * CPU time of threads, processes and cgroups over a sliding window.
+ ******************************************************************************/
+#pragma once
+
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <elphi/cpu_sampler.hpp>
+
+namespace elphi::view {
+
+/*******************************************************************************
+ * @brief Sliding window of a @ref UsageAggregator.
+ ******************************************************************************/
+struct UsageConfig {
+    /*! Width of a single bucket of the window. */
+    TimePoint bucket_width = std::chrono::seconds{1};
+    /*! Number of buckets of the window, including the accumulating one. */
+    std::size_t num_buckets = 10;
+    /*! Number of threads held without growing. */
+    std::size_t capacity = 1024;
+};
+
+/*******************************************************************************
+ * @brief CPU time of a single thread.
+ ******************************************************************************/
+struct ThreadUsage {
+    /*! Process ID */
+    ProcId pid = 0;
+    /*! Thread ID */
+    ThreadId tid = 0;
+    /*! Control group of the thread when last sampled. */
+    GroupId cgroup = 0;
+    /*! CPU time in the window. */
+    TimePoint time = TimePoint::zero();
+};
+
+/*******************************************************************************
+ * @brief CPU time of all threads of a single process.
+ ******************************************************************************/
+struct ProcessUsage {
+    /*! Process ID */
+    ProcId pid = 0;
+    /*! Number of threads which ran in the window. */
+    std::size_t num_threads = 0;
+    /*! CPU time in the window. */
+    TimePoint time = TimePoint::zero();
+};
+
+/*******************************************************************************
+ * @brief CPU time of all threads of a single cgroup.
+ ******************************************************************************/
+struct GroupUsage {
+    /*! Control group. */
+    GroupId cgroup = 0;
+    /*! CPU time in the window. */
+    TimePoint time = TimePoint::zero();
+};
+
+/*******************************************************************************
+ * @brief Running CPU time of each thread over a sliding window of samples.
+ *
+ * Time between consecutive samples of a CPU is attributed to the thread as
+ * @ref TimelineBuilder prolongs its slices, whole to the bucket of the later
+ * sample. The idle task, process 0, is not accounted.
+ *
+ * Threads live in a flat open-addressing table, each with a ring of the
+ * window's buckets. A sample costs O(1), a bucket leaving the window costs
+ * O(capacity) once per bucket width, and neither allocates unless the table
+ * grows. Threads without any time in the window are dropped then.
+ ******************************************************************************/
+class UsageAggregator {
+public:
+    /*******************************************************************************
+     * @brief Create empty aggregator with the default window.
+     ******************************************************************************/
+    UsageAggregator();
+
+    /*******************************************************************************
+     * @brief Create empty aggregator with window given by @p config .
+     *
+     * @throw ElphiException if @p config has zero bucket width or no buckets.
+     ******************************************************************************/
+    explicit UsageAggregator(const UsageConfig& config);
+
+    /*******************************************************************************
+     * @brief Account @p samples .
+     *
+     * @param samples Samples ordered by time for each CPU, not older than the
+     *  samples added before, with non-negative times. Samples older than the
+     *  window are ignored.
+     ******************************************************************************/
+    void
+    add(std::span<const CpuSample> samples);
+
+    /*******************************************************************************
+     * @brief Up to @p k threads with the most CPU time in the window, most first.
+     ******************************************************************************/
+    std::vector<ThreadUsage>
+    top_threads(std::size_t k) const;
+
+    /*******************************************************************************
+     * @brief Up to @p k processes with the most CPU time in the window, most first.
+     ******************************************************************************/
+    std::vector<ProcessUsage>
+    top_processes(std::size_t k) const;
+
+    /*******************************************************************************
+     * @brief Up to @p k cgroups with the most CPU time in the window, most first.
+     ******************************************************************************/
+    std::vector<GroupUsage>
+    top_groups(std::size_t k) const;
+
+    /*******************************************************************************
+     * @brief CPU time of thread @p tid of process @p pid in the window.
+     ******************************************************************************/
+    TimePoint
+    thread_time(ProcId pid, ThreadId tid) const noexcept;
+
+    /*******************************************************************************
+     * @brief Start of the window, zero before any sample.
+     ******************************************************************************/
+    TimePoint
+    window_begin() const noexcept;
+
+    /*******************************************************************************
+     * @brief End of the window, i.e. of its accumulating bucket.
+     ******************************************************************************/
+    TimePoint
+    window_end() const noexcept;
+
+    /*******************************************************************************
+     * @brief Number of threads in the window.
+     ******************************************************************************/
+    std::size_t
+    num_threads() const noexcept {
+        return m_size;
+    }
+
+    /*******************************************************************************
+     * @brief Number of threads the table holds without growing.
+     ******************************************************************************/
+    std::size_t
+    capacity() const noexcept {
+        return m_slots.size() / 2;
+    }
+
+private:
+    /*! Slot of the table, empty if the process is zero. */
+    struct Slot {
+        ProcId pid = 0;
+        ThreadId tid = 0;
+        GroupId cgroup = 0;
+        /*! Sum of the buckets of the slot. */
+        TimePoint total = TimePoint::zero();
+    };
+
+    /*******************************************************************************
+     * @brief Index of the slot of the thread, inserted if new.
+     ******************************************************************************/
+    std::size_t
+    slot_of(ProcId pid, ThreadId tid);
+
+    /*******************************************************************************
+     * @brief Index of the slot of the thread or of the empty slot ending its probe.
+     ******************************************************************************/
+    std::size_t
+    probe(std::span<const Slot> slots, ProcId pid, ThreadId tid) const noexcept;
+
+    /*******************************************************************************
+     * @brief Move bucket number @p number into the window, clearing the leaving ones.
+     ******************************************************************************/
+    void
+    advance_to(std::uint64_t number);
+
+    /*******************************************************************************
+     * @brief Move threads with time into tables of @p num_slots , dropping others.
+     ******************************************************************************/
+    void
+    rehash(std::size_t num_slots);
+
+    /*! Width of a bucket. */
+    TimePoint m_width;
+    /*! Number of buckets of the window. */
+    std::size_t m_num_buckets;
+    /*! Number of the newest bucket, counted from time zero. */
+    std::optional<std::uint64_t> m_head;
+
+    /*! Hash table of the threads, size is a power of two kept at most half full. */
+    std::vector<Slot> m_slots;
+    /*! Ring of buckets of each slot, `m_num_buckets` per slot. */
+    std::vector<TimePoint> m_buckets;
+    /*! Preallocated target of @ref rehash of the same size. */
+    std::vector<Slot> m_spare_slots;
+    /*! Preallocated target of @ref rehash of the same size. */
+    std::vector<TimePoint> m_spare_buckets;
+    /*! Number of occupied slots. */
+    std::size_t m_size = 0;
+
+    /*! The last sample of each CPU, indexed by the CPU. */
+    std::vector<std::optional<CpuSample>> m_last;
+};
+} // namespace elphi::view
@@ -5,9 +5,13 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <concepts>
 #include <cstring>
+#include <optional>
 #include <ranges>
 #include <span>
+#include <type_traits>
 #include <vector>
 
 #include <unistd.h>
@@ -18,11 +22,25 @@ namespace elphi {
 using Buffer = std::vector<unsigned char>;
 
 /*******************************************************************************
- * @brief Compiler memory barrier.
+ * @brief Load @p value shared with another thread or the kernel, acquire semantics.
+ *
+ * Reads following the load observe all writes preceding the matching release.
  ******************************************************************************/
-inline void
-read_memory_barrier() {
-    asm volatile("" ::: "memory");
+template <std::integral T>
+T
+load_acquire(T& value) noexcept {
+    return std::atomic_ref<T>{value}.load(std::memory_order_acquire);
+}
+
+/*******************************************************************************
+ * @brief Store @p new_value to @p value shared with another thread or the kernel, release semantics.
+ *
+ * Accesses preceding the store are finished before it becomes visible.
+ ******************************************************************************/
+template <std::integral T>
+void
+store_release(T& value, std::type_identity_t<T> new_value) noexcept {
+    std::atomic_ref<T>{value}.store(new_value, std::memory_order_release);
 }
 
 /*******************************************************************************
@@ -84,4 +102,21 @@ inline const std::size_t c_page_size = getpagesize();
  ******************************************************************************/
 std::string
 strerror(int err);
+
+/*******************************************************************************
+ * @brief Find the NUMA node of @p cpu .
+ *
+ * @param cpu Zero-based CPU index.
+ * @return Node index, nothing if the system does not expose it.
+ ******************************************************************************/
+std::optional<std::size_t>
+numa_node_of_cpu(std::size_t cpu);
+
+/*******************************************************************************
+ * @brief Bytes of ring buffers each CPU may lock without CAP_IPC_LOCK.
+ *
+ * @return perf_event_mlock_kb in bytes, nothing if the system does not expose it.
+ ******************************************************************************/
+std::optional<std::size_t>
+perf_event_mlock_limit();
 } // namespace elphi
@@ -0,0 +1,30 @@
+/*******************************************************************************
+ * @file call_tree.cpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license	This file is released under ElPhi project's license, see LICENSE.
+ ******************************************************************************/
+#include <ranges>
+
+#include <elphi/call_tree.hpp>
+
+namespace elphi {
+
+CallTree::CallTree() : m_nodes(1) {}
+
+StackId
+CallTree::child(StackId parent, std::uint64_t ip) {
+    auto [it, inserted] = m_index.try_emplace(Key{.parent = parent, .ip = ip}, static_cast<StackId>(m_nodes.size()));
+    if (inserted)
+        m_nodes.push_back(Node{.ip = ip, .parent = parent, .depth = m_nodes[parent].depth + 1});
+    return it->second;
+}
+
+StackId
+CallTree::intern(std::span<const std::uint64_t> ips) {
+    StackId id = c_root_stack;
+    // Callchains start with the innermost frame.
+    for (auto ip : std::views::reverse(ips))
+        id = child(id, ip);
+    return id;
+}
+} // namespace elphi
@@ -0,0 +1,643 @@
+/*******************************************************************************
+ * @file capture.cpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license	This file is released under ElPhi project's license, see LICENSE.
+ ******************************************************************************/
+#include <array>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#include <fcntl.h>
+#include <fmt/format.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <elphi/capture.hpp>
+#include <elphi/exception.hpp>
+
+namespace elphi {
+
+namespace {
+
+static_assert(std::endian::native == std::endian::little, "Capture files are stored in little endian.");
+
+/*! Identifies capture files. */
+constexpr std::array<char, 8> c_magic{'E', 'L', 'P', 'H', 'I', 'C', 'A', 'P'};
+/*! Current version of the format. */
+constexpr std::uint32_t c_version = 4;
+/*! Oldest readable version, without cgroups. */
+constexpr std::uint32_t c_min_version = 1;
+
+/*******************************************************************************
+ * @brief Header at the beginning of the file.
+ ******************************************************************************/
+struct FileHeader {
+    std::array<char, 8> m_magic;
+    std::uint32_t m_version;
+    std::uint32_t m_reserved;
+};
+static_assert(sizeof(FileHeader) == 16);
+
+/*! Type of a block. */
+enum class BlockKind : std::uint32_t { samples = 1, names = 2, groups = 3, stacks = 4, counters = 5 };
+
+/*******************************************************************************
+ * @brief Header of each block, followed by `m_payload_size` bytes.
+ ******************************************************************************/
+struct BlockHeader {
+    BlockKind m_kind;
+    /*! Number of samples, names, stacks or counters. */
+    std::uint32_t m_num_entries;
+    /*! CPU of the samples. */
+    std::uint64_t m_cpu;
+    /*! Time of the first sample, others are deltas. */
+    std::int64_t m_first_time;
+    std::uint32_t m_payload_size;
+    /*! Bytes of the (pid,tid,cgroup,kind,stack) dictionary column. */
+    std::uint32_t m_dict_size;
+    /*! Bytes of the time column. */
+    std::uint32_t m_times_size;
+    /*! Bytes of the counter values column, zero without values and in older versions. */
+    std::uint32_t m_counters_size;
+};
+static_assert(sizeof(BlockHeader) == 40);
+
+/*******************************************************************************
+ * @brief Append LEB128 encoded @p value to @p dest .
+ ******************************************************************************/
+void
+put_varint(Buffer& dest, std::uint64_t value) {
+    while (value >= 0x80) {
+        dest.push_back(static_cast<unsigned char>(value | 0x80));
+        value >>= 7;
+    }
+    dest.push_back(static_cast<unsigned char>(value));
+}
+
+/*******************************************************************************
+ * @brief Append trivially copyable @p value to @p dest .
+ ******************************************************************************/
+template <typename T>
+void
+put_pod(Buffer& dest, const T& value) {
+    const auto* bytes = reinterpret_cast<const unsigned char*>(&value);
+    dest.insert(dest.end(), bytes, bytes + sizeof(value));
+}
+
+/*******************************************************************************
+ * @brief Append length-prefixed @p str to @p dest .
+ ******************************************************************************/
+void
+put_string(Buffer& dest, std::string_view str) {
+    put_varint(dest, str.size());
+    dest.insert(dest.end(), str.begin(), str.end());
+}
+
+/*******************************************************************************
+ * @brief Append block of @p kind with @p num_entries encoded in @p payload to @p dest .
+ ******************************************************************************/
+void
+put_table_block(Buffer& dest, BlockKind kind, std::size_t num_entries, const Buffer& payload) {
+    const BlockHeader header{
+        .m_kind = kind,
+        .m_num_entries = static_cast<std::uint32_t>(num_entries),
+        .m_cpu = 0,
+        .m_first_time = 0,
+        .m_payload_size = static_cast<std::uint32_t>(payload.size()),
+        .m_dict_size = 0,
+        .m_times_size = 0,
+        .m_counters_size = 0,
+    };
+    put_pod(dest, header);
+    dest.insert(dest.end(), payload.begin(), payload.end());
+}
+
+/*******************************************************************************
+ * @brief Append block of @p kind with (id, name) @p entries to @p dest .
+ ******************************************************************************/
+template <typename Id>
+void
+put_names_block(Buffer& dest, BlockKind kind, const std::vector<std::pair<Id, std::string>>& entries) {
+    Buffer payload;
+    for (const auto& [id, name] : entries) {
+        put_varint(payload, id);
+        put_string(payload, name);
+    }
+    put_table_block(dest, kind, entries.size(), payload);
+}
+
+/*******************************************************************************
+ * @brief Thread, its cgroup, stack and the kind of sample, entry of the dictionary column.
+ ******************************************************************************/
+struct DictEntry {
+    ProcId pid;
+    ThreadId tid;
+    GroupId cgroup;
+    SampleKind kind;
+    StackId stack;
+
+    friend bool
+    operator==(const DictEntry&, const DictEntry&) = default;
+};
+
+/*******************************************************************************
+ * @brief Hash of @ref DictEntry.
+ ******************************************************************************/
+struct DictEntryHash {
+    std::size_t
+    operator()(const DictEntry& entry) const noexcept {
+        const auto thread = (static_cast<std::uint64_t>(entry.pid) << 32U) | entry.tid;
+        const auto context = (std::uint64_t{entry.stack} << 8U) | static_cast<std::uint64_t>(entry.kind);
+        return std::hash<std::uint64_t>{}(thread ^ (entry.cgroup * 0x9E3779B97F4A7C15ULL) ^
+                                          (context * 0xC2B2AE3D27D4EB4FULL));
+    }
+};
+
+/*******************************************************************************
+ * @brief Bounds-checked reading of encoded values.
+ ******************************************************************************/
+class Cursor {
+public:
+    explicit Cursor(std::span<const unsigned char> bytes) : m_bytes(bytes) {}
+
+    std::uint64_t
+    varint() {
+        std::uint64_t value = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            const auto byte = next();
+            value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0)
+                return value;
+        }
+        throw ElphiException("Malformed capture, varint is too long.");
+    }
+
+    template <typename T>
+    T
+    pod() {
+        T value;
+        std::memcpy(&value, take(sizeof(T)).data(), sizeof(T));
+        return value;
+    }
+
+    std::span<const unsigned char>
+    take(std::size_t size) {
+        if (size > m_bytes.size())
+            throw ElphiException("Malformed capture, unexpected end of data.");
+        auto bytes = m_bytes.first(size);
+        m_bytes = m_bytes.subspan(size);
+        return bytes;
+    }
+
+    std::size_t
+    offset_in(std::span<const unsigned char> whole) const {
+        return static_cast<std::size_t>(m_bytes.data() - whole.data());
+    }
+
+    bool
+    empty() const noexcept {
+        return m_bytes.empty();
+    }
+
+private:
+    unsigned char
+    next() {
+        return take(1)[0];
+    }
+
+    std::span<const unsigned char> m_bytes;
+};
+
+/*******************************************************************************
+ * @brief Check that sizes in @p header of a sample block are consistent.
+ *
+ * Each sample takes at least a byte of the time and the thread column, thus
+ * a valid header never claims more samples than the payload can hold.
+ *
+ * @throw ElphiException if they are not.
+ ******************************************************************************/
+void
+check_samples_header(const BlockHeader& header) {
+    if (std::uint64_t{header.m_dict_size} + header.m_times_size + header.m_counters_size > header.m_payload_size)
+        throw ElphiException("Malformed capture, inconsistent block sizes.");
+    const auto threads_size = header.m_payload_size - header.m_dict_size - header.m_times_size - header.m_counters_size;
+    if (header.m_num_entries > header.m_times_size || header.m_num_entries > threads_size)
+        throw ElphiException(fmt::format("Malformed capture, {} samples do not fit a block of {} bytes.",
+                                         header.m_num_entries, header.m_payload_size));
+}
+} // namespace
+
+CaptureWriter::CaptureWriter(const std::string& path) :
+    m_fd(::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) {
+    if (!m_fd.is_opened() || m_fd.raw() == -1)
+        throw ElphiException(fmt::format("Cannot open capture '{}', reason: {}", path, strerror(errno)));
+
+    m_block.reserve(c_block_samples * 8);
+    const FileHeader header{.m_magic = c_magic, .m_version = c_version, .m_reserved = 0};
+    write_bytes({reinterpret_cast<const unsigned char*>(&header), sizeof(header)});
+}
+
+CaptureWriter::~CaptureWriter() {
+    try {
+        close();
+    } catch (...) { // NOLINT - nothing to do about the error now.
+    }
+}
+
+void
+CaptureWriter::write(std::span<const CpuSample> samples, std::span<const CounterValues> values) {
+    if (!values.empty() && values.size() != samples.size())
+        throw ElphiException(
+            fmt::format("Cannot capture values of {} samples with {} samples.", values.size(), samples.size()));
+
+    m_written = m_written || !samples.empty();
+    for (std::size_t i = 0; i < samples.size(); ++i) {
+        const auto& sample = samples[i];
+        auto& pending = m_pending[sample.cpu];
+        auto& pending_values = m_pending_values[sample.cpu];
+        if (pending.capacity() == 0)
+            pending.reserve(c_block_samples);
+        pending.push_back(sample);
+        if (!m_counters.empty()) {
+            if (pending_values.capacity() == 0)
+                pending_values.reserve(c_block_samples);
+            pending_values.push_back(values.empty() ? CounterValues{} : values[i]);
+        }
+        if (pending.size() == c_block_samples)
+            flush_samples(sample.cpu, pending, pending_values);
+    }
+}
+
+void
+CaptureWriter::write_counters(std::span<const Counter> counters) {
+    if (m_written)
+        throw ElphiException("Counters must be captured before the samples.");
+    if (counters.size() > c_max_counters)
+        throw ElphiException(fmt::format("Cannot capture {} counters, at most {}.", counters.size(), c_max_counters));
+    m_counters.assign(counters.begin(), counters.end());
+}
+
+void
+CaptureWriter::write_name(ProcId pid, std::string_view name) {
+    m_names.emplace_back(pid, name);
+}
+
+void
+CaptureWriter::write_group_name(GroupId id, std::string_view path) {
+    m_group_names.emplace_back(id, path);
+}
+
+void
+CaptureWriter::write_stack(StackId id, StackId parent, std::uint64_t ip, std::string_view symbol) {
+    if (id != c_root_stack)
+        m_stacks.push_back(StackEntry{.id = id, .parent = parent, .ip = ip, .symbol = std::string{symbol}});
+}
+
+void
+CaptureWriter::close() {
+    if (!m_fd.is_opened())
+        return;
+
+    for (auto& [cpu, pending] : m_pending)
+        flush_samples(cpu, pending, m_pending_values[cpu]);
+    flush_names();
+    m_fd.close();
+}
+
+void
+CaptureWriter::flush_samples(CpuId cpu, std::vector<CpuSample>& samples, std::vector<CounterValues>& values) {
+    if (samples.empty())
+        return;
+
+    // Threads repeat a lot within a block, store each only once.
+    std::unordered_map<DictEntry, std::uint32_t, DictEntryHash> dict;
+    Buffer dict_column;
+    Buffer time_column;
+    Buffer thread_column;
+    time_column.reserve(samples.size() * 4);
+    thread_column.reserve(samples.size());
+
+    auto prev_time = samples.front().time;
+    for (const auto& sample : samples) {
+        const DictEntry key{
+            .pid = sample.pid, .tid = sample.tid, .cgroup = sample.cgroup, .kind = sample.kind, .stack = sample.stack};
+        auto [it, inserted] = dict.try_emplace(key, static_cast<std::uint32_t>(dict.size()));
+        if (inserted) {
+            put_varint(dict_column, sample.pid);
+            put_varint(dict_column, sample.tid);
+            put_varint(dict_column, sample.cgroup);
+            put_varint(dict_column, static_cast<std::uint64_t>(sample.kind));
+            put_varint(dict_column, sample.stack);
+        }
+        put_varint(thread_column, it->second);
+        // Samples of a CPU are ordered, the deltas are non-negative.
+        put_varint(time_column, static_cast<std::uint64_t>((sample.time - prev_time).count()));
+        prev_time = sample.time;
+    }
+
+    // Values of each sample, prefixed by their number to keep the block self-contained.
+    Buffer values_column;
+    if (!values.empty()) {
+        values_column.reserve(1 + values.size() * m_counters.size());
+        put_varint(values_column, m_counters.size());
+        for (const auto& sample_values : values)
+            for (std::size_t i = 0; i < m_counters.size(); ++i)
+                put_varint(values_column, sample_values[i]);
+    }
+
+    const BlockHeader header{
+        .m_kind = BlockKind::samples,
+        .m_num_entries = static_cast<std::uint32_t>(samples.size()),
+        .m_cpu = cpu,
+        .m_first_time = samples.front().time.count(),
+        .m_payload_size = static_cast<std::uint32_t>(dict_column.size() + time_column.size() + thread_column.size() +
+                                                     values_column.size()),
+        .m_dict_size = static_cast<std::uint32_t>(dict_column.size()),
+        .m_times_size = static_cast<std::uint32_t>(time_column.size()),
+        .m_counters_size = static_cast<std::uint32_t>(values_column.size()),
+    };
+
+    m_block.clear();
+    put_pod(m_block, header);
+    for (const auto* column : {&dict_column, &time_column, &thread_column, &values_column})
+        m_block.insert(m_block.end(), column->begin(), column->end());
+    write_bytes(m_block);
+    samples.clear();
+    values.clear();
+}
+
+void
+CaptureWriter::flush_names() {
+    m_block.clear();
+    if (!m_names.empty())
+        put_names_block(m_block, BlockKind::names, m_names);
+    if (!m_group_names.empty())
+        put_names_block(m_block, BlockKind::groups, m_group_names);
+    if (!m_stacks.empty()) {
+        Buffer payload;
+        for (const auto& [id, parent, ip, symbol] : m_stacks) {
+            put_varint(payload, id);
+            put_varint(payload, parent);
+            put_varint(payload, ip);
+            put_string(payload, symbol);
+        }
+        put_table_block(m_block, BlockKind::stacks, m_stacks.size(), payload);
+    }
+    if (!m_counters.empty()) {
+        Buffer payload;
+        for (auto counter : m_counters)
+            put_varint(payload, static_cast<std::uint64_t>(counter));
+        put_table_block(m_block, BlockKind::counters, m_counters.size(), payload);
+    }
+    write_bytes(m_block);
+    m_names.clear();
+    m_group_names.clear();
+    m_stacks.clear();
+}
+
+void
+CaptureWriter::write_bytes(std::span<const unsigned char> bytes) {
+    while (!bytes.empty()) {
+        auto written = ::write(m_fd.raw(), bytes.data(), bytes.size());
+        if (written == -1 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            throw ElphiException(fmt::format("Cannot write capture, reason: {}", strerror(errno)));
+        bytes = bytes.subspan(static_cast<std::size_t>(written));
+    }
+}
+
+CaptureReader::CaptureReader(const std::string& path) {
+    FileDescriptor fd{::open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+    if (fd.raw() == -1)
+        throw ElphiException(fmt::format("Cannot open capture '{}', reason: {}", path, strerror(errno)));
+
+    struct stat info {};
+    if (fstat(fd.raw(), &info) == -1)
+        throw ElphiException(fmt::format("Cannot stat capture '{}', reason: {}", path, strerror(errno)));
+    const auto size = static_cast<std::size_t>(info.st_size);
+    if (size < sizeof(FileHeader))
+        throw ElphiException(fmt::format("'{}' is not a capture file.", path));
+
+    auto* ptr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd.raw(), 0);
+    if (ptr == MAP_FAILED)
+        throw ElphiException(fmt::format("Cannot map capture '{}', reason: {}", path, strerror(errno)));
+    m_file = {static_cast<const unsigned char*>(ptr), size};
+
+    try {
+        Cursor cursor{m_file};
+        const auto header = cursor.pod<FileHeader>();
+        if (header.m_magic != c_magic || header.m_version < c_min_version || header.m_version > c_version)
+            throw ElphiException(fmt::format("'{}' is not a capture file of version {}.", path, c_version));
+
+        m_version = header.m_version;
+
+        // Index the blocks, only names are decoded right away.
+        while (!cursor.empty()) {
+            const auto offset = cursor.offset_in(m_file);
+            const auto block = cursor.pod<BlockHeader>();
+            Cursor payload{cursor.take(block.m_payload_size)};
+
+            if (block.m_kind == BlockKind::samples) {
+                check_samples_header(block);
+                m_blocks.push_back(offset);
+                m_num_samples += block.m_num_entries;
+            } else if (block.m_kind == BlockKind::names) {
+                for (std::uint32_t i = 0; i < block.m_num_entries; ++i) {
+                    const auto pid = static_cast<ProcId>(payload.varint());
+                    const auto name = payload.take(payload.varint());
+                    m_names.insert_or_assign(pid, std::string{name.begin(), name.end()});
+                }
+            } else if (block.m_kind == BlockKind::groups) {
+                for (std::uint32_t i = 0; i < block.m_num_entries; ++i) {
+                    const auto id = GroupId{payload.varint()};
+                    const auto path = payload.take(payload.varint());
+                    m_group_names.insert_or_assign(id, std::string{path.begin(), path.end()});
+                }
+            } else if (block.m_kind == BlockKind::stacks) {
+                for (std::uint32_t i = 0; i < block.m_num_entries; ++i) {
+                    const auto id = payload.varint();
+                    const auto parent = payload.varint();
+                    const auto ip = payload.varint();
+                    const auto symbol = payload.take(payload.varint());
+                    // Replaying the nodes in order recreates their ids.
+                    if (parent >= m_stacks.size() || m_stacks.child(static_cast<StackId>(parent), ip) != id)
+                        throw ElphiException(fmt::format("Malformed capture, stack {} is out of order.", id));
+                    if (!symbol.empty())
+                        m_stack_symbols.insert_or_assign(static_cast<StackId>(id),
+                                                         std::string{symbol.begin(), symbol.end()});
+                }
+            } else if (block.m_kind == BlockKind::counters) {
+                if (block.m_num_entries > c_max_counters)
+                    throw ElphiException("Malformed capture, too many counters.");
+                m_counters.clear();
+                for (std::uint32_t i = 0; i < block.m_num_entries; ++i) {
+                    const auto counter = payload.varint();
+                    if (counter > static_cast<std::uint64_t>(Counter::branch_misses))
+                        throw ElphiException("Malformed capture, unknown counter.");
+                    m_counters.push_back(static_cast<Counter>(counter));
+                }
+            }
+            // Unknown blocks are skipped for forward compatibility.
+        }
+    } catch (...) {
+        (void)munmap(const_cast<unsigned char*>(m_file.data()), m_file.size());
+        throw;
+    }
+}
+
+CaptureReader::CaptureReader(CaptureReader&& other) noexcept :
+    m_file(std::exchange(other.m_file, {})), m_blocks(std::move(other.m_blocks)), m_num_samples(other.m_num_samples),
+    m_version(other.m_version), m_names(std::move(other.m_names)), m_group_names(std::move(other.m_group_names)),
+    m_counters(std::move(other.m_counters)), m_stacks(std::move(other.m_stacks)),
+    m_stack_symbols(std::move(other.m_stack_symbols)) {}
+
+CaptureReader&
+CaptureReader::operator=(CaptureReader&& other) noexcept {
+    if (this != &other) {
+        if (!m_file.empty())
+            (void)munmap(const_cast<unsigned char*>(m_file.data()), m_file.size());
+        m_file = std::exchange(other.m_file, {});
+        m_blocks = std::move(other.m_blocks);
+        m_num_samples = other.m_num_samples;
+        m_version = other.m_version;
+        m_names = std::move(other.m_names);
+        m_group_names = std::move(other.m_group_names);
+        m_counters = std::move(other.m_counters);
+        m_stacks = std::move(other.m_stacks);
+        m_stack_symbols = std::move(other.m_stack_symbols);
+    }
+    return *this;
+}
+
+CaptureReader::~CaptureReader() {
+    if (!m_file.empty())
+        (void)munmap(const_cast<unsigned char*>(m_file.data()), m_file.size());
+}
+
+std::size_t
+CaptureReader::num_blocks() const noexcept {
+    return m_blocks.size();
+}
+
+std::size_t
+CaptureReader::num_samples() const noexcept {
+    return m_num_samples;
+}
+
+void
+CaptureReader::decode_block(std::size_t block, std::vector<CpuSample>& dest) const {
+    Cursor cursor{m_file.subspan(m_blocks.at(block))};
+    const auto header = cursor.pod<BlockHeader>();
+    // Validated on opening, the sizes bound the allocations below.
+    Cursor dict_column{cursor.take(header.m_dict_size)};
+    Cursor time_column{cursor.take(header.m_times_size)};
+    Cursor thread_column{
+        cursor.take(header.m_payload_size - header.m_dict_size - header.m_times_size - header.m_counters_size)};
+
+    std::vector<DictEntry> dict;
+    while (!dict_column.empty()) {
+        auto& entry = dict.emplace_back();
+        entry.pid = static_cast<ProcId>(dict_column.varint());
+        entry.tid = static_cast<ThreadId>(dict_column.varint());
+        // Version 1 has no cgroups, version 2 no context switches, version 3 no stacks.
+        entry.cgroup = m_version >= 2 ? GroupId{dict_column.varint()} : 0;
+        const auto kind = m_version >= 3 ? dict_column.varint() : 0;
+        if (kind > static_cast<std::uint64_t>(SampleKind::switch_out))
+            throw ElphiException("Malformed capture, unknown kind of sample.");
+        entry.kind = static_cast<SampleKind>(kind);
+        const auto stack = m_version >= 4 ? dict_column.varint() : c_root_stack;
+        if (stack >= m_stacks.size())
+            throw ElphiException("Malformed capture, unknown stack.");
+        entry.stack = static_cast<StackId>(stack);
+    }
+
+    dest.resize(header.m_num_entries);
+    auto time = TimePoint{header.m_first_time};
+    for (auto& sample : dest) {
+        time += TimePoint{time_column.varint()};
+        const auto idx = thread_column.varint();
+        if (idx >= dict.size())
+            throw ElphiException("Malformed capture, unknown thread.");
+        sample = CpuSample{.pid = dict[idx].pid,
+                           .tid = dict[idx].tid,
+                           .cpu = header.m_cpu,
+                           .time = time,
+                           .cgroup = dict[idx].cgroup,
+                           .kind = dict[idx].kind,
+                           .stack = dict[idx].stack};
+    }
+}
+
+void
+CaptureReader::decode_counters(std::size_t block, std::vector<CounterValues>& dest) const {
+    Cursor cursor{m_file.subspan(m_blocks.at(block))};
+    const auto header = cursor.pod<BlockHeader>();
+    // The values are the last column, validated on opening.
+    (void)cursor.take(header.m_payload_size - header.m_counters_size);
+    Cursor values_column{cursor.take(header.m_counters_size)};
+
+    dest.assign(header.m_num_entries, CounterValues{});
+    if (values_column.empty())
+        return;
+    const auto num_counters = values_column.varint();
+    if (num_counters > c_max_counters)
+        throw ElphiException("Malformed capture, too many counters.");
+    for (auto& values : dest)
+        for (std::size_t i = 0; i < num_counters; ++i)
+            values[i] = values_column.varint();
+}
+
+const std::unordered_map<ProcId, std::string>&
+CaptureReader::process_names() const noexcept {
+    return m_names;
+}
+
+const std::unordered_map<GroupId, std::string>&
+CaptureReader::group_names() const noexcept {
+    return m_group_names;
+}
+
+const std::vector<Counter>&
+CaptureReader::counters() const noexcept {
+    return m_counters;
+}
+
+const CallTree&
+CaptureReader::stacks() const noexcept {
+    return m_stacks;
+}
+
+const std::unordered_map<StackId, std::string>&
+CaptureReader::stack_symbols() const noexcept {
+    return m_stack_symbols;
+}
+
+CpuSamplingResult
+CaptureReader::read_all() const {
+    CpuSamplingResult result;
+    result.samples.reserve(m_num_samples);
+    for_each_sample([&result](const CpuSample& sample) { result.samples.push_back(sample); });
+    for (const auto& [pid, name] : m_names)
+        result.set_process_name(pid, name);
+    for (const auto& [id, path] : m_group_names)
+        result.set_group_name(id, path);
+    result.counters = m_counters;
+    if (!m_counters.empty()) {
+        // Blocks are decoded in the order of the samples above.
+        result.counter_values.reserve(m_num_samples);
+        std::vector<CounterValues> values;
+        for (std::size_t i = 0; i < num_blocks(); ++i) {
+            decode_counters(i, values);
+            result.counter_values.insert(result.counter_values.end(), values.begin(), values.end());
+        }
+    }
+    result.stacks = m_stacks;
+    for (const auto& [id, symbol] : m_stack_symbols)
+        result.set_stack_symbol(id, symbol);
+    return result;
+}
+} // namespace elphi
@@ -0,0 +1,123 @@
+/*******************************************************************************
+ * @file cgroup_resolver.cpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license	This file is released under ElPhi project's license, see LICENSE.
+ ******************************************************************************/
+#include <filesystem>
+#include <optional>
+
+#include <sys/stat.h>
+
+#include <elphi/cgroup_resolver.hpp>
+
+namespace elphi {
+
+namespace {
+
+/*******************************************************************************
+ * @brief Id of cgroup at @p path , nothing if it cannot be accessed.
+ ******************************************************************************/
+std::optional<GroupId>
+group_id_of(const std::filesystem::path& path) noexcept {
+    struct stat info {};
+    if (stat(path.c_str(), &info) == -1)
+        return std::nullopt;
+    return static_cast<GroupId>(info.st_ino);
+}
+} // namespace
+
+CgroupResolver::CgroupResolver(std::string root) :
+    m_root(std::move(root)), m_scanner([this](const std::stop_token& token) { run_scanner(token); }) {}
+
+CgroupResolver::~CgroupResolver() {
+    m_scanner.request_stop();
+    m_cv.notify_all();
+}
+
+std::optional<NameId>
+CgroupResolver::lookup(GroupId id) {
+    apply_scanned();
+    if (auto it = m_paths.find(id); it != m_paths.end())
+        return it->second;
+
+    if (m_in_flight.insert(id).second) {
+        std::lock_guard lock{m_mutex};
+        m_requests.push_back(id);
+        m_cv.notify_one();
+    }
+    return std::nullopt;
+}
+
+std::size_t
+CgroupResolver::collect_resolved(const std::function<void(GroupId, NameId)>& clbk) {
+    apply_scanned();
+    const auto num = m_updates.size();
+    for (const auto& [id, name] : m_updates)
+        clbk(id, name);
+    m_updates.clear();
+    return num;
+}
+
+bool
+CgroupResolver::wait_idle(std::chrono::milliseconds timeout) {
+    std::unique_lock lock{m_mutex};
+    return m_cv.wait_for(lock, timeout, [this] { return m_requests.empty() && !m_scanning; });
+}
+
+const StringTable&
+CgroupResolver::names() const noexcept {
+    return m_names;
+}
+
+void
+CgroupResolver::apply_scanned() {
+    if (!m_has_results.load(std::memory_order_acquire))
+        return;
+
+    decltype(m_results) results;
+    {
+        std::lock_guard lock{m_mutex};
+        results.swap(m_results);
+        m_has_results.store(false, std::memory_order_relaxed);
+    }
+
+    for (const auto& [id, path] : results)
+        m_paths.insert_or_assign(id, m_names.intern(path));
+    // Each scan answers all requests made before it, remember missing groups too not to rescan for them.
+    for (auto id : m_in_flight)
+        m_updates.emplace_back(id, m_paths.try_emplace(id, c_unknown_name).first->second);
+    m_in_flight.clear();
+}
+
+void
+CgroupResolver::run_scanner(const std::stop_token& token) {
+    std::unique_lock lock{m_mutex};
+    while (!token.stop_requested()) {
+        if (!m_cv.wait(lock, token, [this] { return !m_requests.empty(); }))
+            break;
+
+        m_requests.clear();
+        m_scanning = true;
+        lock.unlock();
+
+        decltype(m_results) results;
+        const std::filesystem::path root{m_root};
+        if (auto id = group_id_of(root))
+            results.emplace_back(*id, "/");
+        std::error_code ec;
+        for (std::filesystem::recursive_directory_iterator it{root, ec}, end; !ec && it != end; it.increment(ec)) {
+            if (!it->is_directory(ec))
+                continue;
+            if (auto id = group_id_of(it->path()))
+                results.emplace_back(*id, "/" + it->path().lexically_relative(root).string());
+        }
+
+        lock.lock();
+        m_results.insert(m_results.end(), std::make_move_iterator(results.begin()),
+                         std::make_move_iterator(results.end()));
+        m_has_results.store(true, std::memory_order_release);
+        m_scanning = false;
+        m_cv.notify_all();
+    }
+}
+} // namespace elphi
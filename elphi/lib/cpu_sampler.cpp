@@ -5,110 +5,134 @@
  ******************************************************************************/
 #include <algorithm>
 #include <bit>
-#include <cassert>
-
-#include <fmt/format.h>
-#include <sys/poll.h>
+#include <cmath>
+#include <condition_variable>
+#include <map>
+#include <mutex>
 
 #include <elphi/cpu_sampler.hpp>
-#include <elphi/perf_events.hpp>
+#include <elphi/sampling_session.hpp>
+#include <elphi/segmented_vector.hpp>
+#include <elphi/utils.hpp>
 
 namespace elphi {
 
-namespace {
-
-/*******************************************************************************
- * @brief Recorded perf_event sample.
- *
- * Layout matches the expected struct in the ring buffer.
- ******************************************************************************/
-struct RecordSample {
-    std::uint32_t m_pid;
-    std::uint32_t m_tid;
-    std::uint64_t m_time;
-    std::uint64_t m_addr;
-    std::uint32_t m_cpu;
-    std::uint32_t m_cpu_pad;
-};
-static_assert(sizeof(RecordSample) == 32, "The sample must match the record in the ring buffer.");
-
-/*! Use buffer large enough to store ten seconds worth of samples. */
-constexpr const std::size_t c_sample_buff_size_secs = 10;
-/*! Wakeup targets 1s, +500ms for good measure -> no timeout hopefully. */
-constexpr const std::size_t c_poll_timeout_ms = 1500;
-
-[[nodiscard]] perf_event_attr
-creat_attribs(std::size_t frequency) noexcept {
-    perf_event_attr attr = {};
-
-
-    attr.type = PERF_TYPE_SOFTWARE;
-    attr.size = sizeof(attr);
-    attr.config = PERF_COUNT_SW_TASK_CLOCK;
-    attr.sample_freq = frequency;
-    attr.freq = 1;
-
-    attr.sample_type = PERF_SAMPLE_TID | PERF_SAMPLE_TIME | PERF_SAMPLE_ADDR | PERF_SAMPLE_CPU;
-    attr.read_format = 0;
-
-    attr.disabled = 1;
-    attr.sample_id_all = 0;
-    // Target 1sec poll roughly.
-    attr.wakeup_events = frequency;
-    return attr;
+std::vector<std::vector<CpuId>>
+shard_cpus(std::span<const CpuId> cpus, std::size_t num_shards) {
+    num_shards = std::clamp<std::size_t>(num_shards, 1, std::max<std::size_t>(cpus.size(), 1));
+
+    std::vector<std::vector<CpuId>> shards;
+    for (std::size_t i = 0; i < num_shards; ++i) {
+        // Distribute the remainder among the first shards.
+        const auto begin = i * cpus.size() / num_shards;
+        const auto end = (i + 1) * cpus.size() / num_shards;
+        if (begin != end)
+            shards.emplace_back(cpus.begin() + static_cast<std::ptrdiff_t>(begin),
+                                cpus.begin() + static_cast<std::ptrdiff_t>(end));
+    }
+    return shards;
 }
-} // namespace
 
+std::vector<std::vector<CpuId>>
+shard_cpus_by_node(std::span<const CpuId> cpus, const std::function<std::size_t(CpuId)>& node_of) {
+    std::map<std::size_t, std::vector<CpuId>> nodes;
+    for (auto cpu : cpus)
+        nodes[node_of(cpu)].push_back(cpu);
 
-CpuSamplingResult
-sample_cpus_sync(const std::vector<CpuId>& cpus, std::size_t sample_frequency, const std::stop_token& token) {
-    std::uint64_t flags = PERF_FLAG_FD_CLOEXEC;
-
-    const auto exp_size_per_sec = sample_frequency * (sizeof(perf_event_header) + sizeof(RecordSample));
-    //+1 for rounding, ensuring minimal size.
-    // Must be power of two.
-    auto num_pages = std::bit_ceil((exp_size_per_sec * c_sample_buff_size_secs) / c_page_size + 1);
-
-    auto attribs = creat_attribs(sample_frequency);
+    std::vector<std::vector<CpuId>> shards;
+    for (auto& [node, node_cpus] : nodes)
+        shards.push_back(std::move(node_cpus));
+    return shards;
+}
 
+std::unordered_map<CpuId, std::size_t>
+size_rings(std::span<const CpuId> cpus, std::size_t record_rate, std::size_t record_size, const RingPolicy& policy,
+           std::size_t budget) {
+    // Rings must hold the samples until the next drain, slow drains seen before count too.
+    auto latency = policy.drain_latency;
+    std::uint64_t max_records = 0;
+    for (auto cpu : cpus)
+        if (auto it = policy.history.find(cpu); it != policy.history.end()) {
+            latency = std::max(latency, 2 * it->second.max_drain_interval);
+            max_records = std::max(max_records, it->second.num_records);
+        }
+
+    const auto busy_bytes = static_cast<double>(record_rate * record_size) *
+                            std::chrono::duration<double>(latency).count();
+    std::unordered_map<CpuId, std::size_t> pages;
+    for (auto cpu : cpus) {
+        // Without history, assume busy.
+        double weight = 1.0;
+        if (auto it = policy.history.find(cpu); it != policy.history.end() && max_records > 0) {
+            weight = static_cast<double>(it->second.num_records) / static_cast<double>(max_records);
+            if (it->second.num_lost > 0)
+                weight *= 2;
+        }
+        const auto bytes = weight * busy_bytes;
+        const auto num_pages = static_cast<std::size_t>(std::ceil(bytes / static_cast<double>(c_page_size)));
+        pages.insert_or_assign(cpu, std::bit_ceil(std::max<std::size_t>(num_pages, 1)));
+    }
 
-    std::vector<PerfEvents> events;
-    std::vector<pollfd> entries;
-    for (auto cpu_id : cpus) {
-        events.emplace_back(attribs, -1, static_cast<int>(cpu_id), -1, flags, num_pages);
-        entries.push_back({.fd = events.back().fd().raw(), .events = POLLIN, .revents = 0});
+    if (budget == 0)
+        return pages;
+    std::size_t total_pages = 0;
+    for (const auto& [cpu, num_pages] : pages)
+        total_pages += num_pages;
+    // Halve the largest rings until within the budget, the smallest ring is a single page.
+    while (total_pages * c_page_size > budget) {
+        auto largest = std::ranges::max_element(pages, {}, [](const auto& cpu_pages) { return cpu_pages.second; });
+        if (largest == pages.end() || largest->second == 1)
+            break;
+        largest->second /= 2;
+        total_pages -= largest->second;
     }
+    return pages;
+}
 
-    for (auto& event : events)
-        if (!event.perf_start(true))
-            throw ElphiException("Cannot start the sampling events.");
+CpuSamplingResult
+sample_cpus_sync(const SamplingConfig& config, const std::stop_token& token) {
+    // Reallocating a vector of a long capture would stall the sink for the copy, blocks never move.
+    SegmentedVector<CpuSample> samples;
+    SegmentedVector<CounterValues> counter_values;
+    SamplingSession session{config};
 
     CpuSamplingResult result;
-
-    while (token.stop_possible() && !token.stop_requested()) {
-        auto num_active = poll(entries.data(), entries.size(), c_poll_timeout_ms);
-        if (num_active == -1)
-            throw ElphiException(fmt::format("Polling failure: ", strerror(errno)));
-
-        Buffer dest;
-        for (auto& event : events)
-            while (auto maybe_header = event.get_perf_event(&dest, false)) {
-                if (maybe_header->type != PERF_RECORD_SAMPLE)
-                    continue;
-
-                assert(dest.size() == sizeof(RecordSample));
-                const RecordSample* rec_sample = elphi::type_pune<RecordSample>(dest.data());
-                CpuSample sample{.pid = static_cast<ProcId>(rec_sample->m_pid),
-                                 .tid = rec_sample->m_tid,
-                                 .cpu = rec_sample->m_cpu,
-                                 .time = std::chrono::nanoseconds(rec_sample->m_time)};
-                result.samples.push_back(sample);
-            }
-
-        for (auto& entry : entries)
-            entry.revents = 0;
+    result.counters = session.events().counters;
+    session.add_sink([&samples](std::span<const CpuSample> batch) { samples.append(batch); });
+    if (!result.counters.empty())
+        session.add_counter_sink([&counter_values](std::span<const CounterValues> batch) {
+            counter_values.append(batch);
+        });
+    session.add_name_sink([&result](ProcId pid, std::string_view name) { result.set_process_name(pid, name); });
+    if (config.sample_cgroups)
+        session.add_group_sink([&result](GroupId id, std::string_view path) { result.set_group_name(id, path); });
+    if (config.sample_callchains)
+        session.add_stack_sink([&result](StackId, StackId parent, std::uint64_t ip, std::string_view symbol) {
+            const auto id = result.stacks.child(parent, ip);
+            if (!symbol.empty())
+                result.set_stack_symbol(id, symbol);
+        });
+
+    if (config.cpus.empty() || !token.stop_possible() || token.stop_requested())
+        return result;
+
+    session.start();
+    {
+        std::mutex mutex;
+        std::condition_variable_any cv;
+        std::unique_lock lock{mutex};
+        cv.wait(lock, token, [] { return false; });
     }
+    session.stop();
+    result.ring_stats = session.ring_stats();
+    samples.move_to(result.samples);
+    counter_values.move_to(result.counter_values);
 
     return result;
 }
+
+CpuSamplingResult
+sample_cpus_sync(const std::vector<CpuId>& cpus, std::size_t sample_frequency, const std::stop_token& token) {
+    return sample_cpus_sync(SamplingConfig{.cpus = cpus, .frequency = sample_frequency}, token);
+}
 } // namespace elphi
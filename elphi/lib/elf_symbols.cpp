@@ -0,0 +1,288 @@
+/*******************************************************************************
+ * @file elf_symbols.cpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license	This file is released under ElPhi project's license, see LICENSE.
+ ******************************************************************************/
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#include <elf.h>
+#include <fcntl.h>
+#include <fmt/format.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <elphi/elf_symbols.hpp>
+#include <elphi/exception.hpp>
+#include <elphi/file_descriptor.hpp>
+#include <elphi/utils.hpp>
+
+namespace elphi {
+
+namespace {
+
+/*! Byte order of this machine in e_ident. */
+constexpr unsigned char c_native_data = std::endian::native == std::endian::little ? ELFDATA2LSB : ELFDATA2MSB;
+/*! Name of GNU notes, including the terminator. */
+constexpr std::string_view c_gnu_note{"GNU", 4};
+
+/*******************************************************************************
+ * @brief Copy @p T at @p offset of @p image , nothing if out of bounds.
+ ******************************************************************************/
+template <typename T>
+std::optional<T>
+read_at(std::span<const std::byte> image, std::uint64_t offset) noexcept {
+    if (offset > image.size() || image.size() - offset < sizeof(T))
+        return std::nullopt;
+    T value;
+    std::memcpy(&value, image.data() + offset, sizeof(value));
+    return value;
+}
+
+/*******************************************************************************
+ * @brief @p size bytes at @p offset of @p image , nothing if out of bounds.
+ ******************************************************************************/
+std::optional<std::span<const std::byte>>
+slice(std::span<const std::byte> image, std::uint64_t offset, std::uint64_t size) noexcept {
+    if (offset > image.size() || image.size() - offset < size)
+        return std::nullopt;
+    return image.subspan(offset, size);
+}
+
+/*******************************************************************************
+ * @brief ELF header of @p image , nothing if not a 64-bit ELF of this machine.
+ ******************************************************************************/
+std::optional<Elf64_Ehdr>
+elf_header(std::span<const std::byte> image) noexcept {
+    auto header = read_at<Elf64_Ehdr>(image, 0);
+    if (!header || std::memcmp(header->e_ident, ELFMAG, SELFMAG) != 0 || header->e_ident[EI_CLASS] != ELFCLASS64 ||
+        header->e_ident[EI_DATA] != c_native_data)
+        return std::nullopt;
+    return header;
+}
+
+/*******************************************************************************
+ * @brief Program headers of @p image , empty if malformed.
+ ******************************************************************************/
+std::vector<Elf64_Phdr>
+program_headers(std::span<const std::byte> image, const Elf64_Ehdr& header) {
+    std::vector<Elf64_Phdr> headers;
+    if (header.e_phentsize != sizeof(Elf64_Phdr))
+        return headers;
+    for (std::size_t i = 0; i < header.e_phnum; ++i)
+        if (auto phdr = read_at<Elf64_Phdr>(image, header.e_phoff + i * sizeof(Elf64_Phdr)))
+            headers.push_back(*phdr);
+    return headers;
+}
+
+/*******************************************************************************
+ * @brief Section headers of @p image , empty if malformed.
+ ******************************************************************************/
+std::vector<Elf64_Shdr>
+section_headers(std::span<const std::byte> image, const Elf64_Ehdr& header) {
+    std::vector<Elf64_Shdr> headers;
+    if (header.e_shentsize != sizeof(Elf64_Shdr))
+        return headers;
+    for (std::size_t i = 0; i < header.e_shnum; ++i)
+        if (auto shdr = read_at<Elf64_Shdr>(image, header.e_shoff + i * sizeof(Elf64_Shdr)))
+            headers.push_back(*shdr);
+    return headers;
+}
+
+/*******************************************************************************
+ * @brief Find GNU build-id among @p notes aligned to @p align bytes, 4 or 8.
+ ******************************************************************************/
+std::string
+find_build_id(std::span<const std::byte> notes, std::uint64_t align) {
+    const auto padded = [align](std::uint64_t size) { return (size + align - 1) / align * align; };
+    std::uint64_t pos = 0;
+    while (auto note = read_at<Elf64_Nhdr>(notes, pos)) {
+        const auto name_pos = pos + sizeof(Elf64_Nhdr);
+        const auto desc_pos = name_pos + padded(note->n_namesz);
+        const auto name = slice(notes, name_pos, note->n_namesz);
+        const auto desc = slice(notes, desc_pos, note->n_descsz);
+        if (!name || !desc)
+            break;
+        if (note->n_type == NT_GNU_BUILD_ID &&
+            std::string_view{reinterpret_cast<const char*>(name->data()), name->size()} == c_gnu_note) {
+            std::string id;
+            for (auto byte : *desc)
+                id += fmt::format("{:02x}", std::to_integer<unsigned>(byte));
+            return id;
+        }
+        pos = desc_pos + padded(note->n_descsz);
+    }
+    return {};
+}
+} // namespace
+
+MappedFile::MappedFile(const std::string& path) {
+    FileDescriptor fd{::open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+    if (!fd.is_opened())
+        throw ElphiException(fmt::format("Cannot open '{}', reason: {}", path, strerror(errno)));
+
+    struct stat info = {};
+    if (::fstat(fd.raw(), &info) != 0 || !S_ISREG(info.st_mode) || info.st_size <= 0)
+        throw ElphiException(fmt::format("'{}' is not a regular non-empty file.", path));
+
+    const auto size = static_cast<std::size_t>(info.st_size);
+    // The mapping outlives the descriptor.
+    void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd.raw(), 0);
+    if (data == MAP_FAILED)
+        throw ElphiException(fmt::format("Cannot map '{}', reason: {}", path, strerror(errno)));
+    m_data = data;
+    m_size = size;
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept :
+    m_data(std::exchange(other.m_data, nullptr)), m_size(std::exchange(other.m_size, 0)) {}
+
+MappedFile&
+MappedFile::operator=(MappedFile&& other) noexcept {
+    if (&other != this) {
+        if (m_data != nullptr)
+            (void)::munmap(m_data, m_size);
+        m_data = std::exchange(other.m_data, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile() {
+    if (m_data != nullptr)
+        (void)::munmap(m_data, m_size);
+}
+
+std::string
+elf_build_id(std::span<const std::byte> image) {
+    const auto header = elf_header(image);
+    if (!header)
+        return {};
+    // Linked files carry the note in a segment.
+    for (const auto& phdr : program_headers(image, *header))
+        if (phdr.p_type == PT_NOTE)
+            if (auto notes = slice(image, phdr.p_offset, phdr.p_filesz))
+                if (auto id = find_build_id(*notes, phdr.p_align == 8 ? 8 : 4); !id.empty())
+                    return id;
+    return {};
+}
+
+ElfSymbols::ElfSymbols(MappedFile file) : m_file(std::move(file)) {
+    const auto image = m_file.data();
+    const auto header = elf_header(image);
+    if (!header)
+        throw ElphiException("Not a 64-bit ELF file of this machine.");
+    m_build_id = elf_build_id(image);
+
+    for (const auto& phdr : program_headers(image, *header))
+        if (phdr.p_type == PT_LOAD)
+            m_segments.push_back(Segment{.offset = phdr.p_offset, .address = phdr.p_vaddr, .size = phdr.p_filesz});
+
+    // Stripped files still have the dynamic symbols.
+    const auto sections = section_headers(image, *header);
+    const auto table_type =
+        std::ranges::any_of(sections, [](const Elf64_Shdr& shdr) { return shdr.sh_type == SHT_SYMTAB; })
+            ? Elf64_Word{SHT_SYMTAB}
+            : Elf64_Word{SHT_DYNSYM};
+
+    std::vector<std::pair<std::uint64_t, Symbol>> symbols;
+    for (const auto& table : sections) {
+        if (table.sh_type != table_type || table.sh_link >= sections.size())
+            continue;
+        const auto& strtab = sections[table.sh_link];
+        const auto entries = slice(image, table.sh_offset, table.sh_size);
+        const auto strings = slice(image, strtab.sh_offset, strtab.sh_size);
+        if (!entries || !strings)
+            continue;
+        const std::string_view names{reinterpret_cast<const char*>(strings->data()), strings->size()};
+
+        for (std::size_t i = 0; i < entries->size() / sizeof(Elf64_Sym); ++i) {
+            const auto sym = *read_at<Elf64_Sym>(*entries, i * sizeof(Elf64_Sym));
+            const auto type = ELF64_ST_TYPE(sym.st_info);
+            if ((type != STT_FUNC && type != STT_GNU_IFUNC) || sym.st_shndx == SHN_UNDEF || sym.st_value == 0 ||
+                sym.st_name >= names.size())
+                continue;
+            auto name = names.substr(sym.st_name);
+            name = name.substr(0, name.find('\0'));
+            symbols.emplace_back(sym.st_value, Symbol{.end = sym.st_value + sym.st_size, .name = name});
+        }
+    }
+
+    // Aliases share the start, keep the largest one.
+    std::ranges::sort(symbols, [](const auto& lhs, const auto& rhs) {
+        return lhs.first != rhs.first ? lhs.first < rhs.first : lhs.second.end > rhs.second.end;
+    });
+    m_starts.reserve(symbols.size());
+    m_symbols.reserve(symbols.size());
+    for (const auto& [start, symbol] : symbols) {
+        if (!m_starts.empty() && m_starts.back() == start)
+            continue;
+        m_starts.push_back(start);
+        m_symbols.push_back(symbol);
+    }
+    // Functions of unknown size, e.g. from assembly, extend to the next one.
+    for (std::size_t i = 0; i < m_starts.size(); ++i)
+        if (m_symbols[i].end <= m_starts[i])
+            m_symbols[i].end = i + 1 < m_starts.size() ? m_starts[i + 1] : m_starts[i] + 1;
+}
+
+std::optional<std::string_view>
+ElfSymbols::lookup(std::uint64_t offset) const noexcept {
+    // Only a few segments, mostly the first executable one matches.
+    const auto segment = std::ranges::find_if(
+        m_segments, [offset](const Segment& seg) { return offset >= seg.offset && offset - seg.offset < seg.size; });
+    if (segment == m_segments.end())
+        return std::nullopt;
+    const auto address = offset - segment->offset + segment->address;
+
+    if (m_starts.empty() || address < m_starts.front())
+        return std::nullopt;
+    // Branchless search for the last start not above the address, the
+    // comparisons of random addresses are unpredictable.
+    const auto* base = m_starts.data();
+    for (auto len = m_starts.size(); len > 1; len -= len / 2)
+        base = base[len / 2] <= address ? base + len / 2 : base;
+    const auto& symbol = m_symbols[static_cast<std::size_t>(base - m_starts.data())];
+    if (address >= symbol.end)
+        return std::nullopt;
+    return symbol.name;
+}
+
+std::shared_ptr<const ElfSymbols>
+SymbolCache::load(const std::string& path) {
+    try {
+        MappedFile file{path};
+        const auto build_id = elf_build_id(file.data());
+        if (!build_id.empty()) {
+            std::lock_guard lock{m_mutex};
+            if (auto it = m_indexes.find(build_id); it != m_indexes.end())
+                if (auto symbols = it->second.lock())
+                    return symbols;
+        }
+
+        // Index without the lock, other threads may look up other files meanwhile.
+        auto symbols = std::make_shared<const ElfSymbols>(std::move(file));
+        if (build_id.empty())
+            return symbols;
+        std::lock_guard lock{m_mutex};
+        if (auto it = m_indexes.find(build_id); it != m_indexes.end())
+            if (auto indexed = it->second.lock())
+                return indexed;
+        std::erase_if(m_indexes, [](const auto& index) { return index.second.expired(); });
+        m_indexes.insert_or_assign(build_id, symbols);
+        return symbols;
+    } catch (const ElphiException&) {
+        return nullptr;
+    }
+}
+
+std::size_t
+SymbolCache::size() const {
+    std::lock_guard lock{m_mutex};
+    return static_cast<std::size_t>(
+        std::ranges::count_if(m_indexes, [](const auto& index) { return !index.second.expired(); }));
+}
+} // namespace elphi
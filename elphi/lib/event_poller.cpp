@@ -0,0 +1,72 @@
+/*******************************************************************************
+ * @file event_poller.cpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license	This file is released under ElPhi project's license, see LICENSE.
+ ******************************************************************************/
+#include <cerrno>
+#include <cstring>
+#include <limits>
+
+#include <fmt/format.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <elphi/event_poller.hpp>
+#include <elphi/exception.hpp>
+#include <elphi/utils.hpp>
+
+namespace elphi {
+
+namespace {
+/*! Index of the wake-up eventfd, never used for watched descriptors. */
+constexpr std::uint32_t c_wake_index = std::numeric_limits<std::uint32_t>::max();
+} // namespace
+
+EventPoller::EventPoller() :
+    m_epoll(epoll_create1(EPOLL_CLOEXEC)), m_wake(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) {
+    if (m_epoll.raw() == -1 || m_wake.raw() == -1)
+        throw ElphiException(fmt::format("Cannot create epoll, reason: {}", strerror(errno)));
+    add(m_wake.raw(), c_wake_index);
+}
+
+void
+EventPoller::add(int fd, std::uint32_t index) {
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u32 = index;
+    if (epoll_ctl(m_epoll.raw(), EPOLL_CTL_ADD, fd, &event) == -1)
+        throw ElphiException(fmt::format("Cannot watch descriptor {}, reason: {}", fd, strerror(errno)));
+    m_events.resize(m_events.size() + 1);
+    // Waiting must not allocate.
+    m_ready.reserve(m_events.size());
+}
+
+std::span<const std::uint32_t>
+EventPoller::wait(std::chrono::milliseconds timeout) {
+    m_ready.clear();
+    const auto num_ready = epoll_wait(m_epoll.raw(), m_events.data(), static_cast<int>(m_events.size()),
+                                      static_cast<int>(timeout.count()));
+    if (num_ready == -1) {
+        if (errno == EINTR)
+            return m_ready;
+        throw ElphiException(fmt::format("Polling failure: {}", strerror(errno)));
+    }
+
+    for (const auto& event : std::span{m_events}.first(static_cast<std::size_t>(num_ready))) {
+        if (event.data.u32 == c_wake_index) {
+            std::uint64_t count = 0;
+            // Reset the eventfd, fails only if already reset.
+            (void)::read(m_wake.raw(), &count, sizeof(count));
+        } else {
+            m_ready.push_back(event.data.u32);
+        }
+    }
+    return m_ready;
+}
+
+void
+EventPoller::wake() noexcept {
+    const std::uint64_t count = 1;
+    (void)::write(m_wake.raw(), &count, sizeof(count));
+}
+} // namespace elphi
@@ -0,0 +1,138 @@
+/*******************************************************************************
+ * @file flame_graph.cpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license	This file is released under ElPhi project's license, see LICENSE.
+ ******************************************************************************/
+#include <algorithm>
+#include <ranges>
+#include <tuple>
+
+#include <elphi/flame_graph.hpp>
+
+namespace elphi::view {
+
+namespace {
+/*******************************************************************************
+ * @brief Samples of the stacks of a @ref CallTree.
+ ******************************************************************************/
+struct StackWeights {
+    /*! Samples of each stack itself. */
+    std::vector<std::uint64_t> self;
+    /*! Samples of each stack and all its callees. */
+    std::vector<std::uint64_t> total;
+    /*! Callees of each stack with samples, in no particular order. */
+    std::vector<std::vector<StackId>> children;
+};
+
+/*******************************************************************************
+ * @brief Weigh stacks of @p tree by @p samples .
+ ******************************************************************************/
+StackWeights
+weigh(const CallTree& tree, std::span<const CpuSample> samples) {
+    StackWeights weights;
+    weights.self.assign(tree.size(), 0);
+    for (const auto& sample : samples)
+        if (sample.stack < weights.self.size())
+            ++weights.self[sample.stack];
+
+    // Parents precede children, accumulate the totals bottom-up in a single reverse pass.
+    weights.total = weights.self;
+    for (auto id = static_cast<StackId>(tree.size() - 1); id > c_root_stack; --id)
+        weights.total[tree.node(id).parent] += weights.total[id];
+
+    weights.children.resize(tree.size());
+    for (StackId id = c_root_stack + 1; id < tree.size(); ++id)
+        if (weights.total[id] > 0)
+            weights.children[tree.node(id).parent].push_back(id);
+    return weights;
+}
+} // namespace
+
+FlameGraph
+gen_flame_graph(const CallTree& tree, std::span<const CpuSample> samples) {
+    auto [self, total, children] = weigh(tree, samples);
+    for (auto& callees : children)
+        std::ranges::sort(callees, {}, [&tree](StackId id) { return tree.node(id).ip; });
+
+    FlameGraph graph;
+    // Pairs of node and its offset, explicit stack avoids recursion for deep stacks.
+    std::vector<std::pair<StackId, std::uint64_t>> pending{{c_root_stack, 0}};
+    while (!pending.empty()) {
+        const auto [id, offset] = pending.back();
+        pending.pop_back();
+        graph.push_back(FlameFrame{.stack = id,
+                                   .ip = tree.node(id).ip,
+                                   .depth = tree.node(id).depth,
+                                   .offset = offset,
+                                   .total = total[id],
+                                   .self = self[id]});
+
+        // Callees are laid out from the frame's left edge, pushed in reverse to be visited in order.
+        auto callee_offset = offset + total[id] - self[id];
+        for (auto callee : std::views::reverse(children[id])) {
+            callee_offset -= total[callee];
+            pending.emplace_back(callee, callee_offset);
+        }
+    }
+    return graph;
+}
+
+FlameGraph
+gen_flame_graph(const CpuSamplingResult& result) {
+    const auto& tree = result.stacks;
+    const auto [self, total, children] = weigh(tree, result.samples);
+    const auto symbol_of = [&result](StackId id) {
+        auto it = result.stack_symbols.find(id);
+        return it == result.stack_symbols.end() ? c_unknown_name : it->second;
+    };
+    // Siblings of the same function are merged, unresolved ones are told apart by their addresses.
+    const auto key_of = [&](StackId id) {
+        const auto symbol = symbol_of(id);
+        return std::tuple{result.names.resolve(symbol), symbol, symbol == c_unknown_name ? tree.node(id).ip : 0};
+    };
+
+    FlameGraph graph;
+    // Merged sibling stacks and their offset, explicit stack avoids recursion for deep stacks.
+    std::vector<std::pair<std::vector<StackId>, std::uint64_t>> pending;
+    pending.emplace_back(std::vector<StackId>{c_root_stack}, 0);
+    std::vector<StackId> callees;
+    std::vector<std::pair<std::vector<StackId>, std::uint64_t>> merged;
+    while (!pending.empty()) {
+        auto [group, offset] = std::move(pending.back());
+        pending.pop_back();
+
+        // The heaviest of the merged stacks represents the frame.
+        FlameFrame frame{.stack = group.front(), .offset = offset};
+        callees.clear();
+        for (auto id : group) {
+            frame.total += total[id];
+            frame.self += self[id];
+            if (total[id] > total[frame.stack])
+                frame.stack = id;
+            callees.insert(callees.end(), children[id].begin(), children[id].end());
+        }
+        frame.ip = tree.node(frame.stack).ip;
+        frame.depth = tree.node(frame.stack).depth;
+        frame.symbol = symbol_of(frame.stack);
+        graph.push_back(frame);
+
+        // Callees of all the merged stacks ordered by their functions, the same ones merged again.
+        std::ranges::stable_sort(callees, {}, key_of);
+        merged.clear();
+        for (std::size_t i = 0; i < callees.size(); ++i) {
+            if (i == 0 || key_of(callees[i - 1]) != key_of(callees[i]))
+                merged.emplace_back();
+            merged.back().first.push_back(callees[i]);
+            merged.back().second += total[callees[i]];
+        }
+
+        // Callees are laid out from the frame's left edge, pushed in reverse to be visited in order.
+        auto callee_offset = offset + frame.total - frame.self;
+        for (auto& [callee, callee_total] : std::views::reverse(merged)) {
+            callee_offset -= callee_total;
+            pending.emplace_back(std::move(callee), callee_offset);
+        }
+    }
+    return graph;
+}
+} // namespace elphi::view
@@ -0,0 +1,175 @@
+/*******************************************************************************
+ * @file name_resolver.cpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license	This file is released under ElPhi project's license, see LICENSE.
+ ******************************************************************************/
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+
+#include <fmt/format.h>
+
+#include <elphi/name_resolver.hpp>
+
+namespace elphi {
+
+std::optional<std::string>
+read_proc_comm(const std::string& proc_root, ProcId pid) {
+    std::ifstream file{fmt::format("{}/{}/comm", proc_root, pid)};
+    std::string name;
+    if (!file || !std::getline(file, name))
+        return std::nullopt;
+    return name;
+}
+
+NameResolver::NameResolver(std::size_t capacity, std::string proc_root) :
+    m_capacity(std::max<std::size_t>(capacity, 1)), m_proc_root(std::move(proc_root)),
+    m_scanner([this](const std::stop_token& token) { run_scanner(token); }) {}
+
+NameResolver::~NameResolver() {
+    m_scanner.request_stop();
+    m_cv.notify_all();
+}
+
+void
+NameResolver::on_comm(ProcId pid, std::string_view comm) {
+    store(pid, m_names.intern(comm));
+}
+
+void
+NameResolver::on_fork(ProcId parent, ProcId child) {
+    if (auto it = m_index.find(parent); it != m_index.end())
+        store(child, it->second->second);
+}
+
+void
+NameResolver::on_exit(ProcId pid) {
+    if (auto it = m_index.find(pid); it != m_index.end())
+        m_lru.splice(m_lru.end(), m_lru, it->second);
+}
+
+std::optional<NameId>
+NameResolver::lookup(ProcId pid) {
+    apply_scanned();
+    if (auto it = m_index.find(pid); it != m_index.end()) {
+        m_lru.splice(m_lru.begin(), m_lru, it->second);
+        return it->second->second;
+    }
+
+    if (m_in_flight.insert(pid).second) {
+        std::lock_guard lock{m_mutex};
+        m_requests.push_back(pid);
+        m_cv.notify_one();
+    }
+    return std::nullopt;
+}
+
+void
+NameResolver::scan_all() {
+    std::lock_guard lock{m_mutex};
+    m_scan_all = true;
+    m_cv.notify_one();
+}
+
+std::size_t
+NameResolver::collect_resolved(const std::function<void(ProcId, NameId)>& clbk) {
+    apply_scanned();
+    const auto num = m_updates.size();
+    for (const auto& [pid, name] : m_updates)
+        clbk(pid, name);
+    m_updates.clear();
+    return num;
+}
+
+bool
+NameResolver::wait_idle(std::chrono::milliseconds timeout) {
+    std::unique_lock lock{m_mutex};
+    return m_cv.wait_for(lock, timeout, [this] { return m_requests.empty() && !m_scan_all && !m_scanning; });
+}
+
+const StringTable&
+NameResolver::names() const noexcept {
+    return m_names;
+}
+
+std::size_t
+NameResolver::size() const noexcept {
+    return m_lru.size();
+}
+
+void
+NameResolver::store(ProcId pid, NameId name) {
+    m_in_flight.erase(pid);
+    if (auto it = m_index.find(pid); it != m_index.end()) {
+        m_lru.splice(m_lru.begin(), m_lru, it->second);
+        if (it->second->second == name)
+            return;
+        it->second->second = name;
+    } else {
+        m_lru.emplace_front(pid, name);
+        m_index.insert_or_assign(pid, m_lru.begin());
+        if (m_lru.size() > m_capacity) {
+            m_index.erase(m_lru.back().first);
+            m_lru.pop_back();
+        }
+    }
+    m_updates.emplace_back(pid, name);
+}
+
+void
+NameResolver::apply_scanned() {
+    if (!m_has_results.load(std::memory_order_acquire))
+        return;
+
+    decltype(m_results) results;
+    {
+        std::lock_guard lock{m_mutex};
+        results.swap(m_results);
+        m_has_results.store(false, std::memory_order_relaxed);
+    }
+
+    for (auto& [pid, name] : results) {
+        // Names from records are more recent than the scanned ones.
+        if (m_index.contains(pid) && !m_in_flight.contains(pid))
+            continue;
+        store(pid, name ? m_names.intern(*name) : c_unknown_name);
+    }
+}
+
+void
+NameResolver::run_scanner(const std::stop_token& token) {
+    std::unique_lock lock{m_mutex};
+    while (!token.stop_requested()) {
+        if (!m_cv.wait(lock, token, [this] { return !m_requests.empty() || m_scan_all; }))
+            break;
+
+        auto requests = std::exchange(m_requests, {});
+        const bool scan_all = std::exchange(m_scan_all, false);
+        m_scanning = true;
+        lock.unlock();
+
+        if (scan_all) {
+            std::error_code ec;
+            for (std::filesystem::directory_iterator it{m_proc_root, ec}, end; !ec && it != end; it.increment(ec)) {
+                const auto name = it->path().filename().string();
+                ProcId pid = 0;
+                if (auto [ptr, err] = std::from_chars(name.data(), name.data() + name.size(), pid);
+                    err == std::errc{} && ptr == name.data() + name.size())
+                    requests.push_back(pid);
+            }
+        }
+
+        decltype(m_results) results;
+        results.reserve(requests.size());
+        for (auto pid : requests)
+            results.emplace_back(pid, read_proc_comm(m_proc_root, pid));
+
+        lock.lock();
+        m_results.insert(m_results.end(), std::make_move_iterator(results.begin()),
+                         std::make_move_iterator(results.end()));
+        m_has_results.store(!m_results.empty(), std::memory_order_release);
+        m_scanning = false;
+        m_cv.notify_all();
+    }
+}
+} // namespace elphi
@@ -0,0 +1,22 @@
+/*******************************************************************************
+ * @file perf_event_open.cpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license	This file is released under ElPhi project's license, see LICENSE.
+ ******************************************************************************/
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <syscall.h>
+#include <unistd.h>
+
+extern "C" int // NOLINTNEXTLINE - unsigned long on purpose.
+open_perf_event(const perf_event_attr& attr, pid_t pid, int cpu, int group_fd, unsigned long flags) noexcept {
+    // NOLINTNEXTLINE - syscall is vararg.
+    auto res = syscall(SYS_perf_event_open, &attr, pid, cpu, group_fd, flags);
+    return static_cast<int>(res);
+}
+
+extern "C" int // NOLINTNEXTLINE - unsigned long on purpose.
+control_perf_event(int fd, unsigned long request) noexcept {
+    // NOLINTNEXTLINE - ioctl is vararg.
+    return ioctl(fd, request, 0);
+}
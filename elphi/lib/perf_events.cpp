@@ -3,18 +3,18 @@
  * @copyright Copyright 2022 Jan Waltl.
  * @license	This file is released under ElPhi project's license, see LICENSE.
  ******************************************************************************/
+#include <algorithm>
 #include <cassert>
 #include <cerrno>
 #include <cstdint>
 #include <cstdio>
 #include <cstring>
 #include <ctime>
+#include <limits>
 
 #include <fmt/format.h>
 #include <linux/perf_event.h>
-#include <sys/ioctl.h>
 #include <sys/mman.h>
-#include <syscall.h>
 #include <unistd.h>
 
 #include <elphi/perf_events.hpp>
@@ -24,15 +24,22 @@
 
 namespace elphi {
 
-namespace {
+/*******************************************************************************
+ * @brief Wrapper around perf_event_open syscall.
+ *
+ * Defined in a separate translation unit, otherwise the call could not be
+ * redirected by the linker's `--wrap` in tests.
+ ******************************************************************************/
+extern "C" int // NOLINTNEXTLINE - unsigned long on purpose.
+open_perf_event(const perf_event_attr& attr, pid_t pid, int cpu, int group_fd, unsigned long flags) noexcept;
 
+/*******************************************************************************
+ * @brief Wrapper around argument-less perf_event ioctl @p request .
+ *
+ * Defined next to @ref open_perf_event for the same reason.
+ ******************************************************************************/
 extern "C" int // NOLINTNEXTLINE - unsigned long on purpose.
-open_perf_event(const perf_event_attr& attr, pid_t pid, int cpu, int group_fd, unsigned long flags) noexcept {
-    // NOLINTNEXTLINE - syscall is vararg.
-    auto res = syscall(SYS_perf_event_open, &attr, pid, cpu, group_fd, flags);
-    return static_cast<int>(res);
-}
-} // namespace
+control_perf_event(int fd, unsigned long request) noexcept;
 
 PerfEvents::PerfEventBuffer
 PerfEvents::map_perf_event_buffer(std::size_t num_pages) noexcept {
@@ -56,7 +63,7 @@ PerfEvents::unmap_perf_event_buffer() noexcept {
 
 std::optional<perf_event_header>
 PerfEvents::get_perf_event(Buffer* dest, bool peek_only) {
-    if (!m_fd.is_opened() || m_buffer.empty() || (m_buffer.size() % c_page_size) != 0)
+    if (!is_mapped())
         return std::nullopt;
 
     auto* header = type_pune<perf_event_mmap_page>(m_buffer.data());
@@ -64,44 +71,76 @@ PerfEvents::get_perf_event(Buffer* dest, bool peek_only) {
     const auto buffer = m_buffer.subspan(c_page_size);
 
     perf_event_header event_header;
+    // Acquire pairs with the kernel's release, the records up to head are fully written.
+    const std::uint64_t head = load_acquire(header->data_head);
+    // Only we write the tail.
+    const std::uint64_t tail = header->data_tail;
     // Header does not fit -> no unread sample.
     // Both values are non-decreasing.
-    if (header->data_tail + sizeof(event_header) > header->data_head)
+    if (tail + sizeof(event_header) > head)
         return std::nullopt;
-    read_memory_barrier();
 
     std::span header_dest{reinterpret_cast<unsigned char*>(&event_header), sizeof(event_header)};
-    move_wrapped(buffer, header->data_tail % buffer.size(), header_dest);
+    move_wrapped(buffer, tail % buffer.size(), header_dest);
 
     if (dest) {
         // The event is only partially written. Can it even happen?
-        if (header->data_tail + event_header.size > header->data_head)
+        if (tail + event_header.size > head)
             return std::nullopt;
 
         dest->resize(event_header.size - sizeof(perf_event_header));
-        // Some examples and manpages recommend memory barries after reading the values, not sure why.
-        read_memory_barrier();
-
-        move_wrapped(buffer, (header->data_tail + sizeof(event_header)) % buffer.size(), *dest);
+        move_wrapped(buffer, (tail + sizeof(event_header)) % buffer.size(), *dest);
     }
 
     if (!peek_only) {
-        header->data_tail += event_header.size;
-        read_memory_barrier();
+        // All reads must finish before the kernel is allowed to overwrite the record.
+        store_release(header->data_tail, tail + event_header.size);
     }
 
     return event_header;
 }
 
+bool
+PerfEvents::is_mapped() const noexcept {
+    return m_fd.is_opened() && !m_buffer.empty() && (m_buffer.size() % c_page_size) == 0;
+}
+
+PerfRecord
+PerfEvents::view_record(std::span<unsigned char> ring, std::uint64_t offset) {
+    PerfRecord record{};
+
+    const auto begin = offset % ring.size();
+    // Header never wraps in practice because records are 8B aligned, but be safe.
+    if (begin + sizeof(perf_event_header) <= ring.size())
+        std::memcpy(&record.header, ring.data() + begin, sizeof(perf_event_header));
+    else
+        move_wrapped(ring, begin,
+                     std::span{reinterpret_cast<unsigned char*>(&record.header), sizeof(perf_event_header)});
+
+    if (record.header.size < sizeof(perf_event_header) || record.header.size > ring.size())
+        return record;
+
+    const std::size_t payload_size = record.header.size - sizeof(perf_event_header);
+    const auto payload_begin = (begin + sizeof(perf_event_header)) % ring.size();
+    if (payload_begin + payload_size <= ring.size()) {
+        record.payload = ring.subspan(payload_begin, payload_size);
+    } else {
+        m_scratch.resize(payload_size);
+        move_wrapped(ring, payload_begin, m_scratch);
+        record.payload = m_scratch;
+    }
+    return record;
+}
+
 bool
 PerfEvents::perf_start(bool do_reset) noexcept {
-    return (do_reset && ioctl(m_fd.raw(), PERF_EVENT_IOC_RESET, 0) == 0) &&
-           ioctl(m_fd.raw(), PERF_EVENT_IOC_ENABLE, 0) == 0;
+    return (!do_reset || control_perf_event(m_fd.raw(), PERF_EVENT_IOC_RESET) == 0) &&
+           control_perf_event(m_fd.raw(), PERF_EVENT_IOC_ENABLE) == 0;
 }
 
 void
 PerfEvents::perf_stop() noexcept {
-    (void)ioctl(m_fd.raw(), PERF_EVENT_IOC_DISABLE, 0);
+    (void)control_perf_event(m_fd.raw(), PERF_EVENT_IOC_DISABLE);
 }
 
 const FileDescriptor&
@@ -114,12 +153,18 @@ PerfEvents::PerfEvents(const perf_event_attr& attr, pid_t pid, int cpu, int grou
     m_fd = FileDescriptor{open_perf_event(attr, pid, cpu, group_fd, flags)};
     if (m_fd.raw() == -1)
         throw ElphiException(fmt::format("Failed to open the event, reason: {}", strerror(errno)));
+    // Group members write their records into the leader's ring.
+    if (num_pages == 0)
+        return;
 
     m_buffer = map_perf_event_buffer(num_pages);
     if (m_buffer.empty())
         throw ElphiException(fmt::format("Failed to map the buffer, reason: {}", strerror(errno)));
+    // Room for the largest record up front, draining must not allocate.
+    m_scratch.reserve(std::min<std::size_t>(num_pages * c_page_size, std::numeric_limits<std::uint16_t>::max()));
 }
-PerfEvents::PerfEvents(PerfEvents&& other) noexcept : m_fd(std::move(other.m_fd)), m_buffer(other.m_buffer) {
+PerfEvents::PerfEvents(PerfEvents&& other) noexcept :
+    m_fd(std::move(other.m_fd)), m_buffer(other.m_buffer), m_scratch(std::move(other.m_scratch)) {
     other.m_buffer = {};
 }
 
@@ -129,6 +174,7 @@ PerfEvents::operator=(PerfEvents&& other) noexcept {
         this->unmap_perf_event_buffer();
         this->m_fd = std::move(other.m_fd);
         this->m_buffer = other.m_buffer;
+        this->m_scratch = std::move(other.m_scratch);
         other.m_buffer = {};
     }
     return *this;
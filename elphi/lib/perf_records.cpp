@@ -0,0 +1,292 @@
+/*******************************************************************************
+ * @file perf_records.cpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license	This file is released under ElPhi project's license, see LICENSE.
+ ******************************************************************************/
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <limits>
+
+#include <sys/mman.h>
+
+#include <elphi/perf_records.hpp>
+
+namespace elphi {
+
+namespace {
+
+/*! Fixed-size sample fields understood by @ref parse_sample, each takes 8 bytes. */
+constexpr std::uint64_t c_supported_sample_type = c_sample_type | PERF_SAMPLE_CGROUP;
+/*! Fields of sample_id appended to non-sample records, each takes 8 bytes. */
+constexpr std::uint64_t c_sample_id_type = PERF_SAMPLE_TID | PERF_SAMPLE_TIME | PERF_SAMPLE_ID | PERF_SAMPLE_STREAM_ID |
+                                           PERF_SAMPLE_CPU | PERF_SAMPLE_IDENTIFIER;
+
+/*******************************************************************************
+ * @brief PERF_RECORD_LOST.
+ ******************************************************************************/
+struct RecordLost {
+    std::uint64_t m_id;
+    std::uint64_t m_lost;
+};
+
+/*******************************************************************************
+ * @brief PERF_RECORD_COMM without the variable-length name.
+ ******************************************************************************/
+struct RecordComm {
+    std::uint32_t m_pid;
+    std::uint32_t m_tid;
+};
+
+/*******************************************************************************
+ * @brief PERF_RECORD_MMAP2 without the variable-length file name.
+ ******************************************************************************/
+struct RecordMmap2 {
+    std::uint32_t m_pid;
+    std::uint32_t m_tid;
+    std::uint64_t m_addr;
+    std::uint64_t m_len;
+    std::uint64_t m_pgoff;
+    // Device and inode, or build-id with PERF_RECORD_MISC_MMAP_BUILD_ID.
+    std::array<std::uint8_t, 24> m_file_id;
+    std::uint32_t m_prot;
+    std::uint32_t m_flags;
+};
+
+/*******************************************************************************
+ * @brief PERF_RECORD_SWITCH_CPU_WIDE without the sample_id.
+ ******************************************************************************/
+struct RecordSwitch {
+    std::uint32_t m_next_prev_pid;
+    std::uint32_t m_next_prev_tid;
+};
+
+/*******************************************************************************
+ * @brief PERF_RECORD_FORK and PERF_RECORD_EXIT.
+ ******************************************************************************/
+struct RecordTask {
+    std::uint32_t m_pid;
+    std::uint32_t m_ppid;
+    std::uint32_t m_tid;
+    std::uint32_t m_ptid;
+    std::uint64_t m_time;
+};
+
+/*******************************************************************************
+ * @brief Copy the beginning of @p record 's payload into @p T .
+ ******************************************************************************/
+template <typename T>
+std::optional<T>
+read_payload(const PerfRecord& record) noexcept {
+    if (record.payload.size() < sizeof(T))
+        return std::nullopt;
+    T value;
+    std::memcpy(&value, record.payload.data(), sizeof(value));
+    return value;
+}
+} // namespace
+
+std::size_t
+sample_payload_size(std::uint64_t sample_type, std::size_t num_counters) noexcept {
+    auto num_fields = static_cast<std::size_t>(std::popcount(sample_type & c_supported_sample_type));
+    // Number of values, the sampled event and the counters.
+    if ((sample_type & PERF_SAMPLE_READ) != 0)
+        num_fields += 2 + num_counters;
+    // Number of frames, the frames are variable.
+    if ((sample_type & PERF_SAMPLE_CALLCHAIN) != 0)
+        num_fields += 1;
+    return num_fields * sizeof(std::uint64_t);
+}
+
+std::optional<CpuSample>
+parse_sample(const PerfRecord& record, std::uint64_t sample_type, std::vector<std::uint64_t>* callchain,
+             CounterValues* counters) {
+    if (record.header.type != PERF_RECORD_SAMPLE || record.payload.size() < sample_payload_size(sample_type))
+        return std::nullopt;
+
+    // Fields are stored in the order of their bits, with 32-bit ones paired.
+    auto payload = record.payload;
+    const auto next = [&payload]<typename T>(T& value) {
+        std::memcpy(&value, payload.data(), sizeof(value));
+        payload = payload.subspan(sizeof(value));
+    };
+
+    CpuSample sample;
+    std::uint32_t u32_pad = 0;
+    std::uint64_t u64_skip = 0;
+    if ((sample_type & PERF_SAMPLE_TID) != 0) {
+        next(sample.pid);
+        next(sample.tid);
+    }
+    if ((sample_type & PERF_SAMPLE_TIME) != 0) {
+        std::uint64_t time = 0;
+        next(time);
+        sample.time = std::chrono::nanoseconds(time);
+    }
+    if ((sample_type & PERF_SAMPLE_ADDR) != 0)
+        next(u64_skip);
+    if ((sample_type & PERF_SAMPLE_CPU) != 0) {
+        std::uint32_t cpu = 0;
+        next(cpu);
+        next(u32_pad);
+        sample.cpu = cpu;
+    }
+    if ((sample_type & PERF_SAMPLE_READ) != 0) {
+        std::uint64_t num_values = 0;
+        next(num_values);
+        // The group is variable-sized, the fields after it must fit too.
+        const auto tail_size = sample_payload_size(sample_type & (PERF_SAMPLE_CALLCHAIN | PERF_SAMPLE_CGROUP));
+        if (num_values == 0 || num_values > payload.size() / sizeof(std::uint64_t) ||
+            payload.size() - num_values * sizeof(std::uint64_t) < tail_size)
+            return std::nullopt;
+        // The sampled event comes first.
+        next(u64_skip);
+        if (counters != nullptr)
+            counters->fill(0);
+        for (std::size_t i = 1; i < num_values; ++i) {
+            std::uint64_t value = 0;
+            next(value);
+            if (counters != nullptr && i <= c_max_counters)
+                (*counters)[i - 1] = value;
+        }
+    }
+    if ((sample_type & PERF_SAMPLE_CALLCHAIN) != 0) {
+        std::uint64_t num_ips = 0;
+        next(num_ips);
+        const auto tail_size = sample_payload_size(sample_type & PERF_SAMPLE_CGROUP);
+        if (num_ips > payload.size() / sizeof(std::uint64_t) ||
+            payload.size() - num_ips * sizeof(std::uint64_t) < tail_size)
+            return std::nullopt;
+        if (callchain != nullptr)
+            callchain->clear();
+        for (std::size_t i = 0; i < num_ips; ++i) {
+            std::uint64_t ip = 0;
+            next(ip);
+            // Markers of kernel/user parts of the stack are not frames.
+            if (callchain != nullptr && ip < PERF_CONTEXT_MAX && callchain->size() < c_max_callchain_depth)
+                callchain->push_back(ip);
+        }
+    }
+    if ((sample_type & PERF_SAMPLE_CGROUP) != 0)
+        next(sample.cgroup);
+    return sample;
+}
+
+std::optional<CpuSample>
+parse_switch(const PerfRecord& record, std::uint64_t sample_type) noexcept {
+    const auto id_size =
+        static_cast<std::size_t>(std::popcount(sample_type & c_sample_id_type)) * sizeof(std::uint64_t);
+    if (record.header.type != PERF_RECORD_SWITCH_CPU_WIDE || record.payload.size() < sizeof(RecordSwitch) + id_size)
+        return std::nullopt;
+
+    // The sample_id describes the current task, i.e. the switched-out one for switch-outs.
+    auto payload = record.payload.subspan(sizeof(RecordSwitch));
+    const auto next = [&payload]<typename T>(T& value) {
+        std::memcpy(&value, payload.data(), sizeof(value));
+        payload = payload.subspan(sizeof(value));
+    };
+
+    CpuSample sample;
+    sample.kind = (record.header.misc & PERF_RECORD_MISC_SWITCH_OUT) != 0 ? SampleKind::switch_out
+                                                                          : SampleKind::switch_in;
+    std::uint32_t u32_pad = 0;
+    std::uint64_t u64_skip = 0;
+    if ((sample_type & PERF_SAMPLE_TID) != 0) {
+        next(sample.pid);
+        next(sample.tid);
+    }
+    if ((sample_type & PERF_SAMPLE_TIME) != 0) {
+        std::uint64_t time = 0;
+        next(time);
+        sample.time = std::chrono::nanoseconds(time);
+    }
+    if ((sample_type & PERF_SAMPLE_ID) != 0)
+        next(u64_skip);
+    if ((sample_type & PERF_SAMPLE_STREAM_ID) != 0)
+        next(u64_skip);
+    if ((sample_type & PERF_SAMPLE_CPU) != 0) {
+        std::uint32_t cpu = 0;
+        next(cpu);
+        next(u32_pad);
+        sample.cpu = cpu;
+    }
+    if (sample.tid == 0)
+        return std::nullopt;
+    return sample;
+}
+
+std::optional<std::uint64_t>
+parse_lost(const PerfRecord& record) noexcept {
+    if (record.header.type != PERF_RECORD_LOST)
+        return std::nullopt;
+    auto lost = read_payload<RecordLost>(record);
+    if (!lost)
+        return std::nullopt;
+    return lost->m_lost;
+}
+
+std::optional<TaskEvent>
+parse_task_event(const PerfRecord& record) noexcept {
+    switch (record.header.type) {
+    case PERF_RECORD_COMM: {
+        auto comm = read_payload<RecordComm>(record);
+        // Renamed threads do not rename the process.
+        if (!comm || comm->m_pid != comm->m_tid)
+            return std::nullopt;
+
+        TaskEvent event{.kind = TaskEvent::Kind::comm,
+                        .pid = comm->m_pid,
+                        .exec = (record.header.misc & PERF_RECORD_MISC_COMM_EXEC) != 0};
+        // The name is NUL-terminated and padded to 8 bytes.
+        const auto name = record.payload.subspan(sizeof(RecordComm));
+        const auto name_end = std::find(name.begin(), name.end(), '\0');
+        event.comm_size = static_cast<std::uint8_t>(
+            std::min<std::size_t>(static_cast<std::size_t>(name_end - name.begin()), TaskEvent::c_comm_len));
+        std::copy_n(name.begin(), event.comm_size, event.comm.begin());
+        return event;
+    }
+    case PERF_RECORD_FORK: {
+        auto fork = read_payload<RecordTask>(record);
+        // New threads share the process.
+        if (!fork || fork->m_pid == fork->m_ppid || fork->m_pid != fork->m_tid)
+            return std::nullopt;
+        return TaskEvent{.kind = TaskEvent::Kind::fork, .pid = fork->m_pid, .parent = fork->m_ppid};
+    }
+    case PERF_RECORD_EXIT: {
+        auto exit = read_payload<RecordTask>(record);
+        // Only the main thread ends the process.
+        if (!exit || exit->m_pid != exit->m_tid)
+            return std::nullopt;
+        return TaskEvent{.kind = TaskEvent::Kind::exit, .pid = exit->m_pid, .parent = exit->m_ppid};
+    }
+    default:
+        return std::nullopt;
+    }
+}
+
+std::optional<MapEvent>
+parse_map_event(const PerfRecord& record) noexcept {
+    if (record.header.type != PERF_RECORD_MMAP2)
+        return std::nullopt;
+    auto mmap = read_payload<RecordMmap2>(record);
+    // Kernel modules are reported with pid -1.
+    if (!mmap || (mmap->m_prot & PROT_EXEC) == 0 || mmap->m_pid == std::numeric_limits<std::uint32_t>::max())
+        return std::nullopt;
+
+    // The name is NUL-terminated and padded to 8 bytes, files have absolute paths, anonymous ones "//anon".
+    const auto name = record.payload.subspan(sizeof(RecordMmap2));
+    const auto name_end = std::find(name.begin(), name.end(), '\0');
+    if (name.size() < 2 || name[0] != '/' || name[1] == '/')
+        return std::nullopt;
+
+    MapEvent event{.kind = MapEvent::Kind::map,
+                   .pid = mmap->m_pid,
+                   .start = mmap->m_addr,
+                   .size = mmap->m_len,
+                   .offset = mmap->m_pgoff};
+    event.filename_size = static_cast<std::uint16_t>(
+        std::min<std::size_t>(static_cast<std::size_t>(name_end - name.begin()), MapEvent::c_path_len));
+    std::copy_n(name.begin(), event.filename_size, event.filename.begin());
+    return event;
+}
+} // namespace elphi
@@ -0,0 +1,95 @@
+/*******************************************************************************
+ * @file sample_merger.cpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license	This file is released under ElPhi project's license, see LICENSE.
+ ******************************************************************************/
+#include <algorithm>
+#include <cassert>
+
+#include <elphi/sample_merger.hpp>
+
+namespace elphi {
+
+namespace {
+/*******************************************************************************
+ * @brief Heap comparator, the oldest entry is at the top.
+ ******************************************************************************/
+constexpr auto c_newer = [](const auto& lhs, const auto& rhs) { return lhs.time > rhs.time; };
+} // namespace
+
+SampleMerger::SampleMerger(std::size_t num_streams, TimePoint reorder_window) :
+    m_streams(num_streams), m_window(reorder_window) {
+    m_heap.reserve(num_streams);
+}
+
+void
+SampleMerger::push(std::size_t stream, std::span<const CpuSample> samples) {
+    if (samples.empty())
+        return;
+
+    auto& pending = m_streams.at(stream);
+    if (pending.empty()) {
+        m_heap.push_back({.time = samples.front().time, .stream = stream});
+        std::ranges::push_heap(m_heap, c_newer);
+    } else if (pending.first > pending.samples.size() / 2) {
+        // Compact once most of the buffer is emitted, the capacity is kept.
+        pending.samples.erase(pending.samples.begin(),
+                              pending.samples.begin() + static_cast<std::ptrdiff_t>(pending.first));
+        pending.first = 0;
+    }
+    pending.samples.insert(pending.samples.end(), samples.begin(), samples.end());
+
+    m_num_pending += samples.size();
+    m_newest = std::max(m_newest, samples.back().time);
+}
+
+void
+SampleMerger::reserve(std::size_t num) {
+    for (auto& pending : m_streams)
+        pending.samples.reserve(num);
+}
+
+std::size_t
+SampleMerger::num_pending() const noexcept {
+    return m_num_pending;
+}
+
+std::size_t
+SampleMerger::num_late() const noexcept {
+    return m_num_late;
+}
+
+bool
+SampleMerger::can_emit() const noexcept {
+    if (m_heap.empty())
+        return false;
+    // Every stream has a pending sample -> nothing older can arrive.
+    if (m_heap.size() == m_streams.size())
+        return true;
+    return m_heap.front().time <= m_newest - m_window;
+}
+
+CpuSample
+SampleMerger::emit() {
+    assert(!m_heap.empty());
+
+    std::ranges::pop_heap(m_heap, c_newer);
+    auto& pending = m_streams[m_heap.back().stream];
+    const auto sample = pending.samples[pending.first++];
+
+    if (pending.empty()) {
+        m_heap.pop_back();
+        pending.samples.clear();
+        pending.first = 0;
+    } else {
+        m_heap.back().time = pending.samples[pending.first].time;
+        std::ranges::push_heap(m_heap, c_newer);
+    }
+
+    if (sample.time < m_last_emitted)
+        ++m_num_late;
+    m_last_emitted = std::max(m_last_emitted, sample.time);
+    --m_num_pending;
+    return sample;
+}
+} // namespace elphi
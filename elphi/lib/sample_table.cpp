@@ -0,0 +1,330 @@
+/*******************************************************************************
+ * @file sample_table.cpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license	This file is released under ElPhi project's license, see LICENSE.
+ ******************************************************************************/
+#include <algorithm>
+#include <bit>
+#include <limits>
+#include <numeric>
+
+#include <fmt/format.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include <elphi/exception.hpp>
+#include <elphi/sample_table.hpp>
+
+namespace elphi::view {
+
+namespace {
+/*! Filtered columns of a table. */
+struct Columns {
+    const ProcId* pids;
+    const ThreadId* tids;
+    const std::uint16_t* cpus;
+};
+
+/*******************************************************************************
+ * @brief Filter as a row matches if `(column & mask) == value` for each column.
+ *
+ * Unset fields have zero mask and value, thus every row matches them and the
+ * kernels need no branches.
+ ******************************************************************************/
+struct Match {
+    std::uint32_t pid_mask = 0;
+    std::uint32_t pid = 0;
+    std::uint32_t tid_mask = 0;
+    std::uint32_t tid = 0;
+    std::uint16_t cpu_mask = 0;
+    std::uint16_t cpu = 0;
+};
+
+/*******************************************************************************
+ * @brief Reorder rows of @p column from @p first on, row `first + i` takes row `first + order[i]`.
+ ******************************************************************************/
+template <typename T>
+void
+permute(std::vector<T>& column, std::size_t first, std::span<const std::size_t> order) {
+    const std::vector<T> tail(column.begin() + static_cast<std::ptrdiff_t>(first), column.end());
+    for (std::size_t i = 0; i < order.size(); ++i)
+        column[first + i] = tail[order[i]];
+}
+
+/*******************************************************************************
+ * @brief Match of @p filter , nothing if no row can match it.
+ ******************************************************************************/
+std::optional<Match>
+compile(const SampleFilter& filter) noexcept {
+    Match match;
+    if (filter.pid) {
+        match.pid_mask = std::numeric_limits<std::uint32_t>::max();
+        match.pid = *filter.pid;
+    }
+    if (filter.tid) {
+        match.tid_mask = std::numeric_limits<std::uint32_t>::max();
+        match.tid = *filter.tid;
+    }
+    if (filter.cpu) {
+        // The table holds no wider CPUs.
+        if (*filter.cpu > std::numeric_limits<std::uint16_t>::max())
+            return std::nullopt;
+        match.cpu_mask = std::numeric_limits<std::uint16_t>::max();
+        match.cpu = static_cast<std::uint16_t>(*filter.cpu);
+    }
+    return match;
+}
+
+/*******************************************************************************
+ * @brief Count rows in [@p begin, @p end) matching @p match , or write them to @p out .
+ *
+ * @tparam Count Whether to count only, @p out is unused then.
+ * @param out Room for all the rows otherwise.
+ * @return Number of matching rows.
+ ******************************************************************************/
+template <bool Count>
+std::size_t
+scan_scalar(const Columns& cols, const Match& match, std::size_t begin, std::size_t end, std::size_t* out) noexcept {
+    std::size_t num = 0;
+    for (auto row = begin; row < end; ++row) {
+        // Branchless, the rows match unpredictably.
+        const auto hit = static_cast<std::size_t>((cols.pids[row] & match.pid_mask) == match.pid) &
+                         static_cast<std::size_t>((cols.tids[row] & match.tid_mask) == match.tid) &
+                         static_cast<std::size_t>((cols.cpus[row] & match.cpu_mask) == match.cpu);
+        if constexpr (!Count)
+            out[num] = row;
+        num += hit;
+    }
+    return num;
+}
+
+/*******************************************************************************
+ * @brief Account rows @p row + i for each set bit i of @p hits .
+ ******************************************************************************/
+template <bool Count>
+std::size_t
+put_hits(std::uint32_t hits, std::size_t row, std::size_t* out, std::size_t num) noexcept {
+    if constexpr (Count) {
+        return num + static_cast<std::size_t>(std::popcount(hits));
+    } else {
+        for (; hits != 0; hits &= hits - 1)
+            out[num++] = row + static_cast<std::size_t>(std::countr_zero(hits));
+        return num;
+    }
+}
+
+/*******************************************************************************
+ * @brief Scan the rows remaining after a vectorised scan found @p num .
+ ******************************************************************************/
+template <bool Count>
+std::size_t
+scan_tail(const Columns& cols, const Match& match, std::size_t begin, std::size_t end, std::size_t* out,
+          std::size_t num) noexcept {
+    if constexpr (Count)
+        return num + scan_scalar<true>(cols, match, begin, end, nullptr);
+    else
+        return num + scan_scalar<false>(cols, match, begin, end, out + num);
+}
+
+#if defined(__x86_64__)
+/*******************************************************************************
+ * @brief @ref scan_scalar four rows at a time, SSE2 is always present on x86-64.
+ ******************************************************************************/
+template <bool Count>
+std::size_t
+scan_sse2(const Columns& cols, const Match& match, std::size_t begin, std::size_t end, std::size_t* out) noexcept {
+    const auto pid_mask = _mm_set1_epi32(static_cast<int>(match.pid_mask));
+    const auto pid = _mm_set1_epi32(static_cast<int>(match.pid));
+    const auto tid_mask = _mm_set1_epi32(static_cast<int>(match.tid_mask));
+    const auto tid = _mm_set1_epi32(static_cast<int>(match.tid));
+    const auto cpu_mask = _mm_set1_epi16(static_cast<short>(match.cpu_mask));
+    const auto cpu = _mm_set1_epi16(static_cast<short>(match.cpu));
+
+    std::size_t num = 0;
+    auto row = begin;
+    for (; row + 4 <= end; row += 4) {
+        const auto pids = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cols.pids + row));
+        const auto tids = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cols.tids + row));
+        const auto cpus = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(cols.cpus + row));
+        const auto hit_pid = _mm_cmpeq_epi32(_mm_and_si128(pids, pid_mask), pid);
+        const auto hit_tid = _mm_cmpeq_epi32(_mm_and_si128(tids, tid_mask), tid);
+        // Widen the 16-bit lanes to match the others.
+        const auto hit_cpu16 = _mm_cmpeq_epi16(_mm_and_si128(cpus, cpu_mask), cpu);
+        const auto hit_cpu = _mm_unpacklo_epi16(hit_cpu16, hit_cpu16);
+        const auto hits = _mm_and_si128(hit_pid, _mm_and_si128(hit_tid, hit_cpu));
+        num = put_hits<Count>(static_cast<std::uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(hits))), row, out, num);
+    }
+    return scan_tail<Count>(cols, match, row, end, out, num);
+}
+
+/*******************************************************************************
+ * @brief @ref scan_scalar eight rows at a time, the CPU must support AVX2.
+ ******************************************************************************/
+template <bool Count>
+[[gnu::target("avx2,popcnt")]] std::size_t
+scan_avx2(const Columns& cols, const Match& match, std::size_t begin, std::size_t end, std::size_t* out) noexcept {
+    const auto pid_mask = _mm256_set1_epi32(static_cast<int>(match.pid_mask));
+    const auto pid = _mm256_set1_epi32(static_cast<int>(match.pid));
+    const auto tid_mask = _mm256_set1_epi32(static_cast<int>(match.tid_mask));
+    const auto tid = _mm256_set1_epi32(static_cast<int>(match.tid));
+    const auto cpu_mask = _mm_set1_epi16(static_cast<short>(match.cpu_mask));
+    const auto cpu = _mm_set1_epi16(static_cast<short>(match.cpu));
+
+    std::size_t num = 0;
+    auto row = begin;
+    for (; row + 8 <= end; row += 8) {
+        const auto pids = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cols.pids + row));
+        const auto tids = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cols.tids + row));
+        const auto cpus = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cols.cpus + row));
+        const auto hit_pid = _mm256_cmpeq_epi32(_mm256_and_si256(pids, pid_mask), pid);
+        const auto hit_tid = _mm256_cmpeq_epi32(_mm256_and_si256(tids, tid_mask), tid);
+        // Sign extension widens the all-ones lanes.
+        const auto hit_cpu = _mm256_cvtepi16_epi32(_mm_cmpeq_epi16(_mm_and_si128(cpus, cpu_mask), cpu));
+        const auto hits = _mm256_and_si256(hit_pid, _mm256_and_si256(hit_tid, hit_cpu));
+        num = put_hits<Count>(static_cast<std::uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(hits))), row, out,
+                              num);
+    }
+    return scan_tail<Count>(cols, match, row, end, out, num);
+}
+#endif
+
+/*******************************************************************************
+ * @brief Scan rows [@p begin, @p end) with @p kernel , see @ref scan_scalar.
+ ******************************************************************************/
+template <bool Count>
+std::size_t
+scan(ScanKernel kernel, const Columns& cols, const Match& match, std::size_t begin, std::size_t end,
+     std::size_t* out) noexcept {
+    kernel = std::min(kernel, best_scan_kernel());
+#if defined(__x86_64__)
+    if (kernel == ScanKernel::avx2)
+        return scan_avx2<Count>(cols, match, begin, end, out);
+    if (kernel == ScanKernel::sse2)
+        return scan_sse2<Count>(cols, match, begin, end, out);
+#endif
+    return scan_scalar<Count>(cols, match, begin, end, out);
+}
+} // namespace
+
+ScanKernel
+best_scan_kernel() noexcept {
+#if defined(__x86_64__)
+    static const auto best = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt") ? ScanKernel::avx2
+                                                                                                : ScanKernel::sse2;
+    return best;
+#else
+    return ScanKernel::scalar;
+#endif
+}
+
+SampleTable::SampleTable(std::span<const CpuSample> samples) {
+    append(samples);
+}
+
+void
+SampleTable::append(std::span<const CpuSample> samples) {
+    for (const auto& sample : samples)
+        if (sample.cpu > std::numeric_limits<std::uint16_t>::max())
+            throw ElphiException(fmt::format("CPU {} does not fit the sample table.", sample.cpu));
+
+    const auto num_ordered = m_times.size();
+    const auto size = m_times.size() + samples.size();
+    // Grow at most once per batch, yet geometrically for streams of small batches.
+    const auto grow = [size](auto& column) {
+        if (size > column.capacity())
+            column.reserve(std::max(size, 2 * column.capacity()));
+    };
+    grow(m_times);
+    grow(m_pids);
+    grow(m_tids);
+    grow(m_cpus);
+    grow(m_details);
+    for (const auto& sample : samples) {
+        m_times.push_back(sample.time);
+        m_pids.push_back(sample.pid);
+        m_tids.push_back(sample.tid);
+        m_cpus.push_back(static_cast<std::uint16_t>(sample.cpu));
+        m_details.push_back({.cgroup = sample.cgroup, .stack = sample.stack, .kind = sample.kind});
+    }
+    merge_tail(num_ordered);
+}
+
+void
+SampleTable::merge_tail(std::size_t num_ordered) {
+    const auto begin = m_times.begin();
+    const auto tail = begin + static_cast<std::ptrdiff_t>(num_ordered);
+    // Mostly the samples follow the table in order.
+    if (std::is_sorted(num_ordered == 0 ? tail : tail - 1, m_times.end()))
+        return;
+
+    // Late samples move only the rows newer than them.
+    const auto oldest = *std::min_element(tail, m_times.end());
+    const auto first = static_cast<std::size_t>(std::upper_bound(begin, tail, oldest) - begin);
+    std::vector<std::size_t> order(m_times.size() - first);
+    std::iota(order.begin(), order.end(), std::size_t{0});
+    std::ranges::stable_sort(order, {}, [this, first](std::size_t i) { return m_times[first + i]; });
+    permute(m_times, first, order);
+    permute(m_pids, first, order);
+    permute(m_tids, first, order);
+    permute(m_cpus, first, order);
+    permute(m_details, first, order);
+}
+
+CpuSample
+SampleTable::row(std::size_t index) const noexcept {
+    const auto& details = m_details[index];
+    return {.pid = m_pids[index],
+            .tid = m_tids[index],
+            .cpu = m_cpus[index],
+            .time = m_times[index],
+            .cgroup = details.cgroup,
+            .kind = details.kind,
+            .stack = details.stack};
+}
+
+std::size_t
+SampleTable::count(const SampleFilter& filter, ScanKernel kernel) const noexcept {
+    const auto [first, last] = rows_between(filter.from, filter.to);
+    const auto match = compile(filter);
+    if (!match)
+        return 0;
+    // Time range only, no need to look at the rows.
+    if (match->pid_mask == 0 && match->tid_mask == 0 && match->cpu_mask == 0)
+        return last - first;
+    return scan<true>(kernel, {.pids = m_pids.data(), .tids = m_tids.data(), .cpus = m_cpus.data()}, *match, first,
+                      last, nullptr);
+}
+
+std::size_t
+SampleTable::select(const SampleFilter& filter, std::vector<std::size_t>& rows, ScanKernel kernel) const {
+    const auto num = rows.size();
+    const auto [first, last] = rows_between(filter.from, filter.to);
+    select_between(filter, first, last, rows, kernel);
+    return rows.size() - num;
+}
+
+std::pair<std::size_t, std::size_t>
+SampleTable::rows_between(TimePoint from, TimePoint to) const noexcept {
+    if (from > to)
+        return {0, 0};
+    const auto first = std::ranges::lower_bound(m_times, from);
+    const auto last = std::upper_bound(first, m_times.end(), to);
+    return {static_cast<std::size_t>(first - m_times.begin()), static_cast<std::size_t>(last - m_times.begin())};
+}
+
+void
+SampleTable::select_between(const SampleFilter& filter, std::size_t begin, std::size_t end,
+                            std::vector<std::size_t>& rows, ScanKernel kernel) const {
+    const auto match = compile(filter);
+    if (!match || begin >= end)
+        return;
+    // Room for all, the kernels write without checks.
+    const auto num = rows.size();
+    rows.resize(num + end - begin);
+    const auto num_hits = scan<false>(kernel, {.pids = m_pids.data(), .tids = m_tids.data(), .cpus = m_cpus.data()},
+                                      *match, begin, end, rows.data() + num);
+    rows.resize(num + num_hits);
+}
+} // namespace elphi::view
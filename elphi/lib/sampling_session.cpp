@@ -0,0 +1,1064 @@
+/*******************************************************************************
+ * @file sampling_session.cpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license	This file is released under ElPhi project's license, see LICENSE.
+ ******************************************************************************/
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+#include <fmt/format.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include <elphi/cgroup_resolver.hpp>
+#include <elphi/event_poller.hpp>
+#include <elphi/name_resolver.hpp>
+#include <elphi/perf_events.hpp>
+#include <elphi/perf_records.hpp>
+#include <elphi/sample_merger.hpp>
+#include <elphi/sampling_session.hpp>
+#include <elphi/spsc_queue.hpp>
+#include <elphi/symbolizer.hpp>
+
+namespace elphi {
+
+namespace {
+
+/*! Shortest period of collecting rings below their wakeup watermark. */
+constexpr const auto c_min_sweep_period = std::chrono::milliseconds(10);
+/*! Reader queues can hold one second worth of samples. */
+constexpr const std::size_t c_queue_size_secs = 1;
+/*! How often the consumer collects samples from the readers. */
+constexpr const auto c_consume_period = std::chrono::milliseconds(50);
+/*! Maximum number of samples passed to the sinks at once. */
+constexpr const std::size_t c_batch_size = 4096;
+/*! Capacity of reader queues for process lifecycle events. */
+constexpr const std::size_t c_task_queue_size = 4096;
+/*! Capacity of reader queues for address space changes, the events are large but rare. */
+constexpr const std::size_t c_map_queue_size = 1024;
+/*! Maximum number of cached process names. */
+constexpr const std::size_t c_name_cache_size = 8192;
+/*! How long the final stop waits for pending lookups of names and cgroups. */
+constexpr const auto c_name_flush_timeout = std::chrono::milliseconds(1000);
+/*! Expected context switches per second of a busy CPU. */
+constexpr const std::size_t c_switch_rate = 1000;
+/*! Expected number of frames of a sampled call stack. */
+constexpr const std::size_t c_expected_stack_depth = 16;
+
+/*******************************************************************************
+ * @brief Attributes of a disabled event counting @p counter .
+ ******************************************************************************/
+[[nodiscard]] perf_event_attr
+counter_attribs(Counter counter) noexcept {
+    perf_event_attr attr = {};
+    attr.size = sizeof(attr);
+    attr.type = is_hardware(counter) ? PERF_TYPE_HARDWARE : PERF_TYPE_SOFTWARE;
+    switch (counter) {
+    case Counter::task_clock:
+        attr.config = PERF_COUNT_SW_TASK_CLOCK;
+        break;
+    case Counter::cycles:
+        attr.config = PERF_COUNT_HW_CPU_CYCLES;
+        break;
+    case Counter::instructions:
+        attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+        break;
+    case Counter::cache_references:
+        attr.config = PERF_COUNT_HW_CACHE_REFERENCES;
+        break;
+    case Counter::cache_misses:
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        break;
+    case Counter::branch_instructions:
+        attr.config = PERF_COUNT_HW_BRANCH_INSTRUCTIONS;
+        break;
+    case Counter::branch_misses:
+        attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+        break;
+    }
+    attr.disabled = 1;
+    return attr;
+}
+
+[[nodiscard]] perf_event_attr
+creat_attribs(std::size_t frequency, std::uint64_t sample_type, Counter sampled, bool trace_switches,
+              bool trace_maps) noexcept {
+    perf_event_attr attr = counter_attribs(sampled);
+
+    // Without frequency, the event only emits the side-band records.
+    attr.sample_freq = frequency;
+    attr.freq = frequency > 0 ? 1 : 0;
+
+    attr.sample_type = sample_type;
+    // Values of the whole group, the sampled event first.
+    attr.read_format = (sample_type & PERF_SAMPLE_READ) != 0 ? PERF_FORMAT_GROUP : 0;
+
+    // Switch records need the thread, time and CPU of the sample_id.
+    attr.sample_id_all = trace_switches ? 1 : 0;
+    attr.context_switch = trace_switches ? 1 : 0;
+    // Side-band records naming the processes.
+    attr.comm = 1;
+    attr.task = 1;
+    // Side-band records of executable mappings, for symbolization.
+    attr.mmap = trace_maps ? 1 : 0;
+    attr.mmap2 = trace_maps ? 1 : 0;
+    // Wake up at a fill level in bytes, set for each ring.
+    attr.watermark = 1;
+    return attr;
+}
+
+/*******************************************************************************
+ * @brief Expected records per second of a busy CPU with @p attr .
+ ******************************************************************************/
+std::size_t
+record_rate(const perf_event_attr& attr) noexcept {
+    return (attr.freq != 0 ? attr.sample_freq : 0) + (attr.context_switch != 0 ? c_switch_rate : 0);
+}
+
+/*******************************************************************************
+ * @brief Pin the calling thread to @p cpus , errors are ignored.
+ ******************************************************************************/
+void
+pin_current_thread(std::span<const CpuId> cpus) noexcept {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (auto cpu : cpus)
+        if (cpu < CPU_SETSIZE)
+            CPU_SET(cpu, &set);
+    (void)pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+/*******************************************************************************
+ * @brief Reader draining events of a shard of CPUs in its own thread.
+ *
+ * Samples, process lifecycle events and address space changes are handed
+ * over to a single consumer through lock-free queues.
+ ******************************************************************************/
+class CpuReader {
+public:
+    /*******************************************************************************
+     * @brief Open the events for @p cpus , disabled until @ref start.
+     *
+     * @param counters Counters grouped with each sampling event, read with
+     *  PERF_SAMPLE_READ.
+     * @throw ElphiException if the events cannot be opened.
+     ******************************************************************************/
+    CpuReader(std::vector<CpuId> cpus, const perf_event_attr& attribs, std::span<const perf_event_attr> counters,
+              const std::unordered_map<CpuId, std::size_t>& num_pages, const RingPolicy& policy) :
+        m_cpus(std::move(cpus)), m_sample_type(attribs.sample_type),
+        m_sweep_period(std::max(std::chrono::duration_cast<std::chrono::milliseconds>(policy.drain_latency / 2),
+                                c_min_sweep_period)),
+        m_queue(record_rate(attribs) * m_cpus.size() * c_queue_size_secs),
+        m_counters(counters.empty() ? 1 : m_queue.capacity()), m_tasks(c_task_queue_size),
+        m_trace_maps(attribs.mmap2 != 0), m_maps(m_trace_maps ? c_map_queue_size : 1),
+        m_callchains((attribs.sample_type & PERF_SAMPLE_CALLCHAIN) != 0),
+        m_stacks(m_callchains ? std::max(record_rate(attribs) * m_cpus.size() * c_queue_size_secs *
+                                             c_expected_stack_depth,
+                                         2 * (c_max_callchain_depth + 1))
+                              : 1),
+        m_num_records(m_cpus.size()), m_num_lost(m_cpus.size()), m_max_drain_interval(m_cpus.size()),
+        m_last_drain(m_cpus.size()), m_num_counters(counters.size()), m_last_counters(m_cpus.size()) {
+        // Draining and consuming must not allocate, parsed stacks are bounded regardless of the kernel's limit.
+        if (m_callchains) {
+            m_callchain.reserve(c_max_callchain_depth);
+            // A partial stack and the whole queue.
+            m_pending_stacks.reserve(c_max_callchain_depth + 1 + m_stacks.capacity());
+        }
+        if (m_num_counters > 0)
+            m_pending_counters.reserve(m_counters.capacity());
+        const auto fill = std::clamp(policy.wakeup_fill, 0.0, 1.0);
+        for (auto cpu_id : m_cpus) {
+            auto cpu_attribs = attribs;
+            const auto ring_size = num_pages.at(cpu_id) * c_page_size;
+            cpu_attribs.wakeup_watermark =
+                std::max<std::uint32_t>(static_cast<std::uint32_t>(fill * static_cast<double>(ring_size)), 1);
+            m_events.emplace_back(cpu_attribs, -1, static_cast<int>(cpu_id), -1, PERF_FLAG_FD_CLOEXEC,
+                                  num_pages.at(cpu_id));
+            m_poller.add(m_events.back().fd().raw(), static_cast<std::uint32_t>(m_events.size() - 1));
+            // Members follow the leader's enable state and write into its ring.
+            for (const auto& counter : counters)
+                m_members.emplace_back(counter, -1, static_cast<int>(cpu_id), m_events.back().fd().raw(),
+                                       PERF_FLAG_FD_CLOEXEC, 0);
+        }
+    }
+
+    CpuReader(const CpuReader&) = delete;
+    CpuReader(CpuReader&&) = delete;
+    CpuReader&
+    operator=(const CpuReader&) = delete;
+    CpuReader&
+    operator=(CpuReader&&) = delete;
+
+    /*******************************************************************************
+     * @brief Stop the thread, possibly dropping samples if nobody consumes them.
+     ******************************************************************************/
+    ~CpuReader() {
+        abandon();
+        stop();
+    }
+
+    /*******************************************************************************
+     * @brief Nobody will consume the samples anymore, drop them.
+     ******************************************************************************/
+    void
+    abandon() noexcept {
+        m_abandoned.store(true, std::memory_order_relaxed);
+    }
+
+    /*******************************************************************************
+     * @brief Enable the events and run the reader thread until stopped.
+     *
+     * @param pin Whether to pin the thread to the sampled CPUs.
+     * @throw ElphiException if the events cannot be started.
+     ******************************************************************************/
+    void
+    start(bool pin) {
+        for (auto& event : m_events)
+            if (!event.perf_start(true))
+                throw ElphiException("Cannot start the sampling events.");
+        m_thread = std::jthread{[this, pin](const std::stop_token& token) {
+            if (pin)
+                pin_current_thread(m_cpus);
+            try {
+                run(token);
+            } catch (...) {
+                m_error = std::current_exception();
+            }
+            m_done.store(true, std::memory_order_release);
+        }};
+    }
+
+    /*******************************************************************************
+     * @brief Pause the event collection.
+     ******************************************************************************/
+    void
+    pause() noexcept {
+        for (auto& event : m_events)
+            event.perf_stop();
+    }
+
+    /*******************************************************************************
+     * @brief Resume the event collection.
+     *
+     * @throw ElphiException if the events cannot be resumed.
+     ******************************************************************************/
+    void
+    resume() {
+        for (auto& event : m_events)
+            if (!event.perf_start())
+                throw ElphiException("Cannot resume the sampling events.");
+    }
+
+    /*******************************************************************************
+     * @brief Ask the reader thread to flush the events and finish.
+     ******************************************************************************/
+    void
+    request_stop() noexcept {
+        m_thread.request_stop();
+        m_poller.wake();
+    }
+
+    /*******************************************************************************
+     * @brief Stop and join the reader thread.
+     ******************************************************************************/
+    void
+    stop() {
+        request_stop();
+        if (m_thread.joinable())
+            m_thread.join();
+    }
+
+    /*******************************************************************************
+     * @brief Whether the reader thread has finished or has never been started.
+     ******************************************************************************/
+    bool
+    done() const noexcept {
+        return !m_thread.joinable() || m_done.load(std::memory_order_acquire);
+    }
+
+    /*******************************************************************************
+     * @brief Consume samples collected so far, called by the consumer only.
+     *
+     * @throw Any exception that terminated the reader thread.
+     ******************************************************************************/
+    template <typename Clbk>
+    std::size_t
+    consume(Clbk&& clbk) {
+        // Error is published before done.
+        if (m_done.load(std::memory_order_acquire) && m_error)
+            std::rethrow_exception(m_error);
+        return m_queue.consume(clbk);
+    }
+
+    /*******************************************************************************
+     * @brief Consume process lifecycle events collected so far, called by the consumer only.
+     ******************************************************************************/
+    template <typename Clbk>
+    std::size_t
+    consume_tasks(Clbk&& clbk) {
+        return m_tasks.consume(clbk);
+    }
+
+    /*******************************************************************************
+     * @brief Consume address space changes collected so far, called by the consumer only.
+     ******************************************************************************/
+    template <typename Clbk>
+    std::size_t
+    consume_maps(Clbk&& clbk) {
+        return m_maps.consume(clbk);
+    }
+
+    /*******************************************************************************
+     * @brief Call stack of the next consumed tick sample, called by the consumer only.
+     *
+     * Stacks are queued in the order of the samples, each tick sample has
+     * one if callchains are sampled. The stack of an already consumed sample is
+     * always present.
+     *
+     * @return Instruction pointers from the innermost frame, valid until the next call.
+     ******************************************************************************/
+    std::span<const std::uint64_t>
+    next_stack() {
+        const auto available = [this] {
+            return m_stack_pos < m_pending_stacks.size() &&
+                   m_stack_pos + 1 + m_pending_stacks[m_stack_pos] <= m_pending_stacks.size();
+        };
+        if (!available()) {
+            // At most a part of a stack is left, the queue fits after it into the reserved room.
+            m_pending_stacks.erase(m_pending_stacks.begin(),
+                                   m_pending_stacks.begin() + static_cast<std::ptrdiff_t>(m_stack_pos));
+            m_stack_pos = 0;
+            m_stacks.consume([this](std::span<const std::uint64_t> chunk) {
+                m_pending_stacks.insert(m_pending_stacks.end(), chunk.begin(), chunk.end());
+            });
+        }
+        if (!available())
+            return {};
+
+        const auto depth = m_pending_stacks[m_stack_pos];
+        const auto stack = std::span{m_pending_stacks}.subspan(m_stack_pos + 1, depth);
+        m_stack_pos += 1 + depth;
+        return stack;
+    }
+
+    /*******************************************************************************
+     * @brief Counters of the next consumed tick sample, called by the consumer only.
+     *
+     * Counters are queued in the order of the samples, each tick sample has
+     * them if any are read. Those of an already consumed sample are always
+     * present.
+     ******************************************************************************/
+    CounterValues
+    next_counters() {
+        if (m_counter_pos == m_pending_counters.size()) {
+            m_pending_counters.clear();
+            m_counter_pos = 0;
+            m_counters.consume([this](std::span<const CounterValues> chunk) {
+                m_pending_counters.insert(m_pending_counters.end(), chunk.begin(), chunk.end());
+            });
+        }
+        return m_counter_pos < m_pending_counters.size() ? m_pending_counters[m_counter_pos++] : CounterValues{};
+    }
+
+    /*******************************************************************************
+     * @brief Pass activity of each ring to @p clbk as `clbk(CpuId, const RingStats&)`.
+     *
+     * Thread-safe, the values are updated as the reader drains.
+     ******************************************************************************/
+    template <typename Clbk>
+    void
+    stats(Clbk&& clbk) const {
+        for (std::size_t i = 0; i < m_cpus.size(); ++i)
+            clbk(m_cpus[i],
+                 RingStats{.num_records = m_num_records[i].load(std::memory_order_relaxed),
+                           .num_lost = m_num_lost[i].load(std::memory_order_relaxed),
+                           .max_drain_interval = TimePoint{m_max_drain_interval[i].load(std::memory_order_relaxed)}});
+    }
+
+private:
+    void
+    run(const std::stop_token& token) {
+        auto last_sweep = std::chrono::steady_clock::now();
+        std::ranges::fill(m_last_drain, last_sweep);
+        while (!token.stop_requested()) {
+            // Only rings above their watermark wake us up.
+            for (auto i : m_poller.wait(m_sweep_period))
+                drain(i);
+
+            // Collect the rings of mostly idle CPUs which never reach the watermark.
+            if (std::chrono::steady_clock::now() - last_sweep >= m_sweep_period) {
+                drain_all();
+                last_sweep = std::chrono::steady_clock::now();
+            }
+        }
+
+        for (auto& event : m_events)
+            event.perf_stop();
+        // Collect anything left over.
+        drain_all();
+    }
+
+    void
+    drain_all() {
+        for (std::size_t i = 0; i < m_events.size(); ++i)
+            drain(i);
+    }
+
+    /*******************************************************************************
+     * @brief Drain records of the @p i-th event.
+     ******************************************************************************/
+    void
+    drain(std::size_t i) {
+        std::uint64_t num_lost = 0;
+        const auto num_records = m_events[i].drain_perf_events([this, i, &num_lost](const PerfRecord& record) {
+            if (auto sample = parse_sample(record, m_sample_type, &m_callchain, &m_read_counters)) {
+                // Counters and the stack must be visible before their sample.
+                if (m_num_counters > 0) {
+                    // Read values are totals, attribute only the increments to the sample.
+                    for (std::size_t c = 0; c < m_num_counters; ++c)
+                        m_read_counters[c] -= std::exchange(m_last_counters[i][c], m_read_counters[c]);
+                    push(m_counters, m_read_counters);
+                }
+                if (m_callchains) {
+                    push(m_stacks, std::uint64_t{m_callchain.size()});
+                    for (auto ip : m_callchain)
+                        push(m_stacks, ip);
+                }
+                push(m_queue, *sample);
+            } else if (auto context_switch = parse_switch(record, m_sample_type)) {
+                push(m_queue, *context_switch);
+            } else if (auto task = parse_task_event(record)) {
+                push(m_tasks, *task);
+                // Forks, execs and exits change address spaces, ordered with the mappings.
+                if (m_trace_maps && task->kind == TaskEvent::Kind::fork)
+                    push(m_maps, MapEvent{.kind = MapEvent::Kind::fork, .pid = task->pid, .parent = task->parent});
+                else if (m_trace_maps && task->kind == TaskEvent::Kind::exit)
+                    push(m_maps, MapEvent{.kind = MapEvent::Kind::exit, .pid = task->pid});
+                else if (m_trace_maps && task->exec)
+                    push(m_maps, MapEvent{.kind = MapEvent::Kind::exec, .pid = task->pid});
+            } else if (auto map = parse_map_event(record)) {
+                push(m_maps, *map);
+            } else if (auto lost = parse_lost(record)) {
+                num_lost += *lost;
+            }
+        });
+
+        // Only this thread writes the counters.
+        const auto now = std::chrono::steady_clock::now();
+        const auto interval = std::chrono::duration_cast<TimePoint>(now - m_last_drain[i]).count();
+        m_last_drain[i] = now;
+        if (interval > m_max_drain_interval[i].load(std::memory_order_relaxed))
+            m_max_drain_interval[i].store(interval, std::memory_order_relaxed);
+        m_num_records[i].store(m_num_records[i].load(std::memory_order_relaxed) + num_records,
+                               std::memory_order_relaxed);
+        if (num_lost > 0)
+            m_num_lost[i].store(m_num_lost[i].load(std::memory_order_relaxed) + num_lost,
+                                std::memory_order_relaxed);
+    }
+
+    /*******************************************************************************
+     * @brief Push @p value to @p queue , waiting for the consumer unless it is gone.
+     ******************************************************************************/
+    template <typename T>
+    void
+    push(SpscQueue<T>& queue, const T& value) {
+        while (!queue.try_push(value) && !m_abandoned.load(std::memory_order_relaxed))
+            std::this_thread::yield();
+    }
+
+    /*! Sampled CPUs. */
+    std::vector<CpuId> m_cpus;
+    /*! Fields of the sample records. */
+    std::uint64_t m_sample_type;
+    /*! How often all rings are drained regardless of their fill level. */
+    std::chrono::milliseconds m_sweep_period;
+    /*! Event for each sampled CPU. */
+    std::vector<PerfEvents> m_events;
+    /*! Counters grouped with the events. */
+    std::vector<PerfEvents> m_members;
+    /*! Waits for the events reaching their watermark. */
+    EventPoller m_poller;
+    /*! Collected samples. */
+    SpscQueue<CpuSample> m_queue;
+    /*! Counter increments of the tick samples, in the order of the samples. */
+    SpscQueue<CounterValues> m_counters;
+    /*! Collected process lifecycle events. */
+    SpscQueue<TaskEvent> m_tasks;
+    /*! Whether executable mappings are traced. */
+    bool m_trace_maps;
+    /*! Collected address space changes. */
+    SpscQueue<MapEvent> m_maps;
+    /*! Whether the samples have callchains. */
+    bool m_callchains;
+    /*! Callchain of the last parsed sample. */
+    std::vector<std::uint64_t> m_callchain;
+    /*! Call stacks of the tick samples, each as its depth followed by the frames. */
+    SpscQueue<std::uint64_t> m_stacks;
+    /*! Stacks taken from @ref m_stacks, owned by the consumer. */
+    std::vector<std::uint64_t> m_pending_stacks;
+    /*! Start of the next stack in @ref m_pending_stacks. */
+    std::size_t m_stack_pos = 0;
+    /*! Records drained from each event. */
+    std::vector<std::atomic<std::uint64_t>> m_num_records;
+    /*! Records lost by each event. */
+    std::vector<std::atomic<std::uint64_t>> m_num_lost;
+    /*! Longest time between two drains of each event, in nanoseconds. */
+    std::vector<std::atomic<TimePoint::rep>> m_max_drain_interval;
+    /*! Last drain of each event. */
+    std::vector<std::chrono::steady_clock::time_point> m_last_drain;
+    /*! Number of counters grouped with each event. */
+    std::size_t m_num_counters;
+    /*! Counter totals read by the last sample of each event. */
+    std::vector<CounterValues> m_last_counters;
+    /*! Counters of the last parsed sample. */
+    CounterValues m_read_counters{};
+    /*! Counters taken from @ref m_counters, owned by the consumer. */
+    std::vector<CounterValues> m_pending_counters;
+    /*! Next counters in @ref m_pending_counters. */
+    std::size_t m_counter_pos = 0;
+    /*! Error which terminated the thread. */
+    std::exception_ptr m_error;
+    /*! Whether the thread has finished. */
+    std::atomic<bool> m_done{false};
+    /*! Whether nobody consumes the queue anymore. */
+    std::atomic<bool> m_abandoned{false};
+    /*! Reader thread. */
+    std::jthread m_thread;
+};
+} // namespace
+
+/*******************************************************************************
+ * @brief Readers and the consumer merging their samples for the sinks.
+ ******************************************************************************/
+struct SamplingSession::Impl {
+    /*******************************************************************************
+     * @brief Create the consumer of @p num_cpus CPUs, without readers.
+     ******************************************************************************/
+    Impl(std::size_t num_cpus, TimePoint reorder_window) :
+        merger(num_cpus, reorder_window), pending_counters(num_cpus), resolver(c_name_cache_size) {
+        batch.reserve(c_batch_size);
+    }
+
+    /*******************************************************************************
+     * @brief Consume the readers until stopped, then flush everything.
+     ******************************************************************************/
+    void
+    run(const std::stop_token& token) {
+        while (!token.stop_requested()) {
+            if (consume_round() == 0)
+                std::this_thread::sleep_for(c_consume_period);
+        }
+
+        // Keep consuming while readers flush their buffers.
+        for (auto& reader : readers)
+            reader->request_stop();
+        for (auto& reader : readers) {
+            while (!reader->done())
+                if (consume_round() == 0)
+                    std::this_thread::yield();
+            reader->stop();
+        }
+        consume_round();
+        merger.flush([this](const CpuSample& sample) { emit(sample); });
+        dispatch();
+        // Let the scanners finish lookups of the last samples.
+        resolver.wait_idle(c_name_flush_timeout);
+        dispatch_names();
+        groups.wait_idle(c_name_flush_timeout);
+        dispatch_groups();
+    }
+
+    /*******************************************************************************
+     * @brief Move samples from readers through the merger to the sinks.
+     *
+     * @return Number of samples consumed from the readers.
+     ******************************************************************************/
+    std::size_t
+    consume_round() {
+        // Names first, samples may belong to the new processes.
+        const auto collect_tasks = [this](std::span<const TaskEvent> events) {
+            for (const auto& event : events)
+                switch (event.kind) {
+                case TaskEvent::Kind::comm:
+                    resolver.on_comm(event.pid, event.name());
+                    break;
+                case TaskEvent::Kind::fork:
+                    resolver.on_fork(event.parent, event.pid);
+                    break;
+                case TaskEvent::Kind::exit:
+                    resolver.on_exit(event.pid);
+                    break;
+                }
+        };
+        for (auto& reader : readers)
+            reader->consume_tasks(collect_tasks);
+
+        std::size_t num_consumed = 0;
+        for (auto& reader : readers)
+            num_consumed += reader->consume([this, &reader](std::span<const CpuSample> samples) {
+                for (auto sample : samples) {
+                    if (callchains && sample.kind == SampleKind::tick) {
+                        const auto first_new = static_cast<StackId>(stacks.size());
+                        sample.stack = stacks.intern(reader->next_stack());
+                        if (symbolizer)
+                            for (auto id = first_new; id < stacks.size(); ++id)
+                                unresolved.emplace_back(id, sample.pid);
+                    }
+                    const auto stream = stream_of(sample.cpu);
+                    // The merger keeps order of each stream, so do the counters waiting beside it.
+                    if (counting && sample.kind == SampleKind::tick)
+                        pending_counters[stream].push(reader->next_counters());
+                    merger.push(stream, std::span{&sample, 1});
+                }
+            });
+        // Mappings after the samples, those of the consumed samples are visible now.
+        if (symbolizer) {
+            for (auto& reader : readers)
+                reader->consume_maps([this](std::span<const MapEvent> events) {
+                    for (const auto& event : events)
+                        if (event.kind == MapEvent::Kind::exit)
+                            exited.push_back(event.pid);
+                        else
+                            symbolizer->on_map(event);
+                });
+            resolve_stacks();
+            // Exited processes may have sampled the stacks just resolved.
+            for (auto pid : exited)
+                symbolizer->on_map(MapEvent{.kind = MapEvent::Kind::exit, .pid = pid});
+            // A single scan of the files for all exits of the round.
+            if (!exited.empty())
+                symbolizer->release_files();
+            exited.clear();
+        }
+        merger.pop([this](const CpuSample& sample) { emit(sample); });
+        dispatch();
+        dispatch_names();
+        dispatch_groups();
+        return num_consumed;
+    }
+
+    /*******************************************************************************
+     * @brief Index of the merger's stream of @p cpu .
+     ******************************************************************************/
+    std::size_t
+    stream_of(CpuId cpu) const {
+        auto it = cpu_streams.find(cpu);
+        return it != cpu_streams.end() ? it->second : 0;
+    }
+
+    /*******************************************************************************
+     * @brief Resolve functions of the innermost frames of new stacks.
+     ******************************************************************************/
+    void
+    resolve_stacks() {
+        stack_symbols.resize(stacks.size(), c_unknown_name);
+        for (const auto& [id, pid] : unresolved)
+            if (auto symbol = symbolizer->symbolize(pid, stacks.node(id).ip)) {
+                // Functions appear in many stacks, demangle each once. The raw names
+                // are copied, the symbolizer forgets the files of exited processes.
+                auto [it, inserted] = demangled.try_emplace(raw_symbols.intern(*symbol), c_unknown_name);
+                if (inserted)
+                    it->second = symbol_names.intern(demangle(*symbol));
+                stack_symbols[id] = it->second;
+            }
+        unresolved.clear();
+    }
+
+    /*******************************************************************************
+     * @brief Append @p sample to the current batch.
+     ******************************************************************************/
+    void
+    emit(const CpuSample& sample) {
+        // Consecutive samples mostly share the process.
+        if (!name_sinks.empty() && sample.pid != last_pid) {
+            (void)resolver.lookup(sample.pid);
+            last_pid = sample.pid;
+        }
+        if (!group_sinks.empty() && sample.cgroup != last_group) {
+            report_group(sample.cgroup);
+            last_group = sample.cgroup;
+        }
+        batch.push_back(sample);
+        if (counting)
+            counter_batch.push_back(sample.kind == SampleKind::tick ? pending_counters[stream_of(sample.cpu)].pop()
+                                                                     : CounterValues{});
+        if (batch.size() >= c_batch_size)
+            dispatch();
+    }
+
+    /*******************************************************************************
+     * @brief Pass the current batch to the sinks.
+     ******************************************************************************/
+    void
+    dispatch() {
+        if (batch.empty())
+            return;
+        // The batch may refer to new stacks.
+        for (; reported_stacks < stacks.size(); ++reported_stacks) {
+            const auto& node = stacks.node(reported_stacks);
+            const auto id = reported_stacks < stack_symbols.size() ? stack_symbols[reported_stacks] : c_unknown_name;
+            const auto symbol = id != c_unknown_name ? symbol_names.resolve(id) : std::string_view{};
+            for (const auto& sink : stack_sinks)
+                sink(reported_stacks, node.parent, node.ip, symbol);
+        }
+        for (const auto& sink : sinks)
+            sink(batch);
+        batch.clear();
+        if (!counting)
+            return;
+        for (const auto& sink : counter_sinks)
+            sink(counter_batch);
+        counter_batch.clear();
+    }
+
+    /*******************************************************************************
+     * @brief Pass path of cgroup @p id to the group sinks unless already passed.
+     *
+     * Unknown cgroups are passed by @ref dispatch_groups once resolved.
+     ******************************************************************************/
+    void
+    report_group(GroupId id) {
+        if (reported_groups.contains(id))
+            return;
+        if (auto path = groups.lookup(id))
+            pass_group(id, *path);
+    }
+
+    /*******************************************************************************
+     * @brief Pass path @p path of cgroup @p id to the group sinks.
+     ******************************************************************************/
+    void
+    pass_group(GroupId id, NameId path) {
+        reported_groups.insert(id);
+        for (const auto& sink : group_sinks)
+            sink(id, groups.names().resolve(path));
+    }
+
+    /*******************************************************************************
+     * @brief Pass newly resolved cgroup paths to the group sinks.
+     ******************************************************************************/
+    void
+    dispatch_groups() {
+        if (group_sinks.empty())
+            return;
+        groups.collect_resolved([this](GroupId id, NameId path) {
+            if (!reported_groups.contains(id))
+                pass_group(id, path);
+        });
+    }
+
+    /*******************************************************************************
+     * @brief Pass newly resolved process names to the name sinks.
+     ******************************************************************************/
+    void
+    dispatch_names() {
+        if (name_sinks.empty())
+            return;
+        resolver.collect_resolved([this](ProcId pid, NameId name) {
+            for (const auto& sink : name_sinks)
+                sink(pid, resolver.names().resolve(name));
+        });
+    }
+
+    /*! Counters of the samples pending in a stream of the merger, in the order of the samples. */
+    struct PendingCounters {
+        /*! Values, the emitted ones are compacted only once they make up most of it. */
+        std::vector<CounterValues> values;
+        /*! Index of the first pending values. */
+        std::size_t first = 0;
+
+        /*! Append @p counters of the next sample. */
+        void
+        push(const CounterValues& counters) {
+            if (first > values.size() / 2) {
+                values.erase(values.begin(), values.begin() + static_cast<std::ptrdiff_t>(first));
+                first = 0;
+            }
+            values.push_back(counters);
+        }
+
+        /*! Remove counters of the first sample, zeroes if there are none. */
+        CounterValues
+        pop() noexcept {
+            if (first == values.size())
+                return {};
+            const auto counters = values[first++];
+            if (first == values.size()) {
+                values.clear();
+                first = 0;
+            }
+            return counters;
+        }
+    };
+
+    /*! Readers, each for a shard of CPUs. */
+    std::vector<std::unique_ptr<CpuReader>> readers;
+    /*! Index of merger's stream for each CPU. */
+    std::unordered_map<CpuId, std::size_t> cpu_streams;
+    /*! Orders samples of all CPUs. */
+    SampleMerger merger;
+    /*! Whether counters are read with the samples. */
+    bool counting = false;
+    /*! Counters of the samples in each stream of the merger. */
+    std::vector<PendingCounters> pending_counters;
+    /*! Registered sinks. */
+    std::vector<SampleSink> sinks;
+    /*! Registered counter sinks. */
+    std::vector<CounterSink> counter_sinks;
+    /*! Ordered samples not passed to the sinks yet. */
+    std::vector<CpuSample> batch;
+    /*! Counters of @ref batch, empty unless counting. */
+    std::vector<CounterValues> counter_batch;
+    /*! Names of the sampled processes. */
+    NameResolver resolver;
+    /*! Registered name sinks. */
+    std::vector<NameSink> name_sinks;
+    /*! Process of the last emitted sample, already looked up. */
+    std::optional<ProcId> last_pid;
+    /*! Paths of the sampled cgroups. */
+    CgroupResolver groups;
+    /*! Registered group sinks. */
+    std::vector<GroupSink> group_sinks;
+    /*! Cgroups already passed to the group sinks. */
+    std::unordered_set<GroupId> reported_groups;
+    /*! Cgroup of the last emitted sample, already reported. */
+    std::optional<GroupId> last_group;
+    /*! Whether the samples have call stacks. */
+    bool callchains = false;
+    /*! Unique call stacks of the samples. */
+    CallTree stacks;
+    /*! Registered stack sinks. */
+    std::vector<StackSink> stack_sinks;
+    /*! Stacks passed to the stack sinks, the root is never passed. */
+    StackId reported_stacks = c_root_stack + 1;
+    /*! Resolves the stacks, empty unless symbolizing. */
+    std::optional<Symbolizer> symbolizer;
+    /*! New stacks to resolve, with the process which sampled them. */
+    std::vector<std::pair<StackId, ProcId>> unresolved;
+    /*! Processes whose exits are applied after resolving the stacks of a round. */
+    std::vector<ProcId> exited;
+    /*! Demangled function names. */
+    StringTable symbol_names;
+    /*! Raw names of the symbolizer. */
+    StringTable raw_symbols;
+    /*! Maps @ref raw_symbols to @ref symbol_names. */
+    std::unordered_map<NameId, NameId> demangled;
+    /*! Function of the innermost frame of each stack. */
+    std::vector<NameId> stack_symbols;
+    /*! Error which terminated the consumer. */
+    std::exception_ptr error;
+    /*! Consumer thread. */
+    std::jthread consumer;
+};
+
+SamplingSession::SamplingSession(SamplingConfig config) : m_config(std::move(config)) {
+    if (m_config.events.counters.size() > c_max_counters)
+        throw ElphiException(fmt::format("At most {} counters can be read, got {}.", c_max_counters,
+                                         m_config.events.counters.size()));
+    if (m_config.frequency == 0 && !m_config.trace_switches)
+        throw ElphiException("Sampling without frequency requires traced context switches.");
+    if (m_config.trace_switches && m_config.sample_cgroups)
+        throw ElphiException("Context switches cannot be traced together with cgroups.");
+    if (m_config.symbols && !m_config.sample_callchains)
+        throw ElphiException("Symbolization requires sampled callchains.");
+
+    const auto shards = m_config.shard_policy == ShardPolicy::per_numa_node
+                            ? shard_cpus_by_node(m_config.cpus,
+                                                 [](CpuId cpu) { return numa_node_of_cpu(cpu).value_or(0); })
+                            : shard_cpus(m_config.cpus, m_config.num_readers);
+
+    m_impl = std::make_unique<Impl>(m_config.cpus.size(), m_config.reorder_window);
+    m_impl->callchains = m_config.sample_callchains;
+    if (m_config.symbols)
+        m_impl->symbolizer.emplace(m_config.symbols);
+    // Each CPU's samples are ordered, merge them into one time-ordered stream.
+    for (std::size_t i = 0; i < m_config.cpus.size(); ++i)
+        m_impl->cpu_streams.try_emplace(m_config.cpus[i], i);
+
+    try {
+        open_readers(shards);
+    } catch (const ElphiException&) {
+        if (!m_config.events.uses_hardware())
+            throw;
+        // No PMU, e.g. in a VM, software events are always present.
+        m_impl->readers.clear();
+        m_config.events = EventSpec{};
+        open_readers(shards);
+    }
+    m_impl->counting = !m_config.events.counters.empty();
+    if (m_impl->counting)
+        m_impl->counter_batch.reserve(c_batch_size);
+}
+
+void
+SamplingSession::open_readers(const std::vector<std::vector<CpuId>>& shards) {
+    const auto& events = m_config.events;
+    const auto sample_type = c_sample_type | (m_config.sample_cgroups ? PERF_SAMPLE_CGROUP : 0) |
+                             (events.counters.empty() ? 0 : PERF_SAMPLE_READ) |
+                             (m_config.sample_callchains ? PERF_SAMPLE_CALLCHAIN : 0);
+    // Without explicit budget, stay within the memory perf allows to lock.
+    auto budget = m_config.rings.memory_budget;
+    if (budget == 0)
+        if (auto limit = perf_event_mlock_limit())
+            // The limit includes the header page.
+            budget = (*limit > c_page_size ? *limit - c_page_size : 0) * m_config.cpus.size();
+    const auto record_size = sizeof(perf_event_header) + sample_payload_size(sample_type, events.counters.size()) +
+                             (m_config.sample_callchains ? c_expected_stack_depth * sizeof(std::uint64_t) : 0);
+    const auto attribs = creat_attribs(m_config.frequency, sample_type, events.sampled, m_config.trace_switches,
+                                       m_config.symbols != nullptr);
+    const auto num_pages = size_rings(m_config.cpus, record_rate(attribs), record_size, m_config.rings, budget);
+    // Busy streams hold about a consume period of samples. Streams waiting for idle ones grow once to the
+    // reorder window and keep the room.
+    const auto num_pending = record_rate(attribs) * c_consume_period / std::chrono::seconds{1};
+    m_impl->merger.reserve(num_pending);
+    if (!events.counters.empty())
+        for (auto& pending : m_impl->pending_counters)
+            pending.values.reserve(num_pending);
+
+    std::vector<perf_event_attr> counters;
+    for (auto counter : events.counters)
+        counters.push_back(counter_attribs(counter));
+    // Counters are enabled together with their leader.
+    for (auto& counter : counters)
+        counter.disabled = 0;
+
+    // Open all events first to report errors before any thread is started.
+    for (const auto& shard : shards)
+        m_impl->readers.push_back(std::make_unique<CpuReader>(shard, attribs, counters, num_pages, m_config.rings));
+}
+
+SamplingSession::SamplingSession(SamplingSession&& other) noexcept = default;
+
+SamplingSession&
+SamplingSession::operator=(SamplingSession&& other) noexcept = default;
+
+SamplingSession::~SamplingSession() {
+    if (!m_impl)
+        return;
+    try {
+        stop();
+    } catch (...) { // NOLINT - nothing to do about the error now.
+    }
+}
+
+void
+SamplingSession::add_sink(SampleSink sink) {
+    if (m_state != SessionState::created)
+        throw ElphiException("Sinks must be added before the session is started.");
+    m_impl->sinks.push_back(std::move(sink));
+}
+
+void
+SamplingSession::add_counter_sink(CounterSink sink) {
+    if (m_state != SessionState::created)
+        throw ElphiException("Sinks must be added before the session is started.");
+    m_impl->counter_sinks.push_back(std::move(sink));
+}
+
+void
+SamplingSession::add_name_sink(NameSink sink) {
+    if (m_state != SessionState::created)
+        throw ElphiException("Sinks must be added before the session is started.");
+    m_impl->name_sinks.push_back(std::move(sink));
+}
+
+void
+SamplingSession::add_group_sink(GroupSink sink) {
+    if (m_state != SessionState::created)
+        throw ElphiException("Sinks must be added before the session is started.");
+    m_impl->group_sinks.push_back(std::move(sink));
+}
+
+void
+SamplingSession::add_stack_sink(StackSink sink) {
+    if (m_state != SessionState::created)
+        throw ElphiException("Sinks must be added before the session is started.");
+    m_impl->stack_sinks.push_back(std::move(sink));
+}
+
+void
+SamplingSession::start() {
+    switch (m_state) {
+    case SessionState::created:
+        // Processes started before the session are not announced by any record.
+        if (!m_impl->name_sinks.empty())
+            m_impl->resolver.scan_all();
+        for (auto& reader : m_impl->readers)
+            reader->start(m_config.pin_readers);
+        m_impl->consumer = std::jthread{[impl = m_impl.get()](const std::stop_token& token) {
+            try {
+                impl->run(token);
+            } catch (...) {
+                impl->error = std::current_exception();
+                // Do not leave readers blocked on full queues.
+                for (auto& reader : impl->readers)
+                    reader->abandon();
+            }
+        }};
+        break;
+    case SessionState::paused:
+        for (auto& reader : m_impl->readers)
+            reader->resume();
+        break;
+    case SessionState::running:
+        return;
+    case SessionState::stopped:
+        throw ElphiException("Stopped session cannot be restarted.");
+    }
+    m_state = SessionState::running;
+}
+
+void
+SamplingSession::pause() {
+    if (m_state != SessionState::running)
+        return;
+    for (auto& reader : m_impl->readers)
+        reader->pause();
+    m_state = SessionState::paused;
+}
+
+void
+SamplingSession::stop() {
+    if (m_state == SessionState::stopped)
+        return;
+    m_state = SessionState::stopped;
+
+    m_impl->consumer.request_stop();
+    if (m_impl->consumer.joinable())
+        m_impl->consumer.join();
+    // No-op unless the consumer failed.
+    for (auto& reader : m_impl->readers)
+        reader->stop();
+    if (m_impl->error)
+        std::rethrow_exception(std::exchange(m_impl->error, nullptr));
+}
+
+SessionState
+SamplingSession::state() const noexcept {
+    return m_state;
+}
+
+const EventSpec&
+SamplingSession::events() const noexcept {
+    return m_config.events;
+}
+
+std::unordered_map<CpuId, RingStats>
+SamplingSession::ring_stats() const {
+    std::unordered_map<CpuId, RingStats> stats;
+    if (!m_impl)
+        return stats;
+    for (const auto& reader : m_impl->readers)
+        reader->stats([&stats](CpuId cpu, const RingStats& ring) { stats.insert_or_assign(cpu, ring); });
+    return stats;
+}
+} // namespace elphi
@@ -0,0 +1,70 @@
+/*******************************************************************************
+ * @file segmented_vector.cpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license	This file is released under ElPhi project's license, see LICENSE.
+ ******************************************************************************/
+#include <new>
+
+#include <elphi/segmented_vector.hpp>
+
+namespace elphi {
+
+BlockPool::~BlockPool() {
+    trim();
+}
+
+void*
+BlockPool::acquire() {
+    {
+        std::scoped_lock lock{m_mutex};
+        if (m_free != nullptr) {
+            auto* block = m_free;
+            m_free = block->next;
+            --m_num_free;
+            return block;
+        }
+        ++m_num_blocks;
+    }
+    try {
+        return ::operator new(c_block_size);
+    } catch (...) {
+        std::scoped_lock lock{m_mutex};
+        --m_num_blocks;
+        throw;
+    }
+}
+
+void
+BlockPool::release(void* block) noexcept {
+    auto* free = ::new (block) FreeBlock{};
+    std::scoped_lock lock{m_mutex};
+    free->next = m_free;
+    m_free = free;
+    ++m_num_free;
+}
+
+void
+BlockPool::trim() noexcept {
+    FreeBlock* free = nullptr;
+    {
+        std::scoped_lock lock{m_mutex};
+        free = std::exchange(m_free, nullptr);
+        m_num_blocks -= m_num_free;
+        m_num_free = 0;
+    }
+    while (free != nullptr)
+        ::operator delete(std::exchange(free, free->next));
+}
+
+std::size_t
+BlockPool::num_blocks() const noexcept {
+    std::scoped_lock lock{m_mutex};
+    return m_num_blocks;
+}
+
+std::size_t
+BlockPool::num_free() const noexcept {
+    std::scoped_lock lock{m_mutex};
+    return m_num_free;
+}
+} // namespace elphi
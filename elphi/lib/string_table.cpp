@@ -0,0 +1,54 @@
+/*******************************************************************************
+ * @file string_table.cpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license	This file is released under ElPhi project's license, see LICENSE.
+ ******************************************************************************/
+#include <elphi/string_table.hpp>
+
+namespace elphi {
+
+namespace {
+/*! String of @ref c_unknown_name. */
+constexpr std::string_view c_unknown_str = "UNKNOWN";
+} // namespace
+
+StringTable::StringTable() { intern(c_unknown_str); }
+
+StringTable::StringTable(const StringTable& other) {
+    for (const auto& str : other.m_strings)
+        intern(str);
+}
+
+StringTable&
+StringTable::operator=(const StringTable& other) {
+    if (this != &other) {
+        m_ids.clear();
+        m_strings.clear();
+        for (const auto& str : other.m_strings)
+            intern(str);
+    }
+    return *this;
+}
+
+NameId
+StringTable::intern(std::string_view str) {
+    if (auto it = m_ids.find(str); it != m_ids.end())
+        return it->second;
+
+    const auto id = static_cast<NameId>(m_strings.size());
+    // The map must view the stored copy, not the argument.
+    const auto& stored = m_strings.emplace_back(str);
+    m_ids.emplace(stored, id);
+    return id;
+}
+
+std::string_view
+StringTable::resolve(NameId id) const noexcept {
+    return id < m_strings.size() ? std::string_view{m_strings[id]} : c_unknown_str;
+}
+
+std::size_t
+StringTable::size() const noexcept {
+    return m_strings.size();
+}
+} // namespace elphi
@@ -0,0 +1,143 @@
+/*******************************************************************************
+ * @file symbolizer.cpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license	This file is released under ElPhi project's license, see LICENSE.
+ ******************************************************************************/
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <utility>
+
+#include <cxxabi.h>
+#include <fmt/format.h>
+
+#include <elphi/symbolizer.hpp>
+
+namespace elphi {
+
+Symbolizer::Symbolizer(std::shared_ptr<SymbolCache> cache, std::string proc_root) :
+    m_cache(std::move(cache)), m_proc_root(std::move(proc_root)) {}
+
+void
+Symbolizer::on_map(const MapEvent& event) {
+    switch (event.kind) {
+    case MapEvent::Kind::map:
+        // Processes seen for the first time have mappings from before the session.
+        map(space(event.pid), Mapping{.start = event.start,
+                                      .end = event.start + event.size,
+                                      .offset = event.offset,
+                                      .path = std::string{event.path()}});
+        break;
+    case MapEvent::Kind::fork:
+        // Unknown parents are left for the child's lookup in /proc.
+        if (auto it = m_spaces.find(event.parent); it != m_spaces.end())
+            m_spaces.insert_or_assign(event.pid, it->second);
+        else
+            m_spaces.erase(event.pid);
+        break;
+    case MapEvent::Kind::exec:
+        // The new image is mapped after the exec, nothing of the old one is left to read from /proc.
+        m_spaces[event.pid].clear();
+        break;
+    case MapEvent::Kind::exit:
+        m_spaces.erase(event.pid);
+        break;
+    }
+}
+
+std::optional<std::string_view>
+Symbolizer::symbolize(ProcId pid, std::uint64_t ip) {
+    auto known = m_spaces.find(pid);
+    if (known == m_spaces.end()) {
+        // Samples may come after the exit, do not remember processes which are gone.
+        AddressSpace read;
+        if (!read_maps(pid, read))
+            return std::nullopt;
+        known = m_spaces.emplace(pid, std::move(read)).first;
+    }
+    auto& mappings = known->second;
+    const auto it =
+        std::ranges::upper_bound(mappings, ip, std::less{}, [](const Mapping& mapping) { return mapping.start; });
+    if (it == mappings.begin())
+        return std::nullopt;
+    auto& mapping = *std::prev(it);
+    if (ip >= mapping.end)
+        return std::nullopt;
+    const auto* index = symbols(mapping);
+    if (index == nullptr)
+        return std::nullopt;
+    return index->lookup(ip - mapping.start + mapping.offset);
+}
+
+Symbolizer::AddressSpace&
+Symbolizer::space(ProcId pid) {
+    auto [it, inserted] = m_spaces.try_emplace(pid);
+    if (inserted)
+        (void)read_maps(pid, it->second);
+    return it->second;
+}
+
+bool
+Symbolizer::read_maps(ProcId pid, AddressSpace& space) const {
+    // Lines look like "<start>-<end> <perms> <offset> <dev> <inode> <path>".
+    std::ifstream file{fmt::format("{}/{}/maps", m_proc_root, pid)};
+    if (!file.is_open())
+        return false;
+    for (std::string line; std::getline(file, line);) {
+        std::uint64_t start = 0;
+        std::uint64_t end = 0;
+        std::uint64_t offset = 0;
+        char perms[5] = {}; // NOLINT - sscanf target.
+        int path_pos = 0;
+        if (std::sscanf(line.c_str(), "%" SCNx64 "-%" SCNx64 " %4s %" SCNx64 " %*s %*s %n", &start, &end, perms,
+                        &offset, &path_pos) != 4 ||
+            perms[2] != 'x' || path_pos <= 0 || line[static_cast<std::size_t>(path_pos)] != '/')
+            continue;
+        map(space, Mapping{.start = start, .end = end, .offset = offset, .path = line.substr(path_pos)});
+    }
+    return true;
+}
+
+void
+Symbolizer::release_files() {
+    // Loaded mappings share the index, unused ones are held by this map alone.
+    std::erase_if(m_files, [](const auto& file) { return file.second.use_count() <= 1; });
+}
+
+void
+Symbolizer::map(AddressSpace& space, Mapping mapping) {
+    // New mappings replace whatever was mapped at their addresses.
+    std::erase_if(space, [&mapping](const Mapping& old) { return old.start < mapping.end && mapping.start < old.end; });
+    const auto it = std::ranges::upper_bound(space, mapping.start, std::less{},
+                                             [](const Mapping& other) { return other.start; });
+    space.insert(it, std::move(mapping));
+}
+
+const ElfSymbols*
+Symbolizer::symbols(Mapping& mapping) {
+    if (!std::exchange(mapping.loaded, true)) {
+        auto [it, inserted] = m_files.try_emplace(mapping.path);
+        if (inserted) {
+            // Shared through a holder of this symbolizer, so that the use count is only of its mappings.
+            auto holder = std::make_shared<std::shared_ptr<const ElfSymbols>>(m_cache->load(mapping.path));
+            it->second = std::shared_ptr<const ElfSymbols>{holder, holder->get()};
+        }
+        mapping.symbols = it->second;
+    }
+    return mapping.symbols.get();
+}
+
+std::string
+demangle(std::string_view symbol) {
+    // Only the Itanium ABI mangling is understood.
+    if (!symbol.starts_with("_Z"))
+        return std::string{symbol};
+    const std::string mangled{symbol};
+    int status = 0;
+    std::unique_ptr<char, decltype(&std::free)> demangled{
+        abi::__cxa_demangle(mangled.c_str(), nullptr, nullptr, &status), &std::free};
+    return status == 0 && demangled ? std::string{demangled.get()} : mangled;
+}
+} // namespace elphi
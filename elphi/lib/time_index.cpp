@@ -0,0 +1,138 @@
+/*******************************************************************************
+ * @file time_index.cpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license	This file is released under ElPhi project's license, see LICENSE.
+ ******************************************************************************/
+#include <elphi/time_index.hpp>
+
+namespace elphi::view {
+
+namespace {
+/*******************************************************************************
+ * @brief Entries of block @p block of @p entries .
+ ******************************************************************************/
+template <typename T>
+std::span<const T>
+block_of(std::span<const T> entries, std::size_t block) noexcept {
+    const auto first = block * c_time_block_size;
+    return entries.subspan(first, std::min(c_time_block_size, entries.size() - first));
+}
+
+/*******************************************************************************
+ * @brief Position of the first of @p entries ending at or after @p from .
+ *
+ * @param block_ends Latest end up to the end of each block, non-decreasing.
+ * @param end_of Returns end of an entry, non-decreasing.
+ ******************************************************************************/
+template <typename T, typename Proj>
+std::size_t
+first_ending_from(std::span<const T> entries, const std::vector<TimePoint>& block_ends, TimePoint from,
+                  Proj end_of) noexcept {
+    // Blocks before it end before the range.
+    const auto block = static_cast<std::size_t>(std::ranges::lower_bound(block_ends, from) - block_ends.begin());
+    if (block == block_ends.size())
+        return entries.size();
+    const auto entries_of = block_of(entries, block);
+    const auto it = std::ranges::partition_point(entries_of, [&](const T& entry) { return end_of(entry) < from; });
+    return block * c_time_block_size + static_cast<std::size_t>(it - entries_of.begin());
+}
+
+/*******************************************************************************
+ * @brief Position past the last of @p entries beginning at or before @p to .
+ *
+ * @param block_begins Begin of the first entry of each block.
+ * @param begin_of Returns begin of an entry, non-decreasing.
+ ******************************************************************************/
+template <typename T, typename Proj>
+std::size_t
+end_beginning_until(std::span<const T> entries, const std::vector<TimePoint>& block_begins, TimePoint to,
+                    Proj begin_of) noexcept {
+    // Blocks after it begin after the range.
+    const auto past = static_cast<std::size_t>(std::ranges::upper_bound(block_begins, to) - block_begins.begin());
+    if (past == 0)
+        return 0;
+    const auto entries_of = block_of(entries, past - 1);
+    const auto it = std::ranges::partition_point(entries_of, [&](const T& entry) { return begin_of(entry) <= to; });
+    return (past - 1) * c_time_block_size + static_cast<std::size_t>(it - entries_of.begin());
+}
+
+/*******************************************************************************
+ * @brief Entries from @p first to @p last of @p entries , empty if reversed.
+ ******************************************************************************/
+template <typename T>
+std::span<const T>
+between(std::span<const T> entries, std::size_t first, std::size_t last) noexcept {
+    return first < last ? entries.subspan(first, last - first) : std::span<const T>{};
+}
+} // namespace
+
+SliceIndex::SliceIndex(std::span<const ThreadTimeSlice> slices) : m_slices(slices) {
+    const auto num_blocks = (slices.size() + c_time_block_size - 1) / c_time_block_size;
+    m_block_begins.reserve(num_blocks);
+    m_block_ends.reserve(num_blocks);
+    auto max_end = TimePoint::min();
+    for (std::size_t b = 0; b < num_blocks; ++b) {
+        const auto block = block_of(slices, b);
+        m_block_begins.push_back(block.front().begin_time);
+        for (const auto& slice : block)
+            max_end = std::max(max_end, slice.end_time);
+        m_block_ends.push_back(max_end);
+    }
+}
+
+std::span<const ThreadTimeSlice>
+SliceIndex::overlapping(TimePoint from, TimePoint to) const noexcept {
+    if (from > to)
+        return {};
+    const auto first = first_ending_from(m_slices, m_block_ends, from,
+                                         [](const ThreadTimeSlice& slice) { return slice.end_time; });
+    const auto last = end_beginning_until(m_slices, m_block_begins, to,
+                                          [](const ThreadTimeSlice& slice) { return slice.begin_time; });
+    return between(m_slices, first, last);
+}
+
+TimelineIndex::TimelineIndex(const Timeline& timeline) {
+    for (const auto& [cpu, slices] : timeline)
+        m_cpus.try_emplace(cpu, slices);
+}
+
+std::span<const ThreadTimeSlice>
+TimelineIndex::overlapping(CpuId cpu, TimePoint from, TimePoint to) const noexcept {
+    auto it = m_cpus.find(cpu);
+    return it != m_cpus.end() ? it->second.overlapping(from, to) : std::span<const ThreadTimeSlice>{};
+}
+
+std::vector<std::pair<CpuId, std::span<const ThreadTimeSlice>>>
+TimelineIndex::overlapping(std::span<const CpuId> cpus, TimePoint from, TimePoint to) const {
+    std::vector<std::pair<CpuId, std::span<const ThreadTimeSlice>>> views;
+    for (auto cpu : cpus)
+        if (auto slices = overlapping(cpu, from, to); !slices.empty())
+            views.emplace_back(cpu, slices);
+    return views;
+}
+
+SampleIndex::SampleIndex(std::span<const CpuSample> samples) : m_samples(samples) {
+    const auto num_blocks = (samples.size() + c_time_block_size - 1) / c_time_block_size;
+    m_block_begins.reserve(num_blocks);
+    m_block_ends.reserve(num_blocks);
+    m_block_cpus.reserve(num_blocks);
+    for (std::size_t b = 0; b < num_blocks; ++b) {
+        const auto block = block_of(samples, b);
+        m_block_begins.push_back(block.front().time);
+        m_block_ends.push_back(block.back().time);
+        std::uint64_t cpus = 0;
+        for (const auto& sample : block)
+            cpus |= cpu_bit(sample.cpu);
+        m_block_cpus.push_back(cpus);
+    }
+}
+
+std::span<const CpuSample>
+SampleIndex::range(TimePoint from, TimePoint to) const noexcept {
+    if (from > to)
+        return {};
+    const auto time_of = [](const CpuSample& sample) { return sample.time; };
+    return between(m_samples, first_ending_from(m_samples, m_block_ends, from, time_of),
+                   end_beginning_until(m_samples, m_block_begins, to, time_of));
+}
+} // namespace elphi::view
@@ -0,0 +1,195 @@
+/*******************************************************************************
+ * @file timeline_lod.cpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license	This file is released under ElPhi project's license, see LICENSE.
+ ******************************************************************************/
+#include <algorithm>
+
+#include <fmt/format.h>
+
+#include <elphi/exception.hpp>
+#include <elphi/timeline_lod.hpp>
+#include <elphi/timeline_view.hpp>
+
+namespace elphi::view {
+
+namespace {
+/*! Number of candidates for the dominant thread of a bucket. */
+constexpr std::size_t c_num_candidates = 8;
+
+/*******************************************************************************
+ * @brief Number of the bucket of width @p width containing @p time .
+ ******************************************************************************/
+std::uint64_t
+bucket_number(TimePoint time, TimePoint width) noexcept {
+    return static_cast<std::uint64_t>(std::max(time, TimePoint::zero()) / width);
+}
+} // namespace
+
+TimelinePyramid::TimelinePyramid() : TimelinePyramid(LodConfig{}) {}
+
+TimelinePyramid::TimelinePyramid(const LodConfig& config) {
+    if (config.base_width <= TimePoint::zero() || config.factor < 2 || config.num_levels == 0)
+        throw ElphiException(fmt::format("Invalid timeline pyramid of {} levels of {}ns merged by {}",
+                                         config.num_levels, config.base_width.count(), config.factor));
+    std::uint64_t span = 1;
+    for (std::size_t level = 0; level < config.num_levels; ++level) {
+        m_spans.push_back(span);
+        m_widths.push_back(config.base_width * static_cast<TimePoint::rep>(span));
+        span *= config.factor;
+    }
+}
+
+LodBucket*
+TimelinePyramid::bucket_at(CpuLevels& cpu, std::size_t level, std::uint64_t number) {
+    auto& [first, buckets, candidates, candidates_of] = cpu.levels[level];
+    if (buckets.empty())
+        first = number;
+    else if (number < first)
+        return nullptr;
+
+    while (first + buckets.size() <= number) {
+        // The last base bucket is finished by starting the next one.
+        if (level == 0 && !buckets.empty())
+            finish_base(cpu, first + buckets.size() - 1);
+        buckets.emplace_back();
+    }
+    return &buckets[number - first];
+}
+
+void
+TimelinePyramid::finish_base(CpuLevels& cpu, std::uint64_t number) {
+    auto& base = cpu.levels[0];
+    auto& bucket = base.buckets[number - base.first];
+    const auto fraction = bucket.busy * static_cast<TimePoint::rep>(c_occupancy_bins) / m_widths[0];
+    const auto bin = std::min(c_occupancy_bins - 1, static_cast<std::size_t>(fraction));
+    bucket.occupancy[bin] = 1;
+    for (std::size_t level = 1; level < m_widths.size(); ++level)
+        if (auto* above = bucket_at(cpu, level, number / m_spans[level]))
+            ++above->occupancy[bin];
+}
+
+void
+TimelinePyramid::attribute(CpuLevels& cpu, const CpuSample& sample, TimePoint from, TimePoint to) {
+    // The base level goes first to finish its buckets before the levels above accumulate after them.
+    for (std::size_t level = 0; level < m_widths.size(); ++level) {
+        const auto width = m_widths[level];
+        for (auto time = from; time < to;) {
+            const auto number = bucket_number(time, width);
+            const auto end = std::min(to, width * static_cast<TimePoint::rep>(number + 1));
+            auto* bucket = bucket_at(cpu, level, number);
+            if (bucket != nullptr) {
+                const auto duration = end - time;
+                bucket->busy += duration;
+
+                // Upper buckets may already exist, created by finished base buckets.
+                auto& candidates = cpu.levels[level].candidates;
+                if (auto& candidates_of = cpu.levels[level].candidates_of; candidates_of != number) {
+                    candidates.clear();
+                    candidates_of = number;
+                }
+                auto it = std::ranges::find_if(candidates, [&sample](const Candidate& candidate) {
+                    return candidate.pid == sample.pid && candidate.tid == sample.tid;
+                });
+                if (it == candidates.end()) {
+                    if (candidates.size() < c_num_candidates) {
+                        it = candidates.insert(it, Candidate{.pid = sample.pid, .tid = sample.tid});
+                    } else {
+                        // Space-saving, the new thread inherits time of the least one.
+                        it = std::ranges::min_element(candidates, {}, &Candidate::time);
+                        it->pid = sample.pid;
+                        it->tid = sample.tid;
+                    }
+                }
+                it->time += duration;
+                if (it->time >= bucket->dominant_time) {
+                    bucket->dominant_time = std::min(it->time, bucket->busy);
+                    bucket->pid = it->pid;
+                    bucket->tid = it->tid;
+                }
+            }
+            time = end;
+        }
+    }
+}
+
+void
+TimelinePyramid::add(std::span<const CpuSample> samples) {
+    CpuRunCache<CpuLevels> cpus;
+    const auto lookup = [this](CpuId id) -> CpuLevels& {
+        auto& levels = m_cpus.try_emplace(id).first->second;
+        if (levels.levels.empty())
+            levels.levels.resize(m_widths.size());
+        return levels;
+    };
+
+    for (const auto& sample : samples) {
+        auto& cpu = cpus.at(sample.cpu, lookup);
+
+        if (cpu.last && cpu.last->pid != 0 && prolongs_slice(*cpu.last, sample))
+            attribute(cpu, sample, cpu.last->time, sample.time);
+        // Buckets of idle periods exist too.
+        (void)bucket_at(cpu, 0, bucket_number(sample.time, m_widths[0]));
+        cpu.last = sample;
+    }
+}
+
+std::size_t
+TimelinePyramid::evict_before(TimePoint cutoff) {
+    std::size_t num_evicted = 0;
+    for (auto& [cpu, cpu_levels] : m_cpus)
+        for (std::size_t level = 0; level < m_widths.size(); ++level) {
+            auto& [first, buckets, candidates, candidates_of] = cpu_levels.levels[level];
+            // Buckets ending at or before the cutoff.
+            const auto cut = bucket_number(cutoff, m_widths[level]);
+            const auto num_dropped = cut > first ? std::min<std::uint64_t>(cut - first, buckets.size()) : 0;
+            buckets.erase(buckets.begin(), buckets.begin() + static_cast<std::ptrdiff_t>(num_dropped));
+            first += num_dropped;
+            if (buckets.empty())
+                candidates.clear();
+            if (level == 0)
+                num_evicted += num_dropped;
+        }
+    return num_evicted;
+}
+
+LodView
+TimelinePyramid::view(CpuId cpu, TimePoint from, TimePoint to, std::size_t max_buckets) const {
+    auto it = m_cpus.find(cpu);
+    if (it == m_cpus.end() || from > to)
+        return {};
+
+    std::size_t level = 0;
+    const auto num_buckets = [&](std::size_t lvl) {
+        return bucket_number(to, m_widths[lvl]) - bucket_number(from, m_widths[lvl]) + 1;
+    };
+    while (level + 1 < m_widths.size() && num_buckets(level) > max_buckets)
+        ++level;
+
+    const auto width = m_widths[level];
+    const auto& [first, buckets, candidates, candidates_of] = it->second.levels[level];
+    const auto begin = std::max(bucket_number(from, width), first);
+    const auto end = std::min(bucket_number(to, width) + 1, first + buckets.size());
+    if (begin >= end)
+        return {.width = width, .buckets = {}};
+    return {.begin = width * static_cast<TimePoint::rep>(begin),
+            .width = width,
+            .buckets = std::span{buckets}.subspan(begin - first, end - begin)};
+}
+
+std::vector<CpuId>
+TimelinePyramid::cpus() const {
+    std::vector<CpuId> cpus;
+    cpus.reserve(m_cpus.size());
+    for (const auto& [cpu, levels] : m_cpus)
+        cpus.push_back(cpu);
+    return cpus;
+}
+
+TimelinePyramid
+gen_timeline_pyramid(const CpuSamplingResult& result, const LodConfig& config) {
+    TimelinePyramid pyramid{config};
+    pyramid.add(result.samples);
+    return pyramid;
+}
+} // namespace elphi::view
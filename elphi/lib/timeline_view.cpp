@@ -1,43 +1,237 @@
+#include <algorithm>
+
 #include <fmt/format.h>
 
 #include <elphi/timeline_view.hpp>
 
 
 namespace elphi::view {
+
 namespace {
+/*******************************************************************************
+ * @brief Whether @p sample continues execution of @p slice .
+ ******************************************************************************/
+bool
+continues(const ThreadTimeSlice& slice, const CpuSample& sample) noexcept {
+    return slice.pid == sample.pid && slice.tid == sample.tid && slice.cgroup == sample.cgroup;
+}
+
+/*******************************************************************************
+ * @brief Create slice of a single @p sample of process named @p name .
+ ******************************************************************************/
+ThreadTimeSlice
+start_slice(const CpuSample& sample, NameId name) noexcept {
+    return ThreadTimeSlice{
+        .begin_time = sample.time,
+        .end_time = sample.time,
+        .name = name,
+        .pid = sample.pid,
+        .tid = sample.tid,
+        .cpu = sample.cpu,
+        .cgroup = sample.cgroup,
+    };
+}
+
+/*******************************************************************************
+ * @brief Whether @p sample starts a new slice even if it continues the last one.
+ ******************************************************************************/
+bool
+starts_slice(const CpuSample& sample) noexcept {
+    return sample.kind == SampleKind::switch_in;
+}
+
+/*******************************************************************************
+ * @brief Whether no sample can prolong the slice after @p sample .
+ ******************************************************************************/
+bool
+ends_slice(const CpuSample& sample) noexcept {
+    return sample.kind == SampleKind::switch_out;
+}
 
 /*******************************************************************************
- * @brief Resolve process name or returns "UNKNOWN".
+ * @brief Prolong @p slice by @p sample which continues it.
  ******************************************************************************/
-std::string
-resolve_name(const CpuSamplingResult& result, ProcId pid) {
-    auto it = result.process_names.find(pid);
-    return it == result.process_names.end() ? "UNKNOWN" : it->second;
+void
+extend_slice(ThreadTimeSlice& slice, const CpuSample& sample) noexcept {
+    slice.end_time = sample.time;
 }
 } // namespace
 
-Timeline
-gen_cpu_timelines(const CpuSamplingResult& result) {
+bool
+prolongs_slice(const CpuSample& last, const CpuSample& sample) noexcept {
+    return !ends_slice(last) && !starts_slice(sample) && last.pid == sample.pid && last.tid == sample.tid &&
+           last.cgroup == sample.cgroup;
+}
 
-    Timeline timeline;
+std::optional<std::uint64_t>
+counter_value(const CounterValues& values, std::span<const Counter> counters, Counter counter) noexcept {
+    auto it = std::ranges::find(counters, counter);
+    const auto index = static_cast<std::size_t>(it - counters.begin());
+    if (it == counters.end() || index >= c_max_counters)
+        return std::nullopt;
+    return values[index];
+}
 
-    for (const auto& sample : result.samples) {
-        auto& cpu_timeline = timeline.try_emplace(sample.cpu).first->second;
+std::optional<double>
+slice_ipc(const CounterValues& values, std::span<const Counter> counters) noexcept {
+    const auto instructions = counter_value(values, counters, Counter::instructions);
+    const auto cycles = counter_value(values, counters, Counter::cycles);
+    if (!instructions || !cycles || *cycles == 0)
+        return std::nullopt;
+    return static_cast<double>(*instructions) / static_cast<double>(*cycles);
+}
+
+TimelineBuilder::TimelineBuilder(std::unordered_map<ProcId, NameId> process_names) :
+    m_names(std::move(process_names)) {}
+
+void
+TimelineBuilder::set_process_name(ProcId pid, NameId name) {
+    m_names.insert_or_assign(pid, name);
+}
+
+NameId
+TimelineBuilder::resolve_name(ProcId pid) const {
+    auto it = m_names.find(pid);
+    return it == m_names.end() ? c_unknown_name : it->second;
+}
+
+void
+TimelineBuilder::add(std::span<const CpuSample> samples) {
+    CpuRunCache<CpuSlices> cpus;
+    const auto lookup = [this](CpuId cpu) -> CpuSlices& {
+        auto it = m_cpus.find(cpu);
+        if (it == m_cpus.end()) {
+            CpuSlices slices{.slices = SegmentedVector<ThreadTimeSlice>{m_pool}, .open = false};
+            it = m_cpus.try_emplace(cpu, std::move(slices)).first;
+        }
+        return it->second;
+    };
+
+    for (const auto& sample : samples) {
+        auto& cpu_slices = cpus.at(sample.cpu, lookup);
+        auto& cpu_timeline = cpu_slices.slices;
 
         // Different execution context -> new slice.
-        if (cpu_timeline.empty() || cpu_timeline.back().pid != sample.pid || cpu_timeline.back().tid != sample.tid) {
-            cpu_timeline.push_back(ThreadTimeSlice{
-                .begin_time = sample.time,
-                .end_time = sample.time,
-                .name = resolve_name(result, sample.pid),
-                .pid = sample.pid,
-                .tid = sample.tid,
-                .cpu = sample.cpu,
-            });
+        if (!cpu_slices.open || starts_slice(sample) || !continues(cpu_timeline.back(), sample)) {
+            cpu_timeline.push_back(start_slice(sample, resolve_name(sample.pid)));
         } else {
             // Prolong the current slice by this sample.
-            cpu_timeline.back().end_time = sample.time;
+            extend_slice(cpu_timeline.back(), sample);
+        }
+        cpu_slices.open = !ends_slice(sample);
+    }
+}
+
+std::size_t
+TimelineBuilder::evict_before(TimePoint cutoff) {
+    std::size_t num_evicted = 0;
+    for (auto& [cpu, cpu_slices] : m_cpus) {
+        auto& [slices, open] = cpu_slices;
+        // Slices are ordered by time.
+        auto it = std::ranges::partition_point(slices, [cutoff](const auto& slice) { return slice.end_time < cutoff; });
+        const auto num = static_cast<std::size_t>(it - slices.begin());
+        // Whole evicted blocks return to the pool, no slices are moved.
+        slices.pop_front(num);
+        num_evicted += num;
+        open = open && !slices.empty();
+    }
+    return num_evicted;
+}
+
+const SegmentedVector<ThreadTimeSlice>&
+TimelineBuilder::cpu_timeline(CpuId cpu) const {
+    static const SegmentedVector<ThreadTimeSlice> c_empty;
+    auto it = m_cpus.find(cpu);
+    return it == m_cpus.end() ? c_empty : it->second.slices;
+}
+
+std::vector<CpuId>
+TimelineBuilder::cpus() const {
+    std::vector<CpuId> cpus;
+    cpus.reserve(m_cpus.size());
+    for (const auto& [cpu, slices] : m_cpus)
+        cpus.push_back(cpu);
+    return cpus;
+}
+
+Timeline
+TimelineBuilder::timeline() const {
+    Timeline timeline;
+    for (const auto& [cpu, cpu_slices] : m_cpus) {
+        auto& slices = timeline[cpu];
+        slices.reserve(cpu_slices.slices.size());
+        cpu_slices.slices.for_each_segment([&slices](std::span<const ThreadTimeSlice> segment) {
+            slices.insert(slices.end(), segment.begin(), segment.end());
+        });
+    }
+    return timeline;
+}
+
+Timeline
+TimelineBuilder::take_timeline() {
+    Timeline timeline;
+    for (auto& [cpu, cpu_slices] : m_cpus)
+        cpu_slices.slices.move_to(timeline[cpu]);
+    m_cpus.clear();
+    return timeline;
+}
+
+Timeline
+gen_cpu_timelines(const CpuSamplingResult& result) {
+    TimelineBuilder builder{result.process_names};
+    builder.add(result.samples);
+    return builder.take_timeline();
+}
+
+GroupTimeline
+gen_group_timelines(const CpuSamplingResult& result) {
+    const auto resolve_name = [&result](ProcId pid) {
+        auto it = result.process_names.find(pid);
+        return it == result.process_names.end() ? c_unknown_name : it->second;
+    };
+
+    GroupTimeline groups;
+    // Timeline holding the last slice of each CPU, map nodes are stable.
+    std::unordered_map<CpuId, CpuTimeline*> open_slices;
+    CpuRunCache<CpuTimeline*> cpus;
+    const auto lookup = [&open_slices](CpuId cpu) -> CpuTimeline*& {
+        return open_slices.try_emplace(cpu, nullptr).first->second;
+    };
+
+    for (const auto& sample : result.samples) {
+        auto& open = cpus.at(sample.cpu, lookup);
+        if (open != nullptr && !starts_slice(sample) && continues(open->back(), sample)) {
+            extend_slice(open->back(), sample);
+        } else {
+            // Slices of other groups in between keep this one closed.
+            open = &groups[sample.cgroup][sample.cpu];
+            open->push_back(start_slice(sample, resolve_name(sample.pid)));
         }
+        if (ends_slice(sample))
+            open = nullptr;
+    }
+    return groups;
+}
+
+CounterTimeline
+gen_counter_timelines(const CpuSamplingResult& result) {
+    CounterTimeline timeline;
+    if (result.counter_values.size() != result.samples.size())
+        return timeline;
+
+    // Last sample of each CPU, slices follow the rule of the timeline.
+    std::unordered_map<CpuId, const CpuSample*> last_samples;
+    for (std::size_t i = 0; i < result.samples.size(); ++i) {
+        const auto& sample = result.samples[i];
+        const auto& values = result.counter_values[i];
+        auto& last = last_samples.try_emplace(sample.cpu, nullptr).first->second;
+        auto& counters = timeline[sample.cpu];
+        if (last == nullptr || !prolongs_slice(*last, sample))
+            counters.push_back(values);
+        else
+            for (std::size_t c = 0; c < c_max_counters; ++c)
+                counters.back()[c] += values[c];
+        last = &sample;
     }
     return timeline;
 }
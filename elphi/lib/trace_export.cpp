@@ -0,0 +1,441 @@
+/*******************************************************************************
+ * @file trace_export.cpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license	This file is released under ElPhi project's license, see LICENSE.
+ ******************************************************************************/
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+
+#include <fcntl.h>
+#include <fmt/format.h>
+#include <unistd.h>
+
+#include <elphi/exception.hpp>
+#include <elphi/trace_export.hpp>
+
+namespace elphi::view {
+
+namespace {
+
+/*! Start of the JSON trace up to the first event. */
+constexpr std::string_view c_json_header = "{\"traceEvents\":[\n"
+                                           R"({"ph":"M","name":"process_name","pid":0,"args":{"name":"CPUs"}})";
+/*! End of the JSON trace after the last event. */
+constexpr std::string_view c_json_footer = "\n],\"displayTimeUnit\":\"ns\"}\n";
+
+/*! Protobuf wire types. */
+enum class WireType : std::uint32_t { varint = 0, bytes = 2 };
+
+/*! Fields of the Perfetto messages, see perfetto/trace/trace_packet.proto. */
+namespace field {
+constexpr std::uint32_t c_trace_packet = 1;
+constexpr std::uint32_t c_packet_timestamp = 8;
+constexpr std::uint32_t c_packet_sequence_id = 10;
+constexpr std::uint32_t c_packet_track_event = 11;
+constexpr std::uint32_t c_packet_interned_data = 12;
+constexpr std::uint32_t c_packet_sequence_flags = 13;
+constexpr std::uint32_t c_packet_track_descriptor = 60;
+constexpr std::uint32_t c_interned_event_names = 2;
+constexpr std::uint32_t c_event_name_iid = 1;
+constexpr std::uint32_t c_event_name_name = 2;
+constexpr std::uint32_t c_track_uuid = 1;
+constexpr std::uint32_t c_track_name = 2;
+constexpr std::uint32_t c_event_annotations = 4;
+constexpr std::uint32_t c_event_type = 9;
+constexpr std::uint32_t c_event_name_iid_ref = 10;
+constexpr std::uint32_t c_event_track_uuid = 11;
+constexpr std::uint32_t c_annotation_int = 4;
+constexpr std::uint32_t c_annotation_name = 10;
+} // namespace field
+
+/*! The only sequence of the trace. */
+constexpr std::uint64_t c_sequence_id = 1;
+/*! TracePacket.SEQ_INCREMENTAL_STATE_CLEARED */
+constexpr std::uint64_t c_state_cleared = 1;
+/*! TracePacket.SEQ_NEEDS_INCREMENTAL_STATE */
+constexpr std::uint64_t c_needs_state = 2;
+/*! TrackEvent.TYPE_SLICE_BEGIN */
+constexpr std::uint64_t c_slice_begin = 1;
+/*! TrackEvent.TYPE_SLICE_END */
+constexpr std::uint64_t c_slice_end = 2;
+
+/*! Longest encoded key or varint. */
+constexpr std::size_t c_max_varint = 10;
+/*! Longest field apart from the content of strings and messages. */
+constexpr std::size_t c_max_field = 2 * c_max_varint;
+/*! Longest debug annotation, names are "pid" or "tid". */
+constexpr std::size_t c_max_annotation = 2 * c_max_field + 3;
+/*! Longest track event, type, track, name and two annotations. */
+constexpr std::size_t c_max_event = 5 * c_max_field + 2 * c_max_annotation;
+/*! Longest event packet, timestamp, sequence, flags and the event. */
+constexpr std::size_t c_max_event_packet = 4 * c_max_field + c_max_event;
+/*! Longest JSON event apart from its name. */
+constexpr std::size_t c_max_json_event = 256;
+
+/*******************************************************************************
+ * @brief Writes into memory reserved beforehand.
+ *
+ * Appending each piece to a vector checks its capacity, that would dominate
+ * the export. Callers reserve the most the event can take instead.
+ ******************************************************************************/
+class Output {
+public:
+    explicit Output(unsigned char* out) noexcept : m_out(out) {}
+
+    /*! End of the written bytes. */
+    unsigned char*
+    end() const noexcept {
+        return m_out;
+    }
+
+    /*! Write @p bytes as they are. */
+    void
+    raw(std::span<const unsigned char> bytes) noexcept {
+        std::memcpy(m_out, bytes.data(), bytes.size());
+        m_out += bytes.size();
+    }
+
+    /*! Write characters of @p str as they are. */
+    void
+    raw(std::string_view str) noexcept {
+        std::memcpy(m_out, str.data(), str.size());
+        m_out += str.size();
+    }
+
+    /*! Write decimal @p value . */
+    void
+    decimal(std::uint64_t value) noexcept {
+        const fmt::format_int str{value};
+        raw({str.data(), str.size()});
+    }
+
+    /*! Write @p time in microseconds with nanosecond precision. */
+    void
+    micros(TimePoint time) noexcept {
+        auto nanos = static_cast<std::uint64_t>(time.count());
+        if (time < TimePoint::zero()) {
+            *m_out++ = '-';
+            nanos = 0 - nanos;
+        }
+        decimal(nanos / 1000);
+        const auto fraction = nanos % 1000;
+        *m_out++ = '.';
+        *m_out++ = static_cast<unsigned char>('0' + fraction / 100);
+        *m_out++ = static_cast<unsigned char>('0' + fraction / 10 % 10);
+        *m_out++ = static_cast<unsigned char>('0' + fraction % 10);
+    }
+
+    /*! Write @p str quoted and escaped, at most `6 * size + 2` bytes. */
+    void
+    json_string(std::string_view str) noexcept {
+        constexpr std::string_view c_hex = "0123456789abcdef";
+        *m_out++ = '"';
+        for (const char c : str) {
+            const auto byte = static_cast<unsigned char>(c);
+            if (c == '"' || c == '\\') {
+                *m_out++ = '\\';
+                *m_out++ = byte;
+            } else if (byte < 0x20) {
+                raw("\\u00");
+                *m_out++ = static_cast<unsigned char>(c_hex[byte >> 4U]);
+                *m_out++ = static_cast<unsigned char>(c_hex[byte & 0xFU]);
+            } else {
+                *m_out++ = byte;
+            }
+        }
+        *m_out++ = '"';
+    }
+
+    /*! Write LEB128 encoded @p value . */
+    void
+    varint(std::uint64_t value) noexcept {
+        for (; value >= 0x80; value >>= 7)
+            *m_out++ = static_cast<unsigned char>(value | 0x80);
+        *m_out++ = static_cast<unsigned char>(value);
+    }
+
+    /*! Write integer @p field . */
+    void
+    uint(std::uint32_t field, std::uint64_t value) noexcept {
+        key(field, WireType::varint);
+        varint(value);
+    }
+
+    /*! Write string or message @p field . */
+    void
+    bytes(std::uint32_t field, std::span<const unsigned char> bytes) noexcept {
+        key(field, WireType::bytes);
+        varint(bytes.size());
+        raw(bytes);
+    }
+
+    /*! Write string @p field . */
+    void
+    string(std::uint32_t field, std::string_view str) noexcept {
+        key(field, WireType::bytes);
+        varint(str.size());
+        raw(str);
+    }
+
+private:
+    /*! Write key of @p field of @p type . */
+    void
+    key(std::uint32_t field, WireType type) noexcept {
+        varint((static_cast<std::uint64_t>(field) << 3U) | static_cast<std::uint32_t>(type));
+    }
+
+    /*! Next byte to write. */
+    unsigned char* m_out;
+};
+
+/*******************************************************************************
+ * @brief Append at most @p max_size bytes written by @p encode to @p dest .
+ *
+ * @param encode Called as `encode(Output&)`.
+ ******************************************************************************/
+template <typename Encode>
+void
+append(Buffer& dest, std::size_t max_size, Encode&& encode) {
+    const auto size = dest.size();
+    dest.resize(size + max_size);
+    Output out{dest.data() + size};
+    encode(out);
+    dest.resize(static_cast<std::size_t>(out.end() - dest.data()));
+}
+
+/*******************************************************************************
+ * @brief Message of at most @p N bytes encoded on the stack.
+ ******************************************************************************/
+template <std::size_t N>
+class Message {
+public:
+    /*******************************************************************************
+     * @brief Encode message by @p encode called as `encode(Output&)`.
+     ******************************************************************************/
+    template <typename Encode>
+    explicit Message(Encode&& encode) noexcept {
+        Output out{m_bytes.data()};
+        encode(out);
+        m_size = static_cast<std::size_t>(out.end() - m_bytes.data());
+    }
+
+    /*! Encoded message. */
+    std::span<const unsigned char>
+    bytes() const noexcept {
+        return {m_bytes.data(), m_size};
+    }
+
+private:
+    /*! Encoded message, the rest is uninitialized. */
+    std::array<unsigned char, N> m_bytes;
+    /*! Length of the message. */
+    std::size_t m_size;
+};
+
+/*******************************************************************************
+ * @brief Debug annotation @p name = @p value of a track event.
+ ******************************************************************************/
+Message<c_max_annotation>
+annotation(std::string_view name, std::uint64_t value) noexcept {
+    return Message<c_max_annotation>{[&](Output& out) {
+        out.string(field::c_annotation_name, name);
+        out.uint(field::c_annotation_int, value);
+    }};
+}
+
+/*******************************************************************************
+ * @brief Append trace packet of @p fields to @p dest .
+ ******************************************************************************/
+void
+put_packet(Buffer& dest, std::span<const unsigned char> fields) {
+    append(dest, c_max_field + fields.size(), [&](Output& out) { out.bytes(field::c_trace_packet, fields); });
+}
+} // namespace
+
+TraceWriter::TraceWriter(const std::string& path, TraceFormat format) :
+    m_fd(::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)), m_format(format) {
+    if (!m_fd.is_opened() || m_fd.raw() == -1)
+        throw ElphiException(fmt::format("Cannot open trace '{}', reason: {}", path, strerror(errno)));
+
+    // Flushed once it holds c_flush_size, a slice more fits without reallocating.
+    m_buffer.reserve(c_flush_size * 2);
+    if (m_format == TraceFormat::chrome_json) {
+        append(m_buffer, c_json_header.size(), [](Output& out) { out.raw(c_json_header); });
+    } else {
+        const Message<2 * c_max_field> packet{[](Output& out) {
+            out.uint(field::c_packet_sequence_id, c_sequence_id);
+            out.uint(field::c_packet_sequence_flags, c_state_cleared);
+        }};
+        put_packet(m_buffer, packet.bytes());
+    }
+}
+
+TraceWriter::~TraceWriter() {
+    try {
+        close();
+    } catch (...) { // NOLINT - nothing to do about the error now.
+    }
+}
+
+void
+TraceWriter::write(std::span<const ThreadTimeSlice> slices, const StringTable& names) {
+    for (const auto& slice : slices) {
+        put_track(slice.cpu);
+        if (m_format == TraceFormat::chrome_json)
+            put_json_slice(slice, names);
+        else
+            put_perfetto_slice(slice, names);
+        if (m_buffer.size() >= c_flush_size)
+            flush();
+    }
+}
+
+void
+TraceWriter::close() {
+    if (!m_fd.is_opened())
+        return;
+
+    if (m_format == TraceFormat::chrome_json)
+        append(m_buffer, c_json_footer.size(), [](Output& out) { out.raw(c_json_footer); });
+    flush();
+    m_fd.close();
+}
+
+void
+TraceWriter::put_track(CpuId cpu) {
+    if (!m_tracks.insert(cpu).second)
+        return;
+
+    if (m_format == TraceFormat::chrome_json) {
+        fmt::format_to(std::back_inserter(m_buffer),
+                       ",\n"
+                       R"({{"ph":"M","name":"thread_name","pid":0,"tid":{0},"args":{{"name":"CPU {0}"}}}},)"
+                       "\n"
+                       R"({{"ph":"M","name":"thread_sort_index","pid":0,"tid":{0},"args":{{"sort_index":{0}}}}})",
+                       cpu);
+        return;
+    }
+
+    const auto name = fmt::format("CPU {}", cpu);
+    Buffer descriptor;
+    append(descriptor, 2 * c_max_field + name.size(), [&](Output& out) {
+        // Zero is not a valid UUID.
+        out.uint(field::c_track_uuid, cpu + 1);
+        out.string(field::c_track_name, name);
+    });
+    Buffer packet;
+    append(packet, 2 * c_max_field + descriptor.size(), [&](Output& out) {
+        out.uint(field::c_packet_sequence_id, c_sequence_id);
+        out.bytes(field::c_packet_track_descriptor, descriptor);
+    });
+    put_packet(m_buffer, packet);
+}
+
+void
+TraceWriter::put_json_slice(const ThreadTimeSlice& slice, const StringTable& names) {
+    const auto name = names.resolve(slice.name);
+    append(m_buffer, c_max_json_event + 6 * name.size(), [&](Output& out) {
+        // The header has an event, thus every event is preceded by a comma.
+        out.raw(",\n{\"ph\":\"X\",\"name\":");
+        out.json_string(name);
+        out.raw(R"(,"pid":0,"tid":)");
+        out.decimal(slice.cpu);
+        out.raw(R"(,"ts":)");
+        out.micros(slice.begin_time);
+        out.raw(R"(,"dur":)");
+        out.micros(slice.end_time - slice.begin_time);
+        out.raw(R"(,"args":{"pid":)");
+        out.decimal(slice.pid);
+        out.raw(R"(,"tid":)");
+        out.decimal(slice.tid);
+        out.raw("}}");
+    });
+}
+
+void
+TraceWriter::put_perfetto_slice(const ThreadTimeSlice& slice, const StringTable& names) {
+    // Names repeat a lot, each is written once and then referred to by its ID + 1, zero is not valid.
+    const auto iid = static_cast<std::uint64_t>(slice.name) + 1;
+    if (m_interned.size() <= slice.name)
+        m_interned.resize(slice.name + 1, false);
+    if (!m_interned[slice.name]) {
+        m_interned[slice.name] = true;
+        const auto name = names.resolve(slice.name);
+        Buffer entry;
+        append(entry, 2 * c_max_field + name.size(), [&](Output& out) {
+            out.uint(field::c_event_name_iid, iid);
+            out.string(field::c_event_name_name, name);
+        });
+        Buffer interned;
+        append(interned, c_max_field + entry.size(),
+               [&](Output& out) { out.bytes(field::c_interned_event_names, entry); });
+        // A packet of its own, the event packets stay bounded.
+        Buffer packet;
+        append(packet, 3 * c_max_field + interned.size(), [&](Output& out) {
+            out.uint(field::c_packet_sequence_id, c_sequence_id);
+            out.uint(field::c_packet_sequence_flags, c_needs_state);
+            out.bytes(field::c_packet_interned_data, interned);
+        });
+        put_packet(m_buffer, packet);
+    }
+
+    const auto track = static_cast<std::uint64_t>(slice.cpu) + 1;
+    const auto put_event = [&](TimePoint time, std::span<const unsigned char> event) {
+        const Message<c_max_event_packet> packet{[&](Output& out) {
+            out.uint(field::c_packet_timestamp, static_cast<std::uint64_t>(time.count()));
+            out.uint(field::c_packet_sequence_id, c_sequence_id);
+            out.uint(field::c_packet_sequence_flags, c_needs_state);
+            out.bytes(field::c_packet_track_event, event);
+        }};
+        put_packet(m_buffer, packet.bytes());
+    };
+
+    const auto pid = annotation("pid", slice.pid);
+    const auto tid = annotation("tid", slice.tid);
+    const Message<c_max_event> begin{[&](Output& out) {
+        out.uint(field::c_event_type, c_slice_begin);
+        out.uint(field::c_event_track_uuid, track);
+        out.uint(field::c_event_name_iid_ref, iid);
+        out.bytes(field::c_event_annotations, pid.bytes());
+        out.bytes(field::c_event_annotations, tid.bytes());
+    }};
+    put_event(slice.begin_time, begin.bytes());
+
+    const Message<c_max_event> end{[&](Output& out) {
+        out.uint(field::c_event_type, c_slice_end);
+        out.uint(field::c_event_track_uuid, track);
+    }};
+    put_event(slice.end_time, end.bytes());
+}
+
+void
+TraceWriter::flush() {
+    std::span<const unsigned char> bytes = m_buffer;
+    while (!bytes.empty()) {
+        auto written = ::write(m_fd.raw(), bytes.data(), bytes.size());
+        if (written == -1 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            throw ElphiException(fmt::format("Cannot write trace, reason: {}", strerror(errno)));
+        bytes = bytes.subspan(static_cast<std::size_t>(written));
+    }
+    m_buffer.clear();
+}
+
+void
+export_trace(const Timeline& timeline, const StringTable& names, const std::string& path, TraceFormat format) {
+    std::vector<CpuId> cpus;
+    cpus.reserve(timeline.size());
+    for (const auto& [cpu, slices] : timeline)
+        cpus.push_back(cpu);
+    std::ranges::sort(cpus);
+
+    TraceWriter writer{path, format};
+    for (const auto cpu : cpus)
+        writer.write(timeline.at(cpu), names);
+    writer.close();
+}
+} // namespace elphi::view
@@ -0,0 +1,222 @@
+/*******************************************************************************
+ * @file usage.cpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license	This file is released under ElPhi project's license, see LICENSE.
+ ******************************************************************************/
+#include <algorithm>
+#include <bit>
+#include <unordered_map>
+
+#include <fmt/format.h>
+
+#include <elphi/exception.hpp>
+#include <elphi/timeline_view.hpp>
+#include <elphi/usage.hpp>
+
+namespace elphi::view {
+
+namespace {
+/*******************************************************************************
+ * @brief Hash of thread @p tid of process @p pid .
+ ******************************************************************************/
+std::size_t
+hash_thread(ProcId pid, ThreadId tid) noexcept {
+    auto key = ((std::uint64_t{pid} << 32U) | tid) * 0x9E3779B97F4A7C15ULL;
+    // Fold the well-mixed high bits into the masked low ones.
+    return static_cast<std::size_t>(key ^ (key >> 32U));
+}
+
+/*******************************************************************************
+ * @brief Up to @p k of @p usages with the most time, most first.
+ *
+ * @param id Returns key of a usage ordering the ties.
+ ******************************************************************************/
+template <typename Usage, typename Id>
+std::vector<Usage>
+top_of(std::vector<Usage> usages, std::size_t k, Id id) {
+    const auto most = [&id](const Usage& lhs, const Usage& rhs) {
+        return lhs.time != rhs.time ? lhs.time > rhs.time : id(lhs) < id(rhs);
+    };
+    k = std::min(k, usages.size());
+    std::ranges::partial_sort(usages, usages.begin() + static_cast<std::ptrdiff_t>(k), most);
+    usages.resize(k);
+    return usages;
+}
+} // namespace
+
+UsageAggregator::UsageAggregator() : UsageAggregator(UsageConfig{}) {}
+
+UsageAggregator::UsageAggregator(const UsageConfig& config) :
+    m_width(config.bucket_width), m_num_buckets(config.num_buckets) {
+    if (m_width <= TimePoint::zero() || m_num_buckets == 0)
+        throw ElphiException(fmt::format("Invalid usage window of {} buckets of {}ns", m_num_buckets, m_width.count()));
+
+    const auto num_slots = std::bit_ceil(std::max<std::size_t>(config.capacity, 1) * 2);
+    m_slots.resize(num_slots);
+    m_buckets.resize(num_slots * m_num_buckets);
+    m_spare_slots.resize(num_slots);
+    m_spare_buckets.resize(num_slots * m_num_buckets);
+}
+
+std::size_t
+UsageAggregator::probe(std::span<const Slot> slots, ProcId pid, ThreadId tid) const noexcept {
+    const auto mask = slots.size() - 1;
+    auto index = hash_thread(pid, tid) & mask;
+    while (slots[index].pid != 0 && (slots[index].pid != pid || slots[index].tid != tid))
+        index = (index + 1) & mask;
+    return index;
+}
+
+std::size_t
+UsageAggregator::slot_of(ProcId pid, ThreadId tid) {
+    auto index = probe(m_slots, pid, tid);
+    if (m_slots[index].pid != 0)
+        return index;
+
+    if ((m_size + 1) * 2 > m_slots.size()) {
+        rehash(m_slots.size() * 2);
+        index = probe(m_slots, pid, tid);
+    }
+    m_slots[index].pid = pid;
+    m_slots[index].tid = tid;
+    ++m_size;
+    return index;
+}
+
+void
+UsageAggregator::rehash(std::size_t num_slots) {
+    // Reuses the spare tables unless growing.
+    if (m_spare_slots.size() != num_slots) {
+        m_spare_slots.assign(num_slots, Slot{});
+        m_spare_buckets.assign(num_slots * m_num_buckets, TimePoint::zero());
+    } else {
+        std::ranges::fill(m_spare_slots, Slot{});
+        std::ranges::fill(m_spare_buckets, TimePoint::zero());
+    }
+
+    m_size = 0;
+    for (std::size_t i = 0; i < m_slots.size(); ++i) {
+        const auto& slot = m_slots[i];
+        if (slot.pid == 0 || slot.total == TimePoint::zero())
+            continue;
+        const auto index = probe(m_spare_slots, slot.pid, slot.tid);
+        m_spare_slots[index] = slot;
+        std::ranges::copy(std::span{m_buckets}.subspan(i * m_num_buckets, m_num_buckets),
+                          m_spare_buckets.begin() + static_cast<std::ptrdiff_t>(index * m_num_buckets));
+        ++m_size;
+    }
+    m_slots.swap(m_spare_slots);
+    m_buckets.swap(m_spare_buckets);
+}
+
+void
+UsageAggregator::advance_to(std::uint64_t number) {
+    if (!m_head) {
+        m_head = number;
+        return;
+    }
+    if (number <= *m_head)
+        return;
+
+    const auto num_leaving = std::min<std::uint64_t>(number - *m_head, m_num_buckets);
+    std::size_t num_idle = 0;
+    for (std::size_t i = 0; i < m_slots.size(); ++i) {
+        auto& slot = m_slots[i];
+        if (slot.pid == 0)
+            continue;
+        // Buckets entering the window reuse the ring entries of the leaving ones.
+        for (std::uint64_t step = 1; step <= num_leaving; ++step) {
+            auto& bucket = m_buckets[i * m_num_buckets + (*m_head + step) % m_num_buckets];
+            slot.total -= bucket;
+            bucket = TimePoint::zero();
+        }
+        num_idle += slot.total == TimePoint::zero() ? 1 : 0;
+    }
+    m_head = number;
+    if (num_idle > 0)
+        rehash(m_slots.size());
+}
+
+void
+UsageAggregator::add(std::span<const CpuSample> samples) {
+    for (const auto& sample : samples) {
+        if (sample.cpu >= m_last.size())
+            m_last.resize(sample.cpu + 1);
+        auto& last = m_last[sample.cpu];
+
+        const auto number = static_cast<std::uint64_t>(std::max(sample.time, TimePoint::zero()) / m_width);
+        advance_to(number);
+        const auto duration = last ? sample.time - last->time : TimePoint::zero();
+        // Threads in the table always have some time.
+        if (duration > TimePoint::zero() && last->pid != 0 && prolongs_slice(*last, sample) &&
+            number + m_num_buckets > *m_head) {
+            const auto index = slot_of(sample.pid, sample.tid);
+            m_slots[index].cgroup = sample.cgroup;
+            m_slots[index].total += duration;
+            m_buckets[index * m_num_buckets + number % m_num_buckets] += duration;
+        }
+        last = sample;
+    }
+}
+
+std::vector<ThreadUsage>
+UsageAggregator::top_threads(std::size_t k) const {
+    std::vector<ThreadUsage> usages;
+    usages.reserve(m_size);
+    for (const auto& slot : m_slots)
+        if (slot.pid != 0 && slot.total > TimePoint::zero())
+            usages.push_back({.pid = slot.pid, .tid = slot.tid, .cgroup = slot.cgroup, .time = slot.total});
+    return top_of(std::move(usages), k, [](const ThreadUsage& usage) { return std::pair{usage.pid, usage.tid}; });
+}
+
+std::vector<ProcessUsage>
+UsageAggregator::top_processes(std::size_t k) const {
+    std::unordered_map<ProcId, ProcessUsage> processes;
+    for (const auto& slot : m_slots)
+        if (slot.pid != 0 && slot.total > TimePoint::zero()) {
+            auto& process = processes.try_emplace(slot.pid, ProcessUsage{.pid = slot.pid}).first->second;
+            ++process.num_threads;
+            process.time += slot.total;
+        }
+
+    std::vector<ProcessUsage> usages;
+    usages.reserve(processes.size());
+    for (const auto& [pid, usage] : processes)
+        usages.push_back(usage);
+    return top_of(std::move(usages), k, [](const ProcessUsage& usage) { return usage.pid; });
+}
+
+std::vector<GroupUsage>
+UsageAggregator::top_groups(std::size_t k) const {
+    std::unordered_map<GroupId, TimePoint> groups;
+    for (const auto& slot : m_slots)
+        if (slot.pid != 0)
+            groups[slot.cgroup] += slot.total;
+
+    std::vector<GroupUsage> usages;
+    usages.reserve(groups.size());
+    for (const auto& [cgroup, time] : groups)
+        if (time > TimePoint::zero())
+            usages.push_back({.cgroup = cgroup, .time = time});
+    return top_of(std::move(usages), k, [](const GroupUsage& usage) { return usage.cgroup; });
+}
+
+TimePoint
+UsageAggregator::thread_time(ProcId pid, ThreadId tid) const noexcept {
+    const auto& slot = m_slots[probe(m_slots, pid, tid)];
+    return slot.pid != 0 ? slot.total : TimePoint::zero();
+}
+
+TimePoint
+UsageAggregator::window_begin() const noexcept {
+    if (!m_head)
+        return TimePoint::zero();
+    const auto first = *m_head + 1 > m_num_buckets ? *m_head + 1 - m_num_buckets : 0;
+    return m_width * static_cast<TimePoint::rep>(first);
+}
+
+TimePoint
+UsageAggregator::window_end() const noexcept {
+    return m_head ? m_width * static_cast<TimePoint::rep>(*m_head + 1) : TimePoint::zero();
+}
+} // namespace elphi::view
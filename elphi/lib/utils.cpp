@@ -1,4 +1,10 @@
+#include <charconv>
 #include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string_view>
+
+#include <fmt/format.h>
 
 #include <elphi/utils.hpp>
 
@@ -13,4 +19,34 @@ strerror(int err) {
     char* ret = strerror_r(err, buffer.data(), buffer.size());
     return std::string{ret};
 }
+
+std::optional<std::size_t>
+numa_node_of_cpu(std::size_t cpu) {
+    constexpr std::string_view c_prefix = "node";
+
+    // Each CPU directory contains `nodeX` link to its node.
+    std::error_code ec;
+    std::filesystem::directory_iterator it{fmt::format("/sys/devices/system/cpu/cpu{}", cpu), ec};
+    for (; !ec && it != std::filesystem::directory_iterator{}; it.increment(ec)) {
+        const auto name = it->path().filename().string();
+        if (!name.starts_with(c_prefix))
+            continue;
+
+        std::size_t node = 0;
+        const auto* begin = name.data() + c_prefix.size();
+        const auto* end = name.data() + name.size();
+        if (auto [ptr, err] = std::from_chars(begin, end, node); err == std::errc{} && ptr == end && begin != end)
+            return node;
+    }
+    return std::nullopt;
+}
+
+std::optional<std::size_t>
+perf_event_mlock_limit() {
+    std::ifstream file{"/proc/sys/kernel/perf_event_mlock_kb"};
+    std::size_t limit_kb = 0;
+    if (!(file >> limit_kb))
+        return std::nullopt;
+    return limit_kb * 1024;
+}
 } // namespace elphi
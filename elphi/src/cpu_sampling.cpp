@@ -6,13 +6,12 @@
  * Example on how to sample the system activity.
  ******************************************************************************/
 
-#include <cassert>
-#include <future>
+#include <atomic>
 #include <thread>
 
 #include <fmt/core.h>
 
-#include <elphi/cpu_sampler.hpp>
+#include <elphi/sampling_session.hpp>
 
 using namespace std::chrono_literals;
 
@@ -22,18 +21,32 @@ constexpr auto c_duration = 5000ms;
 int
 main() {
     try {
-        std::promise<elphi::CpuSamplingResult> promise;
-        auto fut = promise.get_future();
-        std::jthread sampling{[&](const auto& tok) {
-            promise.set_value(elphi::sample_cpus_sync(std::vector<elphi::CpuId>{0}, frequency, tok));
-        }};
-
+        std::atomic<std::size_t> num_samples{0};
+        elphi::CounterValues totals{};
+
+        elphi::SamplingConfig config{.cpus = {0}, .frequency = frequency};
+        config.events.counters = {elphi::Counter::cycles, elphi::Counter::instructions};
+        elphi::SamplingSession session{config};
+        session.add_sink(
+            [&num_samples](std::span<const elphi::CpuSample> samples) { num_samples += samples.size(); });
+        session.add_counter_sink([&totals](std::span<const elphi::CounterValues> values) {
+            for (const auto& counters : values)
+                for (std::size_t i = 0; i < totals.size(); ++i)
+                    totals[i] += counters[i];
+        });
+
+        session.start();
         std::this_thread::sleep_for(c_duration);
-        sampling.request_stop();
-        sampling.join();
-        auto samples = fut.get();
-
-        fmt::print("Number of samples {}\n", samples.samples.size());
+        session.stop();
+
+        fmt::print("Number of samples {}\n", num_samples.load());
+        if (session.events().counters.empty())
+            fmt::print("Hardware counters are not available\n");
+        else if (totals[0] > 0)
+            fmt::print("IPC {:.2f}\n", static_cast<double>(totals[1]) / static_cast<double>(totals[0]));
+        for (const auto& [cpu, stats] : session.ring_stats())
+            if (stats.num_lost > 0)
+                fmt::print("CPU {} lost {} records\n", cpu, stats.num_lost);
     } catch (const elphi::ElphiException& e) {
         fmt::print("EXCEPTION {}\n", e.what());
     }
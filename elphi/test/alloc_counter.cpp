@@ -0,0 +1,131 @@
+/*******************************************************************************
+ * Replacement of the global allocation functions counting the allocations.
+ ******************************************************************************/
+#include "alloc_counter.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+/*! Allocations of the thread, constant-initialized to be usable at any time. */
+constinit thread_local std::size_t t_num_allocs = 0;
+/*! Allocations of all threads. */
+constinit std::atomic<std::size_t> g_num_allocs{0};
+
+void*
+allocate(std::size_t size) noexcept {
+    ++t_num_allocs;
+    g_num_allocs.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size == 0 ? 1 : size); // NOLINT - the allocator itself.
+}
+
+void*
+allocate(std::size_t size, std::align_val_t align) noexcept {
+    ++t_num_allocs;
+    g_num_allocs.fetch_add(1, std::memory_order_relaxed);
+    const auto alignment = static_cast<std::size_t>(align);
+    // Size must be a multiple of the alignment.
+    return std::aligned_alloc(alignment, (std::max(size, alignment) + alignment - 1) / alignment * alignment);
+}
+
+void*
+allocate_or_throw(void* ptr) {
+    if (ptr == nullptr)
+        throw std::bad_alloc{};
+    return ptr;
+}
+} // namespace
+
+std::size_t
+thread_allocations() noexcept {
+    return t_num_allocs;
+}
+
+std::size_t
+process_allocations() noexcept {
+    return g_num_allocs.load(std::memory_order_relaxed);
+}
+
+// NOLINTBEGIN - replacements of the global allocation functions.
+void*
+operator new(std::size_t size) {
+    return allocate_or_throw(allocate(size));
+}
+
+void*
+operator new[](std::size_t size) {
+    return allocate_or_throw(allocate(size));
+}
+
+void*
+operator new(std::size_t size, std::align_val_t align) {
+    return allocate_or_throw(allocate(size, align));
+}
+
+void*
+operator new[](std::size_t size, std::align_val_t align) {
+    return allocate_or_throw(allocate(size, align));
+}
+
+void*
+operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+
+void*
+operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+
+void*
+operator new(std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+    return allocate(size, align);
+}
+
+void*
+operator new[](std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+    return allocate(size, align);
+}
+
+void
+operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void
+operator delete[](void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void
+operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void
+operator delete[](void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void
+operator delete(void* ptr, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+void
+operator delete[](void* ptr, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+void
+operator delete(void* ptr, std::size_t, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+void
+operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+// NOLINTEND
@@ -0,0 +1,38 @@
+/*******************************************************************************
+ * Counting of heap allocations, global operator new is replaced in tests.
+ ******************************************************************************/
+#pragma once
+
+#include <cstddef>
+
+/*******************************************************************************
+ * @brief Number of allocations made by the calling thread so far.
+ ******************************************************************************/
+std::size_t
+thread_allocations() noexcept;
+
+/*******************************************************************************
+ * @brief Number of allocations made by all threads so far.
+ ******************************************************************************/
+std::size_t
+process_allocations() noexcept;
+
+/*******************************************************************************
+ * @brief Counts allocations of the calling thread since its creation.
+ ******************************************************************************/
+class AllocCounter {
+public:
+    AllocCounter() noexcept : m_start(thread_allocations()) {}
+
+    /*******************************************************************************
+     * @brief Allocations made since the creation.
+     ******************************************************************************/
+    std::size_t
+    num_allocs() const noexcept {
+        return thread_allocations() - m_start;
+    }
+
+private:
+    /*! Allocations before the creation. */
+    std::size_t m_start;
+};
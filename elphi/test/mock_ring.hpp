@@ -0,0 +1,248 @@
+/*******************************************************************************
+ * In-memory perf_event ring buffer backed by mocked syscalls.
+ ******************************************************************************/
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+#include <linux/perf_event.h>
+#include <sys/eventfd.h>
+
+#include <elphi/cpu_sampler.hpp>
+#include <elphi/perf_events.hpp>
+#include <elphi/utils.hpp>
+
+#include "mock_syscalls.hpp"
+
+/*******************************************************************************
+ * @brief Fake event ring buffer, mmap() of any perf event returns it.
+ *
+ * Mocks perf_event_open, mmap, munmap and the perf ioctls for its lifetime,
+ * restores the real ones on destruction. Opened events are real eventfds,
+ * thus can be polled and closed, which never become readable. Records are
+ * written as the kernel would, i.e. wrapped around the end of the ring and
+ * published by a release store of data_head, thus it can be written from
+ * another thread.
+ ******************************************************************************/
+class MockRing {
+public:
+    /*! Most 64-bit words of a record written by @ref write_sample. */
+    static constexpr std::size_t c_max_sample_words = 256;
+
+    /*******************************************************************************
+     * @brief Allocate the ring and redirect the syscalls to it.
+     *
+     * @param num_pages Size of the ring buffer, without the header page.
+     ******************************************************************************/
+    explicit MockRing(std::size_t num_pages) : m_storage((num_pages + 1) * elphi::c_page_size) {
+        SysMock::set_perf_event_clbk([this](const auto&...) {
+            m_num_opened.fetch_add(1, std::memory_order_relaxed);
+            return eventfd(0, EFD_CLOEXEC);
+        });
+        SysMock::set_mmap_clbk([this](void*, std::size_t len, auto&&...) {
+            if (len > m_storage.size()) {
+                errno = ENOMEM;
+                return MAP_FAILED;
+            }
+            return static_cast<void*>(m_storage.data());
+        });
+        SysMock::set_munmap_clbk([](const auto&...) { return 0; });
+        SysMock::set_perf_ioctl_clbk([this](int, unsigned long request) { // NOLINT - unsigned long on purpose.
+            if (request == PERF_EVENT_IOC_ENABLE)
+                m_enabled.store(true, std::memory_order_release);
+            else if (request == PERF_EVENT_IOC_DISABLE)
+                m_enabled.store(false, std::memory_order_release);
+            return 0;
+        });
+    }
+
+    MockRing(const MockRing&) = delete;
+    MockRing(MockRing&&) = delete;
+    MockRing&
+    operator=(const MockRing&) = delete;
+    MockRing&
+    operator=(MockRing&&) = delete;
+
+    ~MockRing() {
+        for (const auto* syscall : {"perf_event", "mmap", "munmap", "perf_ioctl"})
+            SysMock::use_real_syscall(syscall);
+    }
+
+    /*******************************************************************************
+     * @brief Open events over this ring.
+     ******************************************************************************/
+    elphi::PerfEvents
+    open_events() {
+        return elphi::PerfEvents{perf_event_attr{}, -1, 0, -1, 0, num_pages()};
+    }
+
+    /*******************************************************************************
+     * @brief Append a record at the head, publish it if @p publish .
+     *
+     * @param type Record type.
+     * @param payload Record bytes without the header.
+     * @param publish Whether to move the head past the record.
+     ******************************************************************************/
+    void
+    write(std::uint32_t type, std::span<const unsigned char> payload, bool publish = true) {
+        const perf_event_header header{.type = type,
+                                       .misc = 0,
+                                       .size = static_cast<std::uint16_t>(sizeof(header) + payload.size())};
+        write_wrapped(m_write_pos, {reinterpret_cast<const unsigned char*>(&header), sizeof(header)});
+        write_wrapped(m_write_pos + sizeof(header), payload);
+        m_write_pos += header.size;
+        if (publish)
+            set_head(m_write_pos);
+    }
+
+    /*******************************************************************************
+     * @brief Append a record holding the POD @p value .
+     ******************************************************************************/
+    template <typename T>
+    void
+    write_pod(std::uint32_t type, const T& value, bool publish = true) {
+        write(type, {reinterpret_cast<const unsigned char*>(&value), sizeof(value)}, publish);
+    }
+
+    /*******************************************************************************
+     * @brief Append a sample record of @p sample with fields @p sample_type .
+     *
+     * Never allocates, thus can stand in for the kernel in allocation tests.
+     *
+     * @param sample_type @ref elphi::c_sample_type optionally with
+     *  PERF_SAMPLE_READ, PERF_SAMPLE_CALLCHAIN and PERF_SAMPLE_CGROUP.
+     * @param counters Totals of the group members read after the sampled event.
+     * @param callchain User-space frames from the innermost one.
+     ******************************************************************************/
+    void
+    write_sample(std::uint64_t sample_type, const elphi::CpuSample& sample,
+                 std::span<const std::uint64_t> counters = {}, std::span<const std::uint64_t> callchain = {}) {
+        std::array<std::uint64_t, c_max_sample_words> words{};
+        std::size_t num = 0;
+        // Pairs of 32-bit fields, the first one in the lower half.
+        words[num++] = sample.pid | (std::uint64_t{sample.tid} << 32U);
+        words[num++] = static_cast<std::uint64_t>(sample.time.count());
+        words[num++] = 0; // addr
+        words[num++] = sample.cpu;
+        if ((sample_type & PERF_SAMPLE_READ) != 0) {
+            words[num++] = 1 + counters.size();
+            words[num++] = 0; // The sampled event.
+            for (auto value : counters)
+                words[num++] = value;
+        }
+        if ((sample_type & PERF_SAMPLE_CALLCHAIN) != 0) {
+            const auto frames = callchain.first(std::min(callchain.size(), c_max_sample_words - num - 3));
+            words[num++] = 1 + frames.size();
+            words[num++] = PERF_CONTEXT_USER;
+            for (auto ip : frames)
+                words[num++] = ip;
+        }
+        if ((sample_type & PERF_SAMPLE_CGROUP) != 0)
+            words[num++] = sample.cgroup;
+        write(PERF_RECORD_SAMPLE, {reinterpret_cast<const unsigned char*>(words.data()), num * sizeof(words[0])});
+    }
+
+    /*******************************************************************************
+     * @brief Start the empty ring at non-zero @p offset .
+     ******************************************************************************/
+    void
+    reset_to(std::uint64_t offset) {
+        m_write_pos = offset;
+        set_head(offset);
+        set_tail(offset);
+    }
+
+    /*******************************************************************************
+     * @brief Mark records from @p tail on as unread again, e.g. to replay them.
+     ******************************************************************************/
+    void
+    rewind(std::uint64_t tail) {
+        set_tail(tail);
+    }
+
+    /*! Current data_head. */
+    std::uint64_t
+    head() {
+        return elphi::load_acquire(page().data_head);
+    }
+
+    /*! Current data_tail. */
+    std::uint64_t
+    tail() {
+        return elphi::load_acquire(page().data_tail);
+    }
+
+    /*! Bytes which can be written without overwriting unread records. */
+    std::size_t
+    free_space() {
+        return m_storage.size() - elphi::c_page_size - (m_write_pos - tail());
+    }
+
+    /*! Size of the ring without the header page. */
+    std::size_t
+    num_pages() const {
+        return m_storage.size() / elphi::c_page_size - 1;
+    }
+
+    /*! Number of events opened so far. */
+    std::size_t
+    num_opened() const {
+        return m_num_opened.load(std::memory_order_relaxed);
+    }
+
+    /*! Whether the events were enabled last, rather than disabled. */
+    bool
+    enabled() const {
+        return m_enabled.load(std::memory_order_acquire);
+    }
+
+private:
+    perf_event_mmap_page&
+    page() {
+        return *elphi::type_pune<perf_event_mmap_page>(m_storage.data());
+    }
+
+    /*! Publish records up to @p head , as the kernel does. */
+    void
+    set_head(std::uint64_t head) {
+        elphi::store_release(page().data_head, head);
+    }
+
+    void
+    set_tail(std::uint64_t tail) {
+        elphi::store_release(page().data_tail, tail);
+    }
+
+    void
+    write_wrapped(std::uint64_t offset, std::span<const unsigned char> bytes) {
+        auto ring = std::span{m_storage}.subspan(elphi::c_page_size);
+        for (std::size_t i = 0; i < bytes.size(); ++i)
+            ring[(offset + i) % ring.size()] = bytes[i];
+    }
+
+    elphi::Buffer m_storage;
+    std::uint64_t m_write_pos{0};
+    std::atomic<std::size_t> m_num_opened{0};
+    std::atomic<bool> m_enabled{false};
+};
+
+/*******************************************************************************
+ * @brief Sampling of CPU 0 whose events all map the same single-page @ref MockRing.
+ ******************************************************************************/
+inline elphi::SamplingConfig
+mock_ring_config() {
+    elphi::SamplingConfig config{.cpus = {0}, .frequency = 100};
+    config.pin_readers = false;
+    // Ring of a single page, rings below the watermark are swept every 10ms.
+    config.rings.memory_budget = elphi::c_page_size;
+    config.rings.drain_latency = std::chrono::milliseconds(20);
+    return config;
+}
@@ -76,6 +76,20 @@ __wrap_open_perf_event(const perf_event_attr& attr, pid_t pid, int cpu, int grou
     return SysMock::perf_event_clbk(attr, pid, cpu, group_fd, flags);
 }
 
+extern "C" int // NOLINTNEXTLINE - unsigned long on purpose.
+__real_control_perf_event(int fd, unsigned long request);
+
+extern "C" int // NOLINTNEXTLINE - unsigned long on purpose.
+__wrap_control_perf_event(int fd, unsigned long request) {
+    if (SysMock::real_syscall["perf_ioctl"])
+        return __real_control_perf_event(fd, request);
+    if (!SysMock::perf_ioctl_clbk) {
+        FAIL_CHECK("When using mocked perf ioctl, clbk must be provided.");
+        return -1;
+    }
+    return SysMock::perf_ioctl_clbk(fd, request);
+}
+
 void
 SysMock::use_mocked_syscall(std::string_view syscall) {
     assert_lowercase(syscall);
@@ -113,3 +127,9 @@ SysMock::set_perf_event_clbk(PerfEventClbk clbk) {
     SysMock::use_mocked_syscall("perf_event");
     SysMock::perf_event_clbk = std::move(clbk);
 }
+
+void
+SysMock::set_perf_ioctl_clbk(PerfIoctlClbk clbk) {
+    SysMock::use_mocked_syscall("perf_ioctl");
+    SysMock::perf_ioctl_clbk = std::move(clbk);
+}
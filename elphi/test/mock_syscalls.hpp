@@ -16,6 +16,7 @@ using MunmapClbk = std::function<int(void* addr, size_t len)>;
 using CloseClbk = std::function<int(int fd)>;
 using PerfEventClbk = // NOLINTNEXTLINE
     std::function<int(const perf_event_attr& attr, pid_t pid, int cpu, int group_fd, unsigned long flags)>;
+using PerfIoctlClbk = std::function<int(int fd, unsigned long request)>; // NOLINT
 
 /*******************************************************************************
  * @brief Singleton for mocking syscalls.
@@ -72,12 +73,22 @@ public:
     static void
     set_perf_event_clbk(PerfEventClbk clbk);
 
+    /*******************************************************************************
+     * @brief Set mocked ioctl() implementation of perf events.
+     *
+     * @param clbk Redirect enabling, disabling and resetting of events to this function.
+     ******************************************************************************/
+    static void
+    set_perf_ioctl_clbk(PerfIoctlClbk clbk);
+
     /*! Whether to use the real or mocked syscall. */
     inline static std::map<std::string, bool> real_syscall{
-        {"mmap", true}, {"munmap", true}, {"close", true}, {"perf_event", true}};
+        {"mmap", true}, {"munmap", true}, {"close", true}, {"perf_event", true}, {"perf_ioctl", true}};
 
     /*! Active perf_event() mocked implementation. */
     inline static PerfEventClbk perf_event_clbk{nullptr};
+    /*! Active ioctl() mocked implementation of perf events. */
+    inline static PerfIoctlClbk perf_ioctl_clbk{nullptr};
     /*! Active mmap() mocked implementation. */
     inline static MmapClbk mmap_clbk{nullptr};
     /*! Active munmap() mocked implementation. */
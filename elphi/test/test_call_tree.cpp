@@ -0,0 +1,54 @@
+#include <cstdint>
+#include <vector>
+
+#include <catch2/catch_all.hpp>
+#include <elphi/call_tree.hpp>
+
+SCENARIO("Aggregating call stacks", "[call_tree]") {
+    GIVEN("Empty tree") {
+        elphi::CallTree tree;
+
+        THEN("Only the root is present") {
+            CHECK(tree.size() == 1);
+            CHECK(tree.node(elphi::c_root_stack).depth == 0);
+            CHECK(tree.intern({}) == elphi::c_root_stack);
+        }
+
+        WHEN("Stacks sharing their callers are interned") {
+            // Innermost frame first: main -> run -> {parse, eval}.
+            const std::vector<std::uint64_t> parse{0x30, 0x20, 0x10};
+            const std::vector<std::uint64_t> eval{0x40, 0x20, 0x10};
+            const auto parse_id = tree.intern(parse);
+            const auto eval_id = tree.intern(eval);
+
+            THEN("The common prefix is stored once") {
+                CHECK(tree.size() == 5);
+                CHECK(parse_id != eval_id);
+                CHECK(tree.node(parse_id).parent == tree.node(eval_id).parent);
+            }
+            THEN("Nodes describe their frames") {
+                const auto& leaf = tree.node(parse_id);
+                CHECK(leaf.ip == 0x30);
+                CHECK(leaf.depth == 3);
+                const auto& caller = tree.node(leaf.parent);
+                CHECK(caller.ip == 0x20);
+                CHECK(tree.node(caller.parent).ip == 0x10);
+                CHECK(tree.node(caller.parent).parent == elphi::c_root_stack);
+            }
+            THEN("Equal stacks map to the same node") {
+                CHECK(tree.intern(parse) == parse_id);
+                CHECK(tree.intern(std::vector<std::uint64_t>{0x20, 0x10}) == tree.node(parse_id).parent);
+                CHECK(tree.size() == 5);
+            }
+            THEN("Parents precede their children") {
+                for (elphi::StackId id = 1; id < tree.size(); ++id)
+                    CHECK(tree.node(id).parent < id);
+            }
+            THEN("Replaying the nodes recreates the ids") {
+                elphi::CallTree copy;
+                for (elphi::StackId id = 1; id < tree.size(); ++id)
+                    CHECK(copy.child(tree.node(id).parent, tree.node(id).ip) == id);
+            }
+        }
+    }
+}
@@ -0,0 +1,228 @@
+#include <filesystem>
+#include <fstream>
+#include <tuple>
+
+#include <catch2/catch_all.hpp>
+#include <elphi/capture.hpp>
+
+using namespace std::chrono_literals;
+
+namespace {
+/*******************************************************************************
+ * @brief Temporary file removed at the end of the scope.
+ ******************************************************************************/
+struct TempFile {
+    TempFile() : path(std::filesystem::temp_directory_path() / "elphi_test_capture.bin") {}
+    TempFile(const TempFile&) = delete;
+    TempFile(TempFile&&) = delete;
+    TempFile&
+    operator=(const TempFile&) = delete;
+    TempFile&
+    operator=(TempFile&&) = delete;
+    ~TempFile() { std::filesystem::remove(path); }
+
+    std::filesystem::path path;
+};
+
+/*******************************************************************************
+ * @brief Comparable representation of a sample.
+ ******************************************************************************/
+auto
+as_tuple(const elphi::CpuSample& s) {
+    return std::tuple{s.pid, s.tid, s.cpu, s.time, s.cgroup, s.kind, s.stack};
+}
+} // namespace
+
+SCENARIO("Capture round trip", "[capture]") {
+    TempFile file;
+
+    GIVEN("Samples of two CPUs spanning multiple blocks") {
+        std::vector<elphi::CpuSample> samples;
+        for (std::size_t i = 0; i < elphi::CaptureWriter::c_block_samples * 2 + 10; ++i)
+            for (elphi::CpuId cpu : {0U, 3U}) {
+                const auto pid = static_cast<elphi::ProcId>(100 + (i / 50) % 7);
+                samples.push_back({.pid = pid,
+                                   .tid = pid + static_cast<elphi::ThreadId>(cpu),
+                                   .cpu = cpu,
+                                   .time = i * 1ms + cpu * 1us,
+                                   .cgroup = 5000 + pid % 2,
+                                   .kind = static_cast<elphi::SampleKind>(i % 3)});
+            }
+
+        WHEN("Written in batches and read back") {
+            {
+                elphi::CaptureWriter writer{file.path.string()};
+                const std::span all{samples};
+                for (std::size_t i = 0; i < all.size(); i += 1000)
+                    writer.write(all.subspan(i, std::min<std::size_t>(1000, all.size() - i)));
+                writer.write_name(100, "cat");
+                writer.write_name(101, "grep");
+                writer.write_group_name(5000, "/system.slice");
+                writer.close();
+            }
+            elphi::CaptureReader reader{file.path.string()};
+
+            THEN("All samples are present, ordered for each CPU") {
+                CHECK(reader.num_samples() == samples.size());
+                auto result = reader.read_all();
+                REQUIRE(result.samples.size() == samples.size());
+
+                for (elphi::CpuId cpu : {0U, 3U}) {
+                    std::vector<elphi::CpuSample> exp_cpu;
+                    std::vector<elphi::CpuSample> read_cpu;
+                    std::ranges::copy_if(samples, std::back_inserter(exp_cpu), [cpu](auto& s) { return s.cpu == cpu; });
+                    std::ranges::copy_if(result.samples, std::back_inserter(read_cpu),
+                                         [cpu](auto& s) { return s.cpu == cpu; });
+                    CHECK(std::ranges::equal(exp_cpu, read_cpu, {}, as_tuple, as_tuple));
+                }
+            }
+            THEN("Names are present") {
+                CHECK(reader.process_names().at(100) == "cat");
+                CHECK(reader.process_names().at(101) == "grep");
+                CHECK(reader.group_names().at(5000) == "/system.slice");
+                CHECK(reader.read_all().group_name(5000) == "/system.slice");
+                CHECK(reader.read_all().group_name(5001) == "UNKNOWN");
+            }
+            THEN("The capture is much smaller than raw samples") {
+                // Raw record of 32-bit pid and tid, 64-bit cpu and time, whatever else CpuSample holds.
+                constexpr std::size_t c_raw_sample_size = 24;
+                CHECK(std::filesystem::file_size(file.path) * 5 < samples.size() * c_raw_sample_size);
+            }
+        }
+    }
+
+    GIVEN("Samples with call stacks") {
+        elphi::CallTree stacks;
+        const auto main = stacks.child(elphi::c_root_stack, 0x1000);
+        const auto work = stacks.child(main, 0x2000);
+        const auto idle = stacks.child(elphi::c_root_stack, 0x3000);
+        const std::vector<elphi::CpuSample> samples{{.pid = 1, .tid = 1, .time = 1ms, .stack = work},
+                                                    {.pid = 1, .tid = 1, .time = 2ms, .stack = main},
+                                                    {.pid = 1, .tid = 1, .time = 3ms, .stack = work},
+                                                    {.pid = 2, .tid = 2, .time = 4ms, .stack = idle}};
+
+        WHEN("Written with the stack nodes and read back") {
+            {
+                elphi::CaptureWriter writer{file.path.string()};
+                writer.write(samples);
+                for (elphi::StackId id = 0; id < stacks.size(); ++id)
+                    writer.write_stack(id, stacks.node(id).parent, stacks.node(id).ip, id == idle ? "" : "fn");
+                writer.close();
+            }
+            elphi::CaptureReader reader{file.path.string()};
+            const auto result = reader.read_all();
+
+            THEN("Samples refer to the same stacks") {
+                REQUIRE(result.samples.size() == samples.size());
+                CHECK(std::ranges::equal(samples, result.samples, {}, as_tuple, as_tuple));
+                REQUIRE(result.stacks.size() == stacks.size());
+                for (elphi::StackId id = 0; id < stacks.size(); ++id) {
+                    CHECK(result.stacks.node(id).parent == stacks.node(id).parent);
+                    CHECK(result.stacks.node(id).ip == stacks.node(id).ip);
+                }
+            }
+            THEN("Resolved symbols are present") {
+                CHECK(result.stack_symbol(work) == "fn");
+                CHECK(result.stack_symbol(idle) == "UNKNOWN");
+                CHECK(reader.stack_symbols().size() == 2);
+            }
+        }
+        WHEN("Stack nodes are not recorded") {
+            elphi::CaptureWriter{file.path.string()}.write(samples);
+
+            THEN("Samples cannot be decoded") {
+                elphi::CaptureReader reader{file.path.string()};
+                CHECK(reader.stacks().size() == 1);
+                CHECK_THROWS_AS(reader.read_all(), elphi::ElphiException);
+            }
+        }
+    }
+
+    GIVEN("Samples with counter values") {
+        const std::vector<elphi::Counter> counters{elphi::Counter::cycles, elphi::Counter::instructions};
+        std::vector<elphi::CpuSample> samples;
+        std::vector<elphi::CounterValues> values;
+        for (std::size_t i = 0; i < elphi::CaptureWriter::c_block_samples + 10; ++i) {
+            samples.push_back({.pid = 1, .tid = 1, .cpu = i % 2, .time = i * 1ms});
+            values.push_back({1000 + i, 2000 + i * 3, 0, 0});
+        }
+
+        WHEN("Written with their counters and read back") {
+            {
+                elphi::CaptureWriter writer{file.path.string()};
+                writer.write_counters(counters);
+                writer.write(samples, values);
+                writer.close();
+            }
+            elphi::CaptureReader reader{file.path.string()};
+            const auto result = reader.read_all();
+
+            THEN("Each sample has its values") {
+                CHECK(result.counters == counters);
+                REQUIRE(result.samples.size() == samples.size());
+                REQUIRE(result.counter_values.size() == samples.size());
+                for (std::size_t i = 0; i < samples.size(); ++i) {
+                    const auto written = static_cast<std::size_t>(result.samples[i].time / 1ms);
+                    CHECK(result.counter_values[i] == values[written]);
+                }
+            }
+        }
+        WHEN("Counters are recorded after the samples") {
+            elphi::CaptureWriter writer{file.path.string()};
+            writer.write(samples);
+
+            THEN("They are rejected") { CHECK_THROWS_AS(writer.write_counters(counters), elphi::ElphiException); }
+        }
+        WHEN("Values do not match the samples") {
+            elphi::CaptureWriter writer{file.path.string()};
+            writer.write_counters(counters);
+
+            THEN("They are rejected") {
+                CHECK_THROWS_AS(writer.write(samples, std::span{values}.first(1)), elphi::ElphiException);
+            }
+        }
+        WHEN("Written without counters") {
+            elphi::CaptureWriter{file.path.string()}.write(samples, values);
+
+            THEN("No values are read back") {
+                const auto result = elphi::CaptureReader{file.path.string()}.read_all();
+                CHECK(result.counters.empty());
+                CHECK(result.counter_values.empty());
+            }
+        }
+    }
+
+    GIVEN("Empty capture") {
+        elphi::CaptureWriter{file.path.string()}.close();
+
+        THEN("There are no samples") {
+            elphi::CaptureReader reader{file.path.string()};
+            CHECK(reader.num_samples() == 0);
+            CHECK(reader.num_blocks() == 0);
+        }
+    }
+
+    GIVEN("Capture with a corrupt block header") {
+        {
+            elphi::CaptureWriter writer{file.path.string()};
+            const elphi::CpuSample sample{.pid = 1, .tid = 1, .time = 1ms};
+            writer.write({&sample, 1});
+        }
+        // Number of samples of the first block, right after the file header and the block kind.
+        std::fstream stream{file.path, std::ios::in | std::ios::out | std::ios::binary};
+        stream.seekp(16 + 4);
+        const std::uint32_t num_entries = 0xFFFFFFFF;
+        stream.write(reinterpret_cast<const char*>(&num_entries), sizeof(num_entries));
+        stream.close();
+
+        THEN("Reading fails without decoding") {
+            CHECK_THROWS_AS(elphi::CaptureReader{file.path.string()}, elphi::ElphiException);
+        }
+    }
+
+    GIVEN("File which is not a capture") {
+        std::ofstream{file.path} << "Definitely not a capture file.";
+
+        THEN("Reading fails") { CHECK_THROWS_AS(elphi::CaptureReader{file.path.string()}, elphi::ElphiException); }
+    }
+}
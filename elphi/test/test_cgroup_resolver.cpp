@@ -0,0 +1,102 @@
+#include <filesystem>
+#include <map>
+#include <string>
+
+#include <catch2/catch_all.hpp>
+#include <elphi/cgroup_resolver.hpp>
+#include <sys/stat.h>
+
+using namespace std::chrono_literals;
+
+namespace {
+/*******************************************************************************
+ * @brief Fake cgroup hierarchy in a temporary directory, removed at the end of the scope.
+ ******************************************************************************/
+struct FakeCgroups {
+    FakeCgroups() : root(std::filesystem::temp_directory_path() / "elphi_test_cgroup") {
+        std::filesystem::remove_all(root);
+        std::filesystem::create_directories(root);
+    }
+    FakeCgroups(const FakeCgroups&) = delete;
+    FakeCgroups(FakeCgroups&&) = delete;
+    FakeCgroups&
+    operator=(const FakeCgroups&) = delete;
+    FakeCgroups&
+    operator=(FakeCgroups&&) = delete;
+    ~FakeCgroups() { std::filesystem::remove_all(root); }
+
+    /*******************************************************************************
+     * @brief Create cgroup at @p path relative to the root, return its id.
+     ******************************************************************************/
+    elphi::GroupId
+    add(const std::string& path) const {
+        const auto dir = root / path;
+        std::filesystem::create_directories(dir);
+        struct stat info {};
+        REQUIRE(stat(dir.c_str(), &info) == 0);
+        return info.st_ino;
+    }
+
+    std::filesystem::path root;
+};
+
+/*******************************************************************************
+ * @brief Collect all resolved paths of @p resolver .
+ ******************************************************************************/
+std::map<elphi::GroupId, std::string>
+collect(elphi::CgroupResolver& resolver) {
+    std::map<elphi::GroupId, std::string> paths;
+    resolver.collect_resolved([&](elphi::GroupId id, elphi::NameId path) {
+        paths.insert_or_assign(id, std::string{resolver.names().resolve(path)});
+    });
+    return paths;
+}
+} // namespace
+
+SCENARIO("Resolving cgroup paths", "[cgroups]") {
+    GIVEN("Hierarchy with nested cgroups") {
+        FakeCgroups cgroups;
+        const auto root_id = cgroups.add("");
+        const auto slice_id = cgroups.add("system.slice");
+        const auto service_id = cgroups.add("system.slice/sshd.service");
+
+        elphi::CgroupResolver resolver{cgroups.root.string()};
+
+        WHEN("Cgroups are looked up") {
+            CHECK(!resolver.lookup(root_id));
+            CHECK(!resolver.lookup(slice_id));
+            CHECK(!resolver.lookup(service_id));
+            REQUIRE(resolver.wait_idle(5s));
+
+            THEN("Their paths relative to the root are resolved in the background") {
+                const std::map<elphi::GroupId, std::string> expected{
+                    {root_id, "/"}, {slice_id, "/system.slice"}, {service_id, "/system.slice/sshd.service"}};
+                CHECK(collect(resolver) == expected);
+                CHECK(resolver.names().resolve(resolver.lookup(service_id).value()) == "/system.slice/sshd.service");
+                CHECK(collect(resolver).empty());
+            }
+        }
+        WHEN("Cgroup is created after the first scan") {
+            CHECK(!resolver.lookup(slice_id));
+            REQUIRE(resolver.wait_idle(5s));
+            REQUIRE(resolver.lookup(slice_id));
+            const auto user_id = cgroups.add("user.slice");
+            CHECK(!resolver.lookup(user_id));
+            REQUIRE(resolver.wait_idle(5s));
+
+            THEN("It is found by rescanning") {
+                CHECK(collect(resolver) ==
+                      std::map<elphi::GroupId, std::string>{{slice_id, "/system.slice"}, {user_id, "/user.slice"}});
+            }
+        }
+        WHEN("Cgroup does not exist") {
+            CHECK(!resolver.lookup(1));
+            REQUIRE(resolver.wait_idle(5s));
+
+            THEN("It is unknown") {
+                CHECK(collect(resolver) == std::map<elphi::GroupId, std::string>{{1, "UNKNOWN"}});
+                CHECK(resolver.lookup(1) == elphi::c_unknown_name);
+            }
+        }
+    }
+}
@@ -0,0 +1,148 @@
+#include <cinttypes>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include <catch2/catch_all.hpp>
+#include <elphi/elf_symbols.hpp>
+#include <elphi/exception.hpp>
+
+/*******************************************************************************
+ * @brief Function of this binary looked up by the tests.
+ ******************************************************************************/
+extern "C" [[gnu::noinline]] int
+elphi_test_elf_function(int value) {
+    // Keep the body from being folded with other functions.
+    return value * 31 + 7;
+}
+
+namespace {
+/*******************************************************************************
+ * @brief Temporary directory, removed at the end of the scope.
+ ******************************************************************************/
+struct TempDir {
+    TempDir() : root(std::filesystem::temp_directory_path() / "elphi_test_elf") {
+        std::filesystem::remove_all(root);
+        std::filesystem::create_directories(root);
+    }
+    TempDir(const TempDir&) = delete;
+    TempDir(TempDir&&) = delete;
+    TempDir&
+    operator=(const TempDir&) = delete;
+    TempDir&
+    operator=(TempDir&&) = delete;
+    ~TempDir() { std::filesystem::remove_all(root); }
+
+    std::filesystem::path root;
+};
+
+/*******************************************************************************
+ * @brief Path of this test binary.
+ ******************************************************************************/
+std::string
+self_path() {
+    return std::filesystem::read_symlink("/proc/self/exe").string();
+}
+
+/*******************************************************************************
+ * @brief Offset of @p address in the file mapped there, zero if not mapped.
+ ******************************************************************************/
+std::uint64_t
+file_offset(const void* address) {
+    const auto addr = reinterpret_cast<std::uintptr_t>(address);
+    std::ifstream maps{"/proc/self/maps"};
+    for (std::string line; std::getline(maps, line);) {
+        std::uint64_t start = 0;
+        std::uint64_t end = 0;
+        std::uint64_t offset = 0;
+        if (std::sscanf(line.c_str(), "%" SCNx64 "-%" SCNx64 " %*s %" SCNx64, &start, &end, &offset) == 3 &&
+            addr >= start && addr < end)
+            return addr - start + offset;
+    }
+    return 0;
+}
+} // namespace
+
+SCENARIO("Indexing symbols of an ELF file", "[symbols]") {
+    GIVEN("Index of this binary") {
+        const elphi::ElfSymbols symbols{elphi::MappedFile{self_path()}};
+        REQUIRE(symbols.size() > 0);
+        const auto offset = file_offset(reinterpret_cast<const void*>(&elphi_test_elf_function));
+        REQUIRE(offset > 0);
+
+        THEN("Instructions of a function resolve to it") {
+            CHECK(symbols.lookup(offset) == "elphi_test_elf_function");
+            CHECK(symbols.lookup(offset + 1) == "elphi_test_elf_function");
+        }
+        THEN("Offsets outside of the loaded segments are not resolved") {
+            CHECK(!symbols.lookup(0));
+            CHECK(!symbols.lookup(std::uint64_t{1} << 48U));
+        }
+        THEN("The build-id is read from the notes") {
+            CHECK(symbols.build_id() == elphi::elf_build_id(elphi::MappedFile{self_path()}.data()));
+        }
+    }
+    GIVEN("File which is not an ELF") {
+        TempDir dir;
+        const auto path = (dir.root / "text").string();
+        std::ofstream{path} << "Not an ELF file, just text long enough to hold an ELF header.\n";
+
+        THEN("It cannot be indexed") {
+            CHECK(elphi::elf_build_id(elphi::MappedFile{path}.data()).empty());
+            CHECK_THROWS_AS(elphi::ElfSymbols{elphi::MappedFile{path}}, elphi::ElphiException);
+        }
+    }
+    WHEN("File does not exist") {
+        THEN("It cannot be mapped") {
+            CHECK_THROWS_AS(elphi::MappedFile{"/nonexistent/elphi"}, elphi::ElphiException);
+        }
+    }
+}
+
+SCENARIO("Caching indexes by build-id", "[symbols]") {
+    GIVEN("Empty cache") {
+        elphi::SymbolCache cache;
+        auto symbols = cache.load(self_path());
+        REQUIRE(symbols);
+
+        WHEN("The same file is loaded again") {
+            THEN("The index is reused if it has a build-id") {
+                CHECK((cache.load(self_path()) == symbols) == !symbols->build_id().empty());
+            }
+        }
+        WHEN("A copy of the file is loaded") {
+            TempDir dir;
+            const auto copy = (dir.root / "copy").string();
+            std::filesystem::copy_file(self_path(), copy);
+
+            THEN("The index is shared by the build-id") {
+                if (!symbols->build_id().empty()) {
+                    CHECK(cache.load(copy) == symbols);
+                    CHECK(cache.size() == 1);
+                }
+            }
+        }
+        WHEN("The index is no longer used") {
+            const auto build_id = symbols->build_id();
+            const std::weak_ptr<const elphi::ElfSymbols> released = symbols;
+            symbols.reset();
+
+            THEN("The cache does not keep it alive") {
+                CHECK(released.expired());
+                CHECK(cache.size() == 0);
+                if (!build_id.empty()) {
+                    const auto reloaded = cache.load(self_path());
+                    CHECK(reloaded);
+                    CHECK(cache.size() == 1);
+                }
+            }
+        }
+        WHEN("File cannot be read") {
+            THEN("Nothing is loaded") {
+                CHECK(!cache.load("/nonexistent/elphi"));
+                CHECK(!cache.load("/proc/self/maps"));
+            }
+        }
+    }
+}
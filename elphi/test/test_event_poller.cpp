@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch_all.hpp>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <elphi/event_poller.hpp>
+#include <elphi/exception.hpp>
+#include <elphi/file_descriptor.hpp>
+
+namespace {
+using namespace std::chrono_literals;
+
+/*******************************************************************************
+ * @brief Make @p fd readable.
+ ******************************************************************************/
+void
+signal(const elphi::FileDescriptor& fd) {
+    const std::uint64_t count = 1;
+    REQUIRE(::write(fd.raw(), &count, sizeof(count)) == sizeof(count));
+}
+
+/*******************************************************************************
+ * @brief Indices reported by a single wait of @p poller .
+ ******************************************************************************/
+std::vector<std::uint32_t>
+wait_for(elphi::EventPoller& poller, std::chrono::milliseconds timeout) {
+    auto ready = poller.wait(timeout);
+    return {ready.begin(), ready.end()};
+}
+} // namespace
+
+SCENARIO("Waiting for ready descriptors", "[event_poller]") {
+    GIVEN("Poller watching two eventfds") {
+        elphi::EventPoller poller;
+        elphi::FileDescriptor first{eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)};
+        elphi::FileDescriptor second{eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)};
+        REQUIRE(first.raw() != -1);
+        REQUIRE(second.raw() != -1);
+        poller.add(first.raw(), 3);
+        poller.add(second.raw(), 7);
+
+        THEN("Wait without ready descriptors times out") { CHECK(wait_for(poller, 10ms).empty()); }
+
+        WHEN("One of them becomes ready") {
+            signal(second);
+
+            THEN("Only its index is reported") { CHECK(wait_for(poller, 1s) == std::vector<std::uint32_t>{7}); }
+        }
+
+        WHEN("Both become ready") {
+            signal(first);
+            signal(second);
+
+            THEN("Both indices are reported") {
+                auto ready = wait_for(poller, 1s);
+                std::ranges::sort(ready);
+                CHECK(ready == std::vector<std::uint32_t>{3, 7});
+            }
+        }
+
+        WHEN("Woken up before the wait") {
+            poller.wake();
+
+            THEN("The wait returns immediately without indices") {
+                const auto start = std::chrono::steady_clock::now();
+                CHECK(wait_for(poller, 10s).empty());
+                CHECK(std::chrono::steady_clock::now() - start < 5s);
+            }
+            THEN("The wake-up is consumed") { CHECK(wait_for(poller, 10ms).empty()); }
+        }
+
+        WHEN("Woken up from another thread during the wait") {
+            std::jthread waker{[&poller] {
+                std::this_thread::sleep_for(20ms);
+                poller.wake();
+            }};
+
+            THEN("The wait is interrupted") {
+                const auto start = std::chrono::steady_clock::now();
+                CHECK(wait_for(poller, 10s).empty());
+                CHECK(std::chrono::steady_clock::now() - start < 5s);
+            }
+        }
+    }
+
+    GIVEN("Poller") {
+        elphi::EventPoller poller;
+
+        THEN("Invalid descriptors are rejected") { CHECK_THROWS_AS(poller.add(-1, 0), elphi::ElphiException); }
+    }
+}
@@ -0,0 +1,103 @@
+#include <cstdint>
+#include <vector>
+
+#include <catch2/catch_all.hpp>
+#include <elphi/flame_graph.hpp>
+
+namespace velphi = elphi::view;
+
+SCENARIO("Flame graph of sampled stacks", "[view][flame_graph]") {
+    GIVEN("Samples of main -> run -> {parse, eval} and a sample without stack") {
+        elphi::CpuSamplingResult result;
+        const auto parse = result.stacks.intern(std::vector<std::uint64_t>{0x30, 0x20, 0x10});
+        const auto eval = result.stacks.intern(std::vector<std::uint64_t>{0x40, 0x20, 0x10});
+        const auto run = result.stacks.node(parse).parent;
+        const auto main = result.stacks.node(run).parent;
+        // An unused stack must not appear.
+        (void)result.stacks.intern(std::vector<std::uint64_t>{0x50, 0x10});
+        for (auto stack : {eval, parse, parse, eval, eval, run, elphi::c_root_stack})
+            result.samples.push_back({.stack = stack});
+
+        WHEN("Laid out") {
+            const auto graph = velphi::gen_flame_graph(result);
+
+            THEN("Frames are in depth-first order, unresolved callees ordered by address") {
+                const velphi::FlameGraph expected{
+                    {.stack = elphi::c_root_stack, .ip = 0, .depth = 0, .offset = 0, .total = 7, .self = 1},
+                    {.stack = main, .ip = 0x10, .depth = 1, .offset = 0, .total = 6, .self = 0},
+                    {.stack = run, .ip = 0x20, .depth = 2, .offset = 0, .total = 6, .self = 1},
+                    {.stack = parse, .ip = 0x30, .depth = 3, .offset = 0, .total = 2, .self = 2},
+                    {.stack = eval, .ip = 0x40, .depth = 3, .offset = 2, .total = 3, .self = 3},
+                };
+                CHECK(graph == expected);
+            }
+        }
+        WHEN("Functions of the stacks are resolved") {
+            result.set_stack_symbol(run, "run()");
+            result.set_stack_symbol(eval, "eval()");
+            const auto graph = velphi::gen_flame_graph(result);
+
+            THEN("Frames are named by them") {
+                REQUIRE(graph.size() == 5);
+                CHECK(graph[1].symbol == elphi::c_unknown_name);
+                CHECK(result.names.resolve(graph[2].symbol) == "run()");
+                CHECK(graph[3].symbol == elphi::c_unknown_name);
+                CHECK(result.names.resolve(graph[4].symbol) == "eval()");
+                CHECK(result.stack_symbol(parse) == "UNKNOWN");
+            }
+        }
+    }
+
+    GIVEN("Samples of two addresses in each of parse and eval called from main") {
+        elphi::CpuSamplingResult result;
+        const auto parse_a = result.stacks.intern(std::vector<std::uint64_t>{0x31, 0x10});
+        const auto parse_b = result.stacks.intern(std::vector<std::uint64_t>{0x32, 0x10});
+        const auto eval_a = result.stacks.intern(std::vector<std::uint64_t>{0x21, 0x10});
+        const auto eval_b = result.stacks.intern(std::vector<std::uint64_t>{0x22, 0x10});
+        // Both addresses of eval call the same function.
+        const auto leaf_a = result.stacks.intern(std::vector<std::uint64_t>{0x50, 0x21, 0x10});
+        const auto leaf_b = result.stacks.intern(std::vector<std::uint64_t>{0x51, 0x22, 0x10});
+        const auto main = result.stacks.node(parse_a).parent;
+        for (auto stack : {parse_a, parse_b, parse_b, eval_a, eval_b, leaf_a, leaf_b, leaf_b})
+            result.samples.push_back({.stack = stack});
+        result.set_stack_symbol(parse_a, "parse()");
+        result.set_stack_symbol(parse_b, "parse()");
+        result.set_stack_symbol(eval_a, "eval()");
+        result.set_stack_symbol(eval_b, "eval()");
+        result.set_stack_symbol(leaf_a, "leaf()");
+        result.set_stack_symbol(leaf_b, "leaf()");
+
+        WHEN("Laid out") {
+            const auto graph = velphi::gen_flame_graph(result);
+
+            THEN("Frames of a function are merged and sorted by name") {
+                REQUIRE(graph.size() == 5);
+                CHECK(graph[1].stack == main);
+                CHECK(graph[1].total == 8);
+                CHECK(result.names.resolve(graph[2].symbol) == "eval()");
+                CHECK(graph[2].stack == eval_b);
+                CHECK(graph[2].offset == 0);
+                CHECK(graph[2].total == 5);
+                CHECK(graph[2].self == 2);
+                CHECK(result.names.resolve(graph[3].symbol) == "leaf()");
+                CHECK(graph[3].depth == 3);
+                CHECK(graph[3].total == 3);
+                CHECK(graph[3].self == 3);
+                CHECK(result.names.resolve(graph[4].symbol) == "parse()");
+                CHECK(graph[4].stack == parse_b);
+                CHECK(graph[4].offset == 5);
+                CHECK(graph[4].total == 3);
+            }
+        }
+    }
+
+    GIVEN("No samples") {
+        const elphi::CpuSamplingResult result;
+
+        THEN("Only the empty root is present") {
+            const auto graph = velphi::gen_flame_graph(result);
+            REQUIRE(graph.size() == 1);
+            CHECK(graph[0].total == 0);
+        }
+    }
+}
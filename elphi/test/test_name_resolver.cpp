@@ -0,0 +1,127 @@
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+
+#include <catch2/catch_all.hpp>
+#include <elphi/name_resolver.hpp>
+
+using namespace std::chrono_literals;
+
+namespace {
+/*******************************************************************************
+ * @brief Fake procfs in a temporary directory, removed at the end of the scope.
+ ******************************************************************************/
+struct FakeProc {
+    FakeProc() : root(std::filesystem::temp_directory_path() / "elphi_test_proc") {
+        std::filesystem::remove_all(root);
+        std::filesystem::create_directories(root);
+    }
+    FakeProc(const FakeProc&) = delete;
+    FakeProc(FakeProc&&) = delete;
+    FakeProc&
+    operator=(const FakeProc&) = delete;
+    FakeProc&
+    operator=(FakeProc&&) = delete;
+    ~FakeProc() { std::filesystem::remove_all(root); }
+
+    /*******************************************************************************
+     * @brief Create process @p pid named @p name .
+     ******************************************************************************/
+    void
+    add(elphi::ProcId pid, const std::string& name) const {
+        const auto dir = root / std::to_string(pid);
+        std::filesystem::create_directories(dir);
+        std::ofstream{dir / "comm"} << name << '\n';
+    }
+
+    std::filesystem::path root;
+};
+
+/*******************************************************************************
+ * @brief Collect all resolved names of @p resolver .
+ ******************************************************************************/
+std::map<elphi::ProcId, std::string>
+collect(elphi::NameResolver& resolver) {
+    std::map<elphi::ProcId, std::string> names;
+    resolver.collect_resolved([&](elphi::ProcId pid, elphi::NameId name) {
+        names.insert_or_assign(pid, std::string{resolver.names().resolve(name)});
+    });
+    return names;
+}
+
+} // namespace
+
+SCENARIO("Resolving process names", "[names]") {
+    GIVEN("Fake /proc with two processes") {
+        FakeProc proc;
+        proc.add(1, "init");
+        proc.add(42, "bash");
+
+        elphi::NameResolver resolver{3, proc.root.string()};
+
+        WHEN("Names are learned from records") {
+            resolver.on_comm(100, "cat");
+            resolver.on_fork(100, 101);
+            resolver.on_fork(999, 102);
+
+            THEN("Forked process inherits the name") {
+                CHECK(resolver.names().resolve(resolver.lookup(100).value()) == "cat");
+                CHECK(resolver.names().resolve(resolver.lookup(101).value()) == "cat");
+                CHECK(collect(resolver) == std::map<elphi::ProcId, std::string>{{100, "cat"}, {101, "cat"}});
+            }
+            THEN("Renamed process is reported again") {
+                (void)collect(resolver);
+                resolver.on_comm(101, "grep");
+                resolver.on_comm(100, "cat");
+                CHECK(collect(resolver) == std::map<elphi::ProcId, std::string>{{101, "grep"}});
+            }
+        }
+        WHEN("Unknown process is looked up") {
+            CHECK(!resolver.lookup(42));
+            CHECK(!resolver.lookup(7));
+            REQUIRE(resolver.wait_idle(5s));
+
+            THEN("Its name is resolved in the background") {
+                CHECK(collect(resolver) ==
+                      std::map<elphi::ProcId, std::string>{{7, "UNKNOWN"}, {42, "bash"}});
+                CHECK(resolver.names().resolve(resolver.lookup(42).value()) == "bash");
+                CHECK(resolver.lookup(7) == elphi::c_unknown_name);
+            }
+        }
+        WHEN("Record arrives before the scan is applied") {
+            CHECK(!resolver.lookup(42));
+            REQUIRE(resolver.wait_idle(5s));
+            resolver.on_comm(42, "zsh");
+
+            THEN("The record's name wins") {
+                CHECK(collect(resolver) == std::map<elphi::ProcId, std::string>{{42, "zsh"}});
+            }
+        }
+        WHEN("All processes are scanned") {
+            resolver.scan_all();
+            REQUIRE(resolver.wait_idle(5s));
+
+            THEN("All are resolved") {
+                CHECK(collect(resolver) == std::map<elphi::ProcId, std::string>{{1, "init"}, {42, "bash"}});
+            }
+        }
+        WHEN("More processes than the capacity are cached") {
+            resolver.on_comm(1, "a");
+            resolver.on_comm(2, "b");
+            resolver.on_comm(3, "c");
+            // Used recently, must stay.
+            (void)resolver.lookup(1);
+            resolver.on_exit(3);
+            resolver.on_comm(4, "d");
+
+            THEN("Exited and least recently used are forgotten first") {
+                CHECK(resolver.size() == 3);
+                CHECK(resolver.lookup(1));
+                CHECK(resolver.lookup(4));
+                CHECK(resolver.lookup(2));
+                CHECK(!resolver.lookup(3));
+            }
+        }
+    }
+}
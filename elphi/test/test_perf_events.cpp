@@ -1,6 +1,158 @@
 /*******************************************************************************
  * Unit test perf_events.
- * DISABLED for now
+ ******************************************************************************/
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch_all.hpp>
+#include <elphi/perf_events.hpp>
+
+#include "mock_ring.hpp"
+
+namespace {
+/*******************************************************************************
+ * @brief Drain all events from @p events, return their payloads.
+ ******************************************************************************/
+std::vector<elphi::Buffer>
+drain_payloads(elphi::PerfEvents& events) {
+    std::vector<elphi::Buffer> payloads;
+    events.drain_perf_events([&payloads](const elphi::PerfRecord& record) {
+        CHECK(record.header.size == sizeof(perf_event_header) + record.payload.size());
+        payloads.emplace_back(record.payload.begin(), record.payload.end());
+    });
+    return payloads;
+}
+} // namespace
+
+SCENARIO("Batch draining of the event ring buffer", "[perf_events]") {
+    MockRing ring{1};
+    auto events = ring.open_events();
+
+    GIVEN("Empty ring buffer") {
+        ring.reset_to(GENERATE(0UL, 24UL, elphi::c_page_size - 8));
+
+        WHEN("Drained") {
+            const auto tail = ring.tail();
+            auto payloads = drain_payloads(events);
+
+            THEN("No records are popped") {
+                CHECK(payloads.empty());
+                CHECK(ring.tail() == tail);
+            }
+        }
+    }
+
+    GIVEN("Ring buffer with several records") {
+        ring.reset_to(GENERATE(0UL, 40UL));
+        const std::array<elphi::Buffer, 3> exp_payloads{
+            elphi::Buffer{1, 2, 3, 4, 5, 6, 7, 8}, elphi::Buffer{}, elphi::Buffer(64, 7)};
+        for (const auto& payload : exp_payloads)
+            ring.write(PERF_RECORD_SAMPLE, payload);
+
+        WHEN("Drained") {
+            auto payloads = drain_payloads(events);
+
+            THEN("All records are popped in order") {
+                REQUIRE(payloads.size() == exp_payloads.size());
+                for (std::size_t i = 0; i < payloads.size(); ++i)
+                    CHECK(payloads[i] == exp_payloads[i]);
+            }
+            THEN("Tail is published at the head") { CHECK(ring.tail() == ring.head()); }
+            THEN("Second drain pops nothing") { CHECK(drain_payloads(events).empty()); }
+        }
+    }
+
+    GIVEN("Record wrapping around the end of the ring") {
+        // Header fits before the end, the payload wraps.
+        ring.reset_to(elphi::c_page_size - sizeof(perf_event_header) - 8);
+        elphi::Buffer exp_payload(32);
+        std::iota(exp_payload.begin(), exp_payload.end(), 1);
+        ring.write(PERF_RECORD_SAMPLE, exp_payload);
+
+        WHEN("Drained") {
+            auto payloads = drain_payloads(events);
+
+            THEN("The record is reassembled") {
+                REQUIRE(payloads.size() == 1);
+                CHECK(payloads[0] == exp_payload);
+                CHECK(ring.tail() == ring.head());
+            }
+        }
+    }
+
+    GIVEN("Published record followed by a partially written one") {
+        ring.write(PERF_RECORD_SAMPLE, elphi::Buffer{1, 2, 3, 4, 5, 6, 7, 8});
+        const auto published_head = ring.head();
+        ring.write(PERF_RECORD_SAMPLE, elphi::Buffer(16, 1), false);
+
+        WHEN("Drained") {
+            auto payloads = drain_payloads(events);
+
+            THEN("Only the published record is popped") {
+                CHECK(payloads.size() == 1);
+                CHECK(ring.tail() == published_head);
+            }
+        }
+    }
+}
+
+SCENARIO("Draining the ring buffer concurrently with its producer", "[perf_events][stress]") {
+    GIVEN("Small ring written by another thread") {
+        // Small ring wraps around often, record sizes vary to move the wrap point.
+        MockRing ring{1};
+        auto events = ring.open_events();
+        constexpr std::uint64_t c_num_records = 200'000;
+
+        std::jthread producer{[&ring] {
+            std::array<std::uint64_t, 4> payload{};
+            for (std::uint64_t seq = 0; seq < c_num_records; ++seq) {
+                const auto num_words = 1 + seq % payload.size();
+                payload.fill(seq);
+                const auto bytes = std::as_bytes(std::span{payload}.first(num_words));
+                // Wait for the consumer as the kernel would drop the record instead.
+                while (ring.free_space() < sizeof(perf_event_header) + bytes.size())
+                    std::this_thread::yield();
+                ring.write(PERF_RECORD_SAMPLE,
+                           {reinterpret_cast<const unsigned char*>(bytes.data()), bytes.size()});
+            }
+        }};
+
+        WHEN("Drained until all records are read") {
+            std::uint64_t next_seq = 0;
+            std::size_t num_corrupted = 0;
+            while (next_seq < c_num_records) {
+                const auto num_drained = events.drain_perf_events([&](const elphi::PerfRecord& record) {
+                    std::array<std::uint64_t, 4> words{};
+                    const auto num_words = 1 + next_seq % words.size();
+                    if (record.payload.size() != num_words * sizeof(std::uint64_t)) {
+                        ++num_corrupted;
+                    } else {
+                        std::memcpy(words.data(), record.payload.data(), record.payload.size());
+                        const auto is_corrupted = [&](auto word) { return word != next_seq; };
+                        num_corrupted += static_cast<std::size_t>(
+                            std::ranges::count_if(std::span{words}.first(num_words), is_corrupted));
+                    }
+                    ++next_seq;
+                });
+                if (num_drained == 0)
+                    std::this_thread::yield();
+            }
+
+            THEN("Every record is read once, in order and complete") {
+                CHECK(next_seq == c_num_records);
+                CHECK(num_corrupted == 0);
+                CHECK(ring.tail() == ring.head());
+            }
+        }
+    }
+}
+
+/*******************************************************************************
+ * Legacy free-function API, DISABLED for now.
  ******************************************************************************/
 #if false
 
@@ -0,0 +1,280 @@
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include <catch2/catch_all.hpp>
+#include <elphi/perf_records.hpp>
+#include <sys/mman.h>
+
+using namespace std::chrono_literals;
+
+namespace {
+/*******************************************************************************
+ * @brief Build a record of @p type from the raw @p payload .
+ ******************************************************************************/
+elphi::PerfRecord
+make_record(std::uint32_t type, const std::vector<unsigned char>& payload) {
+    perf_event_header header{};
+    header.type = type;
+    header.size = static_cast<std::uint16_t>(sizeof(header) + payload.size());
+    return {.header = header, .payload = payload};
+}
+
+/*******************************************************************************
+ * @brief Serialize @p values as native 32-bit integers followed by @p tail .
+ ******************************************************************************/
+std::vector<unsigned char>
+make_payload(std::initializer_list<std::uint32_t> values, std::string_view tail = {}) {
+    std::vector<unsigned char> payload(values.size() * sizeof(std::uint32_t));
+    std::memcpy(payload.data(), std::data(values), payload.size());
+    payload.insert(payload.end(), tail.begin(), tail.end());
+    return payload;
+}
+/*******************************************************************************
+ * @brief Serialize @p values as native 64-bit integers.
+ ******************************************************************************/
+std::vector<unsigned char>
+make_payload64(std::initializer_list<std::uint64_t> values) {
+    std::vector<unsigned char> payload(values.size() * sizeof(std::uint64_t));
+    std::memcpy(payload.data(), std::data(values), payload.size());
+    return payload;
+}
+} // namespace
+
+SCENARIO("Parsing samples", "[records]") {
+    // pid=7, tid=8
+    const std::uint64_t tid = (8ULL << 32U) | 7U;
+
+    WHEN("Sample has the default fields") {
+        const auto payload = make_payload64({tid, 1000, 0xdead, 3});
+        REQUIRE(elphi::sample_payload_size(elphi::c_sample_type) == payload.size());
+        const auto sample = elphi::parse_sample(make_record(PERF_RECORD_SAMPLE, payload));
+        REQUIRE(sample);
+        CHECK(sample->pid == 7);
+        CHECK(sample->tid == 8);
+        CHECK(sample->time == 1000ns);
+        CHECK(sample->cpu == 3);
+        CHECK(sample->cgroup == 0);
+    }
+    WHEN("Sample has cgroup") {
+        constexpr auto sample_type = elphi::c_sample_type | PERF_SAMPLE_CGROUP;
+        const auto payload = make_payload64({tid, 1000, 0xdead, 3, 4242});
+        REQUIRE(elphi::sample_payload_size(sample_type) == payload.size());
+        const auto sample = elphi::parse_sample(make_record(PERF_RECORD_SAMPLE, payload), sample_type);
+        REQUIRE(sample);
+        CHECK(sample->cpu == 3);
+        CHECK(sample->cgroup == 4242);
+
+        THEN("Truncated record is rejected") {
+            const auto truncated = make_payload64({tid, 1000, 0xdead, 3});
+            CHECK(!elphi::parse_sample(make_record(PERF_RECORD_SAMPLE, truncated), sample_type));
+        }
+    }
+    WHEN("Sample has a group of counters and cgroup") {
+        constexpr auto sample_type = elphi::c_sample_type | PERF_SAMPLE_READ | PERF_SAMPLE_CGROUP;
+        // Three values: the sampled event, cycles and instructions.
+        const auto payload = make_payload64({tid, 1000, 0xdead, 3, 3, 555, 2000, 3000, 4242});
+        REQUIRE(elphi::sample_payload_size(sample_type, 2) == payload.size());
+        elphi::CounterValues counters{1, 2, 3, 4};
+        const auto sample =
+            elphi::parse_sample(make_record(PERF_RECORD_SAMPLE, payload), sample_type, nullptr, &counters);
+        REQUIRE(sample);
+        CHECK(sample->cpu == 3);
+        CHECK(counters == elphi::CounterValues{2000, 3000, 0, 0});
+        CHECK(sample->cgroup == 4242);
+
+        THEN("Group overflowing the record is rejected") {
+            const auto overflow = make_payload64({tid, 1000, 0xdead, 3, 4, 555, 2000, 3000, 4242});
+            CHECK(!elphi::parse_sample(make_record(PERF_RECORD_SAMPLE, overflow), sample_type));
+        }
+        THEN("Empty group is rejected") {
+            const auto empty = make_payload64({tid, 1000, 0xdead, 3, 0, 555, 2000, 3000, 4242});
+            CHECK(!elphi::parse_sample(make_record(PERF_RECORD_SAMPLE, empty), sample_type));
+        }
+    }
+}
+
+SCENARIO("Parsing callchains", "[records]") {
+    const std::uint64_t tid = (8ULL << 32U) | 7U;
+    constexpr auto sample_type = elphi::c_sample_type | PERF_SAMPLE_CALLCHAIN | PERF_SAMPLE_CGROUP;
+
+    WHEN("Sample has kernel and user frames") {
+        const auto payload = make_payload64(
+            {tid, 1000, 0xdead, 3, 5, PERF_CONTEXT_KERNEL, 0xffff1, PERF_CONTEXT_USER, 0x30, 0x20, 4242});
+        std::vector<std::uint64_t> callchain{0x99};
+        const auto sample = elphi::parse_sample(make_record(PERF_RECORD_SAMPLE, payload), sample_type, &callchain);
+
+        THEN("Frames are parsed without the context markers") {
+            REQUIRE(sample);
+            CHECK(callchain == std::vector<std::uint64_t>{0xffff1, 0x30, 0x20});
+            CHECK(sample->cgroup == 4242);
+        }
+    }
+    WHEN("Callchain is deeper than the limit") {
+        std::vector<std::uint64_t> words{tid, 1000, 0xdead, 3, elphi::c_max_callchain_depth + 11, PERF_CONTEXT_USER};
+        for (std::uint64_t i = 0; i < elphi::c_max_callchain_depth + 10; ++i)
+            words.push_back(0x1000 + i);
+        words.push_back(4242);
+        std::vector<unsigned char> payload(words.size() * sizeof(std::uint64_t));
+        std::memcpy(payload.data(), words.data(), payload.size());
+        std::vector<std::uint64_t> callchain;
+        const auto sample = elphi::parse_sample(make_record(PERF_RECORD_SAMPLE, payload), sample_type, &callchain);
+
+        THEN("Only the innermost frames are kept") {
+            REQUIRE(sample);
+            REQUIRE(callchain.size() == elphi::c_max_callchain_depth);
+            CHECK(callchain.front() == 0x1000);
+            CHECK(callchain.back() == 0x1000 + elphi::c_max_callchain_depth - 1);
+            CHECK(sample->cgroup == 4242);
+        }
+    }
+    WHEN("Callchain overflows the record") {
+        const auto payload = make_payload64({tid, 1000, 0xdead, 3, 3, 0x30, 0x20, 4242});
+        THEN("It is rejected") {
+            CHECK(!elphi::parse_sample(make_record(PERF_RECORD_SAMPLE, payload), sample_type));
+        }
+    }
+}
+
+SCENARIO("Parsing context switches", "[records]") {
+    // Switch from/to pid=5, tid=6, sample_id of pid=7, tid=8 at 1000ns on CPU 3.
+    const std::uint64_t next_prev = (6ULL << 32U) | 5U;
+    const std::uint64_t tid = (8ULL << 32U) | 7U;
+    const auto make_switch = [](std::uint16_t misc, const std::vector<unsigned char>& payload) {
+        auto record = make_record(PERF_RECORD_SWITCH_CPU_WIDE, payload);
+        record.header.misc = misc;
+        return record;
+    };
+    const auto payload = make_payload64({next_prev, tid, 1000, 3});
+
+    WHEN("Thread is switched in") {
+        const auto sample = elphi::parse_switch(make_switch(0, payload));
+        THEN("The current thread starts running") {
+            REQUIRE(sample);
+            CHECK(sample->kind == elphi::SampleKind::switch_in);
+            CHECK(sample->pid == 7);
+            CHECK(sample->tid == 8);
+            CHECK(sample->time == 1000ns);
+            CHECK(sample->cpu == 3);
+        }
+    }
+    WHEN("Thread is switched out") {
+        const auto sample = elphi::parse_switch(make_switch(PERF_RECORD_MISC_SWITCH_OUT, payload));
+        THEN("The current thread stops running") {
+            REQUIRE(sample);
+            CHECK(sample->kind == elphi::SampleKind::switch_out);
+            CHECK(sample->tid == 8);
+        }
+    }
+    WHEN("Idle task is switched") {
+        const auto idle = make_payload64({next_prev, 0, 1000, 3});
+        THEN("It is ignored") { CHECK(!elphi::parse_switch(make_switch(0, idle))); }
+    }
+    WHEN("Record is truncated or of other type") {
+        CHECK(!elphi::parse_switch(make_switch(0, make_payload64({next_prev, tid, 1000}))));
+        CHECK(!elphi::parse_switch(make_record(PERF_RECORD_SAMPLE, payload)));
+    }
+}
+
+SCENARIO("Parsing lost records", "[records]") {
+    WHEN("Kernel lost records") {
+        const auto lost = elphi::parse_lost(make_record(PERF_RECORD_LOST, make_payload64({1, 42})));
+        THEN("Their count is parsed") { CHECK(lost == 42U); }
+    }
+    WHEN("Record is truncated or of other type") {
+        CHECK(!elphi::parse_lost(make_record(PERF_RECORD_LOST, make_payload64({1}))));
+        CHECK(!elphi::parse_lost(make_record(PERF_RECORD_SAMPLE, make_payload64({1, 42}))));
+    }
+}
+
+SCENARIO("Parsing process lifecycle records", "[records]") {
+    using Kind = elphi::TaskEvent::Kind;
+
+    WHEN("Process is renamed") {
+        const auto payload = make_payload({10, 10}, std::string_view{"bash\0\0\0\0", 8});
+        const auto event = elphi::parse_task_event(make_record(PERF_RECORD_COMM, payload));
+        REQUIRE(event);
+        CHECK(event->kind == Kind::comm);
+        CHECK(event->pid == 10);
+        CHECK(event->name() == "bash");
+        CHECK(!event->exec);
+    }
+    WHEN("Process calls exec") {
+        const auto payload = make_payload({10, 10}, std::string_view{"ls\0\0\0\0\0\0", 8});
+        auto record = make_record(PERF_RECORD_COMM, payload);
+        record.header.misc = PERF_RECORD_MISC_COMM_EXEC;
+        const auto event = elphi::parse_task_event(record);
+        REQUIRE(event);
+        CHECK(event->name() == "ls");
+        CHECK(event->exec);
+    }
+    WHEN("Thread is renamed") {
+        const auto payload = make_payload({10, 11}, std::string_view{"worker\0\0", 8});
+        THEN("It is ignored") { CHECK(!elphi::parse_task_event(make_record(PERF_RECORD_COMM, payload))); }
+    }
+    WHEN("Process is forked") {
+        const auto payload = make_payload({20, 10, 20, 10, 0, 0});
+        const auto event = elphi::parse_task_event(make_record(PERF_RECORD_FORK, payload));
+        REQUIRE(event);
+        CHECK(event->kind == Kind::fork);
+        CHECK(event->pid == 20);
+        CHECK(event->parent == 10);
+    }
+    WHEN("Thread is created") {
+        const auto payload = make_payload({10, 10, 21, 10, 0, 0});
+        THEN("It is ignored") { CHECK(!elphi::parse_task_event(make_record(PERF_RECORD_FORK, payload))); }
+    }
+    WHEN("Process exits") {
+        const auto payload = make_payload({20, 10, 20, 10, 0, 0});
+        const auto event = elphi::parse_task_event(make_record(PERF_RECORD_EXIT, payload));
+        REQUIRE(event);
+        CHECK(event->kind == Kind::exit);
+        CHECK(event->pid == 20);
+    }
+    WHEN("Record is truncated or of other type") {
+        CHECK(!elphi::parse_task_event(make_record(PERF_RECORD_FORK, make_payload({20, 10}))));
+        CHECK(!elphi::parse_task_event(make_record(PERF_RECORD_SAMPLE, make_payload({20, 10, 20, 10, 0, 0}))));
+        CHECK(!elphi::parse_sample(make_record(PERF_RECORD_COMM, make_payload({10, 10}, "bash"))));
+    }
+}
+
+SCENARIO("Parsing mapping records", "[records]") {
+    // pid, tid, addr, len, pgoff, 24 bytes of file id, prot and flags.
+    const auto make_mmap2 = [](std::uint32_t pid, std::uint32_t prot, std::string_view name) {
+        return make_payload({pid, pid, 0x1000, 0x7f, 0x3000, 0, 0x2000, 0, 0, 0, 0, 0, 0, 0, prot, MAP_PRIVATE}, name);
+    };
+    const auto parse = [](const std::vector<unsigned char>& payload) {
+        return elphi::parse_map_event(make_record(PERF_RECORD_MMAP2, payload));
+    };
+
+    WHEN("Executable file is mapped") {
+        const auto event =
+            parse(make_mmap2(10, PROT_READ | PROT_EXEC, std::string_view{"/usr/lib/libc.so.6\0\0\0\0\0\0", 24}));
+        REQUIRE(event);
+        CHECK(event->kind == elphi::MapEvent::Kind::map);
+        CHECK(event->pid == 10);
+        CHECK(event->start == 0x7f'0000'1000);
+        CHECK(event->size == 0x3000);
+        CHECK(event->offset == 0x2000);
+        CHECK(event->path() == "/usr/lib/libc.so.6");
+    }
+    WHEN("Path is too long") {
+        const auto path = "/" + std::string(elphi::MapEvent::c_path_len, 'a');
+        const auto event = parse(make_mmap2(10, PROT_EXEC, path));
+        REQUIRE(event);
+        THEN("It is truncated") { CHECK(event->path() == path.substr(0, elphi::MapEvent::c_path_len)); }
+    }
+    WHEN("Mapping is not of an executable file") {
+        THEN("It is ignored") {
+            CHECK(!parse(make_mmap2(10, PROT_READ, std::string_view{"/data\0\0\0", 8})));
+            CHECK(!parse(make_mmap2(10, PROT_EXEC, std::string_view{"[vdso]\0\0", 8})));
+            CHECK(!parse(make_mmap2(10, PROT_EXEC, std::string_view{"//anon\0\0", 8})));
+            CHECK(!parse(
+                make_mmap2(std::numeric_limits<std::uint32_t>::max(), PROT_EXEC, std::string_view{"/mod.ko\0", 8})));
+        }
+    }
+    WHEN("Record is truncated or of other type") {
+        CHECK(!elphi::parse_map_event(make_record(PERF_RECORD_MMAP2, make_payload({10, 10, 0x1000}))));
+        CHECK(!elphi::parse_map_event(make_record(PERF_RECORD_COMM, make_payload({10, 10}, "bash"))));
+    }
+}
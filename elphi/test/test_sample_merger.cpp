@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <vector>
+
+#include <catch2/catch_all.hpp>
+#include <elphi/sample_merger.hpp>
+
+using namespace std::chrono_literals;
+
+namespace {
+/*******************************************************************************
+ * @brief Create sample at @p time on @p cpu .
+ ******************************************************************************/
+elphi::CpuSample
+at(elphi::CpuId cpu, elphi::TimePoint time) {
+    return {.pid = 1, .tid = 1, .cpu = cpu, .time = time};
+}
+
+/*******************************************************************************
+ * @brief Collect times of emitted samples.
+ ******************************************************************************/
+struct Collector {
+    void
+    operator()(const elphi::CpuSample& sample) {
+        times.push_back(sample.time);
+    }
+    std::vector<elphi::TimePoint> times;
+};
+} // namespace
+
+SCENARIO("Merging time-ordered sample streams", "[merge]") {
+    GIVEN("Merger of two streams with 10s window") {
+        elphi::SampleMerger merger{2, 10s};
+        Collector out;
+
+        WHEN("Only one stream has samples") {
+            const std::vector samples{at(0, 1s), at(0, 2s), at(0, 3s)};
+            merger.push(0, samples);
+
+            THEN("Nothing is emitted within the window") {
+                CHECK(merger.pop(out) == 0);
+                CHECK(merger.num_pending() == 3);
+            }
+            THEN("Flush emits everything") {
+                CHECK(merger.flush(out) == 3);
+                CHECK(out.times == std::vector<elphi::TimePoint>{1s, 2s, 3s});
+                CHECK(merger.num_pending() == 0);
+            }
+        }
+
+        WHEN("Both streams have interleaved samples") {
+            const std::vector first{at(0, 1s), at(0, 4s), at(0, 5s)};
+            const std::vector second{at(1, 2s), at(1, 3s)};
+            merger.push(0, first);
+            merger.push(1, second);
+
+            THEN("Samples are emitted in order while both streams have samples") {
+                CHECK(merger.pop(out) == 3);
+                CHECK(out.times == std::vector<elphi::TimePoint>{1s, 2s, 3s});
+            }
+            THEN("Flush emits the rest in order") {
+                merger.pop(out);
+                merger.flush(out);
+                CHECK(out.times == std::vector<elphi::TimePoint>{1s, 2s, 3s, 4s, 5s});
+                CHECK(merger.num_late() == 0);
+            }
+        }
+
+        WHEN("One stream gets ahead of the window") {
+            merger.push(0, std::vector{at(0, 1s), at(0, 2s), at(0, 15s)});
+
+            THEN("Samples older than the window are emitted") {
+                CHECK(merger.pop(out) == 2);
+                CHECK(out.times == std::vector<elphi::TimePoint>{1s, 2s});
+            }
+            AND_WHEN("The idle stream delivers a sample older than emitted ones") {
+                merger.pop(out);
+                merger.push(1, std::vector{at(1, 1s)});
+                merger.flush(out);
+
+                THEN("It is reported as late") { CHECK(merger.num_late() == 1); }
+            }
+        }
+    }
+
+    GIVEN("Many random streams") {
+        constexpr std::size_t c_num_streams = 8;
+        // Window covers the shifts between the streams.
+        elphi::SampleMerger merger{c_num_streams, elphi::TimePoint{50}};
+        Collector out;
+
+        std::vector<elphi::CpuSample> all;
+        for (std::size_t round = 0; round < 20; ++round)
+            for (std::size_t stream = 0; stream < c_num_streams; ++stream) {
+                // Streams are shifted by a fraction, ordered within themselves.
+                const auto time = elphi::TimePoint{round * 100 + stream * 7 % 13};
+                std::vector batch{at(stream, time)};
+                merger.push(stream, batch);
+                all.push_back(batch[0]);
+                merger.pop(out);
+            }
+        merger.flush(out);
+
+        THEN("The output is globally ordered") {
+            CHECK(out.times.size() == all.size());
+            CHECK(std::ranges::is_sorted(out.times));
+            CHECK(merger.num_late() == 0);
+        }
+    }
+}
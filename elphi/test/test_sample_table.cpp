@@ -0,0 +1,211 @@
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <vector>
+
+#include <catch2/catch_all.hpp>
+#include <elphi/exception.hpp>
+#include <elphi/sample_table.hpp>
+#include <elphi/timeline_view.hpp>
+
+using namespace std::chrono_literals;
+namespace velphi = elphi::view;
+
+namespace {
+/*******************************************************************************
+ * @brief Time-ordered samples of a few processes, threads and CPUs.
+ ******************************************************************************/
+std::vector<elphi::CpuSample>
+make_samples(std::size_t num) {
+    std::mt19937 gen{42};
+    std::vector<elphi::CpuSample> samples;
+    std::int64_t time = 0;
+    for (std::size_t i = 0; i < num; ++i) {
+        // Some samples share the time.
+        time += static_cast<std::int64_t>(gen() % 3);
+        const auto pid = static_cast<elphi::ProcId>(100 + gen() % 5);
+        samples.push_back({.pid = pid,
+                           .tid = pid + static_cast<elphi::ThreadId>(gen() % 2),
+                           .cpu = gen() % 6,
+                           .time = elphi::TimePoint{time},
+                           .cgroup = gen() % 3,
+                           .kind = gen() % 2 == 0 ? elphi::SampleKind::tick : elphi::SampleKind::switch_out,
+                           .stack = static_cast<elphi::StackId>(gen() % 7)});
+    }
+    return samples;
+}
+
+/*******************************************************************************
+ * @brief Concatenation of @p first and @p second , stably sorted by time.
+ ******************************************************************************/
+std::vector<elphi::CpuSample>
+merged(std::span<const elphi::CpuSample> first, std::span<const elphi::CpuSample> second) {
+    std::vector<elphi::CpuSample> samples(first.begin(), first.end());
+    samples.insert(samples.end(), second.begin(), second.end());
+    std::ranges::stable_sort(samples, {}, &elphi::CpuSample::time);
+    return samples;
+}
+
+/*******************************************************************************
+ * @brief Whether @p table holds exactly @p samples in order.
+ ******************************************************************************/
+bool
+holds(const velphi::SampleTable& table, std::span<const elphi::CpuSample> samples) {
+    if (table.size() != samples.size())
+        return false;
+    for (std::size_t i = 0; i < samples.size(); ++i) {
+        const auto row = table.row(i);
+        const auto& sample = samples[i];
+        if (row.time != sample.time || row.pid != sample.pid || row.tid != sample.tid || row.cpu != sample.cpu ||
+            row.cgroup != sample.cgroup || row.kind != sample.kind || row.stack != sample.stack)
+            return false;
+    }
+    return true;
+}
+
+/*******************************************************************************
+ * @brief Filter of all the fields.
+ ******************************************************************************/
+velphi::SampleFilter
+filter_of(std::optional<elphi::ProcId> pid, std::optional<elphi::ThreadId> tid, std::optional<elphi::CpuId> cpu,
+          elphi::TimePoint from = elphi::TimePoint::min(), elphi::TimePoint to = elphi::TimePoint::max()) {
+    return {.pid = pid, .tid = tid, .cpu = cpu, .from = from, .to = to};
+}
+
+/*******************************************************************************
+ * @brief Whether @p sample matches @p filter , the reference of the kernels.
+ ******************************************************************************/
+bool
+matches(const velphi::SampleFilter& filter, const elphi::CpuSample& sample) {
+    return (!filter.pid || *filter.pid == sample.pid) && (!filter.tid || *filter.tid == sample.tid) &&
+           (!filter.cpu || *filter.cpu == sample.cpu) && filter.from <= sample.time && sample.time <= filter.to;
+}
+} // namespace
+
+SCENARIO("Columnar sample storage", "[view][sample_table]") {
+    GIVEN("Table of samples") {
+        const auto samples = make_samples(1003);
+        const velphi::SampleTable table{samples};
+
+        THEN("Samples are stored as they are") {
+            REQUIRE(table.size() == samples.size());
+            CHECK(table.times().size() == samples.size());
+            CHECK(table.cpus()[7] == samples[7].cpu);
+            for (std::size_t i = 0; i < samples.size(); ++i) {
+                const auto sample = table.row(i);
+                CHECK(sample.time == samples[i].time);
+                CHECK(sample.pid == samples[i].pid);
+                CHECK(sample.tid == samples[i].tid);
+                CHECK(sample.cpu == samples[i].cpu);
+                CHECK(sample.cgroup == samples[i].cgroup);
+                CHECK(sample.kind == samples[i].kind);
+                CHECK(sample.stack == samples[i].stack);
+            }
+        }
+    }
+    GIVEN("Filter of a table") {
+        const auto samples = make_samples(1003);
+        const velphi::SampleTable table{samples};
+        const auto kernel = GENERATE(velphi::ScanKernel::scalar, velphi::ScanKernel::sse2, velphi::ScanKernel::avx2);
+        const auto none = std::nullopt;
+        const auto filter = GENERATE_COPY(filter_of(none, none, none),
+                                          filter_of(102, none, none),
+                                          filter_of(102, none, none, 17ns, 513ns),
+                                          filter_of(101, 102, 3),
+                                          filter_of(none, none, 5, 3ns),
+                                          filter_of(none, 104, none, elphi::TimePoint::min(), 998ns),
+                                          filter_of(100, none, none, 500ns, 499ns),
+                                          filter_of(999, none, none),
+                                          filter_of(none, none, 65536 + 3),
+                                          filter_of(none, none, none, 100ns, 200ns));
+        std::vector<std::size_t> expected;
+        for (std::size_t i = 0; i < samples.size(); ++i)
+            if (matches(filter, samples[i]))
+                expected.push_back(i);
+
+        WHEN("Filtered") {
+            std::vector<std::size_t> rows{7};
+            const auto num = table.select(filter, rows, kernel);
+
+            THEN("Exactly the matching rows are counted and selected") {
+                CHECK(table.count(filter, kernel) == expected.size());
+                CHECK(num == expected.size());
+                REQUIRE(!rows.empty());
+                CHECK(rows.front() == 7);
+                CHECK(std::vector(rows.begin() + 1, rows.end()) == expected);
+            }
+        }
+        WHEN("Passed to a view in batches") {
+            std::vector<elphi::CpuSample> passed;
+            const auto num = table.for_each_batch(filter, [&passed](std::span<const elphi::CpuSample> batch) {
+                CHECK(!batch.empty());
+                CHECK(batch.size() <= velphi::SampleTable::c_batch_size);
+                passed.insert(passed.end(), batch.begin(), batch.end());
+            });
+
+            THEN("The view gets the matching samples in order") {
+                REQUIRE(num == expected.size());
+                REQUIRE(passed.size() == expected.size());
+                for (std::size_t i = 0; i < passed.size(); ++i)
+                    CHECK(passed[i].time == samples[expected[i]].time);
+            }
+        }
+    }
+    GIVEN("Timeline built from a table") {
+        const auto samples = make_samples(5000);
+        const velphi::SampleTable table{samples};
+        velphi::TimelineBuilder from_table;
+        table.for_each_batch({}, [&from_table](std::span<const elphi::CpuSample> batch) { from_table.add(batch); });
+
+        THEN("It is the same as built from the samples") {
+            velphi::TimelineBuilder from_samples;
+            from_samples.add(samples);
+            CHECK(from_table.timeline() == from_samples.timeline());
+        }
+    }
+    GIVEN("Table of ordered samples") {
+        const auto ordered = make_samples(1000);
+        velphi::SampleTable table{std::span{ordered}.first(900)};
+
+        WHEN("Samples older than the table are appended") {
+            const auto older = make_samples(30);
+            table.append(older);
+
+            THEN("They are inserted in order after the rows of the same time") {
+                CHECK(holds(table, merged(std::span{ordered}.first(900), older)));
+            }
+        }
+        WHEN("A merger emits a late sample among newer ones") {
+            std::vector<elphi::CpuSample> batch(ordered.begin() + 900, ordered.end());
+            auto late = ordered[850];
+            late.pid = 999;
+            batch.insert(batch.begin() + 50, late);
+            table.append(batch);
+
+            THEN("It is inserted among the rows of its time") {
+                CHECK(holds(table, merged(std::span{ordered}.first(900), batch)));
+                CHECK(std::ranges::is_sorted(table.times()));
+                CHECK(table.count(filter_of(999, {}, {}, late.time, late.time)) == 1);
+            }
+        }
+    }
+    GIVEN("Invalid samples") {
+        velphi::SampleTable table{make_samples(10)};
+        auto samples = make_samples(3);
+
+        WHEN("Appended with a wide CPU") {
+            for (auto& sample : samples)
+                sample.time += 1h;
+            samples.back().cpu = 70'000;
+
+            THEN("Nothing is appended") {
+                CHECK_THROWS_AS(table.append(samples), elphi::ElphiException);
+                CHECK(table.size() == 10);
+                samples.back().cpu = 65'535;
+                table.append(samples);
+                CHECK(table.size() == 13);
+            }
+        }
+    }
+}
@@ -1,6 +1,9 @@
+#include <bit>
+
 #include <catch2/catch_all.hpp>
 #include <catch2/matchers/catch_matchers_all.hpp>
 #include <elphi/cpu_sampler.hpp>
+#include <elphi/utils.hpp>
 
 
 using namespace std::chrono_literals;
@@ -23,3 +26,112 @@ SCENARIO("Synchronous sampling of system execution", "[sampling]") {
         }
     }
 }
+
+SCENARIO("Distributing CPUs among sampling readers", "[sampling]") {
+    const std::vector<elphi::CpuId> cpus{0, 1, 2, 3, 4, 5, 6};
+
+    GIVEN("Contiguous sharding") {
+        WHEN("Sharded into fewer shards than CPUs") {
+            auto shards = elphi::shard_cpus(cpus, 3);
+
+            THEN("Shards are contiguous and balanced") {
+                using Shards = std::vector<std::vector<elphi::CpuId>>;
+                CHECK(shards == Shards{{0, 1}, {2, 3}, {4, 5, 6}});
+            }
+        }
+        WHEN("Sharded into more shards than CPUs") {
+            auto shards = elphi::shard_cpus(cpus, 100);
+
+            THEN("Each CPU has its own shard") { CHECK_THAT(shards, Catch::Matchers::SizeIs(cpus.size())); }
+        }
+        WHEN("Sharded into zero shards") {
+            auto shards = elphi::shard_cpus(cpus, 0);
+
+            THEN("There is a single shard") { CHECK_THAT(shards, Catch::Matchers::SizeIs(1)); }
+        }
+        WHEN("No CPUs are sharded") {
+            auto shards = elphi::shard_cpus({}, 4);
+
+            THEN("There are no shards") { CHECK_THAT(shards, Catch::Matchers::IsEmpty()); }
+        }
+    }
+
+    GIVEN("NUMA sharding") {
+        WHEN("CPUs are interleaved between two nodes") {
+            auto shards = elphi::shard_cpus_by_node(cpus, [](elphi::CpuId cpu) { return cpu % 2; });
+
+            THEN("Each node has its shard") {
+                using Shards = std::vector<std::vector<elphi::CpuId>>;
+                CHECK(shards == Shards{{0, 2, 4, 6}, {1, 3, 5}});
+            }
+        }
+    }
+}
+
+SCENARIO("Sizing ring buffers of the sampled CPUs", "[sampling]") {
+    const std::vector<elphi::CpuId> cpus{0, 1, 2, 3};
+    const auto page = elphi::c_page_size;
+    // One page worth of records per second.
+    const std::size_t record_size = 64;
+    const std::size_t record_rate = page / record_size;
+
+    GIVEN("Policy without history") {
+        const elphi::RingPolicy policy{.drain_latency = 3s};
+
+        WHEN("Sized without budget") {
+            auto pages = elphi::size_rings(cpus, record_rate, record_size, policy, 0);
+
+            THEN("Each ring holds the latency worth of records, rounded up to a power of two") {
+                REQUIRE(pages.size() == cpus.size());
+                for (auto cpu : cpus)
+                    CHECK(pages.at(cpu) == 4);
+            }
+        }
+        WHEN("Sized within small budget") {
+            auto pages = elphi::size_rings(cpus, record_rate, record_size, policy, 10 * page);
+
+            THEN("The rings are shrunk to fit") {
+                std::size_t total = 0;
+                for (auto cpu : cpus) {
+                    CHECK(std::has_single_bit(pages.at(cpu)));
+                    total += pages.at(cpu);
+                }
+                CHECK(total <= 10);
+            }
+        }
+        WHEN("Budget cannot fit even single pages") {
+            auto pages = elphi::size_rings(cpus, record_rate, record_size, policy, page);
+
+            THEN("Each ring has a single page") {
+                for (auto cpu : cpus)
+                    CHECK(pages.at(cpu) == 1);
+            }
+        }
+    }
+
+    GIVEN("History of a previous session") {
+        elphi::RingPolicy policy{.drain_latency = 8s};
+        policy.history = {
+            {0, {.num_records = 1000}},
+            {1, {.num_records = 1000, .num_lost = 10}},
+            {2, {.num_records = 10}},
+        };
+
+        WHEN("Sized without budget") {
+            auto pages = elphi::size_rings(cpus, record_rate, record_size, policy, 0);
+
+            THEN("Busy CPUs get larger rings, overflowing ones the largest") {
+                CHECK(pages.at(0) == 8);
+                CHECK(pages.at(1) == 16);
+                CHECK(pages.at(2) == 1);
+            }
+            THEN("CPUs without history are assumed busy") { CHECK(pages.at(3) == 8); }
+        }
+        WHEN("Drains were slower than expected") {
+            policy.history[0].max_drain_interval = 8s;
+            auto pages = elphi::size_rings(cpus, record_rate, record_size, policy, 0);
+
+            THEN("Rings hold records of twice the interval") { CHECK(pages.at(0) == 16); }
+        }
+    }
+}
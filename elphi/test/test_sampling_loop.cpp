@@ -0,0 +1,113 @@
+/*******************************************************************************
+ * Allocations of the steady-state sampling loop.
+ ******************************************************************************/
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch_all.hpp>
+#include <elphi/perf_records.hpp>
+#include <elphi/sampling_session.hpp>
+
+#include "alloc_counter.hpp"
+#include "mock_ring.hpp"
+
+using namespace std::chrono_literals;
+
+namespace {
+/*! Fields of the written samples. */
+constexpr std::uint64_t c_sample_type = elphi::c_sample_type | PERF_SAMPLE_READ | PERF_SAMPLE_CALLCHAIN;
+/*! Samples written before waiting for the sinks, fewer than the merger's streams hold without growing. */
+constexpr std::size_t c_burst_size = 32;
+/*! Frames of the written stacks besides the deepest one. */
+constexpr std::array<std::size_t, 3> c_depths{1, 16, 40};
+/*! Most frames of the deepest stack, any depth above the parser's limit yields the same stack. */
+constexpr std::size_t c_max_depth = elphi::c_max_callchain_depth + 100;
+/*! Largest record written by @ref MockRing::write_sample. */
+constexpr std::size_t c_max_record_size =
+    sizeof(perf_event_header) + MockRing::c_max_sample_words * sizeof(std::uint64_t);
+
+/*******************************************************************************
+ * @brief Wait without allocating until @p done , at most a few seconds.
+ ******************************************************************************/
+template <typename Pred>
+void
+wait_for(Pred&& done) {
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (!done() && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(1ms);
+}
+} // namespace
+
+SCENARIO("Steady state of the sampling loop", "[sampling][allocations]") {
+    GIVEN("Session sampling call stacks and counters of a CPU") {
+        MockRing ring{1};
+        auto config = mock_ring_config();
+        // Streams of the merger hold a consume period of samples, i.e. more than a burst.
+        config.frequency = 1000;
+        config.sample_callchains = true;
+        config.events = {.sampled = elphi::Counter::cycles,
+                         .counters = {elphi::Counter::instructions, elphi::Counter::cache_misses}};
+        elphi::SamplingSession session{config};
+
+        std::atomic<std::size_t> num_samples{0};
+        std::atomic<std::size_t> num_values{0};
+        // Depth of each stack node, the root has none.
+        std::vector<std::size_t> depths{0};
+        session.add_sink([&num_samples](std::span<const elphi::CpuSample> samples) {
+            num_samples.fetch_add(samples.size(), std::memory_order_release);
+        });
+        session.add_counter_sink([&num_values](std::span<const elphi::CounterValues> values) {
+            num_values.fetch_add(values.size(), std::memory_order_relaxed);
+        });
+        session.add_stack_sink([&depths](elphi::StackId id, elphi::StackId parent, auto&&...) {
+            depths.resize(std::max<std::size_t>(depths.size(), id + 1));
+            depths[id] = depths[parent] + 1;
+        });
+
+        std::array<std::uint64_t, c_max_depth> frames{};
+        for (std::size_t i = 0; i < frames.size(); ++i)
+            frames[i] = 0x1000 + 0x10 * i;
+        std::size_t num_written = 0;
+        // Stands in for the kernel, then waits until the sinks get the samples.
+        const auto burst = [&](std::size_t num, std::size_t deepest) {
+            for (std::size_t i = 0; i < num; ++i) {
+                // Unread records are never overwritten.
+                wait_for([&ring] { return ring.free_space() >= c_max_record_size; });
+                ++num_written;
+                const std::array<std::uint64_t, 2> totals{num_written * 10, num_written * 20};
+                const auto stack = num_written % (c_depths.size() + 1);
+                const auto depth = stack < c_depths.size() ? c_depths[stack] : deepest;
+                ring.write_sample(c_sample_type, {.pid = 100, .tid = 101, .cpu = 0, .time = 1us * num_written}, totals,
+                                  std::span{frames}.first(depth));
+            }
+            wait_for([&] { return num_samples.load(std::memory_order_acquire) == num_written; });
+        };
+
+        WHEN("Warmed up by single samples of all the stacks") {
+            session.start();
+            for (std::size_t i = 0; i <= c_depths.size(); ++i)
+                burst(1, elphi::c_max_callchain_depth + 50);
+
+            THEN("Neither the reader nor the consumer allocate for bursts of deeper stacks") {
+                // Besides this thread, only the session's threads run.
+                const auto own_start = thread_allocations();
+                const auto all_start = process_allocations();
+                for (int i = 0; i < 10; ++i)
+                    burst(c_burst_size, c_max_depth);
+                const auto num_allocs = (process_allocations() - all_start) - (thread_allocations() - own_start);
+                session.stop();
+
+                CHECK(num_allocs == 0);
+                CHECK(num_samples == num_written);
+                CHECK(num_values == num_written);
+                CHECK(std::ranges::max(depths) == elphi::c_max_callchain_depth);
+            }
+        }
+    }
+}
@@ -0,0 +1,240 @@
+#include <array>
+#include <cerrno>
+#include <vector>
+
+#include <catch2/catch_all.hpp>
+#include <elphi/elf_symbols.hpp>
+#include <elphi/perf_records.hpp>
+#include <elphi/sampling_session.hpp>
+
+#include "mock_ring.hpp"
+#include "mock_syscalls.hpp"
+
+using namespace std::chrono_literals;
+
+namespace {
+/*******************************************************************************
+ * @brief Restores the real perf_event_open on destruction.
+ ******************************************************************************/
+struct RealPerfEventGuard {
+    RealPerfEventGuard() = default;
+    RealPerfEventGuard(const RealPerfEventGuard&) = delete;
+    RealPerfEventGuard(RealPerfEventGuard&&) = delete;
+    RealPerfEventGuard&
+    operator=(const RealPerfEventGuard&) = delete;
+    RealPerfEventGuard&
+    operator=(RealPerfEventGuard&&) = delete;
+    ~RealPerfEventGuard() { SysMock::use_real_syscall("perf_event"); }
+};
+} // namespace
+
+SCENARIO("Sampling session lifecycle", "[sampling][session]") {
+    GIVEN("Session sampling no CPUs") {
+        elphi::SamplingSession session{elphi::SamplingConfig{.cpus = {}, .frequency = 5}};
+        std::size_t num_samples = 0;
+        session.add_sink([&num_samples](std::span<const elphi::CpuSample> samples) { num_samples += samples.size(); });
+
+        THEN("It is created") { CHECK(session.state() == elphi::SessionState::created); }
+
+        WHEN("Started") {
+            session.start();
+
+            THEN("It is running") { CHECK(session.state() == elphi::SessionState::running); }
+            THEN("No more sinks can be added") { CHECK_THROWS_AS(session.add_sink({}), elphi::ElphiException); }
+
+            AND_WHEN("Paused and resumed") {
+                session.pause();
+                CHECK(session.state() == elphi::SessionState::paused);
+                session.start();
+
+                THEN("It is running again") { CHECK(session.state() == elphi::SessionState::running); }
+            }
+
+            AND_WHEN("Stopped") {
+                session.stop();
+
+                THEN("It is stopped without samples") {
+                    CHECK(session.state() == elphi::SessionState::stopped);
+                    CHECK(num_samples == 0);
+                }
+                THEN("It cannot be restarted") { CHECK_THROWS_AS(session.start(), elphi::ElphiException); }
+                THEN("Second stop is no-op") { CHECK_NOTHROW(session.stop()); }
+            }
+        }
+
+        WHEN("Stopped without being started") {
+            session.stop();
+
+            THEN("It is stopped") { CHECK(session.state() == elphi::SessionState::stopped); }
+        }
+    }
+
+    GIVEN("Session of a CPU whose events emit samples only while enabled") {
+        MockRing ring{1};
+        elphi::SamplingSession session{mock_ring_config()};
+        std::size_t num_samples = 0;
+        session.add_sink([&num_samples](std::span<const elphi::CpuSample> samples) { num_samples += samples.size(); });
+        // Stands in for the kernel.
+        auto time = elphi::TimePoint::zero();
+        const auto tick = [&ring, &time] {
+            time += 1ms;
+            if (ring.enabled())
+                ring.write_sample(elphi::c_sample_type, {.pid = 100, .tid = 100, .cpu = 0, .time = time});
+        };
+
+        THEN("The events are disabled") { CHECK(!ring.enabled()); }
+
+        WHEN("Ticking before and after the start") {
+            for (int i = 0; i < 5; ++i)
+                tick();
+            session.start();
+            for (int i = 0; i < 3; ++i)
+                tick();
+            session.stop();
+
+            THEN("Nothing is sampled before the start") { CHECK(num_samples == 3); }
+        }
+    }
+}
+
+SCENARIO("Sampling hardware counters", "[sampling][session]") {
+    GIVEN("More counters than supported") {
+        elphi::SamplingConfig config{.cpus = {}, .frequency = 5};
+        config.events.counters.assign(elphi::c_max_counters + 1, elphi::Counter::cycles);
+
+        THEN("Session cannot be created") { CHECK_THROWS_AS(elphi::SamplingSession{config}, elphi::ElphiException); }
+    }
+
+    GIVEN("System without PMU where no event can be opened") {
+        const RealPerfEventGuard guard;
+        std::vector<perf_event_attr> opened;
+        SysMock::set_perf_event_clbk([&opened](const perf_event_attr& attr, auto&&...) {
+            opened.push_back(attr);
+            errno = ENOENT;
+            return -1;
+        });
+
+        WHEN("Hardware events are requested") {
+            elphi::SamplingConfig config{.cpus = {0}, .frequency = 5};
+            config.events = {.sampled = elphi::Counter::cycles, .counters = {elphi::Counter::instructions}};
+            CHECK_THROWS_AS(elphi::SamplingSession{config}, elphi::ElphiException);
+
+            THEN("Software events without counters are tried next") {
+                REQUIRE(opened.size() == 2);
+                CHECK(opened[0].type == PERF_TYPE_HARDWARE);
+                CHECK(opened[0].config == PERF_COUNT_HW_CPU_CYCLES);
+                CHECK((opened[0].sample_type & PERF_SAMPLE_READ) != 0);
+                CHECK(opened[0].read_format == PERF_FORMAT_GROUP);
+                CHECK(opened[1].type == PERF_TYPE_SOFTWARE);
+                CHECK(opened[1].config == PERF_COUNT_SW_TASK_CLOCK);
+                CHECK((opened[1].sample_type & PERF_SAMPLE_READ) == 0);
+            }
+        }
+        WHEN("Software events are requested") {
+            CHECK_THROWS_AS(elphi::SamplingSession(elphi::SamplingConfig{.cpus = {0}, .frequency = 5}),
+                            elphi::ElphiException);
+
+            THEN("There is nothing to fall back to") { CHECK(opened.size() == 1); }
+        }
+    }
+
+    GIVEN("Context switches traced without samples") {
+        const RealPerfEventGuard guard;
+        std::vector<perf_event_attr> opened;
+        SysMock::set_perf_event_clbk([&opened](const perf_event_attr& attr, auto&&...) {
+            opened.push_back(attr);
+            errno = ENOENT;
+            return -1;
+        });
+        const elphi::SamplingConfig config{.cpus = {0}, .frequency = 0, .trace_switches = true};
+        CHECK_THROWS_AS(elphi::SamplingSession{config}, elphi::ElphiException);
+
+        THEN("The event emits only switch records") {
+            REQUIRE(opened.size() == 1);
+            CHECK(opened[0].context_switch == 1);
+            CHECK(opened[0].sample_id_all == 1);
+            CHECK(opened[0].freq == 0);
+            CHECK(opened[0].sample_period == 0);
+        }
+    }
+
+    GIVEN("Symbolized call stacks") {
+        const RealPerfEventGuard guard;
+        std::vector<perf_event_attr> opened;
+        SysMock::set_perf_event_clbk([&opened](const perf_event_attr& attr, auto&&...) {
+            opened.push_back(attr);
+            errno = ENOENT;
+            return -1;
+        });
+        elphi::SamplingConfig config{.cpus = {0}, .frequency = 5, .sample_callchains = true};
+        config.symbols = std::make_shared<elphi::SymbolCache>();
+        CHECK_THROWS_AS(elphi::SamplingSession{config}, elphi::ElphiException);
+
+        THEN("Executable mappings are recorded") {
+            REQUIRE(opened.size() == 1);
+            CHECK(opened[0].mmap == 1);
+            CHECK(opened[0].mmap2 == 1);
+        }
+        WHEN("Call stacks are not sampled") {
+            config.sample_callchains = false;
+            THEN("Session cannot be created") {
+                CHECK_THROWS_AS(elphi::SamplingSession{config}, elphi::ElphiException);
+                CHECK(opened.size() == 1);
+            }
+        }
+    }
+
+    GIVEN("Neither samples nor context switches") {
+        const elphi::SamplingConfig config{.cpus = {}, .frequency = 0};
+
+        THEN("Session cannot be created") { CHECK_THROWS_AS(elphi::SamplingSession{config}, elphi::ElphiException); }
+    }
+
+    GIVEN("Context switches traced together with cgroups") {
+        const elphi::SamplingConfig config{.cpus = {}, .frequency = 5, .trace_switches = true, .sample_cgroups = true};
+
+        THEN("Session cannot be created") { CHECK_THROWS_AS(elphi::SamplingSession{config}, elphi::ElphiException); }
+    }
+
+    GIVEN("PMU where all the events can be opened") {
+        MockRing ring{1};
+        auto config = mock_ring_config();
+        config.events = {.sampled = elphi::Counter::cycles,
+                         .counters = {elphi::Counter::instructions, elphi::Counter::cache_misses}};
+        elphi::SamplingSession session{config};
+        std::vector<elphi::CpuSample> samples;
+        std::vector<elphi::CounterValues> values;
+        session.add_sink([&samples](std::span<const elphi::CpuSample> batch) {
+            samples.insert(samples.end(), batch.begin(), batch.end());
+        });
+        session.add_counter_sink([&values](std::span<const elphi::CounterValues> batch) {
+            values.insert(values.end(), batch.begin(), batch.end());
+        });
+
+        THEN("The sampled event and its counters are opened without falling back") {
+            CHECK(ring.num_opened() == 3);
+            CHECK(session.events().counters == config.events.counters);
+        }
+        WHEN("Samples are taken") {
+            session.start();
+            constexpr auto sample_type = elphi::c_sample_type | PERF_SAMPLE_READ;
+            const std::array<std::array<std::uint64_t, 2>, 3> totals{{{10, 20}, {25, 60}, {40, 70}}};
+            for (std::size_t i = 0; i < totals.size(); ++i)
+                ring.write_sample(sample_type, {.pid = 100, .tid = 100, .cpu = 0, .time = 1ms * (i + 1)}, totals[i]);
+            session.stop();
+
+            THEN("Increments of the counters reach the counter sinks") {
+                CHECK(samples.size() == totals.size());
+                CHECK(values == std::vector<elphi::CounterValues>{{10, 20, 0, 0}, {15, 40, 0, 0}, {15, 10, 0, 0}});
+            }
+        }
+    }
+
+    GIVEN("Session of no CPUs with counters") {
+        elphi::SamplingConfig config{.cpus = {}, .frequency = 5};
+        config.events.counters = {elphi::Counter::cycles, elphi::Counter::instructions};
+        elphi::SamplingSession session{config};
+
+        THEN("The events are kept") { CHECK(session.events().counters == config.events.counters); }
+    }
+}
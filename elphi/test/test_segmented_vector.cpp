@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <numeric>
+#include <span>
+#include <vector>
+
+#include <catch2/catch_all.hpp>
+#include <elphi/segmented_vector.hpp>
+
+namespace {
+/*! Element spanning a few blocks for small counts. */
+struct Wide {
+    std::uint64_t value;
+    std::array<std::uint64_t, 511> padding;
+};
+
+/*******************************************************************************
+ * @brief Elements of @p vec gathered through its segments.
+ ******************************************************************************/
+template <typename T>
+std::vector<T>
+gather(const elphi::SegmentedVector<T>& vec) {
+    std::vector<T> values;
+    vec.for_each_segment([&values](std::span<const T> segment) {
+        CHECK(segment.size() <= elphi::SegmentedVector<T>::c_segment_size);
+        values.insert(values.end(), segment.begin(), segment.end());
+    });
+    return values;
+}
+} // namespace
+
+SCENARIO("Segmented vector", "[segmented_vector]") {
+    using Vec = elphi::SegmentedVector<std::uint64_t>;
+    constexpr auto c_segment = Vec::c_segment_size;
+    auto pool = std::make_shared<elphi::BlockPool>();
+
+    GIVEN("Empty vector") {
+        Vec vec{pool};
+        THEN("It has no blocks") {
+            CHECK(vec.empty());
+            CHECK(vec.begin() == vec.end());
+            CHECK(gather(vec).empty());
+            CHECK(pool->num_blocks() == 0);
+        }
+    }
+    GIVEN("Vector of a few blocks") {
+        Vec vec{pool};
+        const std::size_t num = c_segment * 3 + 7;
+        std::vector<const std::uint64_t*> addresses;
+        for (std::size_t i = 0; i < num; ++i)
+            addresses.push_back(&vec.push_back(i));
+
+        THEN("Elements keep their addresses and order") {
+            REQUIRE(vec.size() == num);
+            CHECK(pool->num_blocks() == 4);
+            for (std::size_t i = 0; i < num; ++i) {
+                CHECK(&vec[i] == addresses[i]);
+                CHECK(vec[i] == i);
+            }
+            std::vector<std::uint64_t> expected(num);
+            std::iota(expected.begin(), expected.end(), 0);
+            CHECK(gather(vec) == expected);
+            CHECK(std::vector<std::uint64_t>(vec.begin(), vec.end()) == expected);
+            CHECK(vec.back() == num - 1);
+        }
+        THEN("Iterators are random-access") {
+            STATIC_REQUIRE(std::random_access_iterator<Vec::Iterator>);
+            const auto it = std::ranges::partition_point(vec, [](auto value) { return value < c_segment + 5; });
+            CHECK(it - vec.begin() == static_cast<std::ptrdiff_t>(c_segment + 5));
+            CHECK(*it == c_segment + 5);
+            CHECK(vec.begin()[10] == 10);
+        }
+        WHEN("Front is removed") {
+            vec.pop_front(c_segment + 2);
+
+            THEN("Only whole blocks are released and the rest stays in place") {
+                CHECK(vec.size() == num - c_segment - 2);
+                CHECK(pool->num_free() == 1);
+                CHECK(vec[0] == c_segment + 2);
+                CHECK(&vec[0] == addresses[c_segment + 2]);
+                CHECK(gather(vec).front() == c_segment + 2);
+                CHECK(gather(vec).size() == vec.size());
+            }
+            AND_WHEN("More elements are appended") {
+                for (std::size_t i = 0; i < c_segment; ++i)
+                    vec.push_back(num + i);
+
+                THEN("The released block is reused") {
+                    CHECK(pool->num_free() == 0);
+                    CHECK(pool->num_blocks() == 4);
+                    CHECK(vec.back() == num + c_segment - 1);
+                }
+            }
+        }
+        WHEN("All elements are removed") {
+            vec.pop_front(num + 10);
+
+            THEN("All blocks are free") {
+                CHECK(vec.empty());
+                CHECK(pool->num_free() == 4);
+                pool->trim();
+                CHECK(pool->num_blocks() == 0);
+            }
+        }
+        WHEN("Moved to a vector") {
+            std::vector<std::uint64_t> dest{42};
+            vec.move_to(dest);
+
+            THEN("Elements are appended at once and the blocks freed") {
+                CHECK(vec.empty());
+                REQUIRE(dest.size() == num + 1);
+                CHECK(dest.capacity() == dest.size());
+                CHECK(dest[0] == 42);
+                CHECK(dest[1] == 0);
+                CHECK(dest.back() == num - 1);
+                CHECK(pool->num_blocks() == 0);
+            }
+        }
+        WHEN("Copied and moved") {
+            Vec copy = vec;
+            Vec moved = std::move(vec);
+
+            THEN("The copy has its own blocks, the move takes them") {
+                CHECK(gather(copy) == gather(moved));
+                CHECK(&moved[0] == addresses[0]);
+                CHECK(vec.empty()); // NOLINT - checking the moved-from state.
+                CHECK(pool->num_blocks() == 8);
+            }
+        }
+    }
+    GIVEN("Vector without a pool") {
+        elphi::SegmentedVector<Wide> vec;
+        std::vector<Wide> values(10);
+        for (std::size_t i = 0; i < values.size(); ++i)
+            values[i].value = i;
+
+        WHEN("Appended in spans crossing blocks") {
+            vec.append(std::span{values}.first(3));
+            vec.append(std::span{values}.subspan(3));
+
+            THEN("It creates a pool of its own") {
+                REQUIRE(vec.pool() != nullptr);
+                const auto per_block = elphi::SegmentedVector<Wide>::c_segment_size;
+                CHECK(vec.pool()->num_blocks() == (values.size() + per_block - 1) / per_block);
+                const auto gathered = gather(vec);
+                REQUIRE(gathered.size() == values.size());
+                for (std::size_t i = 0; i < values.size(); ++i)
+                    CHECK(gathered[i].value == i);
+            }
+        }
+    }
+}
@@ -0,0 +1,83 @@
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch_all.hpp>
+#include <elphi/spsc_queue.hpp>
+
+namespace {
+/*******************************************************************************
+ * @brief Pop all elements from @p queue .
+ ******************************************************************************/
+std::vector<int>
+consume_all(elphi::SpscQueue<int>& queue) {
+    std::vector<int> values;
+    queue.consume([&values](std::span<const int> chunk) { values.insert(values.end(), chunk.begin(), chunk.end()); });
+    return values;
+}
+} // namespace
+
+SCENARIO("Single-threaded SPSC queue operations", "[spsc]") {
+    GIVEN("Empty queue") {
+        elphi::SpscQueue<int> queue{5};
+
+        THEN("Capacity is rounded to power of two") { CHECK(queue.capacity() == 8); }
+        THEN("Nothing is consumed") {
+            CHECK(queue.size() == 0);
+            CHECK(consume_all(queue).empty());
+        }
+
+        WHEN("Filled to the capacity") {
+            for (int i = 0; i < 8; ++i)
+                REQUIRE(queue.try_push(i));
+
+            THEN("Further pushes fail") { CHECK(!queue.try_push(8)); }
+            THEN("All values are consumed in order") {
+                CHECK(consume_all(queue) == std::vector<int>{0, 1, 2, 3, 4, 5, 6, 7});
+                CHECK(queue.size() == 0);
+                CHECK(queue.try_push(8));
+            }
+        }
+
+        WHEN("Values wrap around the end of the storage") {
+            for (int i = 0; i < 6; ++i)
+                REQUIRE(queue.try_push(i));
+            (void)consume_all(queue);
+            for (int i = 6; i < 12; ++i)
+                REQUIRE(queue.try_push(i));
+
+            THEN("Values are consumed in two chunks, in order") {
+                std::size_t num_chunks = 0;
+                std::vector<int> values;
+                auto num = queue.consume([&](std::span<const int> chunk) {
+                    ++num_chunks;
+                    values.insert(values.end(), chunk.begin(), chunk.end());
+                });
+                CHECK(num == 6);
+                CHECK(num_chunks == 2);
+                CHECK(values == std::vector<int>{6, 7, 8, 9, 10, 11});
+            }
+        }
+    }
+}
+
+TEST_CASE("SPSC queue hands over all values between threads", "[spsc]") {
+    constexpr int c_num_values = 200'000;
+    elphi::SpscQueue<int> queue{64};
+
+    std::jthread producer{[&queue] {
+        for (int i = 0; i < c_num_values; ++i)
+            while (!queue.try_push(i))
+                std::this_thread::yield();
+    }};
+
+    std::vector<int> values;
+    values.reserve(c_num_values);
+    while (values.size() < c_num_values)
+        queue.consume(
+            [&values](std::span<const int> chunk) { values.insert(values.end(), chunk.begin(), chunk.end()); });
+
+    std::vector<int> exp_values(c_num_values);
+    std::iota(exp_values.begin(), exp_values.end(), 0);
+    CHECK(values == exp_values);
+}
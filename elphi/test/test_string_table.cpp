@@ -0,0 +1,48 @@
+#include <catch2/catch_all.hpp>
+#include <elphi/string_table.hpp>
+
+SCENARIO("Interning strings", "[strings]") {
+    GIVEN("Empty table") {
+        elphi::StringTable table;
+
+        THEN("Unknown name is present") {
+            CHECK(table.size() == 1);
+            CHECK(table.resolve(elphi::c_unknown_name) == "UNKNOWN");
+            CHECK(table.intern("UNKNOWN") == elphi::c_unknown_name);
+        }
+        THEN("Unknown ids resolve to the unknown name") { CHECK(table.resolve(1234) == "UNKNOWN"); }
+
+        WHEN("Strings are interned") {
+            std::string name = "cat";
+            const auto cat = table.intern(name);
+            const auto grep = table.intern("grep");
+            // Changing the argument must not affect the table.
+            name = "dog";
+
+            THEN("Each distinct string has its own id") {
+                CHECK(cat != grep);
+                CHECK(table.intern("cat") == cat);
+                CHECK(table.intern(std::string{"gr"} + "ep") == grep);
+                CHECK(table.size() == 3);
+            }
+            THEN("Ids resolve to the strings") {
+                CHECK(table.resolve(cat) == "cat");
+                CHECK(table.resolve(grep) == "grep");
+            }
+            THEN("Copies preserve the ids") {
+                const elphi::StringTable copy = table;
+                CHECK(copy.resolve(cat) == "cat");
+                elphi::StringTable other;
+                other = copy;
+                CHECK(other.intern("grep") == grep);
+            }
+            THEN("Views stay valid while the table grows") {
+                const auto view = table.resolve(cat);
+                for (int i = 0; i < 1000; ++i)
+                    (void)table.intern(std::to_string(i));
+                CHECK(view == "cat");
+                CHECK(view.data() == table.resolve(cat).data());
+            }
+        }
+    }
+}
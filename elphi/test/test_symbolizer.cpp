@@ -0,0 +1,182 @@
+#include <cinttypes>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include <catch2/catch_all.hpp>
+#include <elphi/symbolizer.hpp>
+#include <unistd.h>
+
+/*******************************************************************************
+ * @brief Function of this binary resolved by the tests.
+ ******************************************************************************/
+extern "C" [[gnu::noinline]] int
+elphi_test_symbolized_function(int value) {
+    // Keep the body from being folded with other functions.
+    return value * 17 + 3;
+}
+
+namespace {
+/*******************************************************************************
+ * @brief Fake procfs in a temporary directory, removed at the end of the scope.
+ ******************************************************************************/
+struct FakeProc {
+    FakeProc() : root(std::filesystem::temp_directory_path() / "elphi_test_symbolizer") {
+        std::filesystem::remove_all(root);
+        std::filesystem::create_directories(root);
+    }
+    FakeProc(const FakeProc&) = delete;
+    FakeProc(FakeProc&&) = delete;
+    FakeProc&
+    operator=(const FakeProc&) = delete;
+    FakeProc&
+    operator=(FakeProc&&) = delete;
+    ~FakeProc() { std::filesystem::remove_all(root); }
+
+    /*******************************************************************************
+     * @brief Create process @p pid with @p maps .
+     ******************************************************************************/
+    void
+    add(elphi::ProcId pid, const std::string& maps) const {
+        const auto dir = root / std::to_string(pid);
+        std::filesystem::create_directories(dir);
+        std::ofstream{dir / "maps"} << maps;
+    }
+
+    std::filesystem::path root;
+};
+
+/*******************************************************************************
+ * @brief Line of /proc/self/maps mapping @p address , empty if not mapped.
+ ******************************************************************************/
+std::string
+self_maps_line(std::uint64_t address) {
+    std::ifstream maps{"/proc/self/maps"};
+    for (std::string line; std::getline(maps, line);) {
+        std::uint64_t start = 0;
+        std::uint64_t end = 0;
+        if (std::sscanf(line.c_str(), "%" SCNx64 "-%" SCNx64, &start, &end) == 2 && address >= start &&
+            address < end)
+            return line;
+    }
+    return {};
+}
+
+/*******************************************************************************
+ * @brief Mapping of process @p pid equal to this process' mapping of @p address .
+ ******************************************************************************/
+elphi::MapEvent
+self_mapping(elphi::ProcId pid, std::uint64_t address) {
+    const auto line = self_maps_line(address);
+    elphi::MapEvent event{.kind = elphi::MapEvent::Kind::map, .pid = pid};
+    int path_pos = 0;
+    REQUIRE(std::sscanf(line.c_str(), "%" SCNx64 "-%" SCNx64 " %*s %" SCNx64 " %*s %*s %n", &event.start, &event.size,
+                        &event.offset, &path_pos) == 3);
+    event.size -= event.start;
+    const auto path = line.substr(static_cast<std::size_t>(path_pos));
+    event.filename_size = static_cast<std::uint16_t>(path.copy(event.filename.data(), event.filename.size()));
+    return event;
+}
+} // namespace
+
+SCENARIO("Symbolizing instruction pointers", "[symbols]") {
+    const auto ip = reinterpret_cast<std::uint64_t>(&elphi_test_symbolized_function);
+    auto cache = std::make_shared<elphi::SymbolCache>();
+
+    GIVEN("Symbolizer of running processes") {
+        elphi::Symbolizer symbolizer{cache};
+
+        WHEN("Process was not seen in any record") {
+            const auto pid = static_cast<elphi::ProcId>(::getpid());
+            THEN("Its mappings are read from /proc") {
+                CHECK(symbolizer.symbolize(pid, ip) == "elphi_test_symbolized_function");
+                CHECK(symbolizer.symbolize(pid, ip + 1) == "elphi_test_symbolized_function");
+                CHECK(symbolizer.num_processes() == 1);
+            }
+            THEN("Unmapped addresses are not resolved") {
+                CHECK(!symbolizer.symbolize(pid, 0));
+                CHECK(!symbolizer.symbolize(pid, ~std::uint64_t{0}));
+            }
+        }
+    }
+    GIVEN("Symbolizer of fake processes") {
+        FakeProc proc;
+        elphi::Symbolizer symbolizer{cache, proc.root.string()};
+
+        WHEN("Process is in /proc") {
+            proc.add(10, self_maps_line(ip) + "\n");
+            THEN("It is resolved") { CHECK(symbolizer.symbolize(10, ip) == "elphi_test_symbolized_function"); }
+
+            AND_WHEN("Another file is mapped into it before any lookup") {
+                elphi::MapEvent other{.kind = elphi::MapEvent::Kind::map, .pid = 10, .start = 0x1000, .size = 0x1000};
+                const std::string_view path = "/nonexistent/elphi";
+                other.filename_size = static_cast<std::uint16_t>(path.copy(other.filename.data(), path.size()));
+                symbolizer.on_map(other);
+                THEN("Mappings from /proc are kept") {
+                    CHECK(symbolizer.symbolize(10, ip) == "elphi_test_symbolized_function");
+                }
+            }
+        }
+        WHEN("Process is not in /proc") {
+            THEN("Nothing is resolved nor remembered") {
+                CHECK(!symbolizer.symbolize(11, ip));
+                CHECK(symbolizer.num_processes() == 0);
+            }
+        }
+        WHEN("Process maps the file") {
+            symbolizer.on_map(self_mapping(7, ip));
+            THEN("It is resolved") { CHECK(symbolizer.symbolize(7, ip) == "elphi_test_symbolized_function"); }
+
+            AND_WHEN("The process is forked") {
+                symbolizer.on_map(elphi::MapEvent{.kind = elphi::MapEvent::Kind::fork, .pid = 8, .parent = 7});
+                THEN("The child inherits the mapping") {
+                    CHECK(symbolizer.symbolize(8, ip) == "elphi_test_symbolized_function");
+                }
+
+                AND_WHEN("Both processes exit") {
+                    CHECK(symbolizer.symbolize(7, ip) == "elphi_test_symbolized_function");
+                    CHECK(symbolizer.symbolize(8, ip) == "elphi_test_symbolized_function");
+                    symbolizer.on_map(elphi::MapEvent{.kind = elphi::MapEvent::Kind::exit, .pid = 8});
+                    symbolizer.release_files();
+                    THEN("The file is kept while the parent maps it") {
+                        CHECK(symbolizer.num_processes() == 1);
+                        CHECK(symbolizer.num_files() == 1);
+                        CHECK(symbolizer.symbolize(7, ip) == "elphi_test_symbolized_function");
+                    }
+
+                    symbolizer.on_map(elphi::MapEvent{.kind = elphi::MapEvent::Kind::exit, .pid = 7});
+                    THEN("Their address spaces are forgotten, the file once released") {
+                        CHECK(symbolizer.num_processes() == 0);
+                        CHECK(symbolizer.num_files() == 1);
+                        symbolizer.release_files();
+                        CHECK(symbolizer.num_files() == 0);
+                        CHECK(!symbolizer.symbolize(7, ip));
+                        CHECK(symbolizer.num_processes() == 0);
+                    }
+                }
+                AND_WHEN("The child calls exec") {
+                    symbolizer.on_map(elphi::MapEvent{.kind = elphi::MapEvent::Kind::exec, .pid = 8});
+                    THEN("Its mappings are gone") {
+                        CHECK(!symbolizer.symbolize(8, ip));
+                        CHECK(symbolizer.symbolize(7, ip) == "elphi_test_symbolized_function");
+                    }
+                }
+            }
+            AND_WHEN("Another file is mapped over it") {
+                auto other = self_mapping(7, ip);
+                const std::string_view path = "/nonexistent/elphi";
+                other.filename_size = static_cast<std::uint16_t>(path.copy(other.filename.data(), path.size()));
+                symbolizer.on_map(other);
+                THEN("The new file is used") { CHECK(!symbolizer.symbolize(7, ip)); }
+            }
+        }
+    }
+}
+
+SCENARIO("Demangling symbols", "[symbols]") {
+    CHECK(elphi::demangle("_Z3fooi") == "foo(int)");
+    CHECK(elphi::demangle("_ZN5elphi3barEv") == "elphi::bar()");
+    CHECK(elphi::demangle("main") == "main");
+    CHECK(elphi::demangle("_Zinvalid") == "_Zinvalid");
+}
@@ -0,0 +1,165 @@
+#include <random>
+#include <vector>
+
+#include <catch2/catch_all.hpp>
+#include <elphi/time_index.hpp>
+
+namespace {
+using elphi::TimePoint;
+
+/*******************************************************************************
+ * @brief Back-to-back slices of random lengths, with gaps between some.
+ ******************************************************************************/
+elphi::view::CpuTimeline
+random_slices(std::size_t num, std::mt19937_64& gen) {
+    elphi::view::CpuTimeline slices;
+    TimePoint time{0};
+    for (std::size_t i = 0; i < num; ++i) {
+        const TimePoint begin = time + TimePoint{gen() % 3 == 0 ? gen() % 50 : 0};
+        const TimePoint end = begin + TimePoint{gen() % 100};
+        slices.push_back({.begin_time = begin, .end_time = end, .pid = static_cast<elphi::ProcId>(i)});
+        time = end + TimePoint{1};
+    }
+    return slices;
+}
+
+/*******************************************************************************
+ * @brief Slices of @p slices overlapping [@p from, @p to] by a linear scan.
+ ******************************************************************************/
+std::vector<elphi::ProcId>
+scan_overlapping(const elphi::view::CpuTimeline& slices, TimePoint from, TimePoint to) {
+    std::vector<elphi::ProcId> found;
+    for (const auto& slice : slices)
+        if (slice.end_time >= from && slice.begin_time <= to)
+            found.push_back(slice.pid);
+    return found;
+}
+
+/*******************************************************************************
+ * @brief PIDs of @p slices .
+ ******************************************************************************/
+std::vector<elphi::ProcId>
+pids_of(std::span<const elphi::view::ThreadTimeSlice> slices) {
+    std::vector<elphi::ProcId> pids;
+    for (const auto& slice : slices)
+        pids.push_back(slice.pid);
+    return pids;
+}
+} // namespace
+
+SCENARIO("Querying time ranges of a timeline", "[view][index]") {
+    std::mt19937_64 gen{7};
+
+    GIVEN("Index of no slices") {
+        const elphi::view::SliceIndex index;
+        THEN("Nothing overlaps") { CHECK(index.overlapping(TimePoint{0}, TimePoint::max()).empty()); }
+    }
+    GIVEN("Index of slices spanning several blocks") {
+        const std::size_t num = GENERATE(1, 63, 64, 65, 1000);
+        const auto slices = random_slices(num, gen);
+        const elphi::view::SliceIndex index{slices};
+        const auto last_end = slices.back().end_time;
+
+        THEN("Random ranges match a linear scan") {
+            for (int i = 0; i < 500; ++i) {
+                const TimePoint from{static_cast<std::int64_t>(gen() % (last_end.count() + 100)) - 50};
+                const TimePoint to = from + TimePoint{gen() % 400};
+                INFO("from " << from.count() << " to " << to.count());
+                CHECK(pids_of(index.overlapping(from, to)) == scan_overlapping(slices, from, to));
+            }
+        }
+        THEN("Ranges at the edges of slices include them") {
+            for (const auto& slice : slices) {
+                CHECK(pids_of(index.overlapping(slice.begin_time, slice.begin_time)) ==
+                      scan_overlapping(slices, slice.begin_time, slice.begin_time));
+                CHECK(pids_of(index.overlapping(slice.end_time, slice.end_time)) ==
+                      scan_overlapping(slices, slice.end_time, slice.end_time));
+            }
+        }
+        THEN("The whole range returns all slices") {
+            CHECK(index.overlapping(TimePoint::min(), TimePoint::max()).size() == slices.size());
+        }
+        THEN("Ranges outside of the slices are empty") {
+            CHECK(index.overlapping(last_end + TimePoint{1}, TimePoint::max()).empty());
+            CHECK(index.overlapping(TimePoint::min(), slices.front().begin_time - TimePoint{1}).empty());
+        }
+        THEN("Reversed ranges are empty") { CHECK(index.overlapping(last_end, TimePoint{0}).empty()); }
+    }
+    GIVEN("Index of a timeline") {
+        elphi::view::Timeline timeline;
+        timeline[0] = random_slices(200, gen);
+        timeline[3] = random_slices(10, gen);
+        const elphi::view::TimelineIndex index{timeline};
+
+        THEN("CPUs are queried separately") {
+            const TimePoint from{100};
+            const TimePoint to{300};
+            CHECK(pids_of(index.overlapping(0, from, to)) == scan_overlapping(timeline[0], from, to));
+            CHECK(pids_of(index.overlapping(3, from, to)) == scan_overlapping(timeline[3], from, to));
+            CHECK(index.overlapping(1, from, to).empty());
+        }
+        THEN("Multiple CPUs are queried together, omitting those without slices") {
+            const std::vector<elphi::CpuId> cpus{3, 1, 0};
+            const auto views = index.overlapping(cpus, TimePoint{0}, TimePoint{10});
+            REQUIRE(views.size() == 2);
+            CHECK(views[0].first == 3);
+            CHECK(views[1].first == 0);
+            CHECK(pids_of(views[1].second) == scan_overlapping(timeline[0], TimePoint{0}, TimePoint{10}));
+        }
+    }
+}
+
+SCENARIO("Querying time ranges of samples", "[view][index]") {
+    std::mt19937_64 gen{11};
+
+    GIVEN("Index of no samples") {
+        const elphi::view::SampleIndex index;
+        THEN("Nothing is found") {
+            CHECK(index.range(TimePoint::min(), TimePoint::max()).empty());
+            const std::vector<elphi::CpuId> cpus{0};
+            CHECK(index.for_each(TimePoint::min(), TimePoint::max(), cpus, [](const auto&) {}) == 0);
+        }
+    }
+    GIVEN("Index of samples with repeated times") {
+        const std::size_t num = GENERATE(1, 64, 129, 2000);
+        std::vector<elphi::CpuSample> samples;
+        TimePoint time{0};
+        for (std::size_t i = 0; i < num; ++i) {
+            time += TimePoint{gen() % 3};
+            // Runs of CPUs let whole blocks be skipped.
+            samples.push_back({.pid = static_cast<elphi::ProcId>(i), .cpu = (i / 100) % 4 + (i % 7 == 0 ? 64 : 0),
+                               .time = time});
+        }
+        const elphi::view::SampleIndex index{samples};
+
+        THEN("Random ranges match a linear scan") {
+            for (int i = 0; i < 500; ++i) {
+                const TimePoint from{static_cast<std::int64_t>(gen() % (time.count() + 20)) - 10};
+                const TimePoint to = from + TimePoint{gen() % 100};
+                const std::vector<elphi::CpuId> cpus{gen() % 4, 64 + gen() % 4};
+                INFO("from " << from.count() << " to " << to.count());
+
+                std::vector<elphi::ProcId> expected_range;
+                std::vector<elphi::ProcId> expected_cpus;
+                for (const auto& sample : samples)
+                    if (sample.time >= from && sample.time <= to) {
+                        expected_range.push_back(sample.pid);
+                        if (sample.cpu == cpus[0] || sample.cpu == cpus[1])
+                            expected_cpus.push_back(sample.pid);
+                    }
+
+                std::vector<elphi::ProcId> found_range;
+                for (const auto& sample : index.range(from, to))
+                    found_range.push_back(sample.pid);
+                CHECK(found_range == expected_range);
+
+                std::vector<elphi::ProcId> found_cpus;
+                CHECK(index.for_each(from, to, cpus, [&](const elphi::CpuSample& sample) {
+                    found_cpus.push_back(sample.pid);
+                }) == expected_cpus.size());
+                CHECK(found_cpus == expected_cpus);
+            }
+        }
+        THEN("Reversed ranges are empty") { CHECK(index.range(time, TimePoint{0}).empty() == (time > TimePoint{0})); }
+    }
+}
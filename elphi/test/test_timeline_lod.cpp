@@ -0,0 +1,190 @@
+#include <map>
+#include <random>
+#include <vector>
+
+#include <catch2/catch_all.hpp>
+#include <elphi/exception.hpp>
+#include <elphi/timeline_lod.hpp>
+#include <elphi/timeline_view.hpp>
+
+using namespace std::chrono_literals;
+namespace velphi = elphi::view;
+
+namespace {
+/*******************************************************************************
+ * @brief Samples of a single CPU switching among @p num_threads threads.
+ ******************************************************************************/
+std::vector<elphi::CpuSample>
+random_samples(std::size_t num, std::size_t num_threads, std::mt19937_64& gen) {
+    std::vector<elphi::CpuSample> samples;
+    elphi::TimePoint time{0};
+    auto pid = elphi::ProcId{1};
+    for (std::size_t i = 0; i < num; ++i) {
+        time += elphi::TimePoint{static_cast<std::int64_t>(gen() % 2000)};
+        if (gen() % 5 == 0)
+            pid = static_cast<elphi::ProcId>(gen() % num_threads);
+        const auto kind = gen() % 17 == 0 ? elphi::SampleKind::switch_out : elphi::SampleKind::tick;
+        samples.push_back({.pid = pid, .tid = pid, .cpu = 2, .time = time, .kind = kind});
+    }
+    return samples;
+}
+
+/*******************************************************************************
+ * @brief Time of each thread in [@p begin, @p begin + @p width) by the slices.
+ ******************************************************************************/
+std::map<elphi::ProcId, elphi::TimePoint>
+thread_times(const velphi::CpuTimeline& slices, elphi::TimePoint begin, elphi::TimePoint width) {
+    std::map<elphi::ProcId, elphi::TimePoint> times;
+    for (const auto& slice : slices) {
+        const auto overlap = std::min(slice.end_time, begin + width) - std::max(slice.begin_time, begin);
+        if (slice.pid != 0 && overlap > elphi::TimePoint::zero())
+            times[slice.pid] += overlap;
+    }
+    return times;
+}
+} // namespace
+
+SCENARIO("Timeline pyramid", "[view][lod]") {
+    std::mt19937_64 gen{3};
+    const velphi::LodConfig config{.base_width = 10us, .factor = 4, .num_levels = 4};
+
+    GIVEN("Invalid resolution") {
+        THEN("No pyramid is created") {
+            CHECK_THROWS_AS(velphi::TimelinePyramid{velphi::LodConfig{.base_width = 0ns}}, elphi::ElphiException);
+            CHECK_THROWS_AS(velphi::TimelinePyramid{velphi::LodConfig{.factor = 1}}, elphi::ElphiException);
+            CHECK_THROWS_AS(velphi::TimelinePyramid{velphi::LodConfig{.num_levels = 0}}, elphi::ElphiException);
+        }
+    }
+    GIVEN("Pyramid of random samples of a few threads") {
+        const auto samples = random_samples(2000, 5, gen);
+        const elphi::CpuSamplingResult result{.samples = samples};
+        const auto pyramid = velphi::gen_timeline_pyramid(result, config);
+        const auto timeline = velphi::gen_cpu_timelines(result);
+        const auto& slices = timeline.at(2);
+
+        THEN("Each level matches the slices") {
+            REQUIRE(pyramid.num_levels() == 4);
+            for (std::size_t level = 0; level < pyramid.num_levels(); ++level) {
+                const auto width = pyramid.width(level);
+                CHECK(width == 10us * (1 << (2 * level)));
+                const auto view = pyramid.view(2, 0ns, samples.back().time, 1 << 20);
+                // The finest level fits.
+                REQUIRE(view.width == config.base_width);
+
+                const auto all = pyramid.view(2, 0ns, samples.back().time, (samples.back().time / width) + 1);
+                REQUIRE(all.width == width);
+                REQUIRE(all.buckets.size() == static_cast<std::size_t>(samples.back().time / width) + 1);
+                for (std::size_t i = 0; i < all.buckets.size(); ++i) {
+                    const auto& bucket = all.buckets[i];
+                    const auto begin = all.begin + width * static_cast<std::int64_t>(i);
+                    const auto times = thread_times(slices, begin, width);
+                    INFO("level " << level << " bucket " << i);
+
+                    elphi::TimePoint busy{0};
+                    elphi::TimePoint dominant{0};
+                    for (const auto& [pid, time] : times) {
+                        busy += time;
+                        dominant = std::max(dominant, time);
+                    }
+                    CHECK(bucket.busy == busy);
+                    CHECK(bucket.dominant_time == dominant);
+                    if (dominant > 0ns)
+                        CHECK(times.at(bucket.pid) == dominant);
+
+                    std::uint32_t num_finished = 0;
+                    for (auto count : bucket.occupancy)
+                        num_finished += count;
+                    const auto num_base = static_cast<std::uint32_t>(width / config.base_width);
+                    CHECK(num_finished == (i + 1 < all.buckets.size() ? num_base : num_finished));
+                }
+            }
+        }
+        THEN("Busy base buckets are in the upper occupancy bins") {
+            const auto view = pyramid.view(2, 0ns, samples.back().time, 1 << 20);
+            for (const auto& bucket : view.buckets.first(view.buckets.size() - 1)) {
+                const auto bin = std::ranges::find(bucket.occupancy, 1U) - bucket.occupancy.begin();
+                CHECK(bin == std::min<std::int64_t>(bucket.busy * 8 / config.base_width, 7));
+            }
+        }
+        THEN("Coarser levels are chosen for fewer buckets") {
+            CHECK(pyramid.view(2, 0ns, 999us, 100).width == 10us);
+            CHECK(pyramid.view(2, 0ns, 999us, 30).width == 40us);
+            CHECK(pyramid.view(2, 0ns, 1ms, 1).width == 640us);
+            CHECK(pyramid.view(2, 0ns, 1ms, 100).width == 40us);
+            CHECK(pyramid.view(2, 100us, 139us, 1).buckets.size() == 1);
+        }
+        THEN("Unknown CPUs and reversed ranges are empty") {
+            CHECK(pyramid.view(3, 0ns, 1ms, 100).buckets.empty());
+            CHECK(pyramid.view(2, 1ms, 0ns, 100).buckets.empty());
+        }
+
+        WHEN("Built batch by batch") {
+            velphi::TimelinePyramid incremental{config};
+            const std::span all{samples};
+            for (std::size_t i = 0; i < all.size(); i += 7)
+                incremental.add(all.subspan(i, std::min<std::size_t>(7, all.size() - i)));
+
+            THEN("It matches the one built at once") {
+                for (std::size_t level = 0; level < pyramid.num_levels(); ++level) {
+                    const auto max = static_cast<std::size_t>(samples.back().time / pyramid.width(level)) + 1;
+                    const auto expected = pyramid.view(2, 0ns, samples.back().time, max).buckets;
+                    const auto built = incremental.view(2, 0ns, samples.back().time, max).buckets;
+                    REQUIRE(built.size() == expected.size());
+                    for (std::size_t i = 0; i < built.size(); ++i) {
+                        CHECK(built[i].busy == expected[i].busy);
+                        CHECK(built[i].pid == expected[i].pid);
+                        CHECK(built[i].occupancy == expected[i].occupancy);
+                    }
+                }
+            }
+            AND_WHEN("Old buckets are evicted") {
+                const auto cutoff = samples.back().time / 2;
+                const auto num_evicted = incremental.evict_before(cutoff);
+
+                THEN("Only the newer buckets are retained") {
+                    CHECK(num_evicted == static_cast<std::size_t>(cutoff / config.base_width));
+                    const auto view = incremental.view(2, 0ns, samples.back().time, 1 << 20);
+                    CHECK(view.begin <= cutoff);
+                    CHECK(view.begin + config.base_width > cutoff);
+                }
+            }
+        }
+    }
+    GIVEN("Pyramid of a thread spanning a bucket boundary") {
+        velphi::TimelinePyramid pyramid{velphi::LodConfig{.base_width = 1ms, .factor = 4, .num_levels = 3}};
+        const std::vector<elphi::CpuSample> samples{
+            {.pid = 1, .tid = 1, .time = 0us},      {.pid = 1, .tid = 1, .time = 9500us},
+            {.pid = 2, .tid = 2, .time = 9500us},   {.pid = 2, .tid = 2, .time = 11500us},
+            {.pid = 1, .tid = 1, .time = 11500us},  {.pid = 1, .tid = 1, .time = 11900us},
+            {.pid = 0, .tid = 0, .time = 20000us},
+        };
+        pyramid.add(samples);
+
+        THEN("Time of the previous bucket does not count") {
+            const auto view = pyramid.view(0, 8ms, 11ms, 1);
+            REQUIRE(view.width == 4ms);
+            REQUIRE(view.buckets.size() == 1);
+            CHECK(view.buckets[0].busy == 3900us);
+            CHECK(view.buckets[0].pid == 2);
+            CHECK(view.buckets[0].dominant_time == 2ms);
+        }
+    }
+    GIVEN("Pyramid of a bucket with many threads") {
+        velphi::TimelinePyramid pyramid{config};
+        std::vector<elphi::CpuSample> samples;
+        // Thread 100 runs most of the time between short runs of other threads.
+        for (int i = 0; i < 100; ++i) {
+            const auto pid = static_cast<elphi::ProcId>(i % 2 == 0 ? 100 : i);
+            samples.push_back({.pid = pid, .tid = pid, .time = elphi::TimePoint{i * 100}});
+            samples.push_back({.pid = pid, .tid = pid, .time = elphi::TimePoint{i * 100 + (pid == 100 ? 99 : 9)}});
+        }
+        pyramid.add(samples);
+
+        THEN("The dominant one is found") {
+            const auto view = pyramid.view(0, 0ns, 9us, 1);
+            REQUIRE(view.buckets.size() == 1);
+            CHECK(view.buckets[0].pid == 100);
+            CHECK(view.buckets[0].busy == elphi::TimePoint{50 * 99 + 50 * 9});
+        }
+    }
+}
@@ -7,33 +7,41 @@ using namespace std::chrono_literals;
 namespace velphi = elphi::view;
 namespace {
 velphi::ThreadTimeSlice
-sample_to_timeslice(const elphi::CpuSample& sample, std::string name) {
+sample_to_timeslice(const elphi::CpuSample& sample, elphi::NameId name) {
     return {
         .begin_time = sample.time,
         .end_time = sample.time,
-        .name = std::move(name),
+        .name = name,
         .pid = sample.pid,
         .tid = sample.tid,
         .cpu = sample.cpu,
     };
 }
+
+/*******************************************************************************
+ * @brief Sampling result with process @p pid named @p name .
+ ******************************************************************************/
+elphi::CpuSamplingResult
+named_result(std::vector<elphi::CpuSample> samples, elphi::ProcId pid, std::string_view name) {
+    elphi::CpuSamplingResult result{.samples = std::move(samples)};
+    result.set_process_name(pid, name);
+    return result;
+}
 } // namespace
 
 SCENARIO("Timeline view single sample processing", "[view][timeline]") {
 
     GIVEN("A named sample") {
         constexpr elphi::CpuSample sample{.pid = 1, .tid = 4, .cpu = 3, .time = 1s};
-        const std::string proc_name = "cat";
-        elphi::CpuSamplingResult result{
-            .samples = {sample},
-            .process_names = {{sample.pid, proc_name}},
-        };
+        const auto result = named_result({sample}, sample.pid, "cat");
+        const auto proc_name = result.process_names.at(sample.pid);
 
         WHEN("Processed") {
             velphi::Timeline timeline = velphi::gen_cpu_timelines(result);
             THEN("Timeline contains exactly the one sample") {
                 const auto exp_slice = sample_to_timeslice(sample, proc_name);
 
+                CHECK(result.names.resolve(timeline[sample.cpu][0].name) == "cat");
                 CHECK(timeline.contains(sample.cpu));
                 CHECK_THAT(timeline, Catch::Matchers::SizeIs(1));
                 CHECK_THAT(timeline[sample.cpu], Catch::Matchers::SizeIs(1));
@@ -44,12 +52,14 @@ SCENARIO("Timeline view single sample processing", "[view][timeline]") {
 
     GIVEN("An unnamed sample") {
         constexpr elphi::CpuSample sample{.pid = 12, .tid = 41, .cpu = 31, .time = 11s};
-        elphi::CpuSamplingResult result{.samples = {sample}, .process_names = {}};
+        elphi::CpuSamplingResult result{.samples = {sample}};
 
         WHEN("Processed") {
             velphi::Timeline timeline = velphi::gen_cpu_timelines(result);
             THEN("Timeline contains exactly the one unnamed sample") {
-                const auto exp_slice = sample_to_timeslice(sample, "UNKNOWN");
+                const auto exp_slice = sample_to_timeslice(sample, elphi::c_unknown_name);
+
+                CHECK(result.names.resolve(elphi::c_unknown_name) == "UNKNOWN");
 
                 CHECK(timeline.contains(sample.cpu));
                 CHECK_THAT(timeline, Catch::Matchers::SizeIs(1));
@@ -66,8 +76,8 @@ SCENARIO("Timeline view sample concatenation", "[view][timeline]") {
 
         constexpr elphi::CpuSample sample1{.pid = 1, .tid = 4, .cpu = 3, .time = 1s};
         constexpr elphi::CpuSample sample2{.pid = 1, .tid = 4, .cpu = 3, .time = 5s};
-        const std::string proc_name = "cat";
-        elphi::CpuSamplingResult result{.samples = {sample1, sample2}, .process_names = {{1, proc_name}}};
+        const auto result = named_result({sample1, sample2}, 1, "cat");
+        const auto proc_name = result.process_names.at(1);
         WHEN("Processed") {
             velphi::Timeline timeline = velphi::gen_cpu_timelines(result);
             THEN("Samples are merged in the timeline") {
@@ -87,8 +97,8 @@ SCENARIO("Timeline view sample concatenation", "[view][timeline]") {
 
         constexpr elphi::CpuSample sample1{.pid = 1, .tid = 4, .cpu = 3, .time = 1s};
         constexpr elphi::CpuSample sample2{.pid = 1, .tid = 5, .cpu = 3, .time = 5s};
-        const std::string proc_name = "cat";
-        elphi::CpuSamplingResult result{.samples = {sample1, sample2}, .process_names = {{1, proc_name}}};
+        const auto result = named_result({sample1, sample2}, 1, "cat");
+        const auto proc_name = result.process_names.at(1);
         WHEN("Processed") {
             velphi::Timeline timeline = velphi::gen_cpu_timelines(result);
             THEN("Samples appear as two slices in the timeline") {
@@ -107,13 +117,13 @@ SCENARIO("Timeline view sample concatenation", "[view][timeline]") {
 
         constexpr elphi::CpuSample sample1{.pid = 1, .tid = 4, .cpu = 3, .time = 1s};
         constexpr elphi::CpuSample sample2{.pid = 2, .tid = 4, .cpu = 3, .time = 5s};
-        const std::string proc_name = "cat";
-        elphi::CpuSamplingResult result{.samples = {sample1, sample2}, .process_names = {{1, proc_name}}};
+        const auto result = named_result({sample1, sample2}, 1, "cat");
+        const auto proc_name = result.process_names.at(1);
         WHEN("Processed") {
             velphi::Timeline timeline = velphi::gen_cpu_timelines(result);
             THEN("Samples appear as two slices in the timeline") {
                 auto exp_slice1 = sample_to_timeslice(sample1, proc_name);
-                auto exp_slice2 = sample_to_timeslice(sample2, "UNKNOWN");
+                auto exp_slice2 = sample_to_timeslice(sample2, elphi::c_unknown_name);
 
                 CHECK(timeline.contains(sample1.cpu));
                 CHECK_THAT(timeline, Catch::Matchers::SizeIs(1));
@@ -124,3 +134,190 @@ SCENARIO("Timeline view sample concatenation", "[view][timeline]") {
         }
     }
 }
+
+SCENARIO("Incremental timeline building", "[view][timeline]") {
+    GIVEN("Samples of two CPUs split into batches") {
+        const std::vector<elphi::CpuSample> samples{
+            {.pid = 1, .tid = 1, .cpu = 0, .time = 1s}, {.pid = 2, .tid = 2, .cpu = 1, .time = 1s},
+            {.pid = 1, .tid = 1, .cpu = 0, .time = 2s}, {.pid = 2, .tid = 2, .cpu = 1, .time = 2s},
+            {.pid = 3, .tid = 3, .cpu = 0, .time = 3s}, {.pid = 2, .tid = 2, .cpu = 1, .time = 3s},
+            {.pid = 3, .tid = 3, .cpu = 0, .time = 4s}, {.pid = 1, .tid = 1, .cpu = 1, .time = 4s},
+        };
+        const auto result = named_result(samples, 1, "cat");
+        velphi::TimelineBuilder builder{result.process_names};
+
+        WHEN("Added batch by batch") {
+            const std::span all{samples};
+            for (std::size_t i = 0; i < all.size(); i += 3)
+                builder.add(all.subspan(i, std::min<std::size_t>(3, all.size() - i)));
+
+            THEN("Timeline matches the one built at once") {
+                CHECK(builder.timeline() == velphi::gen_cpu_timelines(result));
+                CHECK_THAT(builder.cpu_timeline(0), Catch::Matchers::SizeIs(2));
+                CHECK_THAT(builder.cpu_timeline(1), Catch::Matchers::SizeIs(2));
+                CHECK(builder.cpu_timeline(0)[1].end_time == 4s);
+            }
+
+            AND_WHEN("Slices ending before 3s are evicted") {
+                auto num_evicted = builder.evict_before(3s);
+
+                THEN("Only the newer slices are retained") {
+                    CHECK(num_evicted == 1);
+                    REQUIRE_THAT(builder.cpu_timeline(0), Catch::Matchers::SizeIs(1));
+                    CHECK(builder.cpu_timeline(0)[0].pid == 3);
+                    CHECK_THAT(builder.cpu_timeline(1), Catch::Matchers::SizeIs(2));
+                }
+                THEN("New samples extend the open slices") {
+                    const std::vector<elphi::CpuSample> next{{.pid = 3, .tid = 3, .cpu = 0, .time = 5s}};
+                    builder.add(next);
+                    REQUIRE_THAT(builder.cpu_timeline(0), Catch::Matchers::SizeIs(1));
+                    CHECK(builder.cpu_timeline(0)[0].end_time == 5s);
+                }
+            }
+
+            AND_WHEN("Everything is evicted") {
+                builder.evict_before(10s);
+
+                THEN("Timeline is empty") {
+                    CHECK_THAT(builder.cpu_timeline(0), Catch::Matchers::IsEmpty());
+                    CHECK_THAT(builder.cpu_timeline(1), Catch::Matchers::IsEmpty());
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("Timeline view of cgroups", "[view][timeline]") {
+    GIVEN("CPU switching between threads of two cgroups") {
+        const std::vector<elphi::CpuSample> samples{
+            {.pid = 1, .tid = 1, .cpu = 0, .time = 1s, .cgroup = 10},
+            {.pid = 1, .tid = 1, .cpu = 0, .time = 2s, .cgroup = 10},
+            {.pid = 2, .tid = 2, .cpu = 0, .time = 3s, .cgroup = 20},
+            {.pid = 3, .tid = 3, .cpu = 1, .time = 3s, .cgroup = 10},
+            {.pid = 1, .tid = 1, .cpu = 0, .time = 4s, .cgroup = 10},
+            // Migrated to another cgroup.
+            {.pid = 1, .tid = 1, .cpu = 0, .time = 5s, .cgroup = 20},
+        };
+        auto result = named_result(samples, 1, "cat");
+        result.set_group_name(10, "/a");
+
+        WHEN("Processed") {
+            const auto groups = velphi::gen_group_timelines(result);
+
+            THEN("Each cgroup has only its slices") {
+                REQUIRE(groups.size() == 2);
+                const auto& first = groups.at(10);
+                REQUIRE_THAT(first.at(0), Catch::Matchers::SizeIs(2));
+                CHECK(first.at(0)[0].begin_time == 1s);
+                CHECK(first.at(0)[0].end_time == 2s);
+                CHECK(first.at(0)[0].name == result.process_names.at(1));
+                // Not merged over the slice of the other cgroup.
+                CHECK(first.at(0)[1].begin_time == 4s);
+                CHECK(first.at(0)[1].end_time == 4s);
+                CHECK_THAT(first.at(1), Catch::Matchers::SizeIs(1));
+
+                const auto& second = groups.at(20);
+                REQUIRE_THAT(second.at(0), Catch::Matchers::SizeIs(2));
+                CHECK(second.at(0)[0].pid == 2);
+                CHECK(second.at(0)[1].pid == 1);
+                CHECK(second.at(0)[1].cgroup == 20);
+                CHECK(!second.contains(1));
+            }
+            THEN("Slices match the CPU timeline") {
+                const auto timeline = velphi::gen_cpu_timelines(result);
+                std::size_t num_slices = 0;
+                for (const auto& [group, group_timeline] : groups)
+                    for (const auto& [cpu, slices] : group_timeline)
+                        for (const auto& slice : slices) {
+                            CHECK(std::ranges::find(timeline.at(cpu), slice) != timeline.at(cpu).end());
+                            ++num_slices;
+                        }
+                CHECK(num_slices == timeline.at(0).size() + timeline.at(1).size());
+            }
+            THEN("Paths are resolved by the result") {
+                CHECK(result.group_name(10) == "/a");
+                CHECK(result.group_name(20) == "UNKNOWN");
+            }
+        }
+    }
+}
+
+SCENARIO("Timeline view of hardware counters", "[view][timeline]") {
+    GIVEN("Samples with cycles and instructions, the thread changes at the third one") {
+        const std::vector<elphi::Counter> counters{elphi::Counter::cycles, elphi::Counter::instructions};
+        elphi::CpuSamplingResult result{.samples = {
+                                            {.pid = 1, .tid = 1, .cpu = 0, .time = 1s},
+                                            {.pid = 1, .tid = 1, .cpu = 0, .time = 2s},
+                                            {.pid = 3, .tid = 3, .cpu = 1, .time = 2s},
+                                            {.pid = 2, .tid = 2, .cpu = 0, .time = 3s},
+                                        }};
+        result.counters = counters;
+        result.counter_values = {{100, 150}, {300, 450}, {7, 7}, {200, 100}};
+
+        WHEN("Processed") {
+            auto timeline = velphi::gen_cpu_timelines(result);
+            auto counter_timeline = velphi::gen_counter_timelines(result);
+            REQUIRE_THAT(timeline[0], Catch::Matchers::SizeIs(2));
+            REQUIRE_THAT(counter_timeline[0], Catch::Matchers::SizeIs(2));
+            REQUIRE_THAT(counter_timeline[1], Catch::Matchers::SizeIs(1));
+            const auto& first = counter_timeline[0][0];
+            const auto& second = counter_timeline[0][1];
+
+            THEN("Counters of each slice are summed") {
+                CHECK(first == elphi::CounterValues{400, 600, 0, 0});
+                CHECK(second == elphi::CounterValues{200, 100, 0, 0});
+                CHECK(counter_timeline[1][0] == elphi::CounterValues{7, 7, 0, 0});
+            }
+            THEN("IPC of each slice is computed") {
+                CHECK(velphi::slice_ipc(first, counters) == 1.5);
+                CHECK(velphi::slice_ipc(second, counters) == 0.5);
+            }
+            THEN("Counters which were not sampled have no value") {
+                CHECK(velphi::counter_value(first, counters, elphi::Counter::instructions) == 600U);
+                CHECK(!velphi::counter_value(first, counters, elphi::Counter::cache_misses));
+                CHECK(!velphi::slice_ipc(first, std::span{counters}.first(1)));
+            }
+        }
+        WHEN("The values are missing") {
+            result.counter_values.clear();
+
+            THEN("There are no counters of the slices") { CHECK(velphi::gen_counter_timelines(result).empty()); }
+        }
+    }
+}
+
+SCENARIO("Timeline view of context switches", "[view][timeline]") {
+    using Kind = elphi::SampleKind;
+
+    GIVEN("Thread switched in twice with an idle gap and a tick in between") {
+        elphi::CpuSamplingResult result{.samples = {
+                                            {.pid = 1, .tid = 1, .cpu = 0, .time = 1ms, .kind = Kind::switch_in},
+                                            {.pid = 1, .tid = 1, .cpu = 0, .time = 2ms, .kind = Kind::tick},
+                                            {.pid = 1, .tid = 1, .cpu = 0, .time = 3ms, .kind = Kind::switch_out},
+                                            {.pid = 1, .tid = 1, .cpu = 0, .time = 5ms, .kind = Kind::switch_in},
+                                            {.pid = 1, .tid = 1, .cpu = 0, .time = 6ms, .kind = Kind::switch_out},
+                                            {.pid = 2, .tid = 2, .cpu = 0, .time = 6ms, .kind = Kind::switch_in},
+                                            {.pid = 2, .tid = 2, .cpu = 0, .time = 7ms, .kind = Kind::switch_out},
+                                        }};
+
+        WHEN("Processed") {
+            auto timeline = velphi::gen_cpu_timelines(result);
+
+            THEN("Slices span exactly the runs") {
+                REQUIRE_THAT(timeline[0], Catch::Matchers::SizeIs(3));
+                CHECK(timeline[0][0].begin_time == 1ms);
+                CHECK(timeline[0][0].end_time == 3ms);
+                CHECK(timeline[0][1].begin_time == 5ms);
+                CHECK(timeline[0][1].end_time == 6ms);
+                CHECK(timeline[0][2].pid == 2);
+                CHECK(timeline[0][2].begin_time == 6ms);
+                CHECK(timeline[0][2].end_time == 7ms);
+            }
+        }
+        WHEN("Processed into cgroup timelines") {
+            auto groups = velphi::gen_group_timelines(result);
+
+            THEN("The slices are the same") { CHECK(groups[0] == velphi::gen_cpu_timelines(result)); }
+        }
+    }
+}
@@ -0,0 +1,229 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include <catch2/catch_all.hpp>
+#include <elphi/exception.hpp>
+#include <elphi/trace_export.hpp>
+
+using namespace std::chrono_literals;
+namespace velphi = elphi::view;
+
+namespace {
+/*******************************************************************************
+ * @brief Temporary file removed at the end of the scope.
+ ******************************************************************************/
+struct TempFile {
+    explicit TempFile(std::string_view name) : path(std::filesystem::temp_directory_path() / name) {}
+    TempFile(const TempFile&) = delete;
+    TempFile(TempFile&&) = delete;
+    TempFile&
+    operator=(const TempFile&) = delete;
+    TempFile&
+    operator=(TempFile&&) = delete;
+    ~TempFile() { std::filesystem::remove(path); }
+
+    std::filesystem::path path;
+};
+
+/*******************************************************************************
+ * @brief Whole content of file at @p path .
+ ******************************************************************************/
+std::string
+read_file(const std::filesystem::path& path) {
+    std::ifstream file{path, std::ios::binary};
+    return {std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+}
+
+/*******************************************************************************
+ * @brief Protobuf message decoded as field -> values, nested messages stay encoded.
+ ******************************************************************************/
+struct Message {
+    std::multimap<std::uint32_t, std::uint64_t> ints;
+    std::multimap<std::uint32_t, std::string> bytes;
+
+    std::uint64_t
+    get(std::uint32_t field) const {
+        REQUIRE(ints.count(field) == 1);
+        return ints.find(field)->second;
+    }
+
+    Message
+    sub(std::uint32_t field) const;
+};
+
+std::uint64_t
+get_varint(std::string_view& bytes) {
+    std::uint64_t value = 0;
+    for (unsigned shift = 0;; shift += 7) {
+        REQUIRE(!bytes.empty());
+        const auto byte = static_cast<unsigned char>(bytes.front());
+        bytes.remove_prefix(1);
+        value |= static_cast<std::uint64_t>(byte & 0x7FU) << shift;
+        if ((byte & 0x80U) == 0)
+            return value;
+    }
+}
+
+Message
+decode(std::string_view bytes) {
+    Message msg;
+    while (!bytes.empty()) {
+        const auto key = get_varint(bytes);
+        const auto field = static_cast<std::uint32_t>(key >> 3U);
+        if ((key & 7U) == 0) {
+            msg.ints.emplace(field, get_varint(bytes));
+        } else {
+            REQUIRE((key & 7U) == 2);
+            const auto size = get_varint(bytes);
+            REQUIRE(size <= bytes.size());
+            msg.bytes.emplace(field, std::string{bytes.substr(0, size)});
+            bytes.remove_prefix(size);
+        }
+    }
+    return msg;
+}
+
+Message
+Message::sub(std::uint32_t field) const {
+    REQUIRE(bytes.count(field) == 1);
+    return decode(bytes.find(field)->second);
+}
+
+/*******************************************************************************
+ * @brief Slice of @p pid named @p name on @p cpu during [@p begin, @p end ).
+ ******************************************************************************/
+velphi::ThreadTimeSlice
+slice(elphi::CpuId cpu, elphi::ProcId pid, elphi::NameId name, elphi::TimePoint begin, elphi::TimePoint end) {
+    return {.begin_time = begin, .end_time = end, .name = name, .pid = pid, .tid = pid + 1, .cpu = cpu};
+}
+} // namespace
+
+SCENARIO("Exporting timelines as traces", "[view][trace_export]") {
+    TempFile file{"elphi_test_trace"};
+    elphi::StringTable names;
+    const auto bash = names.intern("bash");
+    const auto quoted = names.intern("a \"b\"\\\n");
+
+    GIVEN("Unwritable path") {
+        THEN("No writer is created") {
+            CHECK_THROWS_AS(velphi::TraceWriter("/nonexistent/trace.json", velphi::TraceFormat::chrome_json),
+                            elphi::ElphiException);
+        }
+    }
+    GIVEN("Timeline of two CPUs") {
+        velphi::Timeline timeline;
+        timeline[3] = {slice(3, 10, bash, 1'000'500ns, 1'002'000ns)};
+        timeline[0] = {slice(0, 20, quoted, 5ns, 2'000ns), slice(0, 10, bash, 3'000ns, 3'001ns)};
+
+        WHEN("Exported as Chrome JSON") {
+            velphi::export_trace(timeline, names, file.path.string(), velphi::TraceFormat::chrome_json);
+
+            THEN("CPUs are threads with complete events in microseconds") {
+                constexpr std::string_view expected =
+                    R"({"traceEvents":[
+{"ph":"M","name":"process_name","pid":0,"args":{"name":"CPUs"}},
+{"ph":"M","name":"thread_name","pid":0,"tid":0,"args":{"name":"CPU 0"}},
+{"ph":"M","name":"thread_sort_index","pid":0,"tid":0,"args":{"sort_index":0}},
+{"ph":"X","name":"a \"b\"\\\u000a","pid":0,"tid":0,"ts":0.005,"dur":1.995,"args":{"pid":20,"tid":21}},
+{"ph":"X","name":"bash","pid":0,"tid":0,"ts":3.000,"dur":0.001,"args":{"pid":10,"tid":11}},
+{"ph":"M","name":"thread_name","pid":0,"tid":3,"args":{"name":"CPU 3"}},
+{"ph":"M","name":"thread_sort_index","pid":0,"tid":3,"args":{"sort_index":3}},
+{"ph":"X","name":"bash","pid":0,"tid":3,"ts":1000.500,"dur":1.500,"args":{"pid":10,"tid":11}}
+],"displayTimeUnit":"ns"}
+)";
+                CHECK(read_file(file.path) == expected);
+            }
+        }
+        WHEN("Exported as Perfetto trace") {
+            velphi::export_trace(timeline, names, file.path.string(), velphi::TraceFormat::perfetto);
+            const auto trace = decode(read_file(file.path));
+            std::vector<Message> packets;
+            for (const auto& [field, packet] : trace.bytes) {
+                REQUIRE(field == 1);
+                packets.push_back(decode(packet));
+            }
+            REQUIRE(trace.ints.empty());
+
+            THEN("Each CPU is described before its slices") {
+                REQUIRE(packets.size() == 1 + 2 + 2 + 3 * 2);
+                CHECK(packets[0].get(13) == 1);
+                const auto cpu0 = packets[1].sub(60);
+                CHECK(cpu0.get(1) == 1);
+                CHECK(cpu0.bytes.find(2)->second == "CPU 0");
+                const auto cpu3 = packets[8].sub(60);
+                CHECK(cpu3.get(1) == 4);
+                CHECK(cpu3.bytes.find(2)->second == "CPU 3");
+            }
+            THEN("Slices begin and end on their tracks, names are interned once") {
+                std::map<std::uint64_t, std::string> interned;
+                std::vector<std::tuple<std::uint64_t, std::uint64_t, std::uint64_t, std::string>> events;
+                for (const auto& packet : packets) {
+                    if (packet.bytes.contains(12)) {
+                        CHECK(packet.get(13) == 2);
+                        const auto entry = packet.sub(12).sub(2);
+                        CHECK(interned.emplace(entry.get(1), entry.bytes.find(2)->second).second);
+                    }
+                    if (!packet.bytes.contains(11))
+                        continue;
+                    CHECK(packet.get(10) == 1);
+                    CHECK(packet.get(13) == 2);
+                    const auto event = packet.sub(11);
+                    const auto type = event.get(9);
+                    std::string name;
+                    if (type == 1) {
+                        REQUIRE(interned.contains(event.get(10)));
+                        name = interned[event.get(10)];
+                        const auto pid = decode(event.bytes.find(4)->second);
+                        CHECK(pid.bytes.find(10)->second == "pid");
+                    }
+                    events.emplace_back(packet.get(8), event.get(11), type, name);
+                }
+                CHECK(interned.size() == 2);
+                using Event = std::tuple<std::uint64_t, std::uint64_t, std::uint64_t, std::string>;
+                CHECK(events == std::vector<Event>{{5, 1, 1, "a \"b\"\\\n"},
+                                                   {2'000, 1, 2, ""},
+                                                   {3'000, 1, 1, "bash"},
+                                                   {3'001, 1, 2, ""},
+                                                   {1'000'500, 4, 1, "bash"},
+                                                   {1'002'000, 4, 2, ""}});
+            }
+        }
+    }
+    GIVEN("Timeline larger than the buffer") {
+        velphi::Timeline timeline;
+        for (elphi::CpuId cpu = 0; cpu < 4; ++cpu)
+            for (std::size_t i = 0; i < 20'000; ++i) {
+                const auto begin = elphi::TimePoint{static_cast<std::int64_t>(i * 1000 + cpu)};
+                timeline[cpu].push_back(slice(cpu, static_cast<elphi::ProcId>(i % 7), i % 2 == 0 ? bash : quoted,
+                                              begin, begin + 700ns));
+            }
+
+        for (const auto format : {velphi::TraceFormat::chrome_json, velphi::TraceFormat::perfetto}) {
+            WHEN("Written in batches") {
+                {
+                    velphi::TraceWriter writer{file.path.string(), format};
+                    for (elphi::CpuId cpu = 0; cpu < 4; ++cpu) {
+                        const std::span slices{timeline[cpu]};
+                        for (std::size_t i = 0; i < slices.size(); i += 999)
+                            writer.write(slices.subspan(i, std::min<std::size_t>(999, slices.size() - i)), names);
+                    }
+                }
+                const auto batched = read_file(file.path);
+
+                THEN("The trace is the same as exported at once") {
+                    REQUIRE(batched.size() > velphi::TraceWriter::c_flush_size);
+                    velphi::export_trace(timeline, names, file.path.string(), format);
+                    CHECK(read_file(file.path) == batched);
+                }
+            }
+        }
+    }
+}
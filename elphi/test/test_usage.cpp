@@ -0,0 +1,178 @@
+#include <map>
+#include <random>
+#include <vector>
+
+#include <catch2/catch_all.hpp>
+#include <elphi/exception.hpp>
+#include <elphi/timeline_view.hpp>
+#include <elphi/usage.hpp>
+
+using namespace std::chrono_literals;
+namespace velphi = elphi::view;
+
+namespace {
+/*******************************************************************************
+ * @brief Time-ordered samples of @p num_cpus CPUs running @p num_threads threads.
+ ******************************************************************************/
+std::vector<elphi::CpuSample>
+random_samples(std::size_t num, std::size_t num_cpus, std::size_t num_threads, std::mt19937_64& gen) {
+    std::vector<elphi::CpuSample> samples;
+    std::vector<elphi::ProcId> running(num_cpus, 1);
+    elphi::TimePoint time{0};
+    for (std::size_t i = 0; i < num; ++i) {
+        time += elphi::TimePoint{static_cast<std::int64_t>(gen() % 300)};
+        const auto cpu = gen() % num_cpus;
+        if (gen() % 4 == 0)
+            running[cpu] = static_cast<elphi::ProcId>(gen() % num_threads);
+        const auto pid = running[cpu];
+        samples.push_back({.pid = pid / 3,
+                           .tid = pid,
+                           .cpu = cpu,
+                           .time = time,
+                           .cgroup = pid % 2,
+                           .kind = gen() % 13 == 0 ? elphi::SampleKind::switch_out : elphi::SampleKind::tick});
+    }
+    return samples;
+}
+
+/*******************************************************************************
+ * @brief Time of each thread in the window ending by bucket of the last sample.
+ ******************************************************************************/
+std::map<std::pair<elphi::ProcId, elphi::ThreadId>, elphi::TimePoint>
+scan_usage(const std::vector<elphi::CpuSample>& samples, elphi::TimePoint width, std::int64_t num_buckets) {
+    std::map<std::pair<elphi::ProcId, elphi::ThreadId>, elphi::TimePoint> times;
+    std::map<elphi::CpuId, elphi::CpuSample> last;
+    const auto head = samples.back().time / width;
+    for (const auto& sample : samples) {
+        auto it = last.find(sample.cpu);
+        if (it != last.end() && it->second.pid != 0 && velphi::prolongs_slice(it->second, sample) &&
+            sample.time / width > head - num_buckets)
+            times[{sample.pid, sample.tid}] += sample.time - it->second.time;
+        last.insert_or_assign(sample.cpu, sample);
+    }
+    std::erase_if(times, [](const auto& entry) { return entry.second == 0ns; });
+    return times;
+}
+} // namespace
+
+SCENARIO("Aggregating CPU usage", "[view][usage]") {
+    std::mt19937_64 gen{5};
+
+    GIVEN("Invalid window") {
+        THEN("No aggregator is created") {
+            CHECK_THROWS_AS(velphi::UsageAggregator{velphi::UsageConfig{.bucket_width = 0ns}}, elphi::ElphiException);
+            CHECK_THROWS_AS(velphi::UsageAggregator{velphi::UsageConfig{.num_buckets = 0}}, elphi::ElphiException);
+        }
+    }
+    GIVEN("Empty aggregator") {
+        const velphi::UsageAggregator usage;
+        THEN("Nothing is reported") {
+            CHECK(usage.top_threads(10).empty());
+            CHECK(usage.top_processes(10).empty());
+            CHECK(usage.top_groups(10).empty());
+            CHECK(usage.window_end() == 0ns);
+            CHECK(usage.num_threads() == 0);
+        }
+    }
+    GIVEN("Aggregator of a small table and a short window") {
+        const velphi::UsageConfig config{.bucket_width = 10us, .num_buckets = 4, .capacity = 2};
+        velphi::UsageAggregator usage{config};
+        const auto samples = random_samples(5000, 3, 40, gen);
+
+        WHEN("Samples are added batch by batch") {
+            const std::span all{samples};
+            const std::size_t batch = GENERATE(1, 100, 5000);
+            std::size_t added = 0;
+            for (; added < all.size(); added += batch) {
+                const auto num = std::min(batch, all.size() - added);
+                usage.add(all.subspan(added, num));
+                // Checking every few hundred samples keeps the scans short.
+                if ((added + num) % 500 >= num && added + num != all.size())
+                    continue;
+
+                const std::vector<elphi::CpuSample> prefix{all.begin(), all.begin() + static_cast<long>(added + num)};
+                const auto expected = scan_usage(prefix, config.bucket_width, 4);
+                REQUIRE(usage.num_threads() == expected.size());
+                for (const auto& [thread, time] : expected)
+                    REQUIRE(usage.thread_time(thread.first, thread.second) == time);
+            }
+
+            THEN("The table grew to hold the threads") { CHECK(usage.capacity() >= usage.num_threads()); }
+            THEN("The window ends by the bucket of the last sample") {
+                CHECK(usage.window_end() - usage.window_begin() == 40us);
+                CHECK(usage.window_end() > samples.back().time);
+                CHECK(usage.window_end() - 10us <= samples.back().time);
+            }
+            THEN("Top threads are ordered by time") {
+                const auto expected = scan_usage(samples, config.bucket_width, 4);
+                const auto top = usage.top_threads(5);
+                REQUIRE(top.size() == std::min<std::size_t>(5, expected.size()));
+                for (std::size_t i = 0; i + 1 < top.size(); ++i)
+                    CHECK(top[i].time >= top[i + 1].time);
+                for (const auto& [thread, time] : expected)
+                    CHECK(time <= top.front().time);
+                CHECK(usage.top_threads(1000).size() == expected.size());
+            }
+            THEN("Processes and cgroups sum their threads") {
+                const auto expected = scan_usage(samples, config.bucket_width, 4);
+                std::map<elphi::ProcId, elphi::TimePoint> processes;
+                std::map<elphi::GroupId, elphi::TimePoint> groups;
+                for (const auto& [thread, time] : expected) {
+                    processes[thread.first] += time;
+                    groups[thread.second % 2] += time;
+                }
+                const auto top_processes = usage.top_processes(1000);
+                REQUIRE(top_processes.size() == processes.size());
+                for (const auto& process : top_processes)
+                    CHECK(processes.at(process.pid) == process.time);
+                const auto top_groups = usage.top_groups(1000);
+                REQUIRE(top_groups.size() == groups.size());
+                for (const auto& group : top_groups)
+                    CHECK(groups.at(group.cgroup) == group.time);
+            }
+        }
+    }
+    GIVEN("Aggregator of a few threads") {
+        velphi::UsageAggregator usage{velphi::UsageConfig{.bucket_width = 1s, .num_buckets = 2}};
+        const std::vector<elphi::CpuSample> samples{
+            {.pid = 1, .tid = 1, .cpu = 0, .time = 0ms},   {.pid = 2, .tid = 3, .cpu = 1, .time = 0ms},
+            {.pid = 1, .tid = 1, .cpu = 0, .time = 300ms}, {.pid = 2, .tid = 3, .cpu = 1, .time = 100ms},
+            {.pid = 0, .tid = 0, .cpu = 0, .time = 400ms}, {.pid = 0, .tid = 0, .cpu = 0, .time = 900ms},
+        };
+        usage.add(samples);
+
+        THEN("Each gets the time of its slices") {
+            CHECK(usage.thread_time(1, 1) == 300ms);
+            CHECK(usage.thread_time(2, 3) == 100ms);
+            const auto top = usage.top_threads(1);
+            REQUIRE(top.size() == 1);
+            CHECK(top[0].pid == 1);
+        }
+        THEN("The idle task is not accounted") {
+            CHECK(usage.thread_time(0, 0) == 0ns);
+            CHECK(usage.num_threads() == 2);
+        }
+
+        WHEN("The window slides past them") {
+            const std::vector<elphi::CpuSample> later{
+                {.pid = 2, .tid = 3, .cpu = 1, .time = 1100ms},
+                {.pid = 2, .tid = 3, .cpu = 1, .time = 2100ms},
+            };
+            usage.add(later);
+
+            THEN("Only the time in the window remains") {
+                CHECK(usage.thread_time(1, 1) == 0ns);
+                CHECK(usage.thread_time(2, 3) == 2000ms);
+                CHECK(usage.num_threads() == 1);
+                CHECK(usage.window_begin() == 1s);
+            }
+            AND_WHEN("An old sample arrives") {
+                const std::vector<elphi::CpuSample> old{
+                    {.pid = 1, .tid = 1, .cpu = 0, .time = 500ms},
+                };
+                usage.add(old);
+                THEN("It is ignored") { CHECK(usage.thread_time(1, 1) == 0ns); }
+            }
+        }
+    }
+}
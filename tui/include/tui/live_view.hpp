@@ -0,0 +1,139 @@
+/*******************************************************************************
+ * @file live_view.hpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license This file is released under ElPhi project's license, see LICENSE.
+ *
+ * Per-CPU timeline of a running sampling session drawn to a screen.
+ ******************************************************************************/
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <elphi/cpu_sampler.hpp>
+#include <elphi/timeline_lod.hpp>
+#include <elphi/usage.hpp>
+#include <tui/screen.hpp>
+
+namespace elphi::tui {
+
+/*******************************************************************************
+ * @brief What part of the timeline is shown.
+ ******************************************************************************/
+struct ViewState {
+    /*! Time range shown by the CPU rows. */
+    TimePoint span = std::chrono::seconds{10};
+    /*! Index of the first shown CPU. */
+    std::size_t first_cpu = 0;
+    /*! Whether the view stays at the time it was paused at. */
+    bool paused = false;
+    /*! Latest shown time while paused. */
+    TimePoint paused_at = TimePoint::zero();
+};
+
+/*******************************************************************************
+ * @brief Cost of the viewer itself, shown in its header.
+ ******************************************************************************/
+struct FrameStats {
+    /*! Average time to draw and render a frame. */
+    std::chrono::microseconds frame_time{};
+    /*! Average number of cells updated by a frame. */
+    std::size_t num_updated = 0;
+    /*! Frames per second over the last second. */
+    double fps = 0.0;
+};
+
+/*******************************************************************************
+ * @brief Bounded summary of a live session drawn as a row per CPU.
+ *
+ * Samples are folded into a @ref view::TimelinePyramid, thus drawing a frame
+ * costs O(width) per shown CPU regardless of the zoom. Buckets older than the
+ * retention are evicted as the samples come, the memory stays bounded.
+ *
+ * Sinks of the session and the drawing thread may call it concurrently.
+ ******************************************************************************/
+class LiveView {
+public:
+    /*******************************************************************************
+     * @brief Create view of @p cpus retaining their last @p retention .
+     ******************************************************************************/
+    LiveView(std::vector<CpuId> cpus, TimePoint retention);
+
+    /*******************************************************************************
+     * @brief Fold @p samples into the view, a @ref SampleSink.
+     ******************************************************************************/
+    void
+    add(std::span<const CpuSample> samples);
+
+    /*******************************************************************************
+     * @brief Name process @p pid , a @ref NameSink.
+     ******************************************************************************/
+    void
+    set_name(ProcId pid, std::string_view name);
+
+    /*******************************************************************************
+     * @brief Time of the latest sample.
+     ******************************************************************************/
+    TimePoint
+    now() const;
+
+    /*******************************************************************************
+     * @brief Number of sampled CPUs.
+     ******************************************************************************/
+    std::size_t
+    num_cpus() const noexcept {
+        return m_cpus.size();
+    }
+
+    /*******************************************************************************
+     * @brief Longest span that can be shown.
+     ******************************************************************************/
+    TimePoint
+    retention() const noexcept {
+        return m_retention;
+    }
+
+    /*******************************************************************************
+     * @brief Draw the whole frame into @p screen .
+     ******************************************************************************/
+    void
+    draw(Screen& screen, const ViewState& state, const FrameStats& stats) const;
+
+private:
+    /*******************************************************************************
+     * @brief Draw row @p y of @p cpu covering [@p from, @p from + @p columns * @p column).
+     ******************************************************************************/
+    void
+    draw_cpu(Screen& screen, std::size_t y, CpuId cpu, TimePoint from, TimePoint column) const;
+
+    /*******************************************************************************
+     * @brief Draw the processes using most CPU from row @p y on.
+     ******************************************************************************/
+    void
+    draw_top(Screen& screen, std::size_t y) const;
+
+    /*! Guards all of the below. */
+    mutable std::mutex m_mutex;
+    /*! Sampled CPUs, ordered. */
+    std::vector<CpuId> m_cpus;
+    /*! How long the buckets are kept. */
+    TimePoint m_retention;
+    /*! Time of the last eviction. */
+    TimePoint m_evicted = TimePoint::zero();
+    /*! Time of the latest sample. */
+    TimePoint m_now = TimePoint::zero();
+    /*! Number of folded samples. */
+    std::size_t m_num_samples = 0;
+    /*! Summary of the timeline. */
+    view::TimelinePyramid m_pyramid;
+    /*! CPU time of the processes in the last few seconds. */
+    view::UsageAggregator m_usage;
+    /*! Name of each process. */
+    std::unordered_map<ProcId, std::string> m_names;
+};
+} // namespace elphi::tui
@@ -0,0 +1,124 @@
+/*******************************************************************************
+ * @file screen.hpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license This file is released under ElPhi project's license, see LICENSE.
+ *
+ * Character grid redrawn incrementally to a terminal.
+ ******************************************************************************/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace elphi::tui {
+
+/*! Index into the 256-color palette of the terminal. */
+using Color = std::uint16_t;
+/*! Default color of the terminal. */
+inline constexpr Color c_default_color = 256;
+
+/*******************************************************************************
+ * @brief Single character of the screen.
+ ******************************************************************************/
+struct Cell {
+    /*! Displayed character. */
+    char32_t ch = U' ';
+    /*! Color of the character. */
+    Color fg = c_default_color;
+    /*! Color of the background. */
+    Color bg = c_default_color;
+
+    /*******************************************************************************
+     * @brief Default member-wise comparison.
+     ******************************************************************************/
+    friend bool
+    operator==(const Cell&, const Cell&) = default;
+};
+
+/*******************************************************************************
+ * @brief Double-buffered grid of cells with damage tracking.
+ *
+ * Cells are drawn into the back buffer, @ref render emits escape sequences
+ * only for cells differing from what the terminal already shows, thus a
+ * mostly static frame costs a few bytes of output.
+ ******************************************************************************/
+class Screen {
+public:
+    /*******************************************************************************
+     * @brief Resize the screen, the next render redraws everything.
+     ******************************************************************************/
+    void
+    resize(std::size_t width, std::size_t height);
+
+    /*******************************************************************************
+     * @brief Number of columns.
+     ******************************************************************************/
+    std::size_t
+    width() const noexcept {
+        return m_width;
+    }
+
+    /*******************************************************************************
+     * @brief Number of rows.
+     ******************************************************************************/
+    std::size_t
+    height() const noexcept {
+        return m_height;
+    }
+
+    /*******************************************************************************
+     * @brief Fill the back buffer with blank cells.
+     ******************************************************************************/
+    void
+    clear() noexcept;
+
+    /*******************************************************************************
+     * @brief Set cell at column @p x of row @p y , ignored outside of the screen.
+     ******************************************************************************/
+    void
+    put(std::size_t x, std::size_t y, const Cell& cell) noexcept {
+        if (x < m_width && y < m_height)
+            m_back[y * m_width + x] = cell;
+    }
+
+    /*******************************************************************************
+     * @brief Write @p text from column @p x of row @p y , clipped to the screen.
+     *
+     * Non-ASCII characters are replaced by '?'.
+     *
+     * @return Column after the text.
+     ******************************************************************************/
+    std::size_t
+    print(std::size_t x, std::size_t y, std::string_view text, Color fg = c_default_color,
+          Color bg = c_default_color) noexcept;
+
+    /*******************************************************************************
+     * @brief Forget what the terminal shows, the next render redraws everything.
+     ******************************************************************************/
+    void
+    invalidate() noexcept;
+
+    /*******************************************************************************
+     * @brief Append escape sequences updating the terminal to the back buffer to @p out .
+     *
+     * @return Number of updated cells.
+     ******************************************************************************/
+    std::size_t
+    render(std::string& out);
+
+private:
+    /*! Number of columns. */
+    std::size_t m_width = 0;
+    /*! Number of rows. */
+    std::size_t m_height = 0;
+    /*! Cells being drawn. */
+    std::vector<Cell> m_back;
+    /*! Cells shown by the terminal. */
+    std::vector<Cell> m_front;
+    /*! Whether the terminal shows unknown content. */
+    bool m_stale = true;
+};
+} // namespace elphi::tui
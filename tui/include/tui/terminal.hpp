@@ -0,0 +1,75 @@
+/*******************************************************************************
+ * @file terminal.hpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license This file is released under ElPhi project's license, see LICENSE.
+ *
+ * Raw-mode terminal owned by a full-screen application.
+ ******************************************************************************/
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include <termios.h>
+
+namespace elphi::tui {
+
+/*******************************************************************************
+ * @brief Terminal in raw mode showing the alternate screen.
+ *
+ * The original mode and screen are restored by the destructor.
+ ******************************************************************************/
+class Terminal {
+public:
+    /*******************************************************************************
+     * @brief Switch the controlling terminal of stdin/stdout to raw mode.
+     *
+     * @throw ElphiException if stdin or stdout is not a terminal.
+     ******************************************************************************/
+    Terminal();
+
+    Terminal(const Terminal&) = delete;
+    Terminal(Terminal&&) = delete;
+    Terminal&
+    operator=(const Terminal&) = delete;
+    Terminal&
+    operator=(Terminal&&) = delete;
+
+    /*******************************************************************************
+     * @brief Restore the original mode and screen.
+     ******************************************************************************/
+    ~Terminal();
+
+    /*******************************************************************************
+     * @brief Number of columns and rows.
+     ******************************************************************************/
+    std::pair<std::size_t, std::size_t>
+    size() const;
+
+    /*******************************************************************************
+     * @brief Whether the terminal was resized since the last call.
+     ******************************************************************************/
+    bool
+    resized() noexcept;
+
+    /*******************************************************************************
+     * @brief Read pending input, waiting up to @p timeout for some.
+     *
+     * @return Bytes of the pressed keys, empty if none came in time.
+     ******************************************************************************/
+    std::string
+    read_input(std::chrono::milliseconds timeout);
+
+    /*******************************************************************************
+     * @brief Write all of @p data to the terminal.
+     ******************************************************************************/
+    void
+    write(std::string_view data);
+
+private:
+    /*! Mode of the terminal before switching to raw. */
+    termios m_original{};
+};
+} // namespace elphi::tui
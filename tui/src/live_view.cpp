@@ -0,0 +1,193 @@
+/*******************************************************************************
+ * @file live_view.cpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license	This file is released under ElPhi project's license, see LICENSE.
+ ******************************************************************************/
+#include <algorithm>
+#include <array>
+
+#include <fmt/format.h>
+
+#include <tui/live_view.hpp>
+
+namespace elphi::tui {
+
+namespace {
+/*! Columns of the CPU labels. */
+constexpr std::size_t c_label_width = 10;
+/*! Rows of the header. */
+constexpr std::size_t c_header_height = 2;
+/*! Most processes listed below the CPUs. */
+constexpr std::size_t c_max_top = 5;
+/*! Finest resolution of the timeline. */
+constexpr view::LodConfig c_lod{.base_width = std::chrono::milliseconds{10}, .factor = 4, .num_levels = 5};
+/*! Window of the process list. */
+constexpr view::UsageConfig c_usage{.bucket_width = std::chrono::seconds{1}, .num_buckets = 5, .capacity = 1024};
+/*! Glyphs of the busy fraction of a column, in eighths. */
+constexpr std::array<char32_t, 9> c_glyphs = {U' ', U'▁', U'▂', U'▃', U'▄', U'▅', U'▆', U'▇', U'█'};
+/*! Color of the header. */
+constexpr Color c_header_color = 250;
+/*! Background of the header. */
+constexpr Color c_header_background = 236;
+
+/*******************************************************************************
+ * @brief Color distinguishing process @p pid , bright ones of the color cube.
+ ******************************************************************************/
+Color
+color_of(ProcId pid) noexcept {
+    if (pid == 0)
+        return c_default_color;
+    const auto hash = static_cast<std::uint32_t>(pid * 2654435761U);
+    // Components 1-5 of the 6x6x6 cube avoid the darkest colors.
+    const auto red = 1 + (hash >> 8U) % 5;
+    const auto green = 1 + (hash >> 16U) % 5;
+    const auto blue = 1 + (hash >> 24U) % 5;
+    return static_cast<Color>(16 + 36 * red + 6 * green + blue);
+}
+
+/*******************************************************************************
+ * @brief Human-readable @p time , e.g. "10s" or "500ms".
+ ******************************************************************************/
+std::string
+format_span(TimePoint time) {
+    if (time >= std::chrono::seconds{1})
+        return fmt::format("{}s", std::chrono::duration_cast<std::chrono::seconds>(time).count());
+    return fmt::format("{}ms", std::chrono::duration_cast<std::chrono::milliseconds>(time).count());
+}
+} // namespace
+
+LiveView::LiveView(std::vector<CpuId> cpus, TimePoint retention) :
+    m_cpus(std::move(cpus)), m_retention(retention), m_pyramid(c_lod), m_usage(c_usage) {
+    std::ranges::sort(m_cpus);
+}
+
+void
+LiveView::add(std::span<const CpuSample> samples) {
+    if (samples.empty())
+        return;
+
+    std::scoped_lock lock{m_mutex};
+    m_pyramid.add(samples);
+    m_usage.add(samples);
+    m_num_samples += samples.size();
+    m_now = std::max(m_now, samples.back().time);
+    // Evicting in steps keeps the amortized cost low.
+    if (m_now - m_evicted > m_retention / 8) {
+        m_pyramid.evict_before(m_now - m_retention);
+        m_evicted = m_now;
+    }
+}
+
+void
+LiveView::set_name(ProcId pid, std::string_view name) {
+    std::scoped_lock lock{m_mutex};
+    m_names.insert_or_assign(pid, std::string{name});
+}
+
+TimePoint
+LiveView::now() const {
+    std::scoped_lock lock{m_mutex};
+    return m_now;
+}
+
+void
+LiveView::draw(Screen& screen, const ViewState& state, const FrameStats& stats) const {
+    std::scoped_lock lock{m_mutex};
+    const auto width = screen.width();
+    const auto height = screen.height();
+    if (width <= c_label_width || height <= c_header_height)
+        return;
+
+    // Whole columns keep the drawn buckets in place as the time goes, only the newest column changes.
+    const auto columns = width - c_label_width;
+    const auto column = std::max(TimePoint{1}, state.span / static_cast<TimePoint::rep>(columns));
+    const auto now = state.paused ? state.paused_at : m_now;
+    const auto to = (now / column + 1) * column;
+    const auto from = to - column * static_cast<TimePoint::rep>(columns);
+
+    for (std::size_t x = 0; x < width; ++x)
+        screen.put(x, 0, Cell{.ch = U' ', .fg = c_header_color, .bg = c_header_background});
+    const auto header = fmt::format(" elphi  {} CPUs  {} samples  span {}{}  {:.0f} fps  frame {}us  {} cells  "
+                                    "[q]uit [+/-]zoom [j/k]scroll [space]pause",
+                                    m_cpus.size(), m_num_samples, format_span(state.span),
+                                    state.paused ? " paused" : "", stats.fps, stats.frame_time.count(),
+                                    stats.num_updated);
+    screen.print(0, 0, header, c_header_color, c_header_background);
+    screen.print(0, 1, " CPU busy");
+    screen.print(c_label_width, 1, fmt::format("-{}", format_span(state.span)));
+    screen.print(width - 3, 1, "now");
+
+    const auto num_top = std::min(c_max_top, height > c_header_height + 8 ? height - c_header_height - 8 : 0);
+    const auto top_height = num_top > 0 ? num_top + 1 : 0;
+    const auto rows = height - c_header_height - top_height;
+    for (std::size_t row = 0; row < rows && state.first_cpu + row < m_cpus.size(); ++row)
+        draw_cpu(screen, c_header_height + row, m_cpus[state.first_cpu + row], from, column);
+    if (num_top > 0)
+        draw_top(screen, height - top_height);
+}
+
+void
+LiveView::draw_cpu(Screen& screen, std::size_t y, CpuId cpu, TimePoint from, TimePoint column) const {
+    const auto columns = screen.width() - c_label_width;
+    const auto to = from + column * static_cast<TimePoint::rep>(columns);
+    // Enough finer buckets to fill each column.
+    const auto lod = m_pyramid.view(cpu, from, to - TimePoint{1}, columns * c_lod.factor);
+
+    TimePoint total_busy = TimePoint::zero();
+    std::size_t current = columns;
+    TimePoint busy = TimePoint::zero();
+    const view::LodBucket* dominant = nullptr;
+    const auto flush = [&]() {
+        if (current >= columns)
+            return;
+        const auto begin = from + column * static_cast<TimePoint::rep>(current);
+        // The newest column is still filling.
+        const auto elapsed = std::clamp(m_now - begin, TimePoint{1}, std::max(column, lod.width));
+        auto eighths = static_cast<std::size_t>((busy * 8 + elapsed / 2) / elapsed);
+        eighths = std::clamp<std::size_t>(eighths, busy > TimePoint::zero() ? 1 : 0, 8);
+        const auto pid = dominant != nullptr ? dominant->pid : 0;
+        screen.put(c_label_width + current, y, Cell{.ch = c_glyphs[eighths], .fg = color_of(pid)});
+        total_busy += busy;
+    };
+
+    for (std::size_t i = 0; i < lod.buckets.size(); ++i) {
+        const auto begin = lod.begin + lod.width * static_cast<TimePoint::rep>(i);
+        const auto col = begin > from ? static_cast<std::size_t>((begin - from) / column) : 0;
+        if (col >= columns)
+            break;
+        if (col != current) {
+            flush();
+            current = col;
+            busy = TimePoint::zero();
+            dominant = nullptr;
+        }
+        const auto& bucket = lod.buckets[i];
+        busy += bucket.busy;
+        if (bucket.pid != 0 && (dominant == nullptr || bucket.dominant_time > dominant->dominant_time))
+            dominant = &bucket;
+    }
+    flush();
+
+    const auto shown = std::max(TimePoint{1}, std::min(m_now, to) - from);
+    const auto percent = std::min<TimePoint::rep>(100, total_busy * 100 / shown);
+    screen.print(0, y, fmt::format("{:>4} {:>3}%", cpu, percent));
+}
+
+void
+LiveView::draw_top(Screen& screen, std::size_t y) const {
+    const auto top = m_usage.top_processes(screen.height() - y - 1);
+    const auto window = std::max(TimePoint{1}, std::min(m_now, m_usage.window_end()) - m_usage.window_begin());
+    screen.print(0, y, fmt::format("{:>8} {:>6} {:>7}  COMMAND (last {})", "PID", "CPU%", "THREADS",
+                                   format_span(window)),
+                 c_header_color, c_header_background);
+    for (const auto& process : top) {
+        ++y;
+        auto it = m_names.find(process.pid);
+        const std::string_view name = it != m_names.end() ? std::string_view{it->second} : "?";
+        const auto percent = static_cast<double>(process.time.count()) * 100.0 / static_cast<double>(window.count());
+        const auto x = screen.print(0, y, fmt::format("{:>8} {:>6.1f} {:>7}  ", process.pid, percent,
+                                                      process.num_threads));
+        screen.print(x, y, name, color_of(process.pid));
+    }
+}
+} // namespace elphi::tui
@@ -1,4 +1,205 @@
+/*******************************************************************************
+ * @file main.cpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license	This file is released under ElPhi project's license, see LICENSE.
+ *
+ * Live terminal view of what each CPU executes.
+ ******************************************************************************/
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <unistd.h>
+
+#include <elphi/sampling_session.hpp>
+#include <tui/live_view.hpp>
+#include <tui/terminal.hpp>
+
+namespace {
+using namespace std::chrono_literals;
+using Clock = std::chrono::steady_clock;
+
+/*! Time between frames, 60 per second. */
+constexpr std::chrono::microseconds c_frame_time{16'667};
+/*! Longest shown span, bounds the memory of the view. */
+constexpr elphi::TimePoint c_retention = 120s;
+/*! Shortest shown span. */
+constexpr elphi::TimePoint c_min_span = 1s;
+
+/*******************************************************************************
+ * @brief Options of the viewer.
+ ******************************************************************************/
+struct Options {
+    /*! Samples per second of each CPU. */
+    std::size_t frequency = 250;
+    /*! Whether to record context switches. */
+    bool trace_switches = false;
+};
+
+/*******************************************************************************
+ * @brief Parse command line @p args , nothing if invalid or help was requested.
+ ******************************************************************************/
+std::optional<Options>
+parse_options(std::span<char*> args) {
+    Options options;
+    for (std::size_t i = 1; i < args.size(); ++i) {
+        const std::string_view arg = args[i];
+        if (arg == "-s") {
+            options.trace_switches = true;
+        } else if (arg == "-f" && i + 1 < args.size()) {
+            const std::string_view value = args[++i];
+            if (std::from_chars(value.data(), value.data() + value.size(), options.frequency).ec != std::errc{})
+                return std::nullopt;
+        } else {
+            return std::nullopt;
+        }
+    }
+    return options;
+}
+
+/*******************************************************************************
+ * @brief Apply keys in @p input to @p state .
+ *
+ * @return Whether to quit.
+ ******************************************************************************/
+bool
+handle_input(std::string_view input, elphi::tui::ViewState& state, const elphi::tui::LiveView& view) {
+    while (!input.empty()) {
+        if (input.starts_with("\x1b[A") || input.starts_with("\x1b[B")) {
+            const bool up = input[2] == 'A';
+            state.first_cpu = up ? (state.first_cpu > 0 ? state.first_cpu - 1 : 0) : state.first_cpu + 1;
+            input.remove_prefix(3);
+            continue;
+        }
+        switch (input.front()) {
+        case 'q':
+        case '\x03': // Ctrl+C, raw mode does not raise SIGINT.
+            return true;
+        case '+':
+        case '=':
+            state.span = std::max(c_min_span, state.span / 2);
+            break;
+        case '-':
+            state.span = std::min(c_retention, state.span * 2);
+            break;
+        case 'j':
+            ++state.first_cpu;
+            break;
+        case 'k':
+            state.first_cpu = state.first_cpu > 0 ? state.first_cpu - 1 : 0;
+            break;
+        case ' ':
+            state.paused = !state.paused;
+            state.paused_at = view.now();
+            break;
+        default:
+            break;
+        }
+        input.remove_prefix(1);
+    }
+    state.first_cpu = std::min(state.first_cpu, view.num_cpus() > 0 ? view.num_cpus() - 1 : 0);
+    return false;
+}
+
+/*******************************************************************************
+ * @brief Show @p view until the user quits.
+ ******************************************************************************/
+void
+run(elphi::tui::Terminal& terminal, const elphi::tui::LiveView& view) {
+    elphi::tui::Screen screen;
+    elphi::tui::ViewState state;
+    elphi::tui::FrameStats stats;
+    std::string output;
+
+    // Stats are averaged over a second, redrawing them every frame would dominate the output.
+    std::size_t num_frames = 0;
+    std::size_t num_updated = 0;
+    Clock::duration frame_time{};
+    auto fps_since = Clock::now();
+    auto next_frame = Clock::now();
+    while (true) {
+        const auto begin = Clock::now();
+        if (terminal.resized()) {
+            const auto [width, height] = terminal.size();
+            screen.resize(width, height);
+        }
+        screen.clear();
+        view.draw(screen, state, stats);
+        output.clear();
+        num_updated += screen.render(output);
+        terminal.write(output);
+        frame_time += Clock::now() - begin;
+
+        if (const auto elapsed = Clock::now() - fps_since; ++num_frames, elapsed >= 1s) {
+            stats.fps = static_cast<double>(num_frames) / std::chrono::duration<double>(elapsed).count();
+            stats.frame_time = std::chrono::duration_cast<std::chrono::microseconds>(frame_time / num_frames);
+            stats.num_updated = num_updated / num_frames;
+            num_frames = 0;
+            num_updated = 0;
+            frame_time = {};
+            fps_since = Clock::now();
+        }
+
+        // Sleep in the input until the next frame, late frames are not caught up.
+        next_frame = std::max(next_frame + c_frame_time, Clock::now());
+        for (auto now = Clock::now(); now < next_frame; now = Clock::now()) {
+            const auto timeout = std::chrono::ceil<std::chrono::milliseconds>(next_frame - now);
+            const auto input = terminal.read_input(timeout);
+            if (input.empty())
+                break;
+            if (handle_input(input, state, view))
+                return;
+        }
+    }
+}
+} // namespace
+
 int
-main() {
+main(int argc, char* argv[]) {
+    const auto options = parse_options(std::span{argv, static_cast<std::size_t>(argc)});
+    if (!options) {
+        std::fprintf(stderr, "Usage: %s [-f frequency] [-s]\n"
+                             "  -f  Samples per second of each CPU, default 250.\n"
+                             "  -s  Record context switches for exact slices.\n",
+                     argv[0]);
+        return 2;
+    }
+
+    try {
+        // Online CPUs are assumed to be numbered contiguously.
+        const auto num_cpus = static_cast<elphi::CpuId>(std::max(1L, ::sysconf(_SC_NPROCESSORS_ONLN)));
+        std::vector<elphi::CpuId> cpus(num_cpus);
+        for (elphi::CpuId cpu = 0; cpu < num_cpus; ++cpu)
+            cpus[cpu] = cpu;
+
+        elphi::tui::LiveView view{cpus, c_retention};
+        elphi::SamplingSession session{elphi::SamplingConfig{
+            .cpus = cpus,
+            .frequency = options->frequency,
+            .trace_switches = options->trace_switches,
+            // A reader per 32 CPUs keeps up with large machines.
+            .num_readers = std::max<std::size_t>(1, cpus.size() / 32),
+            // Show the samples promptly, idle CPUs may reorder a few.
+            .reorder_window = 100ms,
+        }};
+        session.add_sink([&view](std::span<const elphi::CpuSample> samples) { view.add(samples); });
+        session.add_name_sink([&view](elphi::ProcId pid, std::string_view name) { view.set_name(pid, name); });
+        session.start();
+        {
+            elphi::tui::Terminal terminal;
+            run(terminal, view);
+        }
+        session.stop();
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
     return 0;
 }
@@ -0,0 +1,114 @@
+/*******************************************************************************
+ * @file screen.cpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license	This file is released under ElPhi project's license, see LICENSE.
+ ******************************************************************************/
+#include <algorithm>
+
+#include <fmt/format.h>
+
+#include <tui/screen.hpp>
+
+namespace elphi::tui {
+
+namespace {
+/*******************************************************************************
+ * @brief Append UTF-8 encoding of @p ch to @p out .
+ ******************************************************************************/
+void
+append_utf8(std::string& out, char32_t ch) {
+    const auto code = static_cast<std::uint32_t>(ch);
+    if (code < 0x80) {
+        out += static_cast<char>(code);
+    } else if (code < 0x800) {
+        out += static_cast<char>(0xC0 | (code >> 6U));
+        out += static_cast<char>(0x80 | (code & 0x3FU));
+    } else if (code < 0x10000) {
+        out += static_cast<char>(0xE0 | (code >> 12U));
+        out += static_cast<char>(0x80 | ((code >> 6U) & 0x3FU));
+        out += static_cast<char>(0x80 | (code & 0x3FU));
+    } else {
+        out += static_cast<char>(0xF0 | (code >> 18U));
+        out += static_cast<char>(0x80 | ((code >> 12U) & 0x3FU));
+        out += static_cast<char>(0x80 | ((code >> 6U) & 0x3FU));
+        out += static_cast<char>(0x80 | (code & 0x3FU));
+    }
+}
+
+/*******************************************************************************
+ * @brief Append SGR sequence switching to colors @p fg and @p bg to @p out .
+ ******************************************************************************/
+void
+append_colors(std::string& out, Color fg, Color bg) {
+    out += "\x1b[";
+    if (fg == c_default_color)
+        out += "39";
+    else
+        fmt::format_to(std::back_inserter(out), "38;5;{}", fg);
+    if (bg == c_default_color)
+        out += ";49m";
+    else
+        fmt::format_to(std::back_inserter(out), ";48;5;{}m", bg);
+}
+} // namespace
+
+void
+Screen::resize(std::size_t width, std::size_t height) {
+    m_width = width;
+    m_height = height;
+    m_back.assign(width * height, Cell{});
+    m_front.assign(width * height, Cell{});
+    m_stale = true;
+}
+
+void
+Screen::clear() noexcept {
+    std::ranges::fill(m_back, Cell{});
+}
+
+std::size_t
+Screen::print(std::size_t x, std::size_t y, std::string_view text, Color fg, Color bg) noexcept {
+    for (auto c : text) {
+        const auto ch = static_cast<unsigned char>(c);
+        put(x++, y, Cell{.ch = ch < 0x80 ? ch : U'?', .fg = fg, .bg = bg});
+    }
+    return x;
+}
+
+void
+Screen::invalidate() noexcept {
+    m_stale = true;
+}
+
+std::size_t
+Screen::render(std::string& out) {
+    if (m_stale) {
+        // Known blank front buffer, only the drawn cells are emitted.
+        out += "\x1b[0m\x1b[2J";
+        std::ranges::fill(m_front, Cell{});
+        m_stale = false;
+    }
+
+    std::size_t num_updated = 0;
+    // Position of the cursor and colors of the terminal, unknown at first.
+    std::size_t cursor = m_back.size();
+    const Cell* colors = nullptr;
+    for (std::size_t i = 0; i < m_back.size(); ++i) {
+        const auto& cell = m_back[i];
+        if (cell == m_front[i])
+            continue;
+
+        if (cursor != i)
+            fmt::format_to(std::back_inserter(out), "\x1b[{};{}H", i / m_width + 1, i % m_width + 1);
+        if (colors == nullptr || colors->fg != cell.fg || colors->bg != cell.bg)
+            append_colors(out, cell.fg, cell.bg);
+        append_utf8(out, cell.ch);
+        colors = &cell;
+        // The cursor does not wrap past the last column.
+        cursor = (i + 1) % m_width == 0 ? m_back.size() : i + 1;
+        m_front[i] = cell;
+        ++num_updated;
+    }
+    return num_updated;
+}
+} // namespace elphi::tui
@@ -0,0 +1,95 @@
+/*******************************************************************************
+ * @file terminal.cpp
+ * @copyright Copyright 2022 Jan Waltl.
+ * @license	This file is released under ElPhi project's license, see LICENSE.
+ ******************************************************************************/
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+
+#include <fmt/format.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <elphi/exception.hpp>
+#include <elphi/utils.hpp>
+#include <tui/terminal.hpp>
+
+namespace elphi::tui {
+
+namespace {
+/*! Set by SIGWINCH. */
+std::atomic<bool> g_resized{true};
+
+/*! Enter the alternate screen, hide the cursor. */
+constexpr std::string_view c_enter = "\x1b[?1049h\x1b[?25l";
+/*! Reset colors, show the cursor, leave the alternate screen. */
+constexpr std::string_view c_leave = "\x1b[0m\x1b[?25h\x1b[?1049l";
+
+extern "C" void
+on_resize(int /*signal*/) {
+    g_resized.store(true, std::memory_order_relaxed);
+}
+} // namespace
+
+Terminal::Terminal() {
+    if (::isatty(STDIN_FILENO) == 0 || ::isatty(STDOUT_FILENO) == 0)
+        throw ElphiException("Terminal viewer requires stdin and stdout to be a terminal.");
+    if (::tcgetattr(STDIN_FILENO, &m_original) != 0)
+        throw ElphiException(fmt::format("Cannot read terminal mode, reason: {}", strerror(errno)));
+
+    termios raw = m_original;
+    ::cfmakeraw(&raw);
+    if (::tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) != 0)
+        throw ElphiException(fmt::format("Cannot set terminal mode, reason: {}", strerror(errno)));
+
+    struct sigaction action {};
+    action.sa_handler = on_resize;
+    ::sigaction(SIGWINCH, &action, nullptr);
+    write(c_enter);
+}
+
+Terminal::~Terminal() {
+    write(c_leave);
+    ::tcsetattr(STDIN_FILENO, TCSAFLUSH, &m_original);
+    ::signal(SIGWINCH, SIG_DFL);
+}
+
+std::pair<std::size_t, std::size_t>
+Terminal::size() const {
+    winsize size{};
+    if (::ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) != 0 || size.ws_col == 0)
+        return {80, 24};
+    return {size.ws_col, size.ws_row};
+}
+
+bool
+Terminal::resized() noexcept {
+    return g_resized.exchange(false, std::memory_order_relaxed);
+}
+
+std::string
+Terminal::read_input(std::chrono::milliseconds timeout) {
+    pollfd input{.fd = STDIN_FILENO, .events = POLLIN, .revents = 0};
+    if (::poll(&input, 1, static_cast<int>(timeout.count())) <= 0)
+        return {};
+
+    std::array<char, 64> buffer{};
+    const auto num_read = ::read(STDIN_FILENO, buffer.data(), buffer.size());
+    return num_read > 0 ? std::string(buffer.data(), static_cast<std::size_t>(num_read)) : std::string{};
+}
+
+void
+Terminal::write(std::string_view data) {
+    while (!data.empty()) {
+        const auto num_written = ::write(STDOUT_FILENO, data.data(), data.size());
+        if (num_written < 0 && errno == EINTR)
+            continue;
+        if (num_written <= 0)
+            return;
+        data.remove_prefix(static_cast<std::size_t>(num_written));
+    }
+}
+} // namespace elphi::tui